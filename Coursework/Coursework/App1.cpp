@@ -19,15 +19,48 @@ void App1::init(HINSTANCE hinstance, HWND hwnd, int screenWidth, int screenHeigh
 	rastDesc.CullMode = D3D11_CULL_NONE;
 	renderer->getDevice()->CreateRasterizerState(&rastDesc, &RSCullFront);
 	
+	// Queue the models and textures on the worker pool first. They import and decode while the shaders, meshes and shadow maps below are created here,
+	// and their GPU resources are made once they are needed at the end of init.
+	AssetLoader loader(renderer->getDevice(), renderer->getDeviceContext());
+
+	// Loading models
+	// *** //
+	loader.loadModel(&corgiMesh, "res/corgi2.obj", true);
+	loader.loadModel(&houseMesh, "res/house.obj", true);
+	loader.loadModel(&campfireMesh, "res/campfire.obj", true);
+	loader.loadModel(&lampMesh, "res/lamp.obj", true);
+	loader.loadModel(&pierMesh, "res/pier.obj", true);
+	// *** //
+
+	// Load textures
+	// *** //
+	loader.loadTexture(textureMgr, L"brick", L"res/brick1.dds");
+	loader.loadTexture(textureMgr, L"height", L"res/heightmap.png", &heightmap);
+	loader.loadTexture(textureMgr, L"sky", L"res/sky.jpg");
+	loader.loadTexture(textureMgr, L"water_height", L"res/water_heightmap.png");
+	loader.loadTexture(textureMgr, L"water", L"res/water.jpg");
+	loader.loadTexture(textureMgr, L"grass", L"res/grass.jpg");
+	loader.loadTexture(textureMgr, L"corgi", L"res/corgi2black.png");
+	loader.loadTexture(textureMgr, L"house", L"res/house.jpg");
+	loader.loadTexture(textureMgr, L"campfire", L"res/campfire.png");
+	loader.loadTexture(textureMgr, L"metal", L"res/metal.jpg");
+	loader.loadTexture(textureMgr, L"wood", L"res/wood.png");
+	// *** //
+
 	// Initialising shaders
+	// Created on this thread while the workers load, timed with the other assets.
 	// *** //
-	waterShader = new WaterShader(renderer->getDevice(), hwnd);
-	lightShader = new LightShader(renderer->getDevice(), hwnd);
-	depthShader = new DepthShader(renderer->getDevice(), hwnd);
-	textureShader = new TextureShader(renderer->getDevice(), hwnd);
-	terrainShader = new TerrainShader(renderer->getDevice(), hwnd);
-	fireShader = new FireShader(renderer->getDevice(), hwnd);
-	motionBlurShader = new MotionBlurShader(renderer->getDevice(), hwnd);
+	loader.loadNow("WaterShader", [&]() { waterShader = new WaterShader(renderer->getDevice(), hwnd); });
+	loader.loadNow("LightShader", [&]() { lightShader = new LightShader(renderer->getDevice(), hwnd); });
+	loader.loadNow("DepthShader", [&]() { depthShader = new DepthShader(renderer->getDevice(), hwnd); });
+	loader.loadNow("LightShader (quantised)", [&]() { quantisedLightShader = new LightShader(renderer->getDevice(), hwnd, true); });
+	loader.loadNow("DepthShader (quantised)", [&]() { quantisedDepthShader = new DepthShader(renderer->getDevice(), hwnd, true); });
+	loader.loadNow("LightShader (instanced)", [&]() { instancedLightShader = new LightShader(renderer->getDevice(), hwnd, false, true); });
+	loader.loadNow("DepthShader (instanced)", [&]() { instancedDepthShader = new DepthShader(renderer->getDevice(), hwnd, false, true); });
+	loader.loadNow("TextureShader", [&]() { textureShader = new TextureShader(renderer->getDevice(), hwnd); });
+	loader.loadNow("TerrainShader", [&]() { terrainShader = new TerrainShader(renderer->getDevice(), hwnd); });
+	loader.loadNow("FireShader", [&]() { fireShader = new FireShader(renderer->getDevice(), hwnd); });
+	loader.loadNow("MotionBlurShader", [&]() { motionBlurShader = new MotionBlurShader(renderer->getDevice(), hwnd); });
 	// *** //
 
 	// Initialising meshes
@@ -35,37 +68,19 @@ void App1::init(HINSTANCE hinstance, HWND hwnd, int screenWidth, int screenHeigh
 	waterResolution = 50;
 	groundResolution = 100;
 
-	waterMesh = new PlaneTessellationMesh(renderer->getDevice(), renderer->getDeviceContext(), waterResolution);
-	groundMesh = new PlaneMesh(renderer->getDevice(), renderer->getDeviceContext(), groundResolution);
-	sphereMesh = new SphereMesh(renderer->getDevice(), renderer->getDeviceContext());
-	cubeMesh = new CubeMesh(renderer->getDevice(), renderer->getDeviceContext());
-	corgiMesh = new AModel(renderer->getDevice(), "res/corgi2.obj");
-	houseMesh = new AModel(renderer->getDevice(), "res/house.obj");
-	campfireMesh = new AModel(renderer->getDevice(), "res/campfire.obj");
-	lampMesh = new AModel(renderer->getDevice(), "res/lamp.obj");
-	pierMesh = new Model(renderer->getDevice(), renderer->getDeviceContext(), "res/pier.obj");
+	loader.loadNow("PlaneTessellationMesh", [&]() { waterMesh = new PlaneTessellationMesh(renderer->getDevice(), renderer->getDeviceContext(), waterResolution); });
+	// The ground is split into tiles of 16 x 16 quads, each with its own level of detail. Pass a tile count to sample a larger height map more finely.
+	loader.loadNow("TerrainMesh", [&]() { groundMesh = new TerrainMesh(renderer->getDevice(), renderer->getDeviceContext(), groundResolution, 16); });
+	loader.loadNow("SphereMesh", [&]() { sphereMesh = new SphereMesh(renderer->getDevice(), renderer->getDeviceContext()); });
+	loader.loadNow("CubeMesh", [&]() { cubeMesh = new CubeMesh(renderer->getDevice(), renderer->getDeviceContext()); });
 	pointMesh = new CustomPointMesh(renderer->getDevice(), renderer->getDeviceContext());
 	shadowMapMesh = new OrthoMesh(renderer->getDevice(), renderer->getDeviceContext(), 256, 256, screenWidth * 0.35, screenHeight * 0.25); // 256x256 pixels in top right corner
 	// *** //
-	
-
-	// Load textures
-	// *** //
-	textureMgr->loadTexture(L"brick", L"res/brick1.dds");
-	textureMgr->loadTexture(L"height", L"res/heightmap.png");
-	textureMgr->loadTexture(L"sky", L"res/sky.jpg");
-	textureMgr->loadTexture(L"water_height", L"res/water_heightmap.png");
-	textureMgr->loadTexture(L"water", L"res/water.jpg");
-	textureMgr->loadTexture(L"grass", L"res/grass.jpg");
-	textureMgr->loadTexture(L"corgi", L"res/corgi2black.png");
-	textureMgr->loadTexture(L"house", L"res/house.jpg");
-	textureMgr->loadTexture(L"campfire", L"res/campfire.png");
-	textureMgr->loadTexture(L"metal", L"res/metal.jpg");
-	textureMgr->loadTexture(L"wood", L"res/wood.png");
-	// *** //
 
 	// Set amplitude of heightmap. Heightmap has flat surfaces, hills and a lake in the centre. Also used to adjust heightmap's y position.
 	terrainHeight = 30;
+	cameraAboveGround = true;
+	cameraClearance = 1.0f;
 
 	// Set start time to 0.
 	elapsedTime = 0;
@@ -122,14 +137,39 @@ void App1::init(HINSTANCE hinstance, HWND hwnd, int screenWidth, int screenHeigh
 	directionalFar = 75.0f;
 	spotPointNear = 1.0f;
 	spotPointFar = 100.0f;
-
-	for (int i = 0; i < LIGHT_COUNT; i++)
+	shadowMapHeight = (float)shadowmapHeight;
+	lodPixelError = 1.0f;
+	shadowLodPixelError = 4.0f;
+	skyPixelError = 8.0f;
+
+	// Cull the house meshlets in every view.
+	meshletCulling = true;
+	meshletsDrawn = 0;
+	meshletsTested = 0;
+	submeshesDrawn = 0;
+	submeshesTested = 0;
+	groundTilesDrawn = 0;
+	groundTilesTested = 0;
+
+	// Nothing drawn through the render queue yet.
+	depthQueueStats = RenderQueue::StatsType();
+	sceneQueueStats = RenderQueue::StatsType();
+	lightUploadStats = LightShader::UploadStatsType();
+
+	// Batch repeated objects into instanced draws.
+	instancing = true;
+	instanceBuffer = new InstanceBuffer(renderer->getDevice());
+
+	loader.loadNow("Shadow maps", [&]()
 	{
-		for (int j = 0; j < 6; j++)
+		for (int i = 0; i < LIGHT_COUNT; i++)
 		{
-			shadowMaps[i][j] = new ShadowMap(renderer->getDevice(), shadowmapWidth, shadowmapHeight);
+			for (int j = 0; j < 6; j++)
+			{
+				shadowMaps[i][j] = new ShadowMap(renderer->getDevice(), shadowmapWidth, shadowmapHeight);
+			}
 		}
-	}
+	});
 	// *** //
 
 	// Initialise lights.
@@ -199,6 +239,17 @@ void App1::init(HINSTANCE hinstance, HWND hwnd, int screenWidth, int screenHeigh
 	waterFrequency = 0.4;
 	waterSpeed = 0.4;
 	// *** // 
+
+	// Wait for the models and textures, creating each one's buffers or texture as soon as its worker finishes. Then write the load times and memory use.
+	loader.finaliseAll();
+	groundMesh->update(renderer->getDeviceContext(), heightmap, terrainHeight);
+	FILE* loadReport;
+	if (fopen_s(&loadReport, "loading.txt", "w") == 0)
+	{
+		loader.report(loadReport);
+		loader.reportMemory(loadReport);
+		fclose(loadReport);
+	}
 }
 
 void App1::initLights()
@@ -451,6 +502,25 @@ bool App1::frame()
 	{
 		return false;
 	}
+
+	// Rebuild the ground's vertices if the terrain height changed. Does nothing otherwise.
+	groundMesh->update(renderer->getDeviceContext(), heightmap, terrainHeight);
+
+	// Lift the camera back above the ground if it moved into it.
+	if (cameraAboveGround)
+	{
+		XMFLOAT3 cameraPosition = camera->getPosition();
+		float groundHeight;
+		if (groundMesh->getHeight(cameraPosition.x - groundPosition.x, cameraPosition.z - groundPosition.z, groundHeight))
+		{
+			float lowest = groundHeight + groundPosition.y + cameraClearance;
+			if (cameraPosition.y < lowest)
+			{
+				camera->setPosition(cameraPosition.x, lowest, cameraPosition.z);
+				camera->update();
+			}
+		}
+	}
 	
 	// Render the graphics.
 	result = render();
@@ -471,6 +541,14 @@ void App1::depthPass()
 	XMMATRIX cameraProjectionMatrix;
 	XMMATRIX worldMatrix;
 
+	// Count meshlets, parts and ground tiles afresh for this pass.
+	meshletsDrawn = 0;
+	meshletsTested = 0;
+	submeshesDrawn = 0;
+	submeshesTested = 0;
+	groundTilesDrawn = 0;
+	groundTilesTested = 0;
+
 	// Iterate through each light.
 	for (int i = 0; i < LIGHT_COUNT; i++)
 	{
@@ -497,7 +575,7 @@ void App1::depthPass()
 				projMatrices[i][0] = lightProjectionMatrix;
 
 				// Render the scene using the generated matrices.
-				depthRender(worldMatrix, lightViewMatrix, lightProjectionMatrix);
+				depthRender(worldMatrix, lightViewMatrix, lightProjectionMatrix, shadowMapHeight, shadowLodPixelError);
 
 				// Set back buffer as render target and reset view port.
 				renderer->setBackBufferRenderTarget();
@@ -523,7 +601,7 @@ void App1::depthPass()
 				projMatrices[i][0] = lightProjectionMatrix;
 
 				// Render the scene using the generated matrices.
-				depthRender(worldMatrix, lightViewMatrix, lightProjectionMatrix);
+				depthRender(worldMatrix, lightViewMatrix, lightProjectionMatrix, shadowMapHeight, shadowLodPixelError);
 
 				// Set back buffer as render target and reset view port.
 				renderer->setBackBufferRenderTarget();
@@ -575,7 +653,7 @@ void App1::depthPass()
 					projMatrices[i][j] = lightProjectionMatrix;
 
 					// Render the scene using the generated matrices.
-					depthRender(worldMatrix, lightViewMatrix, lightProjectionMatrix);
+					depthRender(worldMatrix, lightViewMatrix, lightProjectionMatrix, shadowMapHeight, shadowLodPixelError);
 
 					// Set back buffer as render target and reset view port.
 					renderer->setBackBufferRenderTarget();
@@ -599,20 +677,16 @@ void App1::depthPass()
 	depthMap->BindDsvAndSetNullRenderTarget(renderer->getDeviceContext());
 
 	// Render scene from the camera's perspective.
-	depthRender(worldMatrix, cameraViewMatrix, cameraProjectionMatrix);
+	depthRender(worldMatrix, cameraViewMatrix, cameraProjectionMatrix, (float)sHeight, lodPixelError);
 
-	// Render fire particles to the depth map. This is done outside of the main depth render function so that it doesn't occur during shadow mapping. If particles cast shadows, they would be rendered up to 130000 times a frame (24 shadow maps + depth map + scene render * max particle limit of 5000).
+	// Render fire particles to the depth map. This is done outside of the main depth render function so that it doesn't occur during shadow mapping, which would draw them up to 24 more times a frame.
 	if (fireToggle && blurFireParticles)
 	{
-		// Render each particle using the fire geometry shader.
-		for (int i = 0; i < fireParticleCount; i++)
-		{
-			worldMatrix = renderer->getWorldMatrix();
-			worldMatrix *= XMMatrixTranslation(fireParticle[i].position.x, fireParticle[i].position.y, fireParticle[i].position.z);
-			pointMesh->sendData(renderer->getDeviceContext());
-			fireShader->setShaderParameters(renderer->getDeviceContext(), worldMatrix, cameraViewMatrix, cameraProjectionMatrix, NULL, camera, elapsedTime + i, fireParticle[i].size, fireParticle[i].position.y, maxHeight, minHeight, fireBottomColour, fireTopColour, renderNormals);
-			fireShader->render(renderer->getDeviceContext(), pointMesh->getIndexCount());
-		}
+		// Render every particle in one draw using the fire geometry shader.
+		worldMatrix = renderer->getWorldMatrix();
+		pointMesh->sendData(renderer->getDeviceContext());
+		fireShader->setShaderParameters(renderer->getDeviceContext(), worldMatrix, cameraViewMatrix, cameraProjectionMatrix, NULL, camera, elapsedTime, maxHeight, minHeight, fireBottomColour, fireTopColour, renderNormals);
+		fireShader->renderVertices(renderer->getDeviceContext(), pointMesh->getPointCount());
 	}
 
 	// Set back buffer as render target and reset view port.
@@ -620,23 +694,28 @@ void App1::depthPass()
 	renderer->resetViewport();
 }
 
-void App1::depthRender(XMMATRIX world, XMMATRIX view, XMMATRIX projection)
+void App1::depthRender(XMMATRIX world, XMMATRIX view, XMMATRIX projection, float viewportHeight, float pixelError)
 {
 	// Use basic depth shader where possible to improve performance as lighting is not calculated. Objects that are affected by vertex manipulation use their own shader.
+	// Every object is submitted to the render queue first, then drawn sorted by shader and front to back.
+	int lod; // Level of detail used for each model.
+	RenderQueue::PacketType packet;
+	renderQueue.clear();
 
 	// Render water.
 	world = renderer->getWorldMatrix();
 	world *= XMMatrixTranslation(waterPosition.x, waterPosition.y, waterPosition.z);
-	waterMesh->sendData(renderer->getDeviceContext());
-	waterShader->setShaderParameters(renderer->getDeviceContext(), world, view, projection, tessProperties, elapsedTime, waterAmplitude, waterFrequency, waterSpeed, camera->getPosition(), viewMatrices, projMatrices, textureMgr->getTexture(L"water_height"));
-	waterShader->render(renderer->getDeviceContext(), waterMesh->getIndexCount());
+	renderQueue.submit(makePacket(waterMesh, waterShader, NULL, world, view, PASS_OPAQUE));
 	
 	// Render ground.
+	// The heights are baked into the mesh, so it only needs the depth shader.
+	// Only the tiles inside this view are drawn, each at the level of detail its distance allows.
 	world = renderer->getWorldMatrix();
 	world *= XMMatrixTranslation(groundPosition.x, groundPosition.y, groundPosition.z);
-	groundMesh->sendData(renderer->getDeviceContext());
-	terrainShader->setShaderParameters(renderer->getDeviceContext(), world, view, projection, textureMgr->getTexture(L"height"), terrainHeight, viewMatrices, projMatrices, camera->getPosition());
-	terrainShader->render(renderer->getDeviceContext(), groundMesh->getIndexCount());
+	groundRanges.clear();
+	groundTilesDrawn += groundMesh->select(world, view, projection, viewportHeight, pixelError, groundRanges);
+	groundTilesTested += groundMesh->getTileCount();
+	renderQueue.submit(makePacket(groundMesh, depthShader, NULL, world, view, PASS_OPAQUE), groundRanges);
 
 	// Render dog.
 	world = renderer->getWorldMatrix();
@@ -645,45 +724,70 @@ void App1::depthRender(XMMATRIX world, XMMATRIX view, XMMATRIX projection)
 	world *= XMMatrixTranslation(corgi.position.x, corgi.position.y, corgi.position.z);
 	world *= XMMatrixRotationY(corgiRotation); 
 	world *= XMMatrixTranslation(campfire.position.x, campfire.position.y, campfire.position.z);
-	corgiMesh->sendData(renderer->getDeviceContext());
-	depthShader->setShaderParameters(renderer->getDeviceContext(), world, view, projection);
-	depthShader->render(renderer->getDeviceContext(), corgiMesh->getIndexCount());
+	lod = corgiMesh->selectLod(world, view, projection, viewportHeight, pixelError);
+	// Only the parts of the model inside this view are drawn.
+	submeshRanges.clear();
+	submeshesDrawn += corgiMesh->cullSubmeshes(world, view, projection, lod, submeshRanges);
+	submeshesTested += corgiMesh->getSubmeshCount();
+	renderQueue.submit(makePacket(corgiMesh, quantisedDepthShader, NULL, world, view, PASS_OPAQUE), submeshRanges);
 
 	// Render campfire.
 	world = renderer->getWorldMatrix();
 	world *= XMMatrixScaling(campfire.scale.x, campfire.scale.y, campfire.scale.z);
 	world *= XMMatrixRotationY(campfire.rotationY);
 	world *= XMMatrixTranslation(campfire.position.x, campfire.position.y, campfire.position.z);
-	campfireMesh->sendData(renderer->getDeviceContext());
-	depthShader->setShaderParameters(renderer->getDeviceContext(), world, view, projection);
-	depthShader->render(renderer->getDeviceContext(), campfireMesh->getIndexCount());
+	lod = campfireMesh->selectLod(world, view, projection, viewportHeight, pixelError);
+	// Only the parts of the model inside this view are drawn.
+	submeshRanges.clear();
+	submeshesDrawn += campfireMesh->cullSubmeshes(world, view, projection, lod, submeshRanges);
+	submeshesTested += campfireMesh->getSubmeshCount();
+	renderQueue.submit(makePacket(campfireMesh, quantisedDepthShader, NULL, world, view, PASS_OPAQUE), submeshRanges);
 
 	// Render house.
 	world = renderer->getWorldMatrix();
 	world *= XMMatrixScaling(house.scale.x, house.scale.y, house.scale.z);
 	world *= XMMatrixRotationY(house.rotationY);
 	world *= XMMatrixTranslation(house.position.x, house.position.y, house.position.z);
-	houseMesh->sendData(renderer->getDeviceContext());
-	depthShader->setShaderParameters(renderer->getDeviceContext(), world, view, projection);
-	depthShader->render(renderer->getDeviceContext(), houseMesh->getIndexCount());
+	lod = houseMesh->selectLod(world, view, projection, viewportHeight, pixelError);
+	if (meshletCulling && lod == 0)
+	{
+		// Meshlets split the full detail level. Culled with the plain world matrix, they are stored unquantised.
+		meshletRanges.clear();
+		meshletsDrawn += houseMesh->cullMeshlets(world, view, projection, meshletRanges);
+		meshletsTested += houseMesh->getMeshletCount();
+		renderQueue.submit(makePacket(houseMesh, quantisedDepthShader, NULL, world, view, PASS_OPAQUE), meshletRanges);
+	}
+	else
+	{
+		// Only the parts of the model inside this view are drawn.
+		submeshRanges.clear();
+		submeshesDrawn += houseMesh->cullSubmeshes(world, view, projection, lod, submeshRanges);
+		submeshesTested += houseMesh->getSubmeshCount();
+		renderQueue.submit(makePacket(houseMesh, quantisedDepthShader, NULL, world, view, PASS_OPAQUE), submeshRanges);
+	}
 
 	// Render lamp.
 	world = renderer->getWorldMatrix();
 	world *= XMMatrixScaling(lamp.scale.x, lamp.scale.y, lamp.scale.z);
 	world *= XMMatrixRotationY(lamp.rotationY);
 	world *= XMMatrixTranslation(lamp.position.x, lamp.position.y, lamp.position.z);
-	lampMesh->sendData(renderer->getDeviceContext());
-	depthShader->setShaderParameters(renderer->getDeviceContext(), world, view, projection);
-	depthShader->render(renderer->getDeviceContext(), lampMesh->getIndexCount());
+	lod = lampMesh->selectLod(world, view, projection, viewportHeight, pixelError);
+	// Only the parts of the model inside this view are drawn.
+	submeshRanges.clear();
+	submeshesDrawn += lampMesh->cullSubmeshes(world, view, projection, lod, submeshRanges);
+	submeshesTested += lampMesh->getSubmeshCount();
+	renderQueue.submit(makePacket(lampMesh, quantisedDepthShader, NULL, world, view, PASS_OPAQUE), submeshRanges);
 
 	// Render pier.
 	world = renderer->getWorldMatrix();
 	world *= XMMatrixScaling(pier.scale.x, pier.scale.y, pier.scale.z);
 	world *= XMMatrixRotationY(pier.rotationY);
 	world *= XMMatrixTranslation(pier.position.x, pier.position.y, pier.position.z);
-	pierMesh->sendData(renderer->getDeviceContext());
-	depthShader->setShaderParameters(renderer->getDeviceContext(), world, view, projection);
-	depthShader->render(renderer->getDeviceContext(), pierMesh->getIndexCount());
+	lod = pierMesh->selectLod(world, view, projection, viewportHeight, pixelError);
+	packet = makePacket(pierMesh, quantisedDepthShader, NULL, world, view, PASS_OPAQUE);
+	packet.indexCount = pierMesh->getLodIndexCount(lod);
+	packet.indexStart = pierMesh->getLodIndexStart(lod);
+	renderQueue.submit(packet);
 
 	// Render spheres.
 	for (int i = 0; i < SPHERE_COUNT; i++)
@@ -692,9 +796,11 @@ void App1::depthRender(XMMATRIX world, XMMATRIX view, XMMATRIX projection)
 		world *= XMMatrixScaling(spheres[i].scale.x, spheres[i].scale.y, spheres[i].scale.z);
 		world *= XMMatrixRotationY(spheres[i].rotationY);
 		world *= XMMatrixTranslation(spheres[i].position.x, spheres[i].position.y, spheres[i].position.z);
-		sphereMesh->sendData(renderer->getDeviceContext());
-		depthShader->setShaderParameters(renderer->getDeviceContext(), world, view, projection);
-		depthShader->render(renderer->getDeviceContext(), sphereMesh->getIndexCount());
+		lod = sphereMesh->selectLod(world, view, projection, viewportHeight, pixelError);
+		packet = makePacket(sphereMesh, depthShader, NULL, world, view, PASS_OPAQUE);
+		packet.indexCount = sphereMesh->getLodIndexCount(lod);
+		packet.indexStart = sphereMesh->getLodIndexStart(lod);
+		renderQueue.submit(packet);
 	}
 
 	// Render cubes.
@@ -704,13 +810,146 @@ void App1::depthRender(XMMATRIX world, XMMATRIX view, XMMATRIX projection)
 		world *= XMMatrixScaling(cubes[i].scale.x, cubes[i].scale.y, cubes[i].scale.z);
 		world *= XMMatrixRotationY(cubes[i].rotationY);
 		world *= XMMatrixTranslation(cubes[i].position.x, cubes[i].position.y, cubes[i].position.z);
+		renderQueue.submit(makePacket(cubeMesh, depthShader, NULL, world, view, PASS_OPAQUE));
+	}
+
+	// Draw everything submitted, sorted by shader and then front to back.
+	QueueBackend backend(this, view, projection, true);
+	renderQueue.setInstancing(instancing);
+	renderQueue.sort();
+	renderQueue.execute(backend);
+	depthQueueStats = renderQueue.getStats();
+}
+
+RenderQueue::PacketType App1::makePacket(BaseMesh* mesh, BaseShader* shader, ID3D11ShaderResourceView* texture, const XMMATRIX& world, const XMMATRIX& view, int pass)
+{
+	RenderQueue::PacketType packet = {};
+	packet.mesh = mesh;
+	packet.shader = shader;
+	packet.material = texture;
+
+	// The queue batches copies of the mesh drawn with the light or depth shader into one instanced draw.
+	if (shader == lightShader)
+	{
+		packet.instancedShader = instancedLightShader;
+	}
+	else if (shader == depthShader)
+	{
+		packet.instancedShader = instancedDepthShader;
+	}
+
+	// Quantised models decode their positions with this matrix, it is the identity for the others.
+	XMStoreFloat4x4(&packet.world, mesh->getDecodeMatrix() * world);
+	packet.depth = RenderQueue::getViewDepth(world, view);
+	packet.pass = pass;
+	packet.indexCount = mesh->getIndexCount();
+	return packet;
+}
+
+App1::QueueBackend::QueueBackend(App1* lapp, const XMMATRIX& lview, const XMMATRIX& lprojection, bool ldepthOnly)
+{
+	app = lapp;
+	view = lview;
+	projection = lprojection;
+	depthOnly = ldepthOnly;
+}
+
+void App1::QueueBackend::beginPass(int pass)
+{
+	if (pass == PASS_SKY)
+	{
+		// Cull front face and disable depth buffer, the camera is inside the sky sphere.
+		app->renderer->getDeviceContext()->RSSetState(app->RSCullFront);
+		app->renderer->setZBuffer(false);
+	}
+	else if (!depthOnly)
+	{
+		// Re-enable depth buffer, return to default rasterizer state and set wireframe mode.
+		app->renderer->setZBuffer(true);
+		app->renderer->getDeviceContext()->RSSetState(app->RSDefault);
+		app->renderer->setWireframeMode(app->wireframeToggle);
+	}
+}
+
+void App1::QueueBackend::bindMesh(const void* mesh)
+{
+	// Called through the water's own type, its default topology is a patch list.
+	if (mesh == app->waterMesh)
+	{
+		app->waterMesh->sendData(app->renderer->getDeviceContext());
+	}
+	else
+	{
+		((BaseMesh*)mesh)->sendData(app->renderer->getDeviceContext());
+	}
+}
+
+void App1::QueueBackend::draw(const RenderQueue::PacketType& packet, const MeshletBuilder::RangeType* ranges)
+{
+	ID3D11DeviceContext* deviceContext = app->renderer->getDeviceContext();
+	BaseShader* shader = (BaseShader*)packet.shader;
+	ID3D11ShaderResourceView* texture = (ID3D11ShaderResourceView*)packet.material;
+	XMMATRIX world = XMLoadFloat4x4(&packet.world);
+
+	if (shader == app->waterShader)
+	{
+		// Set both light and water shaders when rendering. The water shader uses light's pixel shader when rendering.
+		// Light first, so the water shader's vertex stage buffers replace the light shader's.
+		if (!depthOnly)
+		{
+			app->lightShader->setShaderParameters(deviceContext, world, texture, app->lights, app->lightProperties, packet.parameters.x, app->shadowMaps, app->shadowMapBias, app->renderNormals, true, app->textureMgr->getTexture(L"water_height"), app->waterAmplitude, app->waterResolution);
+		}
+		app->waterShader->setShaderParameters(deviceContext, world, view, projection, app->tessProperties, app->elapsedTime, app->waterAmplitude, app->waterFrequency, app->waterSpeed, app->camera->getPosition(), app->viewMatrices, app->projMatrices, app->textureMgr->getTexture(L"water_height"));
+	}
+	else if (shader == app->terrainShader)
+	{
+		// Set both light and terrain shaders when rendering. The terrain shader uses light's pixel shader when rendering.
+		// Light first, so the terrain shader's vertex buffers replace the light shader's.
+		app->lightShader->setShaderParameters(deviceContext, world, texture, app->lights, app->lightProperties, packet.parameters.x, app->shadowMaps, app->shadowMapBias, app->renderNormals, true, app->textureMgr->getTexture(L"height"), app->terrainHeight, app->groundResolution);
+		app->terrainShader->setShaderParameters(deviceContext, world, view, projection, app->viewMatrices, app->projMatrices, app->camera->getPosition());
+	}
+	else if (shader == app->lightShader || shader == app->quantisedLightShader)
+	{
+		((LightShader*)shader)->setShaderParameters(deviceContext, world, texture, app->lights, app->lightProperties, packet.parameters.x, app->shadowMaps, app->shadowMapBias, app->renderNormals, false, NULL, NULL, NULL);
+	}
+	else if (shader == app->textureShader)
+	{
+		app->textureShader->setShaderParameters(deviceContext, world, view, projection, texture, packet.parameters);
+	}
+	else
+	{
+		((DepthShader*)shader)->setShaderParameters(deviceContext, world, view, projection);
+	}
 
-		cubeMesh->sendData(renderer->getDeviceContext());
-		depthShader->setShaderParameters(renderer->getDeviceContext(), world, view, projection);
-		depthShader->render(renderer->getDeviceContext(), cubeMesh->getIndexCount());
+	if (ranges)
+	{
+		shader->render(deviceContext, ranges, packet.rangeCount);
+	}
+	else
+	{
+		shader->render(deviceContext, packet.indexCount, packet.indexStart);
 	}
 }
 
+void App1::QueueBackend::drawInstanced(const RenderQueue::PacketType& first, const XMFLOAT4X4* worlds, int count)
+{
+	ID3D11DeviceContext* deviceContext = app->renderer->getDeviceContext();
+	ID3D11ShaderResourceView* texture = (ID3D11ShaderResourceView*)first.material;
+	XMMATRIX world = XMMatrixIdentity(); // Each instance's world matrix comes from the instance buffer instead.
+
+	if (first.instancedShader == app->instancedLightShader)
+	{
+		app->instancedLightShader->setShaderParameters(deviceContext, world, texture, app->lights, app->lightProperties, first.parameters.x, app->shadowMaps, app->shadowMapBias, app->renderNormals, false, NULL, NULL, NULL);
+	}
+	else
+	{
+		((DepthShader*)first.instancedShader)->setShaderParameters(deviceContext, world, view, projection);
+	}
+
+	app->instanceBuffer->write(deviceContext, worlds, count);
+	((BaseShader*)first.instancedShader)->renderInstanced(deviceContext, first.indexCount, first.indexStart, count);
+}
+
 void App1::blurPass()
 {
 	// Matrices used for rendering the ortho mesh.
@@ -730,7 +969,7 @@ void App1::blurPass()
 	// Render the ortho mesh across the full screen.
 	renderer->setZBuffer(false);
 	blurOrthoMesh->sendData(renderer->getDeviceContext());
-	motionBlurShader->setShaderParameters(renderer->getDeviceContext(), worldMatrix, orthoViewMatrix, orthoMatrix, depthMap->getDepthMapSRV(), sceneRenderTexture->getShaderResourceView(), viewProjectionInverse, previousViewProjection, blurSamples, blurStrength);
+	motionBlurShader->setShaderParameters(renderer->getDeviceContext(), blurOrthoMesh->getPlacementMatrix() * worldMatrix, orthoViewMatrix, orthoMatrix, depthMap->getDepthMapSRV(), sceneRenderTexture->getShaderResourceView(), viewProjectionInverse, previousViewProjection, blurSamples, blurStrength);
 	motionBlurShader->render(renderer->getDeviceContext(), blurOrthoMesh->getIndexCount());
 	renderer->setZBuffer(true);
 
@@ -774,28 +1013,25 @@ void App1::scenePass()
 	XMMATRIX projectionMatrix = renderer->getProjectionMatrix();
 	XMMATRIX orthoMatrix = renderer->getOrthoMatrix();
 	XMMATRIX orthoViewMatrix = camera->getOrthoViewMatrix();
+	int lod; // Level of detail used for each model.
+	RenderQueue::PacketType packet;
+
+	// Every object is submitted to the render queue first, then drawn sorted by pass, shader, texture and front to back.
+	renderQueue.clear();
 
 	// Basic skybox - one texture wrapped around sphere. Could be improved using cube mapping to wrap multiple textures.
 	// *** //
-	// Cull front face.
-	renderer->getDeviceContext()->RSSetState(RSCullFront);
-
-	// Disable depth buffer.
-	renderer->setZBuffer(false);
-
+	// The sky pass culls front faces and disables the depth buffer (see QueueBackend::beginPass()).
 	// Render sphere at camera's position so camera is inside the sphere.
+	// The outline never shows from the inside, so use the coarsest level that keeps the texture close to where the full sphere shows it.
 	worldMatrix = renderer->getWorldMatrix();
 	worldMatrix *= XMMatrixTranslation(camera->getPosition().x, camera->getPosition().y, camera->getPosition().z);
-	sphereMesh->sendData(renderer->getDeviceContext());
-	textureShader->setShaderParameters(renderer->getDeviceContext(), worldMatrix, viewMatrix, projectionMatrix, textureMgr->getTexture(L"sky"), XMFLOAT4(0, 0, 0, 1));
-	textureShader->render(renderer->getDeviceContext(), sphereMesh->getIndexCount());
-
-	// Re-enable depth buffer.
-	renderer->setZBuffer(true);
-
-	// Return to default rasterizer state and set wireframe mode.
-	renderer->getDeviceContext()->RSSetState(RSDefault);
-	renderer->setWireframeMode(wireframeToggle);
+	lod = sphereMesh->selectInsideLod(projectionMatrix, (float)sHeight, skyPixelError);
+	packet = makePacket(sphereMesh, textureShader, textureMgr->getTexture(L"sky"), worldMatrix, viewMatrix, PASS_SKY);
+	packet.parameters = XMFLOAT4(0, 0, 0, 1);
+	packet.indexCount = sphereMesh->getLodIndexCount(lod);
+	packet.indexStart = sphereMesh->getLodIndexStart(lod);
+	renderQueue.submit(packet);
 	// *** //
 
 	// Render water.
@@ -803,22 +1039,22 @@ void App1::scenePass()
 	worldMatrix = renderer->getWorldMatrix();
 	worldMatrix *= XMMatrixTranslation(waterPosition.x, waterPosition.y, waterPosition.z);
 
-	// Set both water and light shaders when rendering. The water shader uses light's pixel shader when rendering.
-	waterMesh->sendData(renderer->getDeviceContext());
-	waterShader->setShaderParameters(renderer->getDeviceContext(), worldMatrix, viewMatrix, projectionMatrix, tessProperties, elapsedTime, waterAmplitude, waterFrequency, waterSpeed, camera->getPosition(), viewMatrices, projMatrices, textureMgr->getTexture(L"water_height"));
-	lightShader->setShaderParameters(renderer->getDeviceContext(), worldMatrix, viewMatrix, projectionMatrix, textureMgr->getTexture(L"water"), lights, camera->getPosition(), lightProperties, specularValues.water, shadowMaps, shadowMapBias, viewMatrices, projMatrices, renderNormals, true, textureMgr->getTexture(L"water_height"), waterAmplitude, waterResolution); 
-	waterShader->render(renderer->getDeviceContext(), waterMesh->getIndexCount());
+	// Drawn with both water and light shaders. The water shader uses light's pixel shader when rendering.
+	packet = makePacket(waterMesh, waterShader, textureMgr->getTexture(L"water"), worldMatrix, viewMatrix, PASS_OPAQUE);
+	packet.parameters.x = specularValues.water;
+	renderQueue.submit(packet);
 	
 	// Render ground.
 	// Apply position matrix transformation.
 	worldMatrix = renderer->getWorldMatrix();
 	worldMatrix *= XMMatrixTranslation(groundPosition.x, groundPosition.y, groundPosition.z);
 
-	// Set both terrain and light shaders when rendering. The terrain shader uses light's pixel shader when rendering.
-	groundMesh->sendData(renderer->getDeviceContext());
-	terrainShader->setShaderParameters(renderer->getDeviceContext(), worldMatrix, viewMatrix, projectionMatrix, textureMgr->getTexture(L"height"), terrainHeight, viewMatrices, projMatrices, camera->getPosition());
-	lightShader->setShaderParameters(renderer->getDeviceContext(), worldMatrix, viewMatrix, projectionMatrix, textureMgr->getTexture(L"grass"), lights, camera->getPosition(), lightProperties, specularValues.ground, shadowMaps, shadowMapBias, viewMatrices, projMatrices, renderNormals, true, textureMgr->getTexture(L"height"), terrainHeight, groundResolution);
-	terrainShader->render(renderer->getDeviceContext(), groundMesh->getIndexCount());
+	// Drawn with both terrain and light shaders. The terrain shader uses light's pixel shader when rendering.
+	groundRanges.clear();
+	groundMesh->select(worldMatrix, viewMatrix, projectionMatrix, (float)sHeight, lodPixelError, groundRanges);
+	packet = makePacket(groundMesh, terrainShader, textureMgr->getTexture(L"grass"), worldMatrix, viewMatrix, PASS_OPAQUE);
+	packet.parameters.x = specularValues.ground;
+	renderQueue.submit(packet, groundRanges);
 
 	// Render corgi.
 	// Apply matrix transformations. The corgi has extra transformations for moving around the campfire.
@@ -830,9 +1066,12 @@ void App1::scenePass()
 	worldMatrix *= XMMatrixTranslation(campfire.position.x, campfire.position.y, campfire.position.z); // Move to campfire's position.
 
 	// Render the corgi using the light shader.
-	corgiMesh->sendData(renderer->getDeviceContext());
-	lightShader->setShaderParameters(renderer->getDeviceContext(), worldMatrix, viewMatrix, projectionMatrix, textureMgr->getTexture(L"corgi"), lights, camera->getPosition(), lightProperties, specularValues.dog, shadowMaps, shadowMapBias, viewMatrices, projMatrices, renderNormals, false, NULL, NULL, NULL);
-	lightShader->render(renderer->getDeviceContext(), corgiMesh->getIndexCount());
+	lod = corgiMesh->selectLod(worldMatrix, viewMatrix, projectionMatrix, (float)sHeight, lodPixelError);
+	submeshRanges.clear();
+	corgiMesh->cullSubmeshes(worldMatrix, viewMatrix, projectionMatrix, lod, submeshRanges);
+	packet = makePacket(corgiMesh, quantisedLightShader, textureMgr->getTexture(L"corgi"), worldMatrix, viewMatrix, PASS_OPAQUE);
+	packet.parameters.x = specularValues.dog;
+	renderQueue.submit(packet, submeshRanges);
 
 	// Render campfire.
 	// Apply matrix transformations.
@@ -842,9 +1081,12 @@ void App1::scenePass()
 	worldMatrix *= XMMatrixTranslation(campfire.position.x, campfire.position.y, campfire.position.z);
 
 	// Render campfire using light shader.
-	campfireMesh->sendData(renderer->getDeviceContext());
-	lightShader->setShaderParameters(renderer->getDeviceContext(), worldMatrix, viewMatrix, projectionMatrix, textureMgr->getTexture(L"campfire"), lights, camera->getPosition(), lightProperties, specularValues.wood, shadowMaps, shadowMapBias, viewMatrices, projMatrices, renderNormals, false, NULL, NULL, NULL);
-	lightShader->render(renderer->getDeviceContext(), campfireMesh->getIndexCount());
+	lod = campfireMesh->selectLod(worldMatrix, viewMatrix, projectionMatrix, (float)sHeight, lodPixelError);
+	submeshRanges.clear();
+	campfireMesh->cullSubmeshes(worldMatrix, viewMatrix, projectionMatrix, lod, submeshRanges);
+	packet = makePacket(campfireMesh, quantisedLightShader, textureMgr->getTexture(L"campfire"), worldMatrix, viewMatrix, PASS_OPAQUE);
+	packet.parameters.x = specularValues.wood;
+	renderQueue.submit(packet, submeshRanges);
 
 	// Render house.
 	// Apply matrix transformations.
@@ -854,9 +1096,12 @@ void App1::scenePass()
 	worldMatrix *= XMMatrixTranslation(house.position.x, house.position.y, house.position.z);
 
 	// Render house using light shader.
-	houseMesh->sendData(renderer->getDeviceContext());
-	lightShader->setShaderParameters(renderer->getDeviceContext(), worldMatrix, viewMatrix, projectionMatrix, textureMgr->getTexture(L"house"), lights, camera->getPosition(), lightProperties, specularValues.wood, shadowMaps, shadowMapBias, viewMatrices, projMatrices, renderNormals, false, NULL, NULL, NULL);
-	lightShader->render(renderer->getDeviceContext(), houseMesh->getIndexCount());
+	lod = houseMesh->selectLod(worldMatrix, viewMatrix, projectionMatrix, (float)sHeight, lodPixelError);
+	submeshRanges.clear();
+	houseMesh->cullSubmeshes(worldMatrix, viewMatrix, projectionMatrix, lod, submeshRanges);
+	packet = makePacket(houseMesh, quantisedLightShader, textureMgr->getTexture(L"house"), worldMatrix, viewMatrix, PASS_OPAQUE);
+	packet.parameters.x = specularValues.wood;
+	renderQueue.submit(packet, submeshRanges);
 
 	// Render lamp.
 	// Apply matrix transformations.
@@ -866,9 +1111,12 @@ void App1::scenePass()
 	worldMatrix *= XMMatrixTranslation(lamp.position.x, lamp.position.y, lamp.position.z);
 
 	// Render lamp using light shader.
-	lampMesh->sendData(renderer->getDeviceContext());
-	lightShader->setShaderParameters(renderer->getDeviceContext(), worldMatrix, viewMatrix, projectionMatrix, textureMgr->getTexture(L"metal"), lights, camera->getPosition(), lightProperties, specularValues.metal, shadowMaps, shadowMapBias, viewMatrices, projMatrices, renderNormals, false, NULL, NULL, NULL);
-	lightShader->render(renderer->getDeviceContext(), lampMesh->getIndexCount());
+	lod = lampMesh->selectLod(worldMatrix, viewMatrix, projectionMatrix, (float)sHeight, lodPixelError);
+	submeshRanges.clear();
+	lampMesh->cullSubmeshes(worldMatrix, viewMatrix, projectionMatrix, lod, submeshRanges);
+	packet = makePacket(lampMesh, quantisedLightShader, textureMgr->getTexture(L"metal"), worldMatrix, viewMatrix, PASS_OPAQUE);
+	packet.parameters.x = specularValues.metal;
+	renderQueue.submit(packet, submeshRanges);
 
 	// Render pier.
 	// Apply matrix transformations.
@@ -878,9 +1126,12 @@ void App1::scenePass()
 	worldMatrix *= XMMatrixTranslation(pier.position.x, pier.position.y, pier.position.z);
 
 	// Render pier using light shader.
-	pierMesh->sendData(renderer->getDeviceContext());
-	lightShader->setShaderParameters(renderer->getDeviceContext(), worldMatrix, viewMatrix, projectionMatrix, textureMgr->getTexture(L"wood"), lights, camera->getPosition(), lightProperties, specularValues.wood, shadowMaps, shadowMapBias, viewMatrices, projMatrices, renderNormals, false, NULL, NULL, NULL);
-	lightShader->render(renderer->getDeviceContext(), pierMesh->getIndexCount());
+	lod = pierMesh->selectLod(worldMatrix, viewMatrix, projectionMatrix, (float)sHeight, lodPixelError);
+	packet = makePacket(pierMesh, quantisedLightShader, textureMgr->getTexture(L"wood"), worldMatrix, viewMatrix, PASS_OPAQUE);
+	packet.parameters.x = specularValues.wood;
+	packet.indexCount = pierMesh->getLodIndexCount(lod);
+	packet.indexStart = pierMesh->getLodIndexStart(lod);
+	renderQueue.submit(packet);
 	
 	// Render spheres.
 	for (int i = 0; i < SPHERE_COUNT; i++)
@@ -892,9 +1143,12 @@ void App1::scenePass()
 		worldMatrix *= XMMatrixTranslation(spheres[i].position.x, spheres[i].position.y, spheres[i].position.z);
 
 		// Render sphere using light shader.
-		sphereMesh->sendData(renderer->getDeviceContext());
-		lightShader->setShaderParameters(renderer->getDeviceContext(), worldMatrix, viewMatrix, projectionMatrix, textureMgr->getTexture(L"metal"), lights, camera->getPosition(), lightProperties, specularValues.metal, shadowMaps, shadowMapBias, viewMatrices, projMatrices, renderNormals, false, NULL, NULL, NULL);
-		lightShader->render(renderer->getDeviceContext(), sphereMesh->getIndexCount());
+		lod = sphereMesh->selectLod(worldMatrix, viewMatrix, projectionMatrix, (float)sHeight, lodPixelError);
+		packet = makePacket(sphereMesh, lightShader, textureMgr->getTexture(L"metal"), worldMatrix, viewMatrix, PASS_OPAQUE);
+		packet.parameters.x = specularValues.metal;
+		packet.indexCount = sphereMesh->getLodIndexCount(lod);
+		packet.indexStart = sphereMesh->getLodIndexStart(lod);
+		renderQueue.submit(packet);
 	}
 	
 	for (int i = 0; i < CUBE_COUNT; i++)
@@ -906,24 +1160,9 @@ void App1::scenePass()
 		worldMatrix *= XMMatrixTranslation(cubes[i].position.x, cubes[i].position.y, cubes[i].position.z);
 
 		// Render cube using light shader.
-		cubeMesh->sendData(renderer->getDeviceContext());
-		lightShader->setShaderParameters(renderer->getDeviceContext(), worldMatrix, viewMatrix, projectionMatrix, textureMgr->getTexture(L"metal"), lights, camera->getPosition(), lightProperties, specularValues.metal, shadowMaps, shadowMapBias, viewMatrices, projMatrices, renderNormals, false, NULL, NULL, NULL);
-		lightShader->render(renderer->getDeviceContext(), cubeMesh->getIndexCount());
-	}
-	
-	// If the fire is enabled.
-	if (fireToggle)
-	{
-		// Render each fire particle.
-		for (int i = 0; i < fireParticleCount; i++)
-		{
-			// Generate fire particle using the fire's position and particle size.
-			worldMatrix = renderer->getWorldMatrix();
-			worldMatrix *= XMMatrixTranslation(fireParticle[i].position.x, fireParticle[i].position.y, fireParticle[i].position.z);
-			pointMesh->sendData(renderer->getDeviceContext());
-			fireShader->setShaderParameters(renderer->getDeviceContext(), worldMatrix, viewMatrix, projectionMatrix, NULL, camera, elapsedTime + i, fireParticle[i].size, fireParticle[i].position.y, maxHeight, minHeight, fireBottomColour, fireTopColour, renderNormals);
-			fireShader->render(renderer->getDeviceContext(), pointMesh->getIndexCount());
-		}
+		packet = makePacket(cubeMesh, lightShader, textureMgr->getTexture(L"metal"), worldMatrix, viewMatrix, PASS_OPAQUE);
+		packet.parameters.x = specularValues.metal;
+		renderQueue.submit(packet);
 	}
 	
 	// If rendering the light's position is enabled.
@@ -944,14 +1183,50 @@ void App1::scenePass()
 					worldMatrix *= XMMatrixTranslation(lights[i]->getPosition().x, lights[i]->getPosition().y, lights[i]->getPosition().z);
 
 					// Render using the texture shader as the sphere doesn't need to be affected by lighting.
-					sphereMesh->sendData(renderer->getDeviceContext());
-					textureShader->setShaderParameters(renderer->getDeviceContext(), worldMatrix, viewMatrix, projectionMatrix, NULL, lights[i]->getDiffuseColour());
-					textureShader->render(renderer->getDeviceContext(), sphereMesh->getIndexCount());
+					lod = sphereMesh->selectLod(worldMatrix, viewMatrix, projectionMatrix, (float)sHeight, lodPixelError);
+					packet = makePacket(sphereMesh, textureShader, NULL, worldMatrix, viewMatrix, PASS_OPAQUE);
+					packet.parameters = lights[i]->getDiffuseColour();
+					packet.indexCount = sphereMesh->getLodIndexCount(lod);
+					packet.indexStart = sphereMesh->getLodIndexStart(lod);
+					renderQueue.submit(packet);
 				}
 			}
 		}
 	}
 
+	// Draw everything submitted. The sky pass comes first, then the rest with the default rasterizer state and wireframe mode.
+	QueueBackend backend(this, viewMatrix, projectionMatrix, false);
+	renderQueue.setInstancing(instancing);
+	renderQueue.sort();
+	LightShader* sceneLightShaders[] = { lightShader, quantisedLightShader, instancedLightShader };
+	for (int i = 0; i < 3; i++)
+	{
+		sceneLightShaders[i]->resetUploadStats();
+		sceneLightShaders[i]->setFrame(renderer->getDeviceContext(), viewMatrix, projectionMatrix, viewMatrices, projMatrices, camera->getPosition());
+	}
+	renderQueue.execute(backend);
+	sceneQueueStats = renderQueue.getStats();
+
+	// Add up the light shaders' constant buffer traffic for the GUI.
+	lightUploadStats = LightShader::UploadStatsType();
+	for (int i = 0; i < 3; i++)
+	{
+		const LightShader::UploadStatsType& stats = sceneLightShaders[i]->getUploadStats();
+		lightUploadStats.uploads += stats.uploads;
+		lightUploadStats.skips += stats.skips;
+		lightUploadStats.uploadedBytes += stats.uploadedBytes;
+		lightUploadStats.skippedBytes += stats.skippedBytes;
+	}
+	
+	// If the fire is enabled.
+	if (fireToggle)
+	{
+		// Render every fire particle in one draw. Each point carries its position and size.
+		worldMatrix = renderer->getWorldMatrix();
+		pointMesh->sendData(renderer->getDeviceContext());
+		fireShader->setShaderParameters(renderer->getDeviceContext(), worldMatrix, viewMatrix, projectionMatrix, NULL, camera, elapsedTime, maxHeight, minHeight, fireBottomColour, fireTopColour, renderNormals);
+		fireShader->renderVertices(renderer->getDeviceContext(), pointMesh->getPointCount());
+	}
 }
 
 bool App1::render()
@@ -962,8 +1237,15 @@ bool App1::render()
 	// Increase elapsed time.
 	elapsedTime += timer->getTime();
 
-	// Update the fire.
+	// Count this frame's binds from here, keeping the last frame's for the GUI.
+	StateCache::get(renderer->getDeviceContext())->beginFrame();
+
+	// Update the fire, then copy its particles to the point mesh once for both the depth and scene passes.
 	updateFire(timer->getTime());
+	if (fireToggle)
+	{
+		pointMesh->update(renderer->getDeviceContext(), fireParticle.data(), fireParticleCount);
+	}
 
 	// Depth pass for shadowmaps and depth map.
 	depthPass();
@@ -1002,7 +1284,7 @@ bool App1::render()
 		
 		// Render using the texture shader.
 		shadowMapMesh->sendData(renderer->getDeviceContext());
-		textureShader->setShaderParameters(renderer->getDeviceContext(), worldMatrix, orthoViewMatrix, orthoMatrix, shadowMaps[lightShadowMapToRender - 1][shadowMapToRender - 1]->getDepthMapSRV(), XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f));
+		textureShader->setShaderParameters(renderer->getDeviceContext(), shadowMapMesh->getPlacementMatrix() * worldMatrix, orthoViewMatrix, orthoMatrix, shadowMaps[lightShadowMapToRender - 1][shadowMapToRender - 1]->getDepthMapSRV(), XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f));
 		textureShader->render(renderer->getDeviceContext(), shadowMapMesh->getIndexCount());
 
 		// Enable depth buffer.
@@ -1020,9 +1302,10 @@ bool App1::render()
 void App1::gui()
 {
 	// Force turn off unnecessary shader stages.
-	renderer->getDeviceContext()->GSSetShader(NULL, NULL, 0);
-	renderer->getDeviceContext()->HSSetShader(NULL, NULL, 0);
-	renderer->getDeviceContext()->DSSetShader(NULL, NULL, 0);
+	StateCache* stateCache = StateCache::get(renderer->getDeviceContext());
+	stateCache->GSSetShader(NULL);
+	stateCache->HSSetShader(NULL);
+	stateCache->DSSetShader(NULL);
 
 	// Build UI
 	ImGui::Text("FPS: %.2f", timer->getFPS());
@@ -1086,6 +1369,20 @@ void App1::gui()
 		ImGui::Unindent();
 	}
 
+	// Terrain options:
+	// Adjust the height of the ground. The ground's vertices are only rebuilt when it changes.
+	// Toggle keeping the camera above the ground.
+	if (ImGui::CollapsingHeader("Vertex Manipulation - Terrain"))
+	{
+		ImGui::Indent();
+
+		ImGui::SliderFloat("Terrain Height", &terrainHeight, 0, 60);
+		ImGui::Checkbox("Keep Camera Above Ground", &cameraAboveGround);
+		ImGui::Text("Ground rebuilds: %d, last took %.2f ms", groundMesh->getRebuildCount(), groundMesh->getRebuildTime() * 1000.0);
+
+		ImGui::Unindent();
+	}
+
 	// Options for lighting.
 	if (ImGui::CollapsingHeader("Lights"))
 	{
@@ -1210,6 +1507,53 @@ void App1::gui()
 		ImGui::Unindent();
 	}
 
+	// Level of detail options:
+	// Adjust how much error is allowed on screen before a coarser level of the models, spheres and ground tiles is used, for the camera, shadow maps and sky
+	if (ImGui::CollapsingHeader("Level of Detail"))
+	{
+		ImGui::Indent();
+
+		ImGui::SliderFloat("Camera Pixel Error", &lodPixelError, 0.0f, 10.0f);
+		ImGui::SliderFloat("Shadow Map Pixel Error", &shadowLodPixelError, 0.0f, 20.0f);
+		ImGui::SliderFloat("Sky Pixel Error", &skyPixelError, 0.0f, 20.0f);
+		ImGui::Text("Ground tiles drawn in depth pass: %d / %d", groundTilesDrawn, groundTilesTested);
+
+		ImGui::Unindent();
+	}
+
+	// Meshlet culling options:
+	// Toggle culling the house meshlets in the depth pass, and show how many are drawn.
+	if (ImGui::CollapsingHeader("Meshlet Culling"))
+	{
+		ImGui::Indent();
+
+		ImGui::Checkbox("Cull Meshlets", &meshletCulling);
+		ImGui::Text("Meshlets drawn in depth pass: %d / %d", meshletsDrawn, meshletsTested);
+		ImGui::Text("Model parts drawn in depth pass: %d / %d", submeshesDrawn, submeshesTested);
+
+		ImGui::Unindent();
+	}
+
+	// Render queue statistics:
+	// Packets drawn and the state changes left after sorting, for the scene and the camera's depth map.
+	if (ImGui::CollapsingHeader("Render Queue"))
+	{
+		ImGui::Indent();
+
+		ImGui::Checkbox("Instancing", &instancing);
+		ImGui::Text("Scene: %d packets, %d shader, %d texture and %d mesh changes", sceneQueueStats.packets, sceneQueueStats.shaderChanges, sceneQueueStats.materialChanges, sceneQueueStats.meshChanges);
+		ImGui::Text("Scene: %d draws, %d packets instanced", sceneQueueStats.draws, sceneQueueStats.instancedPackets);
+		ImGui::Text("Scene sort: %.3f ms", sceneQueueStats.sortTime * 1000.0);
+		ImGui::Text("Depth map: %d packets, %d shader, %d texture and %d mesh changes", depthQueueStats.packets, depthQueueStats.shaderChanges, depthQueueStats.materialChanges, depthQueueStats.meshChanges);
+		ImGui::Text("Depth map: %d draws, %d packets instanced", depthQueueStats.draws, depthQueueStats.instancedPackets);
+		ImGui::Text("Light constant buffers: %d uploads, %d skipped as unchanged", lightUploadStats.uploads, lightUploadStats.skips);
+		ImGui::Text("Light constant buffers: %zu bytes uploaded, %zu skipped", lightUploadStats.uploadedBytes, lightUploadStats.skippedBytes);
+		const StateCache::StatsType& bindStats = stateCache->getFrameStats();
+		ImGui::Text("Binds: %d issued, %d skipped as already bound", bindStats.issued, bindStats.elided);
+
+		ImGui::Unindent();
+	}
+
 	// Fire geometry shader options:
 	// Toggle on/off
 	// Restart the fire - used if the fire breaks
@@ -48,12 +48,8 @@ public:
 		float dog;
 	};
 
-	// Struct that contains the position and size of each fire particle.
-	struct FireParticle
-	{
-		XMFLOAT3 position;
-		float size;
-	};
+	// Each fire particle has a position and size. Laid out as the point mesh's points, so the particles are copied straight into it.
+	typedef CustomPointMesh::PointType FireParticle;
 
 	// Tessellation mode for the water. It can either be tessellated based on the distance from the camera, using ImGui sliders, or using the lowest tessellation factor (called 'OFF' for simplicity).
 	enum TessellationMode { DISTANCE = 0, SLIDERS, OFF };
@@ -61,6 +57,9 @@ public:
 	// Each light has a mode. They can be either directional lights, point lights or spotlights.
 	enum LightMode { DIRECTIONAL = 0, POINT, SPOTLIGHT };
 
+	// Passes within the render queue. The skybox is drawn first, without depth and with front faces culled, then everything else.
+	enum QueuePass { PASS_SKY = 0, PASS_OPAQUE };
+
 protected:
 	// Main render function. Contains each pass and renders the final scene.
 	bool render();
@@ -68,8 +67,8 @@ protected:
 	// Depth pass. Used to calculate shadow maps for each light and the depth map used in the motion blur shader.
 	void depthPass();
 
-	// Render function used in the depth pass. Renders relevant objects in the scene.
-	void depthRender(XMMATRIX world, XMMATRIX view, XMMATRIX projection);
+	// Render function used in the depth pass. Renders relevant objects in the scene. The viewport height and pixel error pick the models' levels of detail.
+	void depthRender(XMMATRIX world, XMMATRIX view, XMMATRIX projection, float viewportHeight, float pixelError);
 
 	// Renders all objects in the scene with lighting and shadows.
 	void scenePass();
@@ -89,6 +88,26 @@ protected:
 	// Updates properties of the fire for passing into the geometry shader.
 	void updateFire(float dt);
 
+	// Makes a render queue packet drawing the whole mesh, with the mesh's decode matrix folded into the world matrix and its depth in the given view.
+	RenderQueue::PacketType makePacket(BaseMesh* mesh, BaseShader* shader, ID3D11ShaderResourceView* texture, const XMMATRIX& world, const XMMATRIX& view, int pass);
+
+	// Draws the render queue's packets for one view. Sets each shader's parameters from the packet and the scene, and only re-sends a mesh when it changes.
+	class QueueBackend : public RenderQueue::Backend
+	{
+	public:
+		QueueBackend(App1* app, const XMMATRIX& view, const XMMATRIX& projection, bool depthOnly);
+		void beginPass(int pass) override;
+		void bindMesh(const void* mesh) override;
+		void draw(const RenderQueue::PacketType& packet, const MeshletBuilder::RangeType* ranges) override;
+		void drawInstanced(const RenderQueue::PacketType& first, const XMFLOAT4X4* worlds, int count) override;
+
+	private:
+		App1* app;
+		XMMATRIX view;
+		XMMATRIX projection;
+		bool depthOnly; // Depth and shadow map views, which only need positions.
+	};
+
 private:
 
 	ID3D11RasterizerState* RSCullFront; // Rasterizer state that culls the front face of objects. Used for rendering the skybox.
@@ -99,6 +118,10 @@ private:
 	WaterShader* waterShader;
 	LightShader* lightShader;
 	DepthShader* depthShader;
+	LightShader* quantisedLightShader; // Light and depth shaders for the models, which are stored with quantised vertices.
+	DepthShader* quantisedDepthShader;
+	LightShader* instancedLightShader; // Light and depth shaders that draw every copy of a mesh in one call, for the cubes and spheres.
+	DepthShader* instancedDepthShader;
 	TextureShader* textureShader;
 	TerrainShader* terrainShader;
 	FireShader* fireShader;
@@ -108,7 +131,7 @@ private:
 	// Meshes for the objects in the scene
 	// *** //
 	PlaneTessellationMesh* waterMesh;
-	PlaneMesh* groundMesh;
+	TerrainMesh* groundMesh;
 	SphereMesh* sphereMesh;
 	CubeMesh* cubeMesh;
 	AModel* corgiMesh;
@@ -116,7 +139,7 @@ private:
 	AModel* campfireMesh;
 	AModel* lampMesh;
 	Model* pierMesh;
-	CustomPointMesh* pointMesh;
+	CustomPointMesh* pointMesh; // Every fire particle, rewritten each frame and drawn as one point list.
 	// *** //
 
 	// Plane resolution (number of tiles across) for water and ground.
@@ -267,6 +290,57 @@ private:
 	// Near and far cut-offs for point lights and spotlights.
 	float spotPointNear;
 	float spotPointFar;
+
+	// Height of the shadow maps in pixels, for picking levels of detail.
+	float shadowMapHeight;
+	// *** //
+
+	// Level of detail variables
+	// *** //
+	// Largest error, in pixels, allowed when picking a model's level of detail for the camera and for the shadow maps. Shadows can tolerate more.
+	float lodPixelError;
+	float shadowLodPixelError;
+	// Largest distance, in pixels, the sky's texture may move from where the full sphere shows it. The sky only moves with the camera, so a coarse sphere just bends it slightly.
+	float skyPixelError;
+	// *** //
+
+	// Meshlet culling variables
+	// *** //
+	// Toggle culling the house meshlets against each view before drawing them.
+	bool meshletCulling;
+
+	// Index ranges left after culling. Kept between draws to avoid reallocating.
+	std::vector<MeshletBuilder::RangeType> meshletRanges;
+
+	// Meshlets drawn out of those tested during the last depth pass, shown in the GUI.
+	int meshletsDrawn;
+	int meshletsTested;
+
+	// Visible parts of the imported models, and how many were drawn out of those tested during the last depth pass.
+	std::vector<MeshletBuilder::RangeType> submeshRanges;
+	int submeshesDrawn;
+	int submeshesTested;
+
+	// Ground tiles left after culling, each at its own level of detail, and how many were drawn out of those tested during the last depth pass.
+	std::vector<MeshletBuilder::RangeType> groundRanges;
+	int groundTilesDrawn;
+	int groundTilesTested;
+	// *** //
+
+	// Render queue variables
+	// *** //
+	// Every view submits its draws here, then sorts and executes them. Reused for each view to keep its memory.
+	RenderQueue renderQueue;
+
+	// What the queue did for the camera's depth map and for the scene, shown in the GUI.
+	RenderQueue::StatsType depthQueueStats;
+	RenderQueue::StatsType sceneQueueStats;
+	// Constant buffer bytes the scene's light shaders uploaded and skipped this frame.
+	LightShader::UploadStatsType lightUploadStats;
+
+	// Toggle drawing objects that share a mesh, shader and texture as instances, and the world matrices streamed to them.
+	bool instancing;
+	InstanceBuffer* instanceBuffer;
 	// *** //
 
 	// Water variables
@@ -284,8 +358,13 @@ private:
 	// Keep track of elapsed time for waves in shaders.
 	float elapsedTime;
 
-	// Amplitude to apply to the ground's heightmap.
+	// Amplitude to apply to the ground's heightmap. The heights are baked into the ground mesh, which is rebuilt when this changes.
 	float terrainHeight;
+	Heightmap heightmap;
+
+	// Keep the camera at least this far above the ground, using the height map's CPU copy. Toggled in the GUI.
+	bool cameraAboveGround;
+	float cameraClearance;
 };
 
 #endif
\ No newline at end of file
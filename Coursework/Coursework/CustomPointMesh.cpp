@@ -1,89 +1,208 @@
 #include "CustomPointMesh.h"
+#include "Benchmark.h"
+#include <algorithm>
+#include <cstring>
+#include <random>
+#include <vector>
 
-CustomPointMesh::CustomPointMesh(ID3D11Device* device, ID3D11DeviceContext* deviceContext)
+namespace
 {
+	// Constant buffers the fire shader filled for every particle when each one was its own draw.
+	struct ReferenceMatrixBufferType
+	{
+		XMMATRIX world;
+		XMMATRIX view;
+		XMMATRIX projection;
+	};
+
+	struct ReferenceCameraBufferType
+	{
+		XMFLOAT3 cameraPosition;
+		XMFLOAT2 padding;
+		XMFLOAT3 cameraRotation;
+	};
+
+	struct ReferenceParticleBufferType
+	{
+		float height;
+		float size;
+		float elapsedTime;
+		float maxHeight;
+		float minHeight;
+		int renderNormals;
+		XMFLOAT2 padding;
+		XMFLOAT4 bottomColour;
+		XMFLOAT4 topColour;
+	};
+
+	// What one particle's three maps wrote. Each discard map hands out fresh memory, so every particle gets its own.
+	struct ReferenceConstantsType
+	{
+		ReferenceMatrixBufferType matrices;
+		ReferenceCameraBufferType camera;
+		ReferenceParticleBufferType particle;
+	};
+
+	// Device calls made to bind a shader's stages and draw (see BaseShader::setShaders()), and to set the fire shader's parameters.
+	const int setShaderCalls = 7;
+	const int setParameterCalls = 14;
+}
+
+CustomPointMesh::CustomPointMesh(ID3D11Device* ldevice, ID3D11DeviceContext* deviceContext, int lcapacity)
+{
+	device = ldevice;
+	// At least one point, so the buffer can be created and doubling it grows.
+	capacity = std::max(lcapacity, 1);
+	vertexStride = sizeof(PointType);
 	initBuffers(device);
 }
 
 CustomPointMesh::~CustomPointMesh()
 {
-	BaseMesh::~BaseMesh();
+	// BaseMesh's destructor runs after this one and releases the buffer.
+}
+
+void CustomPointMesh::update(ID3D11DeviceContext* deviceContext, const PointType* points, int count)
+{
+	// Grow to fit, doubling so a slider dragged up doesn't recreate the buffer every frame.
+	if (count > capacity)
+	{
+		while (capacity < count)
+		{
+			capacity *= 2;
+		}
+		vertexBuffer->Release();
+		vertexBuffer = nullptr;
+		initBuffers(device);
+	}
+
+	vertexCount = 0;
+	if (count == 0)
+	{
+		return;
+	}
+
+	D3D11_MAPPED_SUBRESOURCE mappedResource;
+	if (FAILED(deviceContext->Map(vertexBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource)))
+	{
+		return;
+	}
+	memcpy(mappedResource.pData, points, sizeof(PointType) * count);
+	deviceContext->Unmap(vertexBuffer, 0);
+	vertexCount = count;
+}
+
+int CustomPointMesh::getPointCount()
+{
+	return vertexCount;
 }
 
 void CustomPointMesh::sendData(ID3D11DeviceContext* deviceContext, D3D_PRIMITIVE_TOPOLOGY top)
 {
+	StateCache* stateCache = StateCache::get(deviceContext);
+
 	unsigned int stride;
 	unsigned int offset;
 
 	// Set vertex buffer stride and offset.
-	stride = sizeof(VertexType);
+	stride = vertexStride;
 	offset = 0;
 
-	deviceContext->IASetVertexBuffers(0, 1, &vertexBuffer, &stride, &offset);
-	deviceContext->IASetIndexBuffer(indexBuffer, DXGI_FORMAT_R32_UINT, 0);
-	deviceContext->IASetPrimitiveTopology(top);
+	stateCache->IASetVertexBuffers(0, 1, &vertexBuffer, &stride, &offset);
+	stateCache->IASetPrimitiveTopology(top);
 }
 
+// An empty dynamic buffer, written every frame by update().
 void CustomPointMesh::initBuffers(ID3D11Device* device)
 {
-	VertexType* vertices;
-	unsigned long* indices;
-	D3D11_BUFFER_DESC vertexBufferDesc, indexBufferDesc;
-	D3D11_SUBRESOURCE_DATA vertexData, indexData;
-
-	vertexCount = 1;
-	indexCount = 1;
-
-
-	vertices = new VertexType[vertexCount];
-	indices = new unsigned long[indexCount];
-
-	// Load the vertex array with data.
-
-	// Just one point for the particle.
-	vertices[0].position = XMFLOAT3(0.0f, 0.0f, 0.0f);
-	vertices[0].texture = XMFLOAT2(0.0f, 1.0f);
-	vertices[0].normal = XMFLOAT3(0.0f, 0.0f, -1.0f);
-
-	
-
-	// Load the index array with data.
-	indices[0] = 0;
-	
-	
-
-	// Set up the description of the static vertex buffer.
-	vertexBufferDesc.Usage = D3D11_USAGE_DEFAULT;
-	vertexBufferDesc.ByteWidth = sizeof(VertexType) * vertexCount;
+	D3D11_BUFFER_DESC vertexBufferDesc;
+	vertexBufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+	vertexBufferDesc.ByteWidth = sizeof(PointType) * capacity;
 	vertexBufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-	vertexBufferDesc.CPUAccessFlags = 0;
+	vertexBufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
 	vertexBufferDesc.MiscFlags = 0;
 	vertexBufferDesc.StructureByteStride = 0;
-	// Give the subresource structure a pointer to the vertex data.
-	vertexData.pSysMem = vertices;
-	vertexData.SysMemPitch = 0;
-	vertexData.SysMemSlicePitch = 0;
-	// Now create the vertex buffer.
-	device->CreateBuffer(&vertexBufferDesc, &vertexData, &vertexBuffer);
-
-	// Set up the description of the static index buffer.
-	indexBufferDesc.Usage = D3D11_USAGE_DEFAULT;
-	indexBufferDesc.ByteWidth = sizeof(unsigned long) * indexCount;
-	indexBufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
-	indexBufferDesc.CPUAccessFlags = 0;
-	indexBufferDesc.MiscFlags = 0;
-	indexBufferDesc.StructureByteStride = 0;
-	// Give the subresource structure a pointer to the index data.
-	indexData.pSysMem = indices;
-	indexData.SysMemPitch = 0;
-	indexData.SysMemSlicePitch = 0;
-	// Create the index buffer.
-	device->CreateBuffer(&indexBufferDesc, &indexData, &indexBuffer);
-
-	// Release the arrays now that the vertex and index buffers have been created and loaded.
-	delete[] vertices;
-	vertices = 0;
-
-	delete[] indices;
-	indices = 0;
+	device->CreateBuffer(&vertexBufferDesc, NULL, &vertexBuffer);
+	vertexBufferBytes = vertexBufferDesc.ByteWidth;
+}
+
+void CustomPointMesh::benchmark(FILE* report)
+{
+	const int particleCounts[] = { 5000, 50000, 500000 };
+	const double minimumTime = 0.2;
+
+	Benchmark::report(report, "Fire particle submission for one pass, CPU side only: constant buffer and vertex buffer writes and device calls, without the driver. Times in ms, best pass\n");
+	Benchmark::report(report, "%10s %12s %12s %8s %12s %12s %14s %14s\n", "particles", "before ms", "after ms", "speedup", "calls before", "calls after", "bytes before", "bytes after");
+
+	for (int c = 0; c < (int)(sizeof(particleCounts) / sizeof(particleCounts[0])); c++)
+	{
+		int count = particleCounts[c];
+		std::mt19937 random(1);
+		std::uniform_real_distribution<float> spread(-0.6f, 0.6f);
+		std::vector<PointType> particles(count);
+		for (int i = 0; i < count; i++)
+		{
+			particles[i].position = XMFLOAT3(spread(random), spread(random) + 1.5f, spread(random));
+			particles[i].size = 0.1f;
+		}
+
+		// Stand ins for the mapped buffers.
+		ReferenceConstantsType* constants = (ReferenceConstantsType*)_mm_malloc(sizeof(ReferenceConstantsType) * count, 16);
+		std::vector<PointType> vertexBuffer(count);
+		XMMATRIX view = XMMatrixTranslation(0.0f, -2.0f, 10.0f);
+		XMMATRIX projection = XMMatrixPerspectiveFovLH(0.785f, 16.0f / 9.0f, 0.1f, 200.0f);
+
+		// A world matrix and three constant buffers per particle, then its draw, as the passes did.
+		double beforeTime = 1e30;
+		double start = Benchmark::seconds();
+		while (Benchmark::seconds() - start < minimumTime)
+		{
+			double passStart = Benchmark::seconds();
+			for (int i = 0; i < count; i++)
+			{
+				ReferenceConstantsType& constant = constants[i];
+				XMMATRIX world = XMMatrixTranslation(particles[i].position.x, particles[i].position.y, particles[i].position.z);
+				constant.matrices.world = XMMatrixTranspose(world);
+				constant.matrices.view = XMMatrixTranspose(view);
+				constant.matrices.projection = XMMatrixTranspose(projection);
+				constant.camera.cameraPosition = XMFLOAT3(0.0f, 2.0f, -10.0f);
+				constant.camera.padding = XMFLOAT2(0.0f, 0.0f);
+				constant.camera.cameraRotation = XMFLOAT3(0.0f, 0.0f, 0.0f);
+				constant.particle.elapsedTime = 1.0f + i;
+				constant.particle.height = particles[i].position.y;
+				constant.particle.size = particles[i].size;
+				constant.particle.maxHeight = 3.0f;
+				constant.particle.minHeight = 0.0f;
+				constant.particle.renderNormals = 0;
+				constant.particle.padding = XMFLOAT2(0.0f, 0.0f);
+				constant.particle.bottomColour = XMFLOAT4(1.0f, 0.2f, 0.0f, 1.0f);
+				constant.particle.topColour = XMFLOAT4(1.0f, 1.0f, 0.0f, 1.0f);
+			}
+			beforeTime = std::min(beforeTime, Benchmark::seconds() - passStart);
+		}
+
+		// One copy of every particle and one set of constant buffers.
+		double afterTime = 1e30;
+		start = Benchmark::seconds();
+		while (Benchmark::seconds() - start < minimumTime)
+		{
+			double passStart = Benchmark::seconds();
+			memcpy(vertexBuffer.data(), particles.data(), sizeof(PointType) * count);
+			constants[0].matrices.world = XMMatrixTranspose(XMMatrixIdentity());
+			constants[0].matrices.view = XMMatrixTranspose(view);
+			constants[0].matrices.projection = XMMatrixTranspose(projection);
+			afterTime = std::min(afterTime, Benchmark::seconds() - passStart);
+		}
+		_mm_free(constants);
+
+		// Before: the point mesh's three binds, the parameters, the stages and a draw for every particle.
+		// After: the upload's map and unmap, then the vertex buffer and topology, the parameters, the stages and one draw.
+		long long callsBefore = (long long)count * (3 + setParameterCalls + setShaderCalls + 1);
+		long long callsAfter = 2 + 2 + setParameterCalls + setShaderCalls + 1;
+		size_t bytesBefore = sizeof(ReferenceConstantsType) * count;
+		size_t bytesAfter = sizeof(ReferenceConstantsType) + sizeof(PointType) * count;
+
+		Benchmark::report(report, "%10d %12.3f %12.3f %7.1fx %12lld %12lld %14zu %14zu\n", count, beforeTime * 1000.0, afterTime * 1000.0, beforeTime / afterTime,
+			callsBefore, callsAfter, bytesBefore, bytesAfter);
+	}
 }
@@ -1,10 +1,14 @@
 // depth shader.cpp
 #include "depthshader.h"
 
-DepthShader::DepthShader(ID3D11Device* device, HWND hwnd) : BaseShader(device, hwnd) // Use base shader constructor
+DepthShader::DepthShader(ID3D11Device* device, HWND hwnd, bool quantised, bool instanced) : BaseShader(device, hwnd) // Use base shader constructor
 {
-	// Initialise shader using depth vertex and pixel shaders.
-	initShader(L"depth_vs.cso", L"depth_ps.cso");
+	// Quantised meshes only need a different input layout, depth_vs reads the position as a float4 either way.
+	quantisedInput = quantised;
+	instancedInput = instanced;
+
+	// Initialise shader using depth vertex and pixel shaders. Instanced meshes read their world matrix from the instance stream instead.
+	initShader(instanced ? L"depth_instanced_vs.cso" : L"depth_vs.cso", L"depth_ps.cso");
 }
 
 DepthShader::~DepthShader()
@@ -32,7 +36,18 @@ void DepthShader::initShader(const wchar_t* vsFilename, const wchar_t* psFilenam
 	D3D11_BUFFER_DESC matrixBufferDesc;
 
 	// Load (+ compile) shader files
-	loadVertexShader(vsFilename);
+	if (quantisedInput)
+	{
+		loadQuantisedVertexShader(vsFilename);
+	}
+	else if (instancedInput)
+	{
+		loadInstancedVertexShader(vsFilename);
+	}
+	else
+	{
+		loadVertexShader(vsFilename);
+	}
 	loadPixelShader(psFilename);
 
 	// Setup the description of the dynamic matrix constant buffer that is in the vertex shader.
@@ -64,5 +79,5 @@ void DepthShader::setShaderParameters(ID3D11DeviceContext* deviceContext, const
 	dataPtr->view = view;
 	dataPtr->projection = proj;
 	deviceContext->Unmap(matrixBuffer, 0);
-	deviceContext->VSSetConstantBuffers(0, 1, &matrixBuffer);
+	StateCache::get(deviceContext)->VSSetConstantBuffers(0, 1, &matrixBuffer);
 }
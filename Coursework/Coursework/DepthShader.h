@@ -12,8 +12,8 @@ class DepthShader : public BaseShader
 {
 
 public:
-	// Constructors and destructors
-	DepthShader(ID3D11Device* device, HWND hwnd);
+	// Constructors and destructors. Pass quantised to draw meshes created with quantised vertices, or instanced to draw with BaseShader::renderInstanced().
+	DepthShader(ID3D11Device* device, HWND hwnd, bool quantised = false, bool instanced = false);
 	~DepthShader();
 
 	// Shader parameters - just world, view and projection matrices.
@@ -26,4 +26,9 @@ private:
 private:
 	// Only one buffer - matrix buffer.
 	ID3D11Buffer* matrixBuffer;
+
+	// Whether the input layout is for quantised vertices.
+	bool quantisedInput;
+	// Whether the input layout has the per-instance world matrices.
+	bool instancedInput;
 };
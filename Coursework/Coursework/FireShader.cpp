@@ -48,8 +48,8 @@ FireShader::~FireShader()
 
 void FireShader::initShader(const wchar_t* vsFilename, const wchar_t* psFilename)
 {
-	// Load (+ compile) shader files
-	loadVertexShader(vsFilename);
+	// Load (+ compile) shader files. The vertex shader reads points of a position and size.
+	loadPointVertexShader(vsFilename);
 	loadPixelShader(psFilename);
 
 	// Setup the description of the dynamic matrix constant buffer that is in the vertex shader.
@@ -108,8 +108,10 @@ void FireShader::initShader(const wchar_t* vsFilename, const wchar_t* gsFilename
 	loadGeometryShader(gsFilename);
 }
 
-void FireShader::setShaderParameters(ID3D11DeviceContext* deviceContext, const XMMATRIX& worldMatrix, const XMMATRIX& viewMatrix, const XMMATRIX& projectionMatrix, ID3D11ShaderResourceView* texture, Camera* camera, float elapsedTime, float size, float particleHeight, float maxHeight, float minHeight, XMFLOAT4 bottomColour, XMFLOAT4 topColour, bool renderNormals)
+void FireShader::setShaderParameters(ID3D11DeviceContext* deviceContext, const XMMATRIX& worldMatrix, const XMMATRIX& viewMatrix, const XMMATRIX& projectionMatrix, ID3D11ShaderResourceView* texture, Camera* camera, float elapsedTime, float maxHeight, float minHeight, XMFLOAT4 bottomColour, XMFLOAT4 topColour, bool renderNormals)
 {
+	StateCache* stateCache = StateCache::get(deviceContext);
+
 	D3D11_MAPPED_SUBRESOURCE mappedResource;
 	MatrixBufferType* dataPtr;
 
@@ -127,8 +129,8 @@ void FireShader::setShaderParameters(ID3D11DeviceContext* deviceContext, const X
 	deviceContext->Unmap(matrixBuffer, 0);
 
 	// Matrix buffer used in both the vertex and geometry shader.
-	deviceContext->VSSetConstantBuffers(0, 1, &matrixBuffer);
-	deviceContext->GSSetConstantBuffers(0, 1, &matrixBuffer);
+	stateCache->VSSetConstantBuffers(0, 1, &matrixBuffer);
+	stateCache->GSSetConstantBuffers(0, 1, &matrixBuffer);
 
 	// Set camera buffer values.
 	CameraBufferType* cameraPtr;
@@ -140,31 +142,28 @@ void FireShader::setShaderParameters(ID3D11DeviceContext* deviceContext, const X
 	deviceContext->Unmap(cameraBuffer, 0);
 
 	// Used in the geometry shader.
-	deviceContext->GSSetConstantBuffers(1, 1, &cameraBuffer);
+	stateCache->GSSetConstantBuffers(1, 1, &cameraBuffer);
 
 	// Set particle buffer values.
 	ParticleBufferType* particlePtr;
 	deviceContext->Map(particleBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource);
 	particlePtr = (ParticleBufferType*)mappedResource.pData;
 	particlePtr->elapsedTime = elapsedTime;
-	particlePtr->height = particleHeight;
-	particlePtr->size = size;
 	particlePtr->maxHeight = maxHeight;
 	particlePtr->minHeight = minHeight;
 	particlePtr->bottomColour = bottomColour;
 	particlePtr->topColour = topColour;
 	particlePtr->renderNormals = renderNormals;
-	particlePtr->padding = XMFLOAT2(0, 0);
 	deviceContext->Unmap(particleBuffer, 0);
 
 	// Used in every stage of the shader.
-	deviceContext->VSSetConstantBuffers(1, 1, &particleBuffer);
-	deviceContext->PSSetConstantBuffers(0, 1, &particleBuffer);
-	deviceContext->GSSetConstantBuffers(2, 1, &particleBuffer);
+	stateCache->VSSetConstantBuffers(1, 1, &particleBuffer);
+	stateCache->PSSetConstantBuffers(0, 1, &particleBuffer);
+	stateCache->GSSetConstantBuffers(2, 1, &particleBuffer);
 
 	// Send texture and sampler to the pixel shader.
-	deviceContext->PSSetShaderResources(0, 1, &texture);
-	deviceContext->PSSetSamplers(0, 1, &sampleState);
+	stateCache->PSSetShaderResources(0, 1, &texture);
+	stateCache->PSSetSamplers(0, 1, &sampleState);
 }
 
 
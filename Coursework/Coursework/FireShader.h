@@ -12,8 +12,9 @@ public:
 	FireShader(ID3D11Device* device, HWND hwnd);
 	~FireShader();
 
-	// The fire geometry shader uses a texture, camera, the elapsed time, particle size, heights, colours and an option for rendering normals.
-	void setShaderParameters(ID3D11DeviceContext* deviceContext, const XMMATRIX& world, const XMMATRIX& view, const XMMATRIX& projection, ID3D11ShaderResourceView* texture, Camera* camera, float elapsedTime, float particleSize, float particleHeight, float maxHeight, float minHeight, XMFLOAT4 bottomColour, XMFLOAT4 topColour, bool renderNormals);
+	// The fire geometry shader uses a texture, camera, the elapsed time, heights, colours and an option for rendering normals.
+	// Each particle's position and size come from the points of a CustomPointMesh, drawn together with renderVertices().
+	void setShaderParameters(ID3D11DeviceContext* deviceContext, const XMMATRIX& world, const XMMATRIX& view, const XMMATRIX& projection, ID3D11ShaderResourceView* texture, Camera* camera, float elapsedTime, float maxHeight, float minHeight, XMFLOAT4 bottomColour, XMFLOAT4 topColour, bool renderNormals);
 
 private:
 	// Camera buffer uses camera position and rotation. Used for billboarding.
@@ -24,16 +25,13 @@ private:
 		XMFLOAT3 cameraRotation;
 	};
 
-	// Particle buffer contains the particle's properties.
+	// Particle buffer contains the properties shared by every particle.
 	struct ParticleBufferType
 	{
-		float height;
-		float size;
 		float elapsedTime;
 		float maxHeight;
 		float minHeight;
 		int renderNormals;
-		XMFLOAT2 padding;
 		XMFLOAT4 bottomColour;
 		XMFLOAT4 topColour;
 	};
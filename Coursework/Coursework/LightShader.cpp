@@ -1,8 +1,53 @@
 #include "LightShader.h"
+#include <cstring>
 
-LightShader::LightShader(ID3D11Device* device, HWND hwnd) : BaseShader(device, hwnd)
+namespace
 {
-	initShader(L"light_vs.cso", L"light_ps.cso");
+	const unsigned long long hashSeed = 14695981039346656037ull;
+
+	// FNV-1a (64 bit), 8 bytes at a time. Pass the previous result as hash to hash several blocks as one.
+	unsigned long long hashData(unsigned long long hash, const void* data, size_t size)
+	{
+		const char* bytes = (const char*)data;
+		size_t i = 0;
+		for (; i + 8 <= size; i += 8)
+		{
+			unsigned long long word;
+			memcpy(&word, bytes + i, 8);
+			hash = (hash ^ word) * 1099511628211ull;
+		}
+		for (; i < size; i++)
+		{
+			hash = (hash ^ (unsigned char)bytes[i]) * 1099511628211ull;
+		}
+		return hash;
+	}
+
+	// Creates a dynamic constant buffer of size bytes.
+	ID3D11Buffer* createConstantBuffer(ID3D11Device* device, size_t size)
+	{
+		D3D11_BUFFER_DESC bufferDesc;
+		bufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+		bufferDesc.ByteWidth = (UINT)size;
+		bufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+		bufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+		bufferDesc.MiscFlags = 0;
+		bufferDesc.StructureByteStride = 0;
+
+		ID3D11Buffer* buffer = nullptr;
+		device->CreateBuffer(&bufferDesc, NULL, &buffer);
+		return buffer;
+	}
+}
+
+LightShader::LightShader(ID3D11Device* device, HWND hwnd, bool quantised, bool instanced) : BaseShader(device, hwnd)
+{
+	// Quantised meshes need the layout for packed vertices and a vertex shader that decodes the normal.
+	// Instanced meshes need the instance stream in the layout and a vertex shader that reads the world matrix from it.
+	quantisedInput = quantised;
+	instancedInput = instanced;
+	resetUploadStats();
+	initShader(quantised ? L"light_quantised_vs.cso" : instanced ? L"light_instanced_vs.cso" : L"light_vs.cso", L"light_ps.cso");
 }
 
 
@@ -15,11 +60,17 @@ LightShader::~LightShader()
 		sampleState = 0;
 	}
 
-	// Release the matrix constant buffer.
-	if (matrixBuffer)
+	// Release the object and frame constant buffers.
+	if (objectBuffer)
+	{
+		objectBuffer->Release();
+		objectBuffer = 0;
+	}
+
+	if (frameBuffer)
 	{
-		matrixBuffer->Release();
-		matrixBuffer = 0;
+		frameBuffer->Release();
+		frameBuffer = 0;
 	}
 
 	// Release the layout.
@@ -36,11 +87,11 @@ LightShader::~LightShader()
 		lightBuffer = 0;
 	}
 
-	// Release the camera buffer.
-	if (cameraBuffer)
+	// Release the material buffer.
+	if (materialBuffer)
 	{
-		cameraBuffer->Release();
-		cameraBuffer = 0;
+		materialBuffer->Release();
+		materialBuffer = 0;
 	}
 
 	//Release base shader components
@@ -51,32 +102,31 @@ LightShader::~LightShader()
 
 void LightShader::initShader(const wchar_t* vsFilename, const wchar_t* psFilename)
 {
-	D3D11_BUFFER_DESC matrixBufferDesc;
-	D3D11_BUFFER_DESC cameraBufferDesc;
 	D3D11_SAMPLER_DESC samplerDesc;
-	D3D11_BUFFER_DESC lightBufferDesc;
 
 	// Load (+ compile) shader files
-	loadVertexShader(vsFilename);
+	if (quantisedInput)
+	{
+		loadQuantisedVertexShader(vsFilename);
+	}
+	else if (instancedInput)
+	{
+		loadInstancedVertexShader(vsFilename);
+	}
+	else
+	{
+		loadVertexShader(vsFilename);
+	}
 	loadPixelShader(psFilename);
 
-	// Setup the description of the dynamic matrix constant buffer that is in the vertex shader.
-	matrixBufferDesc.Usage = D3D11_USAGE_DYNAMIC;
-	matrixBufferDesc.ByteWidth = sizeof(MatrixBufferType);
-	matrixBufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-	matrixBufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
-	matrixBufferDesc.MiscFlags = 0;
-	matrixBufferDesc.StructureByteStride = 0;
-	renderer->CreateBuffer(&matrixBufferDesc, NULL, &matrixBuffer);
-
-	// Setup the description of the dynamic camera constant buffer that is in the vertex shader.
-	cameraBufferDesc.Usage = D3D11_USAGE_DYNAMIC;
-	cameraBufferDesc.ByteWidth = sizeof(CameraBufferType);
-	cameraBufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-	cameraBufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
-	cameraBufferDesc.MiscFlags = 0;
-	cameraBufferDesc.StructureByteStride = 0;
-	renderer->CreateBuffer(&cameraBufferDesc, NULL, &cameraBuffer);
+	// The dynamic constant buffers for the vertex shader, then the pixel shader. Nothing has been uploaded to them yet.
+	objectBuffer = createConstantBuffer(renderer, sizeof(ObjectBufferType));
+	frameBuffer = createConstantBuffer(renderer, sizeof(FrameBufferType));
+	lightBuffer = createConstantBuffer(renderer, sizeof(LightBufferType));
+	materialBuffer = createConstantBuffer(renderer, sizeof(MaterialBufferType));
+	objectHash = 0;
+	lightHash = 0;
+	materialHash = 0;
 
 	// Create a texture sampler state description.
 	samplerDesc.Filter = D3D11_FILTER_ANISOTROPIC;
@@ -101,68 +151,84 @@ void LightShader::initShader(const wchar_t* vsFilename, const wchar_t* psFilenam
 	samplerDesc.BorderColor[3] = 1.0f;
 	renderer->CreateSamplerState(&samplerDesc, &sampleStateShadow);
 
-	// Setup the description of the light dynamic constant buffer that is in the pixel shader.
-	lightBufferDesc.Usage = D3D11_USAGE_DYNAMIC;
-	lightBufferDesc.ByteWidth = sizeof(LightBufferType);
-	lightBufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-	lightBufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
-	lightBufferDesc.MiscFlags = 0;
-	lightBufferDesc.StructureByteStride = 0;
-	renderer->CreateBuffer(&lightBufferDesc, NULL, &lightBuffer);
-
-
 }
 
-void LightShader::setShaderParameters(ID3D11DeviceContext* deviceContext, const XMMATRIX& worldMatrix, const XMMATRIX& viewMatrix, const XMMATRIX& projectionMatrix, ID3D11ShaderResourceView* texture, Light* lights[LIGHT_COUNT], XMFLOAT3 camPosition, LightProperties lightProperties[LIGHT_COUNT], float specularPower, ShadowMap* shadowMaps[LIGHT_COUNT][6], float shadowMapBias, XMMATRIX viewMatrices[LIGHT_COUNT][6], XMMATRIX projMatrices[LIGHT_COUNT][6], bool renderNormals, bool calculateNormals, ID3D11ShaderResourceView* heightMap, float amplitude, int resolution)
+void LightShader::resetUploadStats()
 {
-	HRESULT result;
-	D3D11_MAPPED_SUBRESOURCE mappedResource;
-	MatrixBufferType* dataPtr;
+	memset(&uploadStats, 0, sizeof(uploadStats));
+}
 
-	XMMATRIX world, view, proj;
+bool LightShader::isDirty(unsigned long long& lastHash, unsigned long long hash, size_t size)
+{
+	if (hash == lastHash)
+	{
+		uploadStats.skips++;
+		uploadStats.skippedBytes += size;
+		return false;
+	}
 
+	lastHash = hash;
+	uploadStats.uploads++;
+	uploadStats.uploadedBytes += size;
+	return true;
+}
 
-	// Transpose the matrices to prepare them for the shader.
-	world = XMMatrixTranspose(worldMatrix);
-	view = XMMatrixTranspose(viewMatrix);
-	proj = XMMatrixTranspose(projectionMatrix);
+void LightShader::upload(ID3D11DeviceContext* deviceContext, ID3D11Buffer* buffer, const void* data, size_t size)
+{
+	// Discarding leaves the old contents to draws already queued, so a skipped upload keeps whatever was last written.
+	D3D11_MAPPED_SUBRESOURCE mappedResource;
+	if (FAILED(deviceContext->Map(buffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource)))
+	{
+		return;
+	}
+	memcpy(mappedResource.pData, data, size);
+	deviceContext->Unmap(buffer, 0);
+}
 
-	// Setup matrix buffer.
-	result = deviceContext->Map(matrixBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource);
-	dataPtr = (MatrixBufferType*)mappedResource.pData;
-	dataPtr->world = world;
-	dataPtr->view = view;
-	dataPtr->projection = proj;
+void LightShader::setFrame(ID3D11DeviceContext* deviceContext, const XMMATRIX& viewMatrix, const XMMATRIX& projectionMatrix, XMMATRIX viewMatrices[LIGHT_COUNT][6], XMMATRIX projMatrices[LIGHT_COUNT][6], XMFLOAT3 camPosition)
+{
+	FrameBufferType frame;
+	frame.view = XMMatrixTranspose(viewMatrix);
+	frame.projection = XMMatrixTranspose(projectionMatrix);
 
 	// Transpose and add each of the light matrices to the shader.
 	for (int i = 0; i < LIGHT_COUNT; i++)
 	{
 		for (int j = 0; j < 6; j++)
 		{
-			dataPtr->lightView[i][j] = XMMatrixTranspose(viewMatrices[i][j]);
-			dataPtr->lightProjection[i][j] = XMMatrixTranspose(projMatrices[i][j]);
+			frame.lightView[i][j] = XMMatrixTranspose(viewMatrices[i][j]);
+			frame.lightProjection[i][j] = XMMatrixTranspose(projMatrices[i][j]);
 		}
 	}
-	deviceContext->Unmap(matrixBuffer, 0);
+	frame.cameraPosition = camPosition;
+	frame.padding = 0.0f;
 
-	// Only used in vertex shader.
-	deviceContext->VSSetConstantBuffers(0, 1, &matrixBuffer);
-	
-	// Setup camera buffer.
-	CameraBufferType* cameraPtr;
-	deviceContext->Map(cameraBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource);
-	cameraPtr = (CameraBufferType*)mappedResource.pData;
-	cameraPtr->cameraPosition = camPosition;
-	cameraPtr->padding = 0.0f;
-	deviceContext->Unmap(cameraBuffer, 0);
+	// Once per pass, so always uploaded rather than hashed.
+	upload(deviceContext, frameBuffer, &frame, sizeof(frame));
+	uploadStats.uploads++;
+	uploadStats.uploadedBytes += sizeof(frame);
+}
+
+void LightShader::setShaderParameters(ID3D11DeviceContext* deviceContext, const XMMATRIX& worldMatrix, ID3D11ShaderResourceView* texture, Light* lights[LIGHT_COUNT], LightProperties lightProperties[LIGHT_COUNT], float specularPower, ShadowMap* shadowMaps[LIGHT_COUNT][6], float shadowMapBias, bool renderNormals, bool calculateNormals, ID3D11ShaderResourceView* heightMap, float amplitude, int resolution)
+{
+	StateCache* stateCache = StateCache::get(deviceContext);
+
+	// Object buffer. Hashing the untransposed matrix saves transposing it when it hasn't changed.
+	if (isDirty(objectHash, hashData(hashSeed, &worldMatrix, sizeof(XMMATRIX)), sizeof(ObjectBufferType)))
+	{
+		ObjectBufferType object;
+		object.world = XMMatrixTranspose(worldMatrix);
+		upload(deviceContext, objectBuffer, &object, sizeof(object));
+	}
 
+	// The frame buffer holds whatever setFrame() last uploaded.
 	// Only used in vertex shader.
-	deviceContext->VSSetConstantBuffers(1, 1, &cameraBuffer);
+	stateCache->VSSetConstantBuffers(0, 1, &objectBuffer);
+	stateCache->VSSetConstantBuffers(1, 1, &frameBuffer);
 
-	// Setup light buffer for the pixel shader.
-	LightBufferType* lightPtr;
-	deviceContext->Map(lightBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource);
-	lightPtr = (LightBufferType*)mappedResource.pData;
+	// Setup light buffer for the pixel shader. Zeroed so the padding hashes the same every time.
+	LightBufferType light;
+	memset(&light, 0, sizeof(light));
 	XMFLOAT3 attenuation;
 	bool toggle;
 	int type;
@@ -180,29 +246,39 @@ void LightShader::setShaderParameters(ID3D11DeviceContext* deviceContext, const
 		outerCutoff = lightProperties[i].outerSpotlightCutoff;
 		falloff = lightProperties[i].spotlightFalloff;
 
-		lightPtr->ambient[i] = lights[i]->getAmbientColour();
-		lightPtr->diffuse[i] = lights[i]->getDiffuseColour();
-		lightPtr->position[i] = XMFLOAT4(lights[i]->getPosition().x, lights[i]->getPosition().y, lights[i]->getPosition().z, 0.0f);
-		lightPtr->attenuation[i] = XMFLOAT4(attenuation.x, attenuation.y, attenuation.z, 0.0f);
-		lightPtr->direction[i] = XMFLOAT4(lights[i]->getDirection().x, lights[i]->getDirection().y, lights[i]->getDirection().z, 0.0f);
-		lightPtr->toggle[i] = XMINT4(toggle, toggle, toggle, toggle); // Pad by repeating toggle value.
-		lightPtr->type[i] = XMINT4(type, type, type, type); // Pad by repeating type value.
-		lightPtr->spotlightProperties[i] = XMFLOAT4(innerCutoff, outerCutoff, falloff, 0.0f); 
-		lightPtr->specularColour[i] = lights[i]->getSpecularColour();
-		lightPtr->specularPower[i] = XMFLOAT4(specularPower, specularPower, specularPower, specularPower); // Pad by repeating specular power value.
+		light.ambient[i] = lights[i]->getAmbientColour();
+		light.diffuse[i] = lights[i]->getDiffuseColour();
+		light.position[i] = XMFLOAT4(lights[i]->getPosition().x, lights[i]->getPosition().y, lights[i]->getPosition().z, 0.0f);
+		light.attenuation[i] = XMFLOAT4(attenuation.x, attenuation.y, attenuation.z, 0.0f);
+		light.direction[i] = XMFLOAT4(lights[i]->getDirection().x, lights[i]->getDirection().y, lights[i]->getDirection().z, 0.0f);
+		light.toggle[i] = XMINT4(toggle, toggle, toggle, toggle); // Pad by repeating toggle value.
+		light.type[i] = XMINT4(type, type, type, type); // Pad by repeating type value.
+		light.spotlightProperties[i] = XMFLOAT4(innerCutoff, outerCutoff, falloff, 0.0f);
+		light.specularColour[i] = lights[i]->getSpecularColour();
 	}
 
 	// Additional values that are not tied to each light.
-	lightPtr->shadowMapBias = shadowMapBias;
-	lightPtr->calculateNormals = calculateNormals;
-	lightPtr->renderNormals = renderNormals;
-	lightPtr->amplitude = amplitude;
-	lightPtr->resolution = resolution;
-	lightPtr->padding = XMFLOAT3(0, 0, 0);
-	deviceContext->Unmap(lightBuffer, 0);
+	light.shadowMapBias = shadowMapBias;
+	light.renderNormals = renderNormals;
+	if (isDirty(lightHash, hashData(hashSeed, &light, sizeof(light)), sizeof(light)))
+	{
+		upload(deviceContext, lightBuffer, &light, sizeof(light));
+	}
+
+	// Setup material buffer for the pixel shader.
+	MaterialBufferType material;
+	material.specularPower = specularPower;
+	material.calculateNormals = calculateNormals;
+	material.amplitude = amplitude;
+	material.resolution = (float)resolution;
+	if (isDirty(materialHash, hashData(hashSeed, &material, sizeof(material)), sizeof(material)))
+	{
+		upload(deviceContext, materialBuffer, &material, sizeof(material));
+	}
 
 	// Only used in the pixel shader.
-	deviceContext->PSSetConstantBuffers(0, 1, &lightBuffer);
+	stateCache->PSSetConstantBuffers(0, 1, &lightBuffer);
+	stateCache->PSSetConstantBuffers(1, 1, &materialBuffer);
 
 	ID3D11ShaderResourceView* shadowMapTextures[LIGHT_COUNT][6];
 
@@ -215,15 +291,15 @@ void LightShader::setShaderParameters(ID3D11DeviceContext* deviceContext, const
 	}
 
 	// Set shader texture resource in the pixel shader.
-	deviceContext->PSSetShaderResources(0, 1, &texture);
+	stateCache->PSSetShaderResources(0, 1, &texture);
 
 	// Water and terrain shaders also provide a heightmap for per-pixel normal calculation.
-	deviceContext->PSSetShaderResources(1, 1, &heightMap);
+	stateCache->PSSetShaderResources(1, 1, &heightMap);
 
 	// Pass shadow map texture array into the pixel shader.
-	deviceContext->PSSetShaderResources(2, LIGHT_COUNT * 6, *shadowMapTextures);
+	stateCache->PSSetShaderResources(2, LIGHT_COUNT * 6, *shadowMapTextures);
 
 	// Different samplers used for sampling textures and shadowmaps.
-	deviceContext->PSSetSamplers(0, 1, &sampleState);
-	deviceContext->PSSetSamplers(1, 1, &sampleStateShadow);
+	stateCache->PSSetSamplers(0, 1, &sampleState);
+	stateCache->PSSetSamplers(1, 1, &sampleStateShadow);
 }
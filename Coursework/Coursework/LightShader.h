@@ -11,7 +11,27 @@ class LightShader : public BaseShader
 {
 private:
 
-	// Light properties passed to shader through this buffer. Arrayed items are int/float 4s that have self-contained padding so that the data is passed correctly.
+	// The shaders' constant buffers are split by how often they change. The frame buffer is uploaded by setFrame(), the others only when their contents differ from their last upload.
+	// The world matrix, per object.
+	struct ObjectBufferType
+	{
+		XMMATRIX world;
+	};
+
+	// The camera and light matrices and the camera position, per frame.
+	struct FrameBufferType
+	{
+		XMMATRIX view;
+		XMMATRIX projection;
+
+		XMMATRIX lightView[LIGHT_COUNT][6];
+		XMMATRIX lightProjection[LIGHT_COUNT][6];
+
+		XMFLOAT3 cameraPosition;
+		float padding;
+	};
+
+	// Light properties passed to shader through this buffer, only changing when the lights do. Arrayed items are int/float 4s that have self-contained padding so that the data is passed correctly.
 	struct LightBufferType
 	{
 		XMFLOAT4 ambient[LIGHT_COUNT];
@@ -23,23 +43,26 @@ private:
 		XMINT4 type[LIGHT_COUNT];
 		XMFLOAT4 spotlightProperties[LIGHT_COUNT];
 		XMFLOAT4 specularColour[LIGHT_COUNT];
-		XMFLOAT4 specularPower[LIGHT_COUNT];
 		float shadowMapBias;
-		int calculateNormals;
 		int renderNormals;
+		XMFLOAT2 padding;
+	};
+
+	// Material properties, per material.
+	struct MaterialBufferType
+	{
+		float specularPower;
+		int calculateNormals;
 		float amplitude;
 		float resolution;
-		XMFLOAT3 padding;
 	};
 
-	
-
 public:
-	// Constructor and destructor
-	LightShader(ID3D11Device* device, HWND hwnd);
+	// Constructor and destructor. Pass quantised to draw meshes created with quantised vertices, or instanced to draw with BaseShader::renderInstanced().
+	LightShader(ID3D11Device* device, HWND hwnd, bool quantised = false, bool instanced = false);
 	~LightShader();
 
-	// Light's matrix buffer. Public so other vertex shaders can use this buffer type to be compatible with the lighting pixel shader.
+	// Every matrix in one buffer. Public so other vertex shaders can use this buffer type to be compatible with the lighting pixel shader.
 	struct MatrixBufferType
 	{
 		XMMATRIX world;
@@ -50,7 +73,7 @@ public:
 		XMMATRIX lightProjection[LIGHT_COUNT][6];
 	};
 
-	// Buffer that contains the camera position.
+	// Buffer that contains the camera position. Used by other vertex shaders, as above.
 	struct CameraBufferType
 	{
 		XMFLOAT3 cameraPosition;
@@ -73,21 +96,50 @@ public:
 		bool toggle;
 	};
 
-	// Setup shaders with given parameters. This includes world/view/projection matrices, the texture, lights, the camera position, the light properties as listed above, the material specular power, shadow maps, shadow map bias, light view/projection matrices, a boolean for rendering normals and extra parameters for rendering manipulated geometry (normal calculation toggle, the heightmap, the amplitude used on the heightmap and the resolution of the plane).
-	void setShaderParameters(ID3D11DeviceContext* deviceContext, const XMMATRIX& world, const XMMATRIX& view, const XMMATRIX& projection, ID3D11ShaderResourceView* texture, Light* lights[LIGHT_COUNT], XMFLOAT3 camPosition, LightProperties lightProperties[LIGHT_COUNT], float specularPower, ShadowMap* shadowMaps[LIGHT_COUNT][6], float shadowMapBias, XMMATRIX viewMatrices[LIGHT_COUNT][6], XMMATRIX projMatrices[LIGHT_COUNT][6], bool renderNormals, bool calculateNormals, ID3D11ShaderResourceView* heightMap, float amplitude, int resolution);
+	// Constant buffer uploads since the last resetUploadStats(), and the ones skipped because nothing had changed.
+	struct UploadStatsType
+	{
+		int uploads;
+		int skips;
+		size_t uploadedBytes;
+		size_t skippedBytes;
+	};
+
+	// Uploads the per-frame buffer: the view/projection matrices, light view/projection matrices and the camera position. Call once per pass, before the draws that use this shader.
+	void setFrame(ID3D11DeviceContext* deviceContext, const XMMATRIX& view, const XMMATRIX& projection, XMMATRIX viewMatrices[LIGHT_COUNT][6], XMMATRIX projMatrices[LIGHT_COUNT][6], XMFLOAT3 camPosition);
+
+	// Setup shaders with given parameters. This includes the world matrix, the texture, lights, the light properties as listed above, the material specular power, shadow maps, shadow map bias, a boolean for rendering normals and extra parameters for rendering manipulated geometry (normal calculation toggle, the heightmap, the amplitude used on the heightmap and the resolution of the plane).
+	void setShaderParameters(ID3D11DeviceContext* deviceContext, const XMMATRIX& world, ID3D11ShaderResourceView* texture, Light* lights[LIGHT_COUNT], LightProperties lightProperties[LIGHT_COUNT], float specularPower, ShadowMap* shadowMaps[LIGHT_COUNT][6], float shadowMapBias, bool renderNormals, bool calculateNormals, ID3D11ShaderResourceView* heightMap, float amplitude, int resolution);
+
+	const UploadStatsType& getUploadStats() { return uploadStats; }
+	void resetUploadStats();
 
 private:
 	// Initialise shader with vertex and pixel shaders.
 	void initShader(const wchar_t* vs, const wchar_t* ps);
+	// Whether a buffer whose contents now hash to hash needs uploading. Remembers the hash and counts the size bytes as uploaded or skipped.
+	bool isDirty(unsigned long long& lastHash, unsigned long long hash, size_t size);
+	// Copies size bytes into a dynamic constant buffer.
+	void upload(ID3D11DeviceContext* deviceContext, ID3D11Buffer* buffer, const void* data, size_t size);
 
 private:
 	// Samplers
 	ID3D11SamplerState* sampleState;
 	ID3D11SamplerState* sampleStateShadow;
 
-	// Buffers
-	ID3D11Buffer* matrixBuffer;
+	// Buffers, and the hash of what was last uploaded to each that is set per draw.
+	ID3D11Buffer* objectBuffer;
+	ID3D11Buffer* frameBuffer;
 	ID3D11Buffer* lightBuffer;
-	ID3D11Buffer* cameraBuffer;
+	ID3D11Buffer* materialBuffer;
+	unsigned long long objectHash;
+	unsigned long long lightHash;
+	unsigned long long materialHash;
+	UploadStatsType uploadStats;
+
+	// Whether the input layout is for quantised vertices.
+	bool quantisedInput;
+	// Whether the input layout has the per-instance world matrices.
+	bool instancedInput;
 };
 
@@ -1,9 +1,101 @@
 // Main.cpp
 #include "../DXFramework/System.h"
+#include "../DXFramework/Heightmap.h"
+#include "../DXFramework/ImportProfile.h"
+#include "../DXFramework/MeshletBuilder.h"
+#include "../DXFramework/MeshOptimiser.h"
+#include "../DXFramework/MeshSimplifier.h"
+#include "../DXFramework/ObjParser.h"
+#include "../DXFramework/PlaneMesh.h"
+#include "../DXFramework/RenderQueue.h"
+#include "../DXFramework/StateCache.h"
+#include "../DXFramework/Tokenizer.h"
+#include "../DXFramework/VertexGenerator.h"
+#include "../DXFramework/VertexQuantiser.h"
 #include "App1.h"
+#include <cstring>
+
+// Headless benchmarks, run with "-benchmark <name>". Results are written to benchmark.txt and the debug output.
+static int runBenchmark(const char* name)
+{
+	FILE* report;
+	if (fopen_s(&report, "benchmark.txt", "w") != 0)
+	{
+		return 1;
+	}
+
+	if (strcmp(name, "obj") == 0)
+	{
+		ObjParser::benchmark("res", report);
+	}
+	else if (strcmp(name, "meshopt") == 0)
+	{
+		MeshOptimiser::benchmark("res", report);
+	}
+	else if (strcmp(name, "lod") == 0)
+	{
+		MeshSimplifier::benchmark("res", report);
+	}
+	else if (strcmp(name, "meshlet") == 0)
+	{
+		MeshletBuilder::benchmark("res", report);
+	}
+	else if (strcmp(name, "tokens") == 0)
+	{
+		Tokenizer::benchmark("res", report);
+	}
+	else if (strcmp(name, "import") == 0)
+	{
+		ImportProfile::benchmark("res", report);
+	}
+	else if (strcmp(name, "quantise") == 0)
+	{
+		VertexQuantiser::benchmark("res", report);
+	}
+	else if (strcmp(name, "heightmap") == 0)
+	{
+		Heightmap::benchmark("res", report);
+	}
+	else if (strcmp(name, "vertices") == 0)
+	{
+		VertexGenerator::benchmark(report);
+	}
+	else if (strcmp(name, "queue") == 0)
+	{
+		RenderQueue::benchmark(report);
+	}
+	else if (strcmp(name, "particles") == 0)
+	{
+		CustomPointMesh::benchmark(report);
+	}
+	else if (strcmp(name, "binds") == 0)
+	{
+		StateCache::benchmark(report);
+	}
+	else if (strcmp(name, "planes") == 0)
+	{
+		PlaneMesh::benchmark(report);
+		PlaneTessellationMesh::benchmark(report);
+	}
+	else
+	{
+		fprintf(report, "Unknown benchmark: %s\n", name);
+	}
+
+	fclose(report);
+	return 0;
+}
 
 int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PSTR pScmdline, int iCmdshow)
 {
+	const char* benchmark = strstr(pScmdline, "-benchmark ");
+	if (benchmark)
+	{
+		char name[64] = {};
+		sscanf_s(benchmark, "-benchmark %63s", name, (unsigned)sizeof(name));
+		return runBenchmark(name);
+	}
+
 	App1* app = new App1();
 	System* system;
 
@@ -108,6 +108,8 @@ void MotionBlurShader::initShader(const wchar_t* vsFilename, const wchar_t* psFi
 
 void MotionBlurShader::setShaderParameters(ID3D11DeviceContext* deviceContext, const XMMATRIX& worldMatrix, const XMMATRIX& viewMatrix, const XMMATRIX& projectionMatrix, ID3D11ShaderResourceView* depthTexture, ID3D11ShaderResourceView* sceneTexture, XMMATRIX viewProjInverse, XMMATRIX previousViewProj, int numSamples, float strength)
 {
+	StateCache* stateCache = StateCache::get(deviceContext);
+
 	HRESULT result;
 	D3D11_MAPPED_SUBRESOURCE mappedResource;
 	MatrixBufferType* dataPtr;
@@ -134,8 +136,8 @@ void MotionBlurShader::setShaderParameters(ID3D11DeviceContext* deviceContext, c
 	deviceContext->Unmap(matrixBuffer, 0);
 
 	// Use matrix buffer in both vertex and pixel shader.
-	deviceContext->VSSetConstantBuffers(0, 1, &matrixBuffer);
-	deviceContext->PSSetConstantBuffers(0, 1, &matrixBuffer);
+	stateCache->VSSetConstantBuffers(0, 1, &matrixBuffer);
+	stateCache->PSSetConstantBuffers(0, 1, &matrixBuffer);
 
 	// Set blur buffer values.
 	BlurBufferType* blurPtr;
@@ -147,16 +149,16 @@ void MotionBlurShader::setShaderParameters(ID3D11DeviceContext* deviceContext, c
 	deviceContext->Unmap(blurBuffer, 0);
 
 	// Set blur buffer for pixel shader.
-	deviceContext->PSSetConstantBuffers(1, 1, &blurBuffer);
+	stateCache->PSSetConstantBuffers(1, 1, &blurBuffer);
 
 
 	// Set pixel shader textures.
-	deviceContext->PSSetShaderResources(0, 1, &sceneTexture);
-	deviceContext->PSSetShaderResources(1, 1, &depthTexture);
+	stateCache->PSSetShaderResources(0, 1, &sceneTexture);
+	stateCache->PSSetShaderResources(1, 1, &depthTexture);
 
 	// Set pixel shader samplers.
-	deviceContext->PSSetSamplers(0, 1, &sampleState);
-	deviceContext->PSSetSamplers(1, 0, &depthSample);
+	stateCache->PSSetSamplers(0, 1, &sampleState);
+	stateCache->PSSetSamplers(1, 0, &depthSample);
 
 	
 }
@@ -1,4 +1,9 @@
 #include "PlaneTessellationMesh.h"
+#include "VertexGenerator.h"
+#include "Benchmark.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
 
 PlaneTessellationMesh::PlaneTessellationMesh(ID3D11Device* device, ID3D11DeviceContext* deviceContext, int res)
 {
@@ -8,7 +13,7 @@ PlaneTessellationMesh::PlaneTessellationMesh(ID3D11Device* device, ID3D11DeviceC
 
 PlaneTessellationMesh::~PlaneTessellationMesh()
 {
-	BaseMesh::~BaseMesh();
+	// BaseMesh's destructor runs after this one and releases the buffers.
 }
 
 void PlaneTessellationMesh::initBuffers(ID3D11Device* device)
@@ -16,98 +21,25 @@ void PlaneTessellationMesh::initBuffers(ID3D11Device* device)
 	
 	VertexType* vertices;
 	unsigned long* indices;
-	int index, i, j;
-	float positionX, positionZ, u, v, increment;
-	D3D11_BUFFER_DESC vertexBufferDesc, indexBufferDesc;
-	D3D11_SUBRESOURCE_DATA vertexData, indexData;
+	float increment;
 
-	// 4 vertices for each quad in the plane, rather than 6 when generating a plane with triangles.
-	vertexCount = (resolution - 1) * (resolution - 1) * 4;
-	indexCount = vertexCount;
+	// One vertex per grid point, shared by the patches around it, and 4 indices for each quad patch.
+	vertexCount = resolution * resolution;
+	indexCount = (resolution - 1) * (resolution - 1) * 4;
 
 	vertices = new VertexType[vertexCount];
 	indices = new unsigned long[indexCount];
 
-	index = 0;
-	u = 0;
-	v = 0;
+	// Texture coordinates follow the positions, u along x and v along z. The domain shader interpolates both the same way.
 	increment = 1.0f / resolution;
 
-	// Generate vertices, 4 points per quad.
-	for (j = 0; j < (resolution - 1); j++)
-	{
-		for (i = 0; i < (resolution - 1); i++)
-		{
-			positionX = (float)(i);
-			positionZ = (float)(j);
-
-			vertices[index].position = XMFLOAT3(positionX, 0.0f, positionZ);
-			vertices[index].texture = XMFLOAT2(u, v);
-			vertices[index].normal = XMFLOAT3(0.0, 1.0, 0.0);
-			indices[index] = index;
-			index++;
-
-			positionX = (float)(i + 1);
-			positionZ = (float)(j);
-
-			vertices[index].position = XMFLOAT3(positionX, 0.0f, positionZ);
-			vertices[index].texture = XMFLOAT2(u, v + increment);
-			vertices[index].normal = XMFLOAT3(0.0, 1.0, 0.0);
-			indices[index] = index;
-			index++;
-
-			positionX = (float)(i + 1);
-			positionZ = (float)(j + 1);
-
-			vertices[index].position = XMFLOAT3(positionX, 0.0f, positionZ);
-			vertices[index].texture = XMFLOAT2(u + increment, v);
-			vertices[index].normal = XMFLOAT3(0.0, 1.0, 0.0);
-			indices[index] = index;
-			index++;
-
-			positionX = (float)(i);
-			positionZ = (float)(j + 1);
-
-			vertices[index].position = XMFLOAT3(positionX, 0.0f, positionZ);
-			vertices[index].texture = XMFLOAT2(u + increment, v + increment);
-			vertices[index].normal = XMFLOAT3(0.0, 1.0, 0.0);
-			indices[index] = index;
-			index++;
-
-			u += increment;
-		}
+	VertexGenerator::writeGrid(reinterpret_cast<PrimitiveShapes::VertexType*>(vertices), resolution, resolution, 1.0f, increment);
 
-		u = 0;
-		v += increment;
-	}
+	writeIndices(indices, resolution);
 
-	// Set up the description of the static vertex buffer.
-	vertexBufferDesc.Usage = D3D11_USAGE_DEFAULT;
-	vertexBufferDesc.ByteWidth = sizeof(VertexType) * vertexCount;
-	vertexBufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-	vertexBufferDesc.CPUAccessFlags = 0;
-	vertexBufferDesc.MiscFlags = 0;
-	vertexBufferDesc.StructureByteStride = 0;
-	// Give the subresource structure a pointer to the vertex data.
-	vertexData.pSysMem = vertices;
-	vertexData.SysMemPitch = 0;
-	vertexData.SysMemSlicePitch = 0;
-	// Now create the vertex buffer.
-	device->CreateBuffer(&vertexBufferDesc, &vertexData, &vertexBuffer);
-
-	// Set up the description of the static index buffer.
-	indexBufferDesc.Usage = D3D11_USAGE_DEFAULT;
-	indexBufferDesc.ByteWidth = sizeof(unsigned long) * indexCount;
-	indexBufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
-	indexBufferDesc.CPUAccessFlags = 0;
-	indexBufferDesc.MiscFlags = 0;
-	indexBufferDesc.StructureByteStride = 0;
-	// Give the subresource structure a pointer to the index data.
-	indexData.pSysMem = indices;
-	indexData.SysMemPitch = 0;
-	indexData.SysMemSlicePitch = 0;
-	// Create the index buffer.
-	device->CreateBuffer(&indexBufferDesc, &indexData, &indexBuffer);
+	// Create the vertex and index buffers.
+	createVertexBuffer(device, vertices);
+	createIndexBuffer(device, indices);
 
 	// Release the arrays now that the vertex and index buffers have been created and loaded.
 	delete[] vertices;
@@ -118,14 +50,154 @@ void PlaneTessellationMesh::initBuffers(ID3D11Device* device)
 
 void PlaneTessellationMesh::sendData(ID3D11DeviceContext* deviceContext, D3D_PRIMITIVE_TOPOLOGY top)
 {
+	StateCache* stateCache = StateCache::get(deviceContext);
+
 	unsigned int stride;
 	unsigned int offset;
 
-	stride = sizeof(VertexType);
+	stride = vertexStride;
 	offset = 0;
 
-	deviceContext->IASetVertexBuffers(0, 1, &vertexBuffer, &stride, &offset);
-	deviceContext->IASetIndexBuffer(indexBuffer, DXGI_FORMAT_R32_UINT, 0);
+	stateCache->IASetVertexBuffers(0, 1, &vertexBuffer, &stride, &offset);
+	stateCache->IASetIndexBuffer(indexBuffer, indexFormat, 0);
 	// Set the type of primitive that should be rendered from this vertex buffer, in this case control patch for tessellation.
-	deviceContext->IASetPrimitiveTopology(top);
+	stateCache->IASetPrimitiveTopology(top);
+}
+
+void PlaneTessellationMesh::writeIndices(unsigned long* indices, int res)
+{
+	// Control points go round each quad: (i, j), (i + 1, j), (i + 1, j + 1), (i, j + 1).
+	int index = 0;
+	for (int j = 0; j < (res - 1); j++)
+	{
+		for (int i = 0; i < (res - 1); i++)
+		{
+			indices[index++] = j * res + i;
+			indices[index++] = j * res + i + 1;
+			indices[index++] = (j + 1) * res + i + 1;
+			indices[index++] = (j + 1) * res + i;
+		}
+	}
+}
+
+namespace
+{
+	// A patch corner, position on the plane and texture coordinates.
+	struct CornerType
+	{
+		float x, z, u, v;
+	};
+
+	float interpolate(float a, float b, float t)
+	{
+		return a + (b - a) * t;
+	}
+
+	// Where water_ds puts a domain point: the position between the corners, and the texture coordinates after scrolling by time * speed.
+	// The old patches interpolated their texture coordinates across the domain the other way round to the positions.
+	void domainPoint(const CornerType* patch, float x, float y, float scroll, bool oldTexture, float* position, float* texture)
+	{
+		position[0] = interpolate(interpolate(patch[0].x, patch[1].x, y), interpolate(patch[3].x, patch[2].x, y), x);
+		position[1] = interpolate(interpolate(patch[0].z, patch[1].z, y), interpolate(patch[3].z, patch[2].z, y), x);
+
+		y += scroll;
+		if (oldTexture)
+		{
+			texture[0] = interpolate(interpolate(patch[0].u, patch[1].u, x), interpolate(patch[2].u, patch[3].u, x), y);
+			texture[1] = interpolate(interpolate(patch[0].v, patch[1].v, x), interpolate(patch[2].v, patch[3].v, x), y);
+		}
+		else
+		{
+			texture[0] = interpolate(interpolate(patch[0].u, patch[1].u, y), interpolate(patch[3].u, patch[2].u, y), x);
+			texture[1] = interpolate(interpolate(patch[0].v, patch[1].v, y), interpolate(patch[3].v, patch[2].v, y), x);
+		}
+	}
+}
+
+void PlaneTessellationMesh::benchmark(FILE* report)
+{
+	const float samples[] = { 0.0f, 0.25f, 0.5f, 0.75f, 1.0f };
+	const float scrolls[] = { 0.0f, 0.37f, 2.5f };
+	const int sampleCount = (int)(sizeof(samples) / sizeof(samples[0]));
+	const int scrollCount = (int)(sizeof(scrolls) / sizeof(scrolls[0]));
+
+	Benchmark::report(report, "Water patches against the four corners per patch generator, %d domain points per patch at %d scroll offsets\n", sampleCount * sampleCount, scrollCount);
+	Benchmark::report(report, "A position or texture coordinate more than a thousandth of a quad's step away from the old one is a mismatch\n");
+	Benchmark::report(report, "%10s %10s %14s %14s %12s %16s %16s\n", "resolution", "patches", "old vertices", "new vertices", "mismatched", "position error", "uv error");
+
+	unsigned long flagged = 0;
+	for (int res = 2; res <= 100; res++)
+	{
+		int patchCount = (res - 1) * (res - 1);
+		std::vector<PrimitiveShapes::VertexType> vertices(res * res);
+		std::vector<unsigned long> indices(patchCount * 4);
+		VertexGenerator::writeGrid(vertices.data(), res, res, 1.0f, 1.0f / res);
+		writeIndices(indices.data(), res);
+
+		float increment = 1.0f / res;
+		float tolerance = 0.001f / res;
+		float u = 0.0f;
+		float v = 0.0f;
+		unsigned long mismatched = 0;
+		float positionError = 0.0f;
+		float textureError = 0.0f;
+		for (int j = 0; j < (res - 1); j++)
+		{
+			for (int i = 0; i < (res - 1); i++)
+			{
+				// The old generator's corners, with texture coordinates stepped by adding the increment.
+				const CornerType oldPatch[4] =
+				{
+					{ (float)i, (float)j, u, v },
+					{ (float)(i + 1), (float)j, u, v + increment },
+					{ (float)(i + 1), (float)(j + 1), u + increment, v },
+					{ (float)i, (float)(j + 1), u + increment, v + increment },
+				};
+				CornerType newPatch[4];
+				for (int k = 0; k < 4; k++)
+				{
+					const PrimitiveShapes::VertexType& corner = vertices[indices[(j * (res - 1) + i) * 4 + k]];
+					CornerType point = { corner.position[0], corner.position[2], corner.texture[0], corner.texture[1] };
+					newPatch[k] = point;
+				}
+
+				for (int s = 0; s < scrollCount; s++)
+				{
+					for (int y = 0; y < sampleCount; y++)
+					{
+						for (int x = 0; x < sampleCount; x++)
+						{
+							float oldPosition[2], oldTexture[2], newPosition[2], newTexture[2];
+							domainPoint(oldPatch, samples[x], samples[y], scrolls[s], true, oldPosition, oldTexture);
+							domainPoint(newPatch, samples[x], samples[y], scrolls[s], false, newPosition, newTexture);
+
+							float pointPositionError = std::max(fabsf(oldPosition[0] - newPosition[0]), fabsf(oldPosition[1] - newPosition[1]));
+							float pointTextureError = std::max(fabsf(oldTexture[0] - newTexture[0]), fabsf(oldTexture[1] - newTexture[1]));
+							positionError = std::max(positionError, pointPositionError);
+							textureError = std::max(textureError, pointTextureError);
+							if (pointPositionError > tolerance || pointTextureError > tolerance)
+							{
+								mismatched++;
+							}
+						}
+					}
+				}
+				u += increment;
+			}
+			u = 0.0f;
+			v += increment;
+		}
+
+		// Every resolution up to 10 and every tenth after, plus any that differ.
+		if (mismatched > 0 || res <= 10 || res % 10 == 0)
+		{
+			const char* note = mismatched > 0 ? "MISMATCH" : "";
+			Benchmark::report(report, "%10d %10d %14d %14d %12lu %16.2e %16.2e %s\n", res, patchCount, patchCount * 4, res * res, mismatched, positionError, textureError, note);
+		}
+		if (mismatched > 0)
+		{
+			flagged++;
+		}
+	}
+	Benchmark::report(report, "%lu of 99 resolutions differ\n", flagged);
 }
@@ -3,6 +3,7 @@
 
 #pragma once
 #include "BaseMesh.h"
+#include <cstdio>
 
 using namespace DirectX;
 
@@ -14,6 +15,13 @@ public:
 
 	// Topology set for handling quad tessellation.
 	void sendData(ID3D11DeviceContext* deviceContext, D3D_PRIMITIVE_TOPOLOGY top = D3D11_PRIMITIVE_TOPOLOGY_4_CONTROL_POINT_PATCHLIST) override;
+
+	// Writes the 4 control points of each quad patch over a grid of res x res vertices, laid out as VertexGenerator::writeGrid() writes them.
+	static void writeIndices(unsigned long* indices, int res);
+
+	// Checks the shared corner patches against the four corners per patch generator, for resolutions 2 to 100.
+	// Samples each patch's domain as water_ds does, before and after the texture coordinate change, and flags any position or texture coordinate that moved.
+	static void benchmark(FILE* report);
 protected:
 	void initBuffers(ID3D11Device* device);
 	int resolution;
@@ -7,13 +7,6 @@ TerrainShader::TerrainShader(ID3D11Device* device, HWND hwnd) : BaseShader(devic
 
 TerrainShader::~TerrainShader()
 {
-	// Release the sampler state.
-	if (sampleState)
-	{
-		sampleState->Release();
-		sampleState = 0;
-	}
-
 	// Release the matrix constant buffer.
 	if (matrixBuffer)
 	{
@@ -21,14 +14,7 @@ TerrainShader::~TerrainShader()
 		matrixBuffer = 0;
 	}
 
-	// Release the height buffer.
-	if (heightBuffer)
-	{
-		heightBuffer->Release();
-		heightBuffer = 0;
-	}
-
-	// Release the height buffer.
+	// Release the camera buffer.
 	if (cameraBuffer)
 	{
 		cameraBuffer->Release();
@@ -49,8 +35,6 @@ TerrainShader::~TerrainShader()
 void TerrainShader::initShader(const wchar_t* vsFilename, const wchar_t* psFilename)
 {
 	D3D11_BUFFER_DESC matrixBufferDesc;
-	D3D11_SAMPLER_DESC samplerDesc;
-	D3D11_BUFFER_DESC heightBufferDesc;
 	D3D11_BUFFER_DESC cameraBufferDesc;
 
 	// Load (+ compile) shader files
@@ -74,31 +58,12 @@ void TerrainShader::initShader(const wchar_t* vsFilename, const wchar_t* psFilen
 	cameraBufferDesc.MiscFlags = 0;
 	cameraBufferDesc.StructureByteStride = 0;
 	renderer->CreateBuffer(&cameraBufferDesc, NULL, &cameraBuffer);
-
-	// Setup height buffer.
-	heightBufferDesc.Usage = D3D11_USAGE_DYNAMIC;
-	heightBufferDesc.ByteWidth = sizeof(HeightBufferType);
-	heightBufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-	heightBufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
-	heightBufferDesc.MiscFlags = 0;
-	heightBufferDesc.StructureByteStride = 0;
-	renderer->CreateBuffer(&heightBufferDesc, NULL, &heightBuffer);
-
-	// Create a texture sampler state description.
-	samplerDesc.Filter = D3D11_FILTER_ANISOTROPIC;
-	samplerDesc.AddressU = D3D11_TEXTURE_ADDRESS_WRAP;
-	samplerDesc.AddressV = D3D11_TEXTURE_ADDRESS_WRAP;
-	samplerDesc.AddressW = D3D11_TEXTURE_ADDRESS_WRAP;
-	samplerDesc.MipLODBias = 0.0f;
-	samplerDesc.MaxAnisotropy = 1;
-	samplerDesc.ComparisonFunc = D3D11_COMPARISON_ALWAYS;
-	samplerDesc.MinLOD = 0;
-	samplerDesc.MaxLOD = D3D11_FLOAT32_MAX;
-	renderer->CreateSamplerState(&samplerDesc, &sampleState);
 }
 
-void TerrainShader::setShaderParameters(ID3D11DeviceContext* deviceContext, const XMMATRIX& worldMatrix, const XMMATRIX& viewMatrix, const XMMATRIX& projectionMatrix, ID3D11ShaderResourceView* heightMap, float amplitude, XMMATRIX viewMatrices[LIGHT_COUNT][6], XMMATRIX projMatrices[LIGHT_COUNT][6], XMFLOAT3 camPosition)
+void TerrainShader::setShaderParameters(ID3D11DeviceContext* deviceContext, const XMMATRIX& worldMatrix, const XMMATRIX& viewMatrix, const XMMATRIX& projectionMatrix, XMMATRIX viewMatrices[LIGHT_COUNT][6], XMMATRIX projMatrices[LIGHT_COUNT][6], XMFLOAT3 camPosition)
 {
+	StateCache* stateCache = StateCache::get(deviceContext);
+
 	HRESULT result;
 	D3D11_MAPPED_SUBRESOURCE mappedResource;
 	LightShader::MatrixBufferType* dataPtr;
@@ -129,18 +94,7 @@ void TerrainShader::setShaderParameters(ID3D11DeviceContext* deviceContext, cons
 	deviceContext->Unmap(matrixBuffer, 0);
 
 	// Send to vertex shader.
-	deviceContext->VSSetConstantBuffers(0, 1, &matrixBuffer);
-
-	// Set height buffer values.
-	HeightBufferType* heightPtr;
-	deviceContext->Map(heightBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource);
-	heightPtr = (HeightBufferType*)mappedResource.pData;
-	heightPtr->amplitude = amplitude;
-	heightPtr->padding = XMFLOAT3(0, 0, 0);
-	deviceContext->Unmap(heightBuffer, 0);
-
-	// Send to vertex shader.
-	deviceContext->VSSetConstantBuffers(2, 1, &heightBuffer);
+	stateCache->VSSetConstantBuffers(0, 1, &matrixBuffer);
 
 	// Set camera buffer values.
 	// Uses light shader's camera buffer type.
@@ -152,11 +106,7 @@ void TerrainShader::setShaderParameters(ID3D11DeviceContext* deviceContext, cons
 	deviceContext->Unmap(cameraBuffer, 0);
 
 	// Send to vertex shader.
-	deviceContext->VSSetConstantBuffers(3, 1, &cameraBuffer);
-
-	// Set height map as shader resource, and set sampler.
-	deviceContext->VSSetShaderResources(0, 1, &heightMap);
-	deviceContext->VSSetSamplers(0, 1, &sampleState);
+	stateCache->VSSetConstantBuffers(3, 1, &cameraBuffer);
 }
 
 
@@ -72,6 +72,8 @@ void TextureShader::initShader(const wchar_t* vsFilename, const wchar_t* psFilen
 
 void TextureShader::setShaderParameters(ID3D11DeviceContext* deviceContext, const XMMATRIX& worldMatrix, const XMMATRIX& viewMatrix, const XMMATRIX& projectionMatrix, ID3D11ShaderResourceView* texture, XMFLOAT4 colour)
 {
+	StateCache* stateCache = StateCache::get(deviceContext);
+
 	HRESULT result;
 	D3D11_MAPPED_SUBRESOURCE mappedResource;
 	TextureBufferType* dataPtr;
@@ -90,10 +92,10 @@ void TextureShader::setShaderParameters(ID3D11DeviceContext* deviceContext, cons
 	dataPtr->projection = proj;
 	dataPtr->colour = colour;
 	deviceContext->Unmap(textureBuffer, 0);
-	deviceContext->VSSetConstantBuffers(0, 1, &textureBuffer);
+	stateCache->VSSetConstantBuffers(0, 1, &textureBuffer);
 
 	// Set shader texture and sampler resource in the pixel shader.
-	deviceContext->PSSetShaderResources(0, 1, &texture);
-	deviceContext->PSSetSamplers(0, 1, &sampleState);
+	stateCache->PSSetShaderResources(0, 1, &texture);
+	stateCache->PSSetSamplers(0, 1, &sampleState);
 }
 
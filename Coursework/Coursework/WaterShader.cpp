@@ -129,6 +129,8 @@ void WaterShader::initShader(const wchar_t* vsFilename, const wchar_t* hsFilenam
 
 void WaterShader::setShaderParameters(ID3D11DeviceContext* deviceContext, const XMMATRIX& worldMatrix, const XMMATRIX& viewMatrix, const XMMATRIX& projectionMatrix, TessellationProperties tessProperties, float time, float amplitude, float frequency, float speed, XMFLOAT3 camPos, XMMATRIX viewMatrices[LIGHT_COUNT][6], XMMATRIX projMatrices[LIGHT_COUNT][6], ID3D11ShaderResourceView* heightMap)
 {
+	StateCache* stateCache = StateCache::get(deviceContext);
+
 	HRESULT result;
 	D3D11_MAPPED_SUBRESOURCE mappedResource;
 
@@ -154,8 +156,8 @@ void WaterShader::setShaderParameters(ID3D11DeviceContext* deviceContext, const
 	deviceContext->Unmap(matrixBuffer, 0);
 
 	// Set buffer in domain and vertex shader.
-	deviceContext->DSSetConstantBuffers(0, 1, &matrixBuffer);
-	deviceContext->VSSetConstantBuffers(0, 1, &matrixBuffer);
+	stateCache->DSSetConstantBuffers(0, 1, &matrixBuffer);
+	stateCache->VSSetConstantBuffers(0, 1, &matrixBuffer);
 
 	// Write tessellation information to the tessellation buffer.
 	result = deviceContext->Map(tessellationBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource);
@@ -171,7 +173,7 @@ void WaterShader::setShaderParameters(ID3D11DeviceContext* deviceContext, const
 	deviceContext->Unmap(tessellationBuffer, 0);
 
 	// Set buffer in hull shader.
-	deviceContext->HSSetConstantBuffers(0, 1, &tessellationBuffer);
+	stateCache->HSSetConstantBuffers(0, 1, &tessellationBuffer);
 
 	// Set wave buffer values.
 	result = deviceContext->Map(waveBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource);
@@ -183,7 +185,7 @@ void WaterShader::setShaderParameters(ID3D11DeviceContext* deviceContext, const
 	deviceContext->Unmap(waveBuffer, 0);
 
 	// Set buffer in domain shader.
-	deviceContext->DSSetConstantBuffers(1, 1, &waveBuffer);
+	stateCache->DSSetConstantBuffers(1, 1, &waveBuffer);
 
 	// Set camera buffer values.
 	result = deviceContext->Map(cameraBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource);
@@ -193,10 +195,10 @@ void WaterShader::setShaderParameters(ID3D11DeviceContext* deviceContext, const
 	deviceContext->Unmap(cameraBuffer, 0);
 
 	// Camera buffer is passed to hull and domain shaders.
-	deviceContext->HSSetConstantBuffers(1, 1, &cameraBuffer);
-	deviceContext->DSSetConstantBuffers(2, 1, &cameraBuffer);
+	stateCache->HSSetConstantBuffers(1, 1, &cameraBuffer);
+	stateCache->DSSetConstantBuffers(2, 1, &cameraBuffer);
 
 	// Domain shader has heightmap texture and a sampler.
-	deviceContext->DSSetShaderResources(0, 1, &heightMap);
-	deviceContext->DSSetSamplers(0, 1, &sampleState);
+	stateCache->DSSetShaderResources(0, 1, &heightMap);
+	stateCache->DSSetSamplers(0, 1, &sampleState);
 }
\ No newline at end of file
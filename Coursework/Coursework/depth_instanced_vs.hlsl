@@ -0,0 +1,5 @@
+// Depth vertex shader for instanced meshes
+// Same as depth_vs, with the world matrix read per instance from the second vertex stream (see InstanceBuffer).
+
+#define INSTANCED
+#include "depth_vs.hlsl"
@@ -12,6 +12,12 @@ struct InputType
     float4 position : POSITION;
     float2 tex : TEXCOORD0;
     float3 normal : NORMAL;
+#ifdef INSTANCED
+    float4 world0 : WORLD0;
+    float4 world1 : WORLD1;
+    float4 world2 : WORLD2;
+    float4 world3 : WORLD3;
+#endif
 };
 
 struct OutputType
@@ -24,8 +30,15 @@ OutputType main(InputType input)
 {
     OutputType output;
 
+    // Instanced meshes (see depth_instanced_vs.hlsl) take their world matrix from the instance stream, one row per element.
+#ifdef INSTANCED
+    float4x4 world = float4x4(input.world0, input.world1, input.world2, input.world3);
+#else
+    float4x4 world = worldMatrix;
+#endif
+
     // Calculate the position of the vertex against the world, view, and projection matrices.
-    output.position = mul(input.position, worldMatrix);
+    output.position = mul(input.position, world);
     output.position = mul(output.position, viewMatrix);
     output.position = mul(output.position, projectionMatrix);
 
@@ -1,5 +1,5 @@
 // Fire geometry shader.
-// Generates a quad that has texture co-ordinates and normals.
+// Generates a quad that has texture co-ordinates and normals around each particle's point, sized by the point.
 
 // Matrix buffer.
 cbuffer MatrixBuffer : register(b0)
@@ -20,26 +20,23 @@ cbuffer CameraBuffer : register(b1)
 
 cbuffer ParticleBuffer : register(b2)
 {
-    float particleHeight;
-    float particleSize;
     float elapsedTime;
     float maxHeight;
     float minHeight;
     float renderNormals;
-    float2 particlePadding;
     float4 bottomColour;
     float4 topColour;
 }
 
 cbuffer PositionBuffer
 {
-    // Fixed position and texture co-ordinates
+    // Fixed corners of a quad one particle size across, and texture co-ordinates
     static float3 positions[4] =
     {
-        float3(-particleSize, particleSize, 0),
-		float3(-particleSize, -particleSize, 0),
-		float3(particleSize, particleSize, 0),
-		float3(particleSize, -particleSize, 0)
+        float3(-0.5, 0.5, 0),
+		float3(-0.5, -0.5, 0),
+		float3(0.5, 0.5, 0),
+		float3(0.5, -0.5, 0)
     };
     
     static float2 texCoords[4] =
@@ -54,8 +51,8 @@ cbuffer PositionBuffer
 struct InputType
 {
     float4 position : POSITION;
-    float2 tex : TEXCOORD0;
-    float3 normal : NORMAL;
+    float size : PSIZE;
+    float height : TEXCOORD1;
 };
 
 struct OutputType
@@ -63,6 +60,7 @@ struct OutputType
     float4 position : SV_POSITION;
     float2 tex : TEXCOORD0;
     float3 normal : NORMAL;
+    float height : TEXCOORD1;
 };
 
 [maxvertexcount(4)]
@@ -70,12 +68,7 @@ void main(point InputType input[1], inout TriangleStream<OutputType> triStream)
 {
     OutputType output;
 	
-    
-     
-	
-    // Move position into world space for subtracting from camera position.
-    input[0].position = mul(input[0].position, worldMatrix);
-    
+    // The vertex shader has already moved the point into world space.
     // For each vertex...
     for (int i = 0; i < 4; i++)
     {
@@ -84,7 +77,7 @@ void main(point InputType input[1], inout TriangleStream<OutputType> triStream)
         float3 normal = float3(0, 0, -1);
         
         // Calculate the vector between the vertex position and the camera's position.
-        float3 posVec = float3(input[0].position.x - cameraPosition.x * 2, 0, input[0].position.z - cameraPosition.z * 2);
+        float3 posVec = float3(input[0].position.x - cameraPosition.x, 0, input[0].position.z - cameraPosition.z);
         
         // Calculate angle of the vector.
         float angle = atan2(posVec.x, posVec.z);
@@ -98,18 +91,19 @@ void main(point InputType input[1], inout TriangleStream<OutputType> triStream)
         };
         
         // Multiply the position by the rotation matrix.
-        float3 newPos = mul(rotationMatrix, positions[i]);
+        float3 newPos = mul(rotationMatrix, positions[i] * input[0].size);
         
         // Multiply the normal by the rotation matrix.
         normal = mul(rotationMatrix, normal);
         
         // Set position, texture co-ordinates and normal.
-        output.position = input[0].position + float4(newPos, 1);
+        output.position = float4(input[0].position.xyz + newPos, 1);
         output.position = mul(output.position, viewMatrix);
         output.position = mul(output.position, projectionMatrix);
         output.tex = texCoords[i];
         output.normal = mul(normal, (float3x3) worldMatrix);
         output.normal = normalize(output.normal);
+        output.height = input[0].height;
         triStream.Append(output);
     }
     triStream.RestartStrip();
@@ -6,13 +6,10 @@ SamplerState sampler0 : register(s0);
 
 cbuffer ParticleBuffer : register(b0)
 {
-    float particleHeight;
-    float particleSize;
     float elapsedTime;
     float maxHeight;
     float minHeight;
     int renderNormals;
-    float2 particlePadding;
     float4 bottomColour;
     float4 topColour;
 }
@@ -22,6 +19,7 @@ struct InputType
     float4 position : SV_POSITION;
     float2 tex : TEXCOORD0;
     float3 normal : NORMAL;
+    float height : TEXCOORD1;
 };
 
 float4 main(InputType input) : SV_TARGET
@@ -34,7 +32,7 @@ float4 main(InputType input) : SV_TARGET
     else // Otherwise render a colour based on particle height.
     {
         // Lerp alpha is the difference between the particle height and max height divided by the difference between the min height and max height.
-        float alpha = (particleHeight - maxHeight) / (minHeight - maxHeight);
+        float alpha = (input.height - maxHeight) / (minHeight - maxHeight);
         
         // Lerp between the colours based on this value.
         return lerp(topColour, bottomColour, alpha);
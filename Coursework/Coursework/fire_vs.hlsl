@@ -1,5 +1,5 @@
 // Fire vertex shader.
-// Adjust's particles position using a sine wave, then outputs the world position.
+// Adjust's particles position using a sine wave, then outputs the world position. Every particle of the fire is one point of the same draw.
 
 // Matrix buffer. Used here for getting the world position of the point.
 cbuffer MatrixBuffer : register(b0)
@@ -12,50 +12,48 @@ cbuffer MatrixBuffer : register(b0)
 // Particle buffer. This stage uses the elapsed time for the sine waves.
 cbuffer ParticleBuffer : register(b1)
 {
-    float particleHeight;
-    float particleSize;
     float elapsedTime;
     float maxHeight;
     float minHeight;
     int renderNormals;
-    float2 particlePadding;
     float4 bottomColour;
     float4 topColour;
 }
 
+// Particle centre and the width of its quad (see CustomPointMesh).
 struct InputType
 {
-    float4 position : POSITION;
-    float2 tex : TEXCOORD0;
-    float3 normal : NORMAL;
+    float3 position : POSITION;
+    float size : PSIZE;
+    uint id : SV_VertexID;
 };
 
 struct OutputType
 {
-    float4 position : SV_POSITION;
-    float2 tex : TEXCOORD0;
-    float3 normal : NORMAL;
+    float4 position : POSITION;
+    float size : PSIZE;
+    float height : TEXCOORD1;
 };
 
-InputType main(InputType input)
+OutputType main(InputType input)
 {
     OutputType output;
     
     // Fixed values to be used in wave.
     float speed = 2;
-    float frequency = 2;
-    float amplitude = 0.5;
+    float amplitude = 0.25;
     
-    // Output tex coords and normals are the same as the inputs.
-    output.tex = input.tex;
-    output.normal = input.normal;
-    
-    // Get input position.
-    output.position = input.position;
+    // Offset each particle's wave by its index so they don't all sway together.
+    float time = elapsedTime + input.id;
+
+    // Size and height pass through. The pixel shader colours the particle by its height before the wave moves it.
+    output.size = input.size;
+    output.height = input.position.y;
     
-    // Transform the x and z positions using a sine wave. The y position is adjusted outside of the shader.
-    output.position.x = sin((output.position.x * frequency) + (elapsedTime * speed)) * amplitude;
-    output.position.z = sin((output.position.z * frequency) + (elapsedTime * speed)) * amplitude;
+    // Move the particle around its centre using a sine wave in x and z. The y position is adjusted outside of the shader.
+    output.position = float4(input.position, 1);
+    output.position.x += sin(time * speed) * amplitude;
+    output.position.z += sin(time * speed) * amplitude;
     
     // Multiply output position by the world matrix to get the position in the world.
     output.position = mul(output.position, worldMatrix);
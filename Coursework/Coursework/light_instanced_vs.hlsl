@@ -0,0 +1,5 @@
+// Light vertex shader for instanced meshes
+// Same as light_vs, with the world matrix read per instance from the second vertex stream (see InstanceBuffer).
+
+#define INSTANCED
+#include "light_vs.hlsl"
@@ -21,13 +21,18 @@ cbuffer LightBuffer : register(b0)
     int4 type[LIGHT_COUNT];
     float4 spotlightProperties[LIGHT_COUNT];
     float4 specularColour[LIGHT_COUNT];
-    float4 specularPower[LIGHT_COUNT];
     float shadowMapBias;
-    int calcNormals; 
     int renderNormals;
+    float2 padding;
+};
+
+// Material properties, and the heightmap values for meshes that calculate their normals per pixel.
+cbuffer MaterialBuffer : register(b1)
+{
+    float specularPower;
+    int calcNormals;
     float amplitude;
     float resolution;
-    float3 padding;
 };
 
 struct InputType
@@ -226,16 +231,16 @@ float4 main(InputType input) : SV_TARGET
                 }
             }
 
-            if (specularPower[i].x < 100) // Specular turns off at 100. When the specular power is below this value calculate the specular lighting.
+            if (specularPower < 100) // Specular turns off at 100. When the specular power is below this value calculate the specular lighting.
             {
                 // Modify texture colour by the calculated specular lighting colour. Directional lights use the light's direction, point and spotlights use the light vector.
                 if (type[i].x == 0) 
                 {
-                    textureColour = textureColour + calculateSpecular(-direction[i].xyz, input.normal, input.viewVector, specularColour[i], specularPower[i].x);
+                    textureColour = textureColour + calculateSpecular(-direction[i].xyz, input.normal, input.viewVector, specularColour[i], specularPower);
                 }
                 else
                 {
-                    textureColour = textureColour + saturate(calculateSpecular(lightVector[i], input.normal, input.viewVector, specularColour[i], specularPower[i].x));
+                    textureColour = textureColour + saturate(calculateSpecular(lightVector[i], input.normal, input.viewVector, specularColour[i], specularPower));
                 }
             }
 
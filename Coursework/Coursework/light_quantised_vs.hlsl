@@ -0,0 +1,5 @@
+// Light vertex shader for quantised meshes
+// Same as light_vs, for 16 byte vertices with snorm positions and octahedral normals (see VertexQuantiser).
+
+#define QUANTISED
+#include "light_vs.hlsl"
@@ -3,32 +3,63 @@
 
 #define LIGHT_COUNT 4
 
-// Matrix buffer
-cbuffer MatrixBuffer : register(b0)
+// Object buffer, the only one that changes between most draws.
+cbuffer ObjectBuffer : register(b0)
 {
     matrix worldMatrix;
+};
+
+// Frame buffer, the camera and every light's matrices.
+cbuffer FrameBuffer : register(b1)
+{
     matrix viewMatrix;
     matrix projectionMatrix;
 
     matrix lightViewMatrix[LIGHT_COUNT][6];
     matrix lightProjectionMatrix[LIGHT_COUNT][6];
-};
 
-// Camera buffer
-cbuffer CameraBuffer : register(b1)
-{
     float3 cameraPosition;
     float padding;
 };
 
 
+// Quantised meshes (see light_quantised_vs.hlsl) store an octahedral normal. Their positions are decoded by the world matrix.
+#ifdef QUANTISED
+struct InputType
+{
+    float4 position : POSITION;
+    float2 normal : NORMAL;
+    float2 tex : TEXCOORD0;
+};
+
+// Unfold the octahedral normal back onto the unit sphere.
+float3 decodeNormal(float2 encoded)
+{
+    float3 normal = float3(encoded, 1.0f - abs(encoded.x) - abs(encoded.y));
+    float t = saturate(-normal.z);
+    normal.xy += normal.xy >= 0.0f ? -t : t;
+    return normalize(normal);
+}
+#else
 struct InputType
 {
     float4 position : POSITION;
     float2 tex : TEXCOORD0;
     float3 normal : NORMAL;
+#ifdef INSTANCED
+    float4 world0 : WORLD0;
+    float4 world1 : WORLD1;
+    float4 world2 : WORLD2;
+    float4 world3 : WORLD3;
+#endif
 };
 
+float3 decodeNormal(float3 normal)
+{
+    return normal;
+}
+#endif
+
 struct OutputType
 {
     float4 position : SV_POSITION;
@@ -43,9 +74,16 @@ struct OutputType
 OutputType main(InputType input)
 {
     OutputType output;
+
+    // Instanced meshes (see light_instanced_vs.hlsl) take their world matrix from the instance stream, one row per element.
+#ifdef INSTANCED
+    float4x4 world = float4x4(input.world0, input.world1, input.world2, input.world3);
+#else
+    float4x4 world = worldMatrix;
+#endif
     
 	// Calculate the position of the vertex against the world, view, and projection matrices.
-    output.position = mul(input.position, worldMatrix);
+    output.position = mul(input.position, world);
     output.position = mul(output.position, viewMatrix);
     output.position = mul(output.position, projectionMatrix);
 
@@ -54,7 +92,7 @@ OutputType main(InputType input)
     {
         for (int j = 0; j < 6; j++)
         {
-            output.lightViewPos[i][j] = mul(input.position, worldMatrix);
+            output.lightViewPos[i][j] = mul(input.position, world);
             output.lightViewPos[i][j] = mul(output.lightViewPos[i][j], lightViewMatrix[i][j]);
             output.lightViewPos[i][j] = mul(output.lightViewPos[i][j], lightProjectionMatrix[i][j]);
         }
@@ -64,11 +102,11 @@ OutputType main(InputType input)
     output.tex = input.tex;
 
 	// Calculate the normal vector against the world matrix only and normalise.
-    output.normal = mul(input.normal, (float3x3) worldMatrix);
+    output.normal = mul(decodeNormal(input.normal), (float3x3) world);
     output.normal = normalize(output.normal);
 
     // Calculate the position of the vertex in the world.
-    output.worldPosition = mul(input.position, worldMatrix).xyz;
+    output.worldPosition = mul(input.position, world).xyz;
 	
     // Calculate view vector - direction between camera and world position.
     output.viewVector = cameraPosition.xyz - output.worldPosition.xyz;
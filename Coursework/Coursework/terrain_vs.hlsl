@@ -3,10 +3,6 @@
 
 #define LIGHT_COUNT 4
 
-// Height map texture and sampler
-Texture2D heightMap : register(t0);
-SamplerState heightSampler : register(s0);
-
 // Matrix buffer.
 cbuffer MatrixBuffer : register(b0)
 {
@@ -18,12 +14,6 @@ cbuffer MatrixBuffer : register(b0)
     matrix lightProjectionMatrix[LIGHT_COUNT][6];
 };
 
-// Height buffer.
-cbuffer HeightBuffer : register(b2)
-{
-    float amplitude;
-}
-
 // Camera buffer.
 cbuffer CameraBuffer : register(b3)
 {
@@ -48,23 +38,13 @@ struct OutputType
     float4 lightViewPos[LIGHT_COUNT][6] : TEXCOORD4;
 };
 
-// Get the height from the heightmap's texture sample.
-float GetHeight(float4 colour)
-{
-    float height;
-    float4 textureColour = colour;
-    height = textureColour.xyz;
-    return height;
-};
-
 OutputType main(InputType input)
 {
     OutputType output;
 
-	// Increase the y position based on the height map's colour * the amplitude
-    input.position.y += GetHeight(heightMap.SampleLevel(heightSampler, input.tex, 0)) * amplitude;
-    
-    // Normals are calculated in pixel shader for more detail.
+	// The heights and smooth normals are already baked into the vertices (see TerrainMesh).
+    // The pixel shader can still work out normals from the height map for more detail.
+    output.normal = normalize(mul(input.normal, (float3x3)worldMatrix));
 
 	// Calculate the position of the vertex against the world, view, and projection matrices.
     output.position = mul(input.position, worldMatrix);
@@ -81,9 +81,10 @@ OutputType main(ConstantOutputType input, float2 uvwCoord : SV_DomainLocation, c
     uvwCoord = float2(uvwCoord.x, uvwCoord.y + time * speed);
     
     // Output updated texture co-ordinates after being moved to the pixel shader.
-    float2 tex1 = lerp(patch[0].tex, patch[1].tex, uvwCoord.x);
-    float2 tex2 = lerp(patch[2].tex, patch[3].tex, uvwCoord.x);
-    output.tex = lerp(tex1, tex2, uvwCoord.y);
+    // Interpolated the same way as the position, as the patch corners share their texture co-ordinates with the neighbouring patches.
+    float2 tex1 = lerp(patch[0].tex, patch[1].tex, uvwCoord.y);
+    float2 tex2 = lerp(patch[3].tex, patch[2].tex, uvwCoord.y);
+    output.tex = lerp(tex1, tex2, uvwCoord.x);
     
     // Calculate height and apply to the vertex position.
     vertexPosition.y += GetHeight(heightMap.SampleLevel(heightSampler, output.tex, 0)) * amplitude;
@@ -1,8 +1,24 @@
 #include "AModel.h"
+#include "MeshCache.h"
+#include "MeshOptimiser.h"
+#include "MeshSimplifier.h"
+#include <algorithm>
+#include <cfloat>
 
-AModel::AModel(ID3D11Device* ldevice, const std::string& file)
+AModel::AModel(ID3D11Device* ldevice, const std::string& lfile, bool quantise, bool lkeepCpuMesh, const ImportProfile& lprofile) : profile(lprofile), file(lfile)
 {
 	device = ldevice;
+	quantised = quantise;
+	keepCpuMesh = lkeepCpuMesh;
+	importModel(file);
+	initBuffers(device);
+}
+
+AModel::AModel(const std::string& lfile, bool quantise, bool lkeepCpuMesh, const ImportProfile& lprofile) : profile(lprofile), file(lfile)
+{
+	device = nullptr;
+	quantised = quantise;
+	keepCpuMesh = lkeepCpuMesh;
 	importModel(file);
 }
 
@@ -11,80 +27,79 @@ AModel::~AModel()
 
 }
 
-void AModel::initBuffers(ID3D11Device* device)
+void AModel::createBuffers(ID3D11Device* ldevice)
 {
-	
+	device = ldevice;
+	initBuffers(device);
 }
 
-void AModel::importModel(const std::string& pFile)
+// Create the vertex and index buffers, from the cooked mesh or the imported arrays. The cooked mesh keeps full precision floats, quantising happens on upload.
+void AModel::initBuffers(ID3D11Device* device)
 {
-	// Create an instance of the Importer class
-	Assimp::Importer importer;
-	// And have it read the given file with some example postprocessing
-	// Usually - if speed is not the most important aspect for you - you'll
-	// probably to request more postprocessing than we do in this example.
-	const aiScene* scene = importer.ReadFile(pFile,
-		aiProcess_CalcTangentSpace |
-		aiProcess_Triangulate |
-		aiProcess_JoinIdenticalVertices |
-		aiProcess_SortByPType|
-		aiProcess_MakeLeftHanded|
-		aiProcess_FlipUVs);
-	// If the import failed, report it
-	/*if (!scene)
-	{
-		DoTheErrorLogging(importer.GetErrorString());
-		return false;
-	}*/
-	// Now we can access the file's contents.
-	//modelProcessing(scene);#
+	// Shared with any other model imported from the same file with the same profile.
+	char key[16];
+	sprintf_s(key, "|%08x", profile.getCacheKey());
 
-	if (scene)
+	if (cache.getVertices())
 	{
-		processNode(scene->mRootNode, scene);
+		createVertexBuffer(device, (const VertexType*)cache.getVertices());
+		createIndexBuffer(device, cache.getIndices());
+		retainCpuMesh(file + key, (const VertexType*)cache.getVertices(), cache.getIndices());
 	}
-
-	// Set up the description of the static vertex buffer.
-	D3D11_BUFFER_DESC vertexBufferDesc, indexBufferDesc;
-	D3D11_SUBRESOURCE_DATA vertexData, indexData;
-	vertexBufferDesc.Usage = D3D11_USAGE_DEFAULT;
-	vertexBufferDesc.ByteWidth = sizeof(VertexType)* (int)vertices.size();
-	vertexBufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-	vertexBufferDesc.CPUAccessFlags = 0;
-	vertexBufferDesc.MiscFlags = 0;
-	vertexBufferDesc.StructureByteStride = 0;
-	// Give the subresource structure a pointer to the vertex data.
-	vertexData.pSysMem = vertices.data();
-	vertexData.SysMemPitch = 0;
-	vertexData.SysMemSlicePitch = 0;
-	// Now create the vertex buffer.
-	device->CreateBuffer(&vertexBufferDesc, &vertexData, &vertexBuffer);
-
-	// Set up the description of the static index buffer.
-	indexBufferDesc.Usage = D3D11_USAGE_DEFAULT;
-	indexBufferDesc.ByteWidth = sizeof(unsigned long)* (int)indices.size();
-	indexBufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
-	indexBufferDesc.CPUAccessFlags = 0;
-	indexBufferDesc.MiscFlags = 0;
-	indexBufferDesc.StructureByteStride = 0;
-	// Give the subresource structure a pointer to the index data.
-	indexData.pSysMem = indices.data();
-	indexData.SysMemPitch = 0;
-	indexData.SysMemSlicePitch = 0;
-	// Create the index buffer.
-	device->CreateBuffer(&indexBufferDesc, &indexData, &indexBuffer);
+	else
+	{
+		createVertexBuffer(device, vertices.data());
+		createIndexBuffer(device, indices.data());
+		retainCpuMesh(file + key, vertices.data(), indices.data());
+	}
+	cache.close();
 
 	// Release the arrays now that the vertex and index buffers have been created and loaded.
-	//delete vertices;
-	//vertices = 0;
+	std::vector<VertexType>().swap(vertices);
+	std::vector<unsigned long>().swap(indices);
+}
 
-	//delete indices;
-	//indices = 0;
-	vertexCount = (int)vertices.size();
-	indexCount = (int)indices.size();
+void AModel::importModel(const std::string& pFile)
+{
+	// Use the cooked mesh if it is up to date with the file and import profile, otherwise import and cook it for next time.
+	// The cache stays open until initBuffers() has uploaded it.
+	if (cache.open(pFile.c_str(), profile.getCacheKey(), sizeof(VertexType)))
+	{
+		vertexCount = (int)cache.getVertexCount();
+		lods.assign(cache.getLods(), cache.getLods() + cache.getLodCount());
+		meshlets.assign(cache.getMeshlets(), cache.getMeshlets() + cache.getMeshletCount());
+		submeshes.assign(cache.getSubmeshes(), cache.getSubmeshes() + cache.getSubmeshCount());
+		submeshLods.assign(cache.getSubmeshLods(), cache.getSubmeshLods() + cache.getSubmeshCount() * cache.getLodCount());
+		indexCount = lods.empty() ? (int)cache.getIndexCount() : (int)lods[0].indexCount;
+	}
+	else
+	{
+		// Create an instance of the Importer class
+		Assimp::Importer importer;
+		// And have it read the given file with only the postprocessing the profile asks for.
+		profile.configure(importer);
+		const aiScene* scene = importer.ReadFile(pFile, profile.getPostProcessFlags());
+		// If the import failed, report it
+		/*if (!scene)
+		{
+			DoTheErrorLogging(importer.GetErrorString());
+			return false;
+		}*/
+		// Now we can access the file's contents.
+		//modelProcessing(scene);#
 
-	//vertices.clear();
-	//indices.clear();
+		if (scene)
+		{
+			// Every mesh in the file becomes a part, then each part is cooked on its own so later loads get it for free.
+			processNode(scene->mRootNode, scene, aiMatrix4x4());
+			cookSubmeshes();
+			cache.write(vertices.data(), (unsigned int)vertices.size(), indices.data(), (unsigned int)indices.size(), lods.data(), (unsigned int)lods.size(), meshlets.data(), (unsigned int)meshlets.size(),
+				submeshes.data(), (unsigned int)submeshes.size(), submeshLods.data());
+		}
+
+		vertexCount = (int)vertices.size();
+		indexCount = lods.empty() ? (int)indices.size() : (int)lods[0].indexCount;
+	}
 }
 
 void AModel::modelProcessing(const aiScene* scene)
@@ -189,21 +204,23 @@ void AModel::processScene(const aiScene* scene)
 {
 
 }
-void AModel::processNode(const aiNode* node, const aiScene* scene)
+void AModel::processNode(const aiNode* node, const aiScene* scene, const aiMatrix4x4& parentTransform)
 {
+	aiMatrix4x4 transform = parentTransform * node->mTransformation;
+
 	for (UINT i = 0; i < node->mNumMeshes; i++)
 	{
 		aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
 		//meshes.push_back(this->processMesh(mesh, scene));
-		processMesh(mesh, scene);
+		processMesh(mesh, scene, transform);
 	}
 
 	for (UINT i = 0; i < node->mNumChildren; i++)
 	{
-		this->processNode(node->mChildren[i], scene);
+		this->processNode(node->mChildren[i], scene, transform);
 	}
 }
-void AModel::processMesh(const aiMesh* mesh, const aiScene* scene)
+void AModel::processMesh(const aiMesh* mesh, const aiScene* scene, const aiMatrix4x4& transform)
 {
 	/*for (UINT i = 0; i < mesh->mNumVertices; i++)
 	{
@@ -232,15 +249,33 @@ void AModel::processMesh(const aiMesh* mesh, const aiScene* scene)
 
 	//---------------------------------
 
+	// aiProcess_SortByPType moves points and lines into meshes of their own, or drops them (see ImportProfile). Only triangles are drawn.
+	if (!(mesh->mPrimitiveTypes & aiPrimitiveType_TRIANGLE) || mesh->mNumFaces == 0)
+	{
+		return;
+	}
+
+	// Each mesh is a part, its indices count from its own first vertex.
+	SubmeshType part = {};
+	part.indexStart = (unsigned int)indices.size();
+	part.baseVertex = (int)vertices.size();
+	part.vertexCount = mesh->mNumVertices;
+	part.materialIndex = mesh->mMaterialIndex;
+
+	// The node places the mesh in the model, bake that into the vertices. Normals take the inverse transpose.
+	aiMatrix3x3 normalTransform = aiMatrix3x3(transform);
+	normalTransform.Inverse().Transpose();
+
 	for (UINT i = 0; i < mesh->mNumVertices; i++)
 	{
 		XMFLOAT3 vert;
-		XMFLOAT2 text;
-		XMFLOAT3 norm;
+		XMFLOAT2 text(0.0f, 0.0f);
+		XMFLOAT3 norm(0.0f, 0.0f, 0.0f);
 
-		vert.x = mesh->mVertices[i].x;
-		vert.y = mesh->mVertices[i].y;
-		vert.z = mesh->mVertices[i].z;
+		aiVector3D position = transform * mesh->mVertices[i];
+		vert.x = position.x;
+		vert.y = position.y;
+		vert.z = position.z;
 
 		if (mesh->HasTextureCoords(0))
 		{
@@ -250,9 +285,11 @@ void AModel::processMesh(const aiMesh* mesh, const aiScene* scene)
 
 		if (mesh->HasNormals())
 		{
-			norm.x = mesh->mNormals[i].x;
-			norm.y = mesh->mNormals[i].y;
-			norm.z = mesh->mNormals[i].z;
+			aiVector3D normal = normalTransform * mesh->mNormals[i];
+			normal.Normalize();
+			norm.x = normal.x;
+			norm.y = normal.y;
+			norm.z = normal.z;
 		}
 
 		VertexType vertex;
@@ -264,11 +301,111 @@ void AModel::processMesh(const aiMesh* mesh, const aiScene* scene)
 
 	for (UINT i = 0; i < mesh->mNumFaces; i++)
 	{
-		aiFace face = mesh->mFaces[i];
+		const aiFace& face = mesh->mFaces[i];
+		if (face.mNumIndices != 3)
+		{
+			continue;
+		}
 
 		for (UINT j = 0; j < face.mNumIndices; j++)
 			indices.push_back(face.mIndices[j]);
 	}
+
+	part.indexCount = (unsigned int)indices.size() - part.indexStart;
+	submeshes.push_back(part);
+}
+
+// Optimises, splits into meshlets and simplifies each part on its own, so every part stays one range of vertices and, at each level, one range of indices.
+// Level 0 of every part comes first, then each coarser level of every part in turn.
+void AModel::cookSubmeshes()
+{
+	std::vector<VertexType> cookedVertices;
+	std::vector<unsigned long> cookedIndices;
+	std::vector<std::vector<unsigned long>> partIndices(submeshes.size());
+	std::vector<std::vector<MeshSimplifier::LodType>> partLods(submeshes.size());
+	size_t levelCount = 1;
+	meshlets.clear();
+
+	for (size_t p = 0; p < submeshes.size(); p++)
+	{
+		SubmeshType& part = submeshes[p];
+		std::vector<VertexType> partVertices(vertices.begin() + part.baseVertex, vertices.begin() + part.baseVertex + part.vertexCount);
+		partIndices[p].assign(indices.begin() + part.indexStart, indices.begin() + part.indexStart + part.indexCount);
+
+		// Reorder for the vertex cache, overdraw and vertex fetch.
+		unsigned long partVertexCount = MeshOptimiser::optimise(partVertices.data(), (unsigned long)partVertices.size(), sizeof(VertexType), partIndices[p].data(), part.indexCount);
+		partVertices.resize(partVertexCount);
+
+		// Split the full detail triangles into meshlets, so views can skip the parts of a part they can't see.
+		std::vector<MeshletBuilder::MeshletType> partMeshlets;
+		MeshletBuilder::build(partVertices.data(), partVertexCount, sizeof(VertexType), partIndices[p].data(), part.indexCount, partMeshlets);
+		part.indexStart = (unsigned int)cookedIndices.size();
+		part.meshletStart = (unsigned int)meshlets.size();
+		part.meshletCount = (unsigned int)partMeshlets.size();
+		for (size_t m = 0; m < partMeshlets.size(); m++)
+		{
+			partMeshlets[m].indexStart += part.indexStart;
+			meshlets.push_back(partMeshlets[m]);
+		}
+
+		// Coarser levels for distant and shadow map draws are appended to the part's own list, and moved into place below.
+		MeshSimplifier::generateLods(partVertices.data(), partVertexCount, sizeof(VertexType), partIndices[p], partLods[p]);
+		levelCount = std::max(levelCount, partLods[p].size());
+
+		for (int axis = 0; axis < 3; axis++)
+		{
+			part.boundsMin[axis] = FLT_MAX;
+			part.boundsMax[axis] = -FLT_MAX;
+		}
+		for (size_t v = 0; v < partVertices.size(); v++)
+		{
+			const float* position = &partVertices[v].position.x;
+			for (int axis = 0; axis < 3; axis++)
+			{
+				part.boundsMin[axis] = std::min(part.boundsMin[axis], position[axis]);
+				part.boundsMax[axis] = std::max(part.boundsMax[axis], position[axis]);
+			}
+		}
+
+		part.baseVertex = (int)cookedVertices.size();
+		part.vertexCount = partVertexCount;
+		cookedVertices.insert(cookedVertices.end(), partVertices.begin(), partVertices.end());
+		cookedIndices.insert(cookedIndices.end(), partIndices[p].begin(), partIndices[p].begin() + part.indexCount);
+	}
+
+	// Lay out the coarser levels. A part with fewer levels than the others keeps drawing its coarsest one.
+	lods.assign(levelCount, MeshSimplifier::LodType());
+	submeshLods.assign(levelCount * submeshes.size(), MeshSimplifier::LodType());
+	for (size_t level = 0; level < levelCount; level++)
+	{
+		MeshSimplifier::LodType& total = lods[level];
+		total.indexStart = level == 0 ? 0 : (unsigned int)cookedIndices.size();
+		for (size_t p = 0; p < submeshes.size(); p++)
+		{
+			MeshSimplifier::LodType& range = submeshLods[level * submeshes.size() + p];
+			if (level == 0)
+			{
+				range = partLods[p][0];
+				range.indexStart = submeshes[p].indexStart;
+			}
+			else if (level < partLods[p].size())
+			{
+				range = partLods[p][level];
+				range.indexStart = (unsigned int)cookedIndices.size();
+				const unsigned long* source = &partIndices[p][partLods[p][level].indexStart];
+				cookedIndices.insert(cookedIndices.end(), source, source + range.indexCount);
+			}
+			else
+			{
+				range = submeshLods[(level - 1) * submeshes.size() + p];
+			}
+			total.error = std::max(total.error, range.error);
+		}
+		total.indexCount = (unsigned int)cookedIndices.size() - total.indexStart;
+	}
+
+	vertices.swap(cookedVertices);
+	indices.swap(cookedIndices);
 }
 
 //vector<Texture> ModelLoader::loadMaterialTextures(aiMaterial * mat, aiTextureType type, string typeName, const aiScene * scene)
@@ -0,0 +1,419 @@
+// Asset loader
+// Runs the CPU side of texture and model loading on the worker pool, and the GPU side on the render thread.
+#include "AssetLoader.h"
+#include "Benchmark.h"
+#include "CpuMeshStore.h"
+#include "GpuMeshStore.h"
+#include "MappedFile.h"
+#include <windows.h>
+#include <wincodec.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+namespace
+{
+	// A decoded image, or the raw file for formats D3D loads directly (.dds).
+	struct ImageType
+	{
+		std::vector<unsigned char> data;
+		unsigned int width;
+		unsigned int height;
+		bool dds;
+	};
+
+	std::string narrow(const wchar_t* text)
+	{
+		std::string result;
+		for (; *text; text++)
+		{
+			result += *text < 128 ? (char)*text : '?';
+		}
+		return result;
+	}
+
+	bool hasExtension(const wchar_t* filename, const wchar_t* extension)
+	{
+		const wchar_t* dot = wcsrchr(filename, L'.');
+		return dot && _wcsicmp(dot + 1, extension) == 0;
+	}
+
+	// Decodes any image WIC understands to 32 bit RGBA. Runs on a worker, so it uses its own COM apartment.
+	bool decodeImage(const char* file, size_t size, ImageType& image)
+	{
+		HRESULT initialise = CoInitializeEx(NULL, COINIT_MULTITHREADED);
+
+		IWICImagingFactory* factory = NULL;
+		IWICStream* stream = NULL;
+		IWICBitmapDecoder* decoder = NULL;
+		IWICBitmapFrameDecode* frame = NULL;
+		IWICFormatConverter* converter = NULL;
+
+		bool decoded = SUCCEEDED(CoCreateInstance(CLSID_WICImagingFactory, NULL, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(&factory))) &&
+			SUCCEEDED(factory->CreateStream(&stream)) &&
+			SUCCEEDED(stream->InitializeFromMemory((BYTE*)file, (DWORD)size)) &&
+			SUCCEEDED(factory->CreateDecoderFromStream(stream, NULL, WICDecodeMetadataCacheOnDemand, &decoder)) &&
+			SUCCEEDED(decoder->GetFrame(0, &frame)) &&
+			SUCCEEDED(factory->CreateFormatConverter(&converter)) &&
+			SUCCEEDED(converter->Initialize(frame, GUID_WICPixelFormat32bppRGBA, WICBitmapDitherTypeNone, NULL, 0.0, WICBitmapPaletteTypeCustom)) &&
+			SUCCEEDED(converter->GetSize(&image.width, &image.height));
+
+		if (decoded)
+		{
+			image.data.resize((size_t)image.width * image.height * 4);
+			decoded = SUCCEEDED(converter->CopyPixels(NULL, image.width * 4, (UINT)image.data.size(), image.data.data()));
+		}
+
+		if (converter)
+		{
+			converter->Release();
+		}
+		if (frame)
+		{
+			frame->Release();
+		}
+		if (decoder)
+		{
+			decoder->Release();
+		}
+		if (stream)
+		{
+			stream->Release();
+		}
+		if (factory)
+		{
+			factory->Release();
+		}
+		if (SUCCEEDED(initialise))
+		{
+			CoUninitialize();
+		}
+		return decoded;
+	}
+
+	// Uploads the top level and lets the GPU build the rest of the mip chain, the same as the WIC texture loader does.
+	ID3D11ShaderResourceView* createTexture(ID3D11Device* device, ID3D11DeviceContext* deviceContext, const ImageType& image)
+	{
+		D3D11_TEXTURE2D_DESC desc = {};
+		desc.Width = image.width;
+		desc.Height = image.height;
+		desc.MipLevels = 0;
+		desc.ArraySize = 1;
+		desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+		desc.SampleDesc.Count = 1;
+		desc.Usage = D3D11_USAGE_DEFAULT;
+		desc.BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_RENDER_TARGET;
+		desc.MiscFlags = D3D11_RESOURCE_MISC_GENERATE_MIPS;
+
+		ID3D11Texture2D* texture = NULL;
+		ID3D11ShaderResourceView* view = NULL;
+		if (FAILED(device->CreateTexture2D(&desc, NULL, &texture)))
+		{
+			return NULL;
+		}
+
+		deviceContext->UpdateSubresource(texture, 0, NULL, image.data.data(), image.width * 4, (UINT)image.data.size());
+		if (SUCCEEDED(device->CreateShaderResourceView(texture, NULL, &view)))
+		{
+			deviceContext->GenerateMips(view);
+		}
+		texture->Release();
+		return view;
+	}
+}
+
+AssetLoader::AssetLoader(ID3D11Device* ldevice, ID3D11DeviceContext* ldeviceContext, WorkerPool& lpool) : pool(lpool)
+{
+	device = ldevice;
+	deviceContext = ldeviceContext;
+	startTime = Benchmark::seconds();
+	allFinalised = 0.0;
+}
+
+AssetLoader::~AssetLoader()
+{
+	for (size_t i = 0; i < assets.size(); i++)
+	{
+		if (assets[i]->future.valid())
+		{
+			assets[i]->future.wait();
+		}
+	}
+}
+
+double AssetLoader::now() const
+{
+	return Benchmark::seconds() - startTime;
+}
+
+AssetLoader::Handle AssetLoader::queue(const std::string& name, const char* kind, const std::function<bool()>& load, const std::function<void()>& finalise)
+{
+	std::unique_ptr<AssetType> asset(new AssetType());
+	asset->name = name;
+	asset->kind = kind;
+	asset->load = load;
+	asset->finalise = finalise;
+	asset->finalised = false;
+	asset->queued = now();
+	asset->loadStart = asset->loadEnd = asset->queued;
+	asset->finaliseTime = 0.0;
+	asset->finished = 0.0;
+
+	// The promise is shared with the task, as pool tasks have to be copyable.
+	std::shared_ptr<std::promise<bool>> promise = std::make_shared<std::promise<bool>>();
+	asset->future = promise->get_future().share();
+
+	AssetType* target = asset.get();
+	assets.push_back(std::move(asset));
+
+	pool.run([this, target, promise]()
+	{
+		target->loadStart = now();
+		bool loaded = target->load();
+		target->loadEnd = now();
+		promise->set_value(loaded);
+	});
+
+	return (Handle)assets.size() - 1;
+}
+
+AssetLoader::Handle AssetLoader::loadTexture(TextureManager* textures, const wchar_t* uid, const wchar_t* filename, Heightmap* heightmap)
+{
+	std::shared_ptr<ImageType> image = std::make_shared<ImageType>();
+	std::wstring path(filename);
+	ID3D11Device* ldevice = device;
+	ID3D11DeviceContext* ldeviceContext = deviceContext;
+
+	return queue(narrow(filename), "texture",
+		[image, path, heightmap]()
+		{
+			MappedFile file;
+			if (!file.open(narrow(path.c_str()).c_str()))
+			{
+				return false;
+			}
+
+			// DDS files are already in a GPU format, they only need reading.
+			image->dds = hasExtension(path.c_str(), L"dds");
+			if (image->dds)
+			{
+				image->data.assign(file.getData(), file.getData() + file.getSize());
+				return true;
+			}
+			if (!decodeImage(file.getData(), file.getSize(), *image))
+			{
+				return false;
+			}
+			if (heightmap)
+			{
+				heightmap->setPixels(image->data.data(), (int)image->width, (int)image->height);
+			}
+			return true;
+		},
+		[image, textures, uid, path, ldevice, ldeviceContext]()
+		{
+			ID3D11ShaderResourceView* texture = NULL;
+			if (image->dds)
+			{
+				CreateDDSTextureFromMemory(ldevice, ldeviceContext, image->data.data(), image->data.size(), NULL, &texture);
+			}
+			else if (!image->data.empty())
+			{
+				texture = createTexture(ldevice, ldeviceContext, *image);
+			}
+
+			if (texture)
+			{
+				textures->addTexture(uid, texture);
+			}
+			else
+			{
+				MessageBox(NULL, path.c_str(), L"Texture loading error", MB_OK);
+			}
+
+			// The pixels are on the GPU now.
+			std::vector<unsigned char>().swap(image->data);
+		});
+}
+
+bool AssetLoader::loadHeightmap(const char* filename, Heightmap& heightmap)
+{
+	MappedFile file;
+	ImageType image;
+	if (!file.open(filename) || !decodeImage(file.getData(), file.getSize(), image))
+	{
+		return false;
+	}
+	heightmap.setPixels(image.data.data(), (int)image.width, (int)image.height);
+	return true;
+}
+
+AssetLoader::Handle AssetLoader::loadModel(AModel** mesh, const std::string& filename, bool quantise, bool keepCpuMesh, const ImportProfile& profile)
+{
+	ID3D11Device* ldevice = device;
+	*mesh = nullptr;
+
+	Handle handle = queue(filename, "model",
+		[mesh, filename, quantise, keepCpuMesh, profile]()
+		{
+			*mesh = new AModel(filename, quantise, keepCpuMesh, profile);
+			return true;
+		},
+		[mesh, ldevice]()
+		{
+			(*mesh)->createBuffers(ldevice);
+		});
+	assets[handle]->mesh = [mesh]() -> BaseMesh* { return *mesh; };
+	return handle;
+}
+
+AssetLoader::Handle AssetLoader::loadModel(Model** mesh, const char* filename, bool quantise, bool keepCpuMesh)
+{
+	ID3D11Device* ldevice = device;
+	std::string path(filename);
+	*mesh = nullptr;
+
+	Handle handle = queue(path, "model",
+		[mesh, path, quantise, keepCpuMesh]()
+		{
+			*mesh = new Model(path.c_str(), quantise, keepCpuMesh);
+			return true;
+		},
+		[mesh, ldevice]()
+		{
+			(*mesh)->createBuffers(ldevice);
+		});
+	assets[handle]->mesh = [mesh]() -> BaseMesh* { return *mesh; };
+	return handle;
+}
+
+AssetLoader::Handle AssetLoader::loadNow(const char* name, const std::function<void()>& create)
+{
+	std::unique_ptr<AssetType> asset(new AssetType());
+	asset->name = name;
+	asset->kind = "render";
+	asset->queued = asset->loadStart = asset->loadEnd = now();
+
+	create();
+
+	asset->finished = now();
+	asset->finaliseTime = asset->finished - asset->loadEnd;
+	asset->finalised = true;
+	std::promise<bool> done;
+	done.set_value(true);
+	asset->future = done.get_future().share();
+
+	assets.push_back(std::move(asset));
+	return (Handle)assets.size() - 1;
+}
+
+std::shared_future<bool> AssetLoader::getFuture(Handle handle) const
+{
+	return assets[handle]->future;
+}
+
+bool AssetLoader::isFinalised(Handle handle) const
+{
+	return assets[handle]->finalised;
+}
+
+void AssetLoader::finalise(AssetType& asset)
+{
+	// Failed loads are finalised too, so they can report the error on the render thread.
+	double start = now();
+	asset.future.wait();
+	asset.finalise();
+	asset.finished = now();
+	asset.finaliseTime = asset.finished - start;
+	asset.finalised = true;
+}
+
+int AssetLoader::finaliseReady()
+{
+	int outstanding = 0;
+	for (size_t i = 0; i < assets.size(); i++)
+	{
+		AssetType& asset = *assets[i];
+		if (asset.finalised)
+		{
+			continue;
+		}
+
+		if (asset.future.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+		{
+			finalise(asset);
+		}
+		else
+		{
+			outstanding++;
+		}
+	}
+	return outstanding;
+}
+
+void AssetLoader::finaliseAll()
+{
+	// Finalise whatever is ready, then wait a moment on the first one that isn't.
+	while (finaliseReady() > 0)
+	{
+		for (size_t i = 0; i < assets.size(); i++)
+		{
+			if (!assets[i]->finalised)
+			{
+				assets[i]->future.wait_for(std::chrono::milliseconds(1));
+				break;
+			}
+		}
+	}
+	allFinalised = now();
+}
+
+void AssetLoader::report(FILE* out) const
+{
+	double total = 0.0;
+	double slowest = 0.0;
+	std::string slowestName;
+
+	Benchmark::report(out, "Asset loading, %u worker threads\n", pool.getThreadCount());
+	Benchmark::report(out, "%-32s %-8s %12s %12s %12s %12s\n", "asset", "kind", "queued ms", "worker ms", "render ms", "ready at ms");
+	for (size_t i = 0; i < assets.size(); i++)
+	{
+		const AssetType& asset = *assets[i];
+		double work = (asset.loadEnd - asset.loadStart) + asset.finaliseTime;
+		total += work;
+		if (work > slowest)
+		{
+			slowest = work;
+			slowestName = asset.name;
+		}
+
+		Benchmark::report(out, "%-32s %-8s %12.2f %12.2f %12.2f %12.2f\n", asset.name.c_str(), asset.kind,
+			(asset.loadStart - asset.queued) * 1000.0, (asset.loadEnd - asset.loadStart) * 1000.0, asset.finaliseTime * 1000.0, asset.finished * 1000.0);
+	}
+	Benchmark::report(out, "Sum of asset times %.2f ms, slowest asset %s %.2f ms, everything finalised at %.2f ms\n", total * 1000.0, slowestName.c_str(), slowest * 1000.0, allFinalised * 1000.0);
+}
+
+void AssetLoader::reportMemory(FILE* out) const
+{
+	size_t totalGpu = 0, totalCpu = 0;
+
+	Benchmark::report(out, "Model memory after upload (retained copies count once per model using them)\n");
+	Benchmark::report(out, "%-32s %12s %12s %10s\n", "asset", "GPU KB", "CPU KB", "retained");
+	for (size_t i = 0; i < assets.size(); i++)
+	{
+		const AssetType& asset = *assets[i];
+		BaseMesh* mesh = asset.mesh ? asset.mesh() : nullptr;
+		if (!mesh || !asset.finalised)
+		{
+			continue;
+		}
+
+		Benchmark::report(out, "%-32s %12.1f %12.1f %10s\n", asset.name.c_str(), mesh->getGpuBytes() / 1024.0, mesh->getCpuBytes() / 1024.0, mesh->getCpuMesh() ? "yes" : "no");
+		totalGpu += mesh->getGpuBytes();
+		totalCpu += mesh->getCpuBytes();
+	}
+	Benchmark::report(out, "%-32s %12.1f %12.1f\n", "total", totalGpu / 1024.0, totalCpu / 1024.0);
+
+	CpuMeshStore::shared().report(out);
+	GpuMeshStore::shared().report(out);
+}
@@ -0,0 +1,102 @@
+/**
+* \class Asset Loader
+*
+* \brief Loads textures and models on the worker pool, then creates their GPU resources on the render thread
+*
+* Each load call queues the file reading, decoding and mesh cooking on a WorkerPool and returns a handle straight away.
+* The render thread carries on with its own work (shaders, render targets) and calls finaliseAll() once it needs the assets,
+* which creates the textures and buffers in the order the workers finish them. Startup then takes about as long as the slowest asset, not the sum of all of them.
+* Every asset is timed, see report().
+*/
+
+
+#ifndef _ASSETLOADER_H_
+#define _ASSETLOADER_H_
+
+#include <d3d11.h>
+#include "AModel.h"
+#include "Heightmap.h"
+#include "Model.h"
+#include "TextureManager.h"
+#include "WorkerPool.h"
+#include <cstdio>
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+class AssetLoader
+{
+public:
+	typedef int Handle;
+
+	AssetLoader(ID3D11Device* device, ID3D11DeviceContext* deviceContext, WorkerPool& pool = WorkerPool::shared());
+	/// Waits for any queued work, the workers write into the caller's pointers.
+	~AssetLoader();
+
+	/** \brief Reads and decodes the image on a worker. Finalising creates the texture (with mipmaps) and adds it to textures under uid.
+	* If heightmap is given it is filled from the decoded pixels on the worker, for meshes that bake the heights in (see TerrainMesh). Not for .dds files.
+	*/
+	Handle loadTexture(TextureManager* textures, const wchar_t* uid, const wchar_t* filename, Heightmap* heightmap = nullptr);
+	/// Reads and decodes an image into heightmap on this thread, for tools and benchmarks that don't need the texture.
+	static bool loadHeightmap(const char* filename, Heightmap& heightmap);
+
+	/** \brief Imports the model on a worker with the asset's import profile. *mesh is set once the handle's future is ready, and can be drawn once it is finalised.
+	* The CPU copy of the geometry is freed once it is uploaded, unless keepCpuMesh asks for a read-only copy (see CpuMeshStore).
+	*/
+	Handle loadModel(AModel** mesh, const std::string& filename, bool quantise = false, bool keepCpuMesh = false, const ImportProfile& profile = ImportProfile());
+	Handle loadModel(Model** mesh, const char* filename, bool quantise = false, bool keepCpuMesh = false);
+
+	/// Runs create on this thread now, for assets that have to be made on the render thread. It is timed with the rest.
+	Handle loadNow(const char* name, const std::function<void()>& create);
+
+	/// Ready once the worker part of the asset has finished, true if it succeeded.
+	std::shared_future<bool> getFuture(Handle handle) const;
+	bool isFinalised(Handle handle) const;
+
+	/// Finalises the assets whose worker part has finished, without waiting. Returns how many are still outstanding.
+	int finaliseReady();
+	/// Waits for every asset and finalises each as soon as its worker part finishes.
+	void finaliseAll();
+
+	/// Writes a line per asset (queue wait, worker time, render thread time, when it was ready) and the totals.
+	void report(FILE* out) const;
+	/// Writes the GPU buffer and CPU memory of each model once finalised, then the shared CPU mesh copies and primitive buffers.
+	void reportMemory(FILE* out) const;
+
+private:
+	struct AssetType
+	{
+		std::string name;
+		const char* kind;
+		std::function<bool()> load;			///< Worker part
+		std::function<void()> finalise;		///< Render thread part
+		std::function<BaseMesh*()> mesh;	///< The loaded mesh, for models
+		std::shared_future<bool> future;
+		bool finalised;
+
+		// Seconds, relative to when the loader was created.
+		double queued;
+		double loadStart;
+		double loadEnd;
+		double finaliseTime;
+		double finished;
+	};
+
+	AssetLoader(const AssetLoader&);
+	AssetLoader& operator=(const AssetLoader&);
+
+	Handle queue(const std::string& name, const char* kind, const std::function<bool()>& load, const std::function<void()>& finalise);
+	void finalise(AssetType& asset);
+	double now() const;
+
+	ID3D11Device* device;
+	ID3D11DeviceContext* deviceContext;
+	WorkerPool& pool;
+	std::vector<std::unique_ptr<AssetType>> assets;
+	double startTime;
+	double allFinalised;
+};
+
+#endif
@@ -2,6 +2,11 @@
 // Base mesh class, for inheriting base mesh functionality.
 
 #include "basemesh.h"
+#include <algorithm>
+#include <cfloat>
+#include <cstddef>
+#include <cmath>
+#include <vector>
 
 BaseMesh::BaseMesh()
 {
@@ -9,7 +14,16 @@ BaseMesh::BaseMesh()
 	indexBuffer = nullptr;
 	vertexCount = 0;
 	indexCount = 0;
-
+	quantised = false;
+	keepCpuMesh = false;
+	vertexStride = sizeof(VertexType);
+	indexFormat = DXGI_FORMAT_R32_UINT;
+	decode.scale = 1.0f;
+	decode.bias[0] = decode.bias[1] = decode.bias[2] = 0.0f;
+	boundsCentre = XMFLOAT3(0.0f, 0.0f, 0.0f);
+	boundsRadius = 0.0f;
+	vertexBufferBytes = 0;
+	indexBufferBytes = 0;
 }
 
 // Release base objects (index, vertex buffers and texture object.
@@ -33,20 +47,453 @@ int BaseMesh::getIndexCount()
 	return indexCount;
 }
 
+bool BaseMesh::isQuantised()
+{
+	return quantised;
+}
+
+XMMATRIX BaseMesh::getDecodeMatrix()
+{
+	return XMMatrixScaling(decode.scale, decode.scale, decode.scale) * XMMatrixTranslation(decode.bias[0], decode.bias[1], decode.bias[2]);
+}
+
+int BaseMesh::getLodCount()
+{
+	return lods.empty() ? 1 : (int)lods.size();
+}
+
+int BaseMesh::getLodIndexCount(int lod)
+{
+	return lods.empty() ? indexCount : (int)lods[lod].indexCount;
+}
+
+int BaseMesh::getLodIndexStart(int lod)
+{
+	return lods.empty() ? 0 : (int)lods[lod].indexStart;
+}
+
+void BaseMesh::getLodRanges(int lod, std::vector<MeshletBuilder::RangeType>& ranges)
+{
+	if (submeshes.empty())
+	{
+		MeshletBuilder::RangeType range = { (unsigned int)getLodIndexStart(lod), (unsigned int)getLodIndexCount(lod), 0 };
+		ranges.push_back(range);
+		return;
+	}
+
+	for (size_t i = 0; i < submeshes.size(); i++)
+	{
+		const MeshSimplifier::LodType& part = submeshLods[lod * submeshes.size() + i];
+		MeshletBuilder::RangeType range = { part.indexStart, part.indexCount, submeshes[i].baseVertex };
+		ranges.push_back(range);
+	}
+}
+
+int BaseMesh::selectLod(const XMMATRIX& world, const XMMATRIX& view, const XMMATRIX& projection, float viewportHeight, float pixelError)
+{
+	if (lods.size() < 2)
+	{
+		return 0;
+	}
+
+	// Largest scale the world matrix applies, so the errors and radius are never underestimated.
+	float scale = 0.0f;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		scale = std::max(scale, XMVectorGetX(XMVector3Length(world.r[axis])));
+	}
+
+	// Depth of the nearest point of the bounding sphere, then the clip space w there (depth for perspective, 1 for orthographic).
+	XMVECTOR centre = XMVector3TransformCoord(XMLoadFloat3(&boundsCentre), world * view);
+	float depth = XMVectorGetZ(centre) - boundsRadius * scale;
+	XMFLOAT4X4 projectionValues;
+	XMStoreFloat4x4(&projectionValues, projection);
+	float w = depth * projectionValues.m[2][3] + projectionValues.m[3][3];
+	if (w <= 0.0f)
+	{
+		return 0;
+	}
+
+	// Pixels covered by one model space unit at that depth.
+	float pixelsPerUnit = scale * projectionValues.m[1][1] * viewportHeight * 0.5f / w;
+
+	int lod = 0;
+	for (int i = 1; i < (int)lods.size(); i++)
+	{
+		if (lods[i].error * pixelsPerUnit <= pixelError)
+		{
+			lod = i;
+		}
+	}
+	return lod;
+}
+
+int BaseMesh::getSubmeshCount()
+{
+	return submeshes.empty() ? 1 : (int)submeshes.size();
+}
+
+const BaseMesh::SubmeshType* BaseMesh::getSubmesh(int submesh)
+{
+	return submeshes.empty() ? nullptr : &submeshes[submesh];
+}
+
+// Frustum planes in model space, from the columns of the combined matrix (Gribb and Hartmann). Clip space z runs from 0 to w.
+void BaseMesh::getFrustumPlanes(const XMMATRIX& worldViewProjection, XMFLOAT4* planes)
+{
+	XMMATRIX columns = XMMatrixTranspose(worldViewProjection);
+	XMVECTOR planeVectors[6] = {
+		columns.r[3] + columns.r[0],
+		columns.r[3] - columns.r[0],
+		columns.r[3] + columns.r[1],
+		columns.r[3] - columns.r[1],
+		columns.r[2],
+		columns.r[3] - columns.r[2]
+	};
+	for (int p = 0; p < 6; p++)
+	{
+		XMStoreFloat4(&planes[p], XMPlaneNormalize(planeVectors[p]));
+	}
+}
+
+// A box is outside if its corner furthest along a plane's normal is still behind it.
+bool BaseMesh::boxInFrustum(const float* minimum, const float* maximum, const XMFLOAT4* planes)
+{
+	for (int p = 0; p < 6; p++)
+	{
+		float x = planes[p].x >= 0.0f ? maximum[0] : minimum[0];
+		float y = planes[p].y >= 0.0f ? maximum[1] : minimum[1];
+		float z = planes[p].z >= 0.0f ? maximum[2] : minimum[2];
+		if (planes[p].x * x + planes[p].y * y + planes[p].z * z + planes[p].w < 0.0f)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+int BaseMesh::cullSubmeshes(const XMMATRIX& world, const XMMATRIX& view, const XMMATRIX& projection, int lod, std::vector<MeshletBuilder::RangeType>& ranges)
+{
+	XMFLOAT4 planes[6];
+	getFrustumPlanes(world * view * projection, planes);
+
+	if (submeshes.empty())
+	{
+		for (int p = 0; p < 6; p++)
+		{
+			if (planes[p].x * boundsCentre.x + planes[p].y * boundsCentre.y + planes[p].z * boundsCentre.z + planes[p].w < -boundsRadius)
+			{
+				return 0;
+			}
+		}
+		getLodRanges(lod, ranges);
+		return 1;
+	}
+
+	int visible = 0;
+	for (size_t i = 0; i < submeshes.size(); i++)
+	{
+		if (boxInFrustum(submeshes[i].boundsMin, submeshes[i].boundsMax, planes))
+		{
+			const MeshSimplifier::LodType& part = submeshLods[lod * submeshes.size() + i];
+			MeshletBuilder::RangeType range = { part.indexStart, part.indexCount, submeshes[i].baseVertex };
+			ranges.push_back(range);
+			visible++;
+		}
+	}
+	return visible;
+}
+
+int BaseMesh::getMeshletCount()
+{
+	return (int)meshlets.size();
+}
+
+int BaseMesh::cullMeshlets(const XMMATRIX& world, const XMMATRIX& view, const XMMATRIX& projection, std::vector<MeshletBuilder::RangeType>& ranges, float displacementY)
+{
+	if (meshlets.empty())
+	{
+		getLodRanges(0, ranges);
+		return 0;
+	}
+
+	XMMATRIX worldView = world * view;
+	XMFLOAT4 planes[6];
+	getFrustumPlanes(worldView * projection, planes);
+
+	// The eye in model space for perspective views, or the view direction for orthographic ones (light views use both).
+	XMFLOAT4X4 projectionValues;
+	XMStoreFloat4x4(&projectionValues, projection);
+	XMMATRIX inverse = XMMatrixInverse(nullptr, worldView);
+	XMFLOAT4 viewer;
+	if (projectionValues.m[2][3] != 0.0f)
+	{
+		XMStoreFloat4(&viewer, XMVector3TransformCoord(XMVectorZero(), inverse));
+		viewer.w = 1.0f;
+	}
+	else
+	{
+		XMStoreFloat4(&viewer, XMVector3Normalize(XMVector3TransformNormal(XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f), inverse)));
+		viewer.w = 0.0f;
+	}
+
+	if (submeshes.empty())
+	{
+		return (int)MeshletBuilder::cull(meshlets.data(), (unsigned int)meshlets.size(), planes, viewer, displacementY, ranges);
+	}
+
+	// Parts outside the view skip their meshlets altogether.
+	int visible = 0;
+	for (size_t i = 0; i < submeshes.size(); i++)
+	{
+		const SubmeshType& part = submeshes[i];
+		float boundsMax[3] = { part.boundsMax[0], part.boundsMax[1] + std::max(displacementY, 0.0f), part.boundsMax[2] };
+		float boundsMin[3] = { part.boundsMin[0], part.boundsMin[1] + std::min(displacementY, 0.0f), part.boundsMin[2] };
+		if (boxInFrustum(boundsMin, boundsMax, planes))
+		{
+			visible += (int)MeshletBuilder::cull(&meshlets[part.meshletStart], part.meshletCount, planes, viewer, displacementY, ranges, part.baseVertex);
+		}
+	}
+	return visible;
+}
+
+void BaseMesh::createVertexBuffer(ID3D11Device* device, const VertexType* vertices)
+{
+	D3D11_BUFFER_DESC vertexBufferDesc;
+	D3D11_SUBRESOURCE_DATA vertexData;
+	std::vector<VertexType_Quantised> packed;
+
+	// Bounding sphere around the box of the positions, for level of detail selection.
+	XMFLOAT3 minimum(FLT_MAX, FLT_MAX, FLT_MAX), maximum(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	for (int i = 0; i < vertexCount; i++)
+	{
+		minimum = XMFLOAT3(std::min(minimum.x, vertices[i].position.x), std::min(minimum.y, vertices[i].position.y), std::min(minimum.z, vertices[i].position.z));
+		maximum = XMFLOAT3(std::max(maximum.x, vertices[i].position.x), std::max(maximum.y, vertices[i].position.y), std::max(maximum.z, vertices[i].position.z));
+	}
+	if (vertexCount > 0)
+	{
+		boundsCentre = XMFLOAT3((minimum.x + maximum.x) * 0.5f, (minimum.y + maximum.y) * 0.5f, (minimum.z + maximum.z) * 0.5f);
+		boundsRadius = 0.5f * sqrtf((maximum.x - minimum.x) * (maximum.x - minimum.x) + (maximum.y - minimum.y) * (maximum.y - minimum.y) + (maximum.z - minimum.z) * (maximum.z - minimum.z));
+	}
+
+	// Pack the vertices down to 16 bytes if asked, halving the vertex fetch of every pass.
+	vertexData.pSysMem = vertices;
+	vertexStride = sizeof(VertexType);
+	if (quantised)
+	{
+		packed.resize(vertexCount);
+		decode = VertexQuantiser::quantise(vertices, vertexCount, sizeof(VertexType), packed.data());
+		vertexData.pSysMem = packed.data();
+		vertexStride = sizeof(VertexType_Quantised);
+	}
+
+	// Set up the description of the static vertex buffer.
+	vertexBufferDesc.Usage = D3D11_USAGE_DEFAULT;
+	vertexBufferDesc.ByteWidth = vertexStride * vertexCount;
+	vertexBufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+	vertexBufferDesc.CPUAccessFlags = 0;
+	vertexBufferDesc.MiscFlags = 0;
+	vertexBufferDesc.StructureByteStride = 0;
+	// Give the subresource structure a pointer to the vertex data.
+	vertexData.SysMemPitch = 0;
+	vertexData.SysMemSlicePitch = 0;
+	// Now create the vertex buffer.
+	device->CreateBuffer(&vertexBufferDesc, &vertexData, &vertexBuffer);
+	vertexBufferBytes = vertexBufferDesc.ByteWidth;
+}
+
+void BaseMesh::createIndexBuffer(ID3D11Device* device, const unsigned long* indices)
+{
+	D3D11_SUBRESOURCE_DATA indexData;
+	std::vector<unsigned short> shortIndices;
+	unsigned int indexSize;
+	unsigned int bufferIndexCount;
+
+	// The buffer also holds any coarser levels of detail after level 0.
+	bufferIndexCount = indexCount;
+	for (size_t i = 0; i < lods.size(); i++)
+	{
+		bufferIndexCount = std::max(bufferIndexCount, lods[i].indexStart + lods[i].indexCount);
+	}
+
+	// Every index fits in 16 bits below 65536 vertices, which halves the index buffer.
+	indexData.pSysMem = indices;
+	indexSize = sizeof(unsigned long);
+	indexFormat = DXGI_FORMAT_R32_UINT;
+	int largestIndex = vertexCount;
+	if (!submeshes.empty())
+	{
+		// Indices count from each part's base vertex, so only the largest part has to fit.
+		largestIndex = 0;
+		for (size_t i = 0; i < submeshes.size(); i++)
+		{
+			largestIndex = std::max(largestIndex, (int)submeshes[i].vertexCount);
+		}
+	}
+	if (largestIndex < 65536)
+	{
+		shortIndices.assign(indices, indices + bufferIndexCount);
+		indexData.pSysMem = shortIndices.data();
+		indexSize = sizeof(unsigned short);
+		indexFormat = DXGI_FORMAT_R16_UINT;
+	}
+
+	uploadIndexBuffer(device, indexData.pSysMem, indexSize, bufferIndexCount);
+}
+
+void BaseMesh::createIndexBuffer(ID3D11Device* device, const unsigned short* indices)
+{
+	indexFormat = DXGI_FORMAT_R16_UINT;
+	uploadIndexBuffer(device, indices, sizeof(unsigned short), indexCount);
+}
+
+void BaseMesh::uploadIndexBuffer(ID3D11Device* device, const void* indices, unsigned int indexSize, unsigned int bufferIndexCount)
+{
+	D3D11_BUFFER_DESC indexBufferDesc;
+	D3D11_SUBRESOURCE_DATA indexData;
+
+	// Set up the description of the static index buffer.
+	indexBufferDesc.Usage = D3D11_USAGE_DEFAULT;
+	indexBufferDesc.ByteWidth = indexSize * bufferIndexCount;
+	indexBufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
+	indexBufferDesc.CPUAccessFlags = 0;
+	indexBufferDesc.MiscFlags = 0;
+	indexBufferDesc.StructureByteStride = 0;
+	// Give the subresource structure a pointer to the index data.
+	indexData.pSysMem = indices;
+	indexData.SysMemPitch = 0;
+	indexData.SysMemSlicePitch = 0;
+	// Create the index buffer.
+	device->CreateBuffer(&indexBufferDesc, &indexData, &indexBuffer);
+	indexBufferBytes = indexBufferDesc.ByteWidth;
+}
+
+void BaseMesh::createVertexBuffer(ID3D11Device* device, const PrimitiveShapes::VertexType* vertices)
+{
+	static_assert(sizeof(PrimitiveShapes::VertexType) == sizeof(VertexType) && offsetof(PrimitiveShapes::VertexType, texture) == offsetof(VertexType, texture) &&
+		offsetof(PrimitiveShapes::VertexType, normal) == offsetof(VertexType, normal), "Primitive tables must match VertexType");
+	createVertexBuffer(device, reinterpret_cast<const VertexType*>(vertices));
+}
+
+bool BaseMesh::acquireSharedBuffers(ID3D11Device* device, const std::string& key)
+{
+	std::shared_ptr<const GpuMeshStore::BuffersType> shape = GpuMeshStore::shared().find(device, key);
+	if (!shape)
+	{
+		return false;
+	}
+
+	// Each mesh holds its own reference, so the destructor releases the buffers the same way whether they are shared or not.
+	sharedBuffers = shape;
+	vertexBuffer = shape->vertexBuffer;
+	indexBuffer = shape->indexBuffer;
+	vertexBuffer->AddRef();
+	indexBuffer->AddRef();
+	vertexCount = shape->vertexCount;
+	indexCount = shape->indexCount;
+	vertexStride = shape->vertexStride;
+	indexFormat = shape->indexFormat;
+	boundsCentre = shape->boundsCentre;
+	boundsRadius = shape->boundsRadius;
+	vertexBufferBytes = shape->vertexBufferBytes;
+	indexBufferBytes = shape->indexBufferBytes;
+	return true;
+}
+
+void BaseMesh::shareBuffers(ID3D11Device* device, const std::string& key)
+{
+	GpuMeshStore::BuffersType buffers = { vertexBuffer, indexBuffer, vertexCount, indexCount, vertexStride, indexFormat, boundsCentre, boundsRadius, vertexBufferBytes, indexBufferBytes };
+	std::shared_ptr<const GpuMeshStore::BuffersType> shape = GpuMeshStore::shared().add(device, key, buffers);
+	if (shape->vertexBuffer != vertexBuffer)
+	{
+		// Another mesh of the same shape was created at the same time and got there first, so use its buffers.
+		vertexBuffer->Release();
+		indexBuffer->Release();
+		acquireSharedBuffers(device, key);
+		return;
+	}
+	sharedBuffers = shape;
+}
+
+void BaseMesh::createSharedBuffers(ID3D11Device* device, const std::string& key, const PrimitiveShapes::VertexType* vertices, int lvertexCount, const unsigned short* indices, int lindexCount)
+{
+	if (acquireSharedBuffers(device, key))
+	{
+		return;
+	}
+
+	vertexCount = lvertexCount;
+	indexCount = lindexCount;
+	createVertexBuffer(device, vertices);
+	createIndexBuffer(device, indices);
+	shareBuffers(device, key);
+}
+
+void BaseMesh::buildMeshlets(const VertexType* vertices, unsigned long* indices)
+{
+	MeshletBuilder::build(vertices, vertexCount, sizeof(VertexType), indices, indexCount, meshlets);
+}
+
+void BaseMesh::retainCpuMesh(const std::string& key, const VertexType* vertices, const unsigned long* indices)
+{
+	if (!keepCpuMesh)
+	{
+		return;
+	}
+
+	// The store wants absolute indices, so parts are offset by their base vertex.
+	std::vector<unsigned long> level0;
+	if (submeshes.empty())
+	{
+		level0.assign(indices, indices + indexCount);
+	}
+	for (size_t p = 0; p < submeshes.size(); p++)
+	{
+		for (unsigned int i = 0; i < submeshes[p].indexCount; i++)
+		{
+			level0.push_back(indices[submeshes[p].indexStart + i] + submeshes[p].baseVertex);
+		}
+	}
+	cpuMesh = CpuMeshStore::shared().acquire(key, vertices, vertexCount, sizeof(VertexType), level0.data(), (unsigned long)level0.size());
+}
+
+std::shared_ptr<const CpuMeshStore::MeshType> BaseMesh::getCpuMesh()
+{
+	return cpuMesh;
+}
+
+size_t BaseMesh::getGpuBytes()
+{
+	return vertexBufferBytes + indexBufferBytes;
+}
+
+size_t BaseMesh::getCpuBytes()
+{
+	size_t bytes = lods.capacity() * sizeof(MeshSimplifier::LodType) + meshlets.capacity() * sizeof(MeshletBuilder::MeshletType) +
+		submeshes.capacity() * sizeof(SubmeshType) + submeshLods.capacity() * sizeof(MeshSimplifier::LodType);
+	if (cpuMesh)
+	{
+		bytes += cpuMesh->getBytes();
+	}
+	return bytes;
+}
+
 // Sends geometry data to the GPU. Default primitive topology is TriangleList.
 // To render alternative topologies this function needs to be overwritten.
 void BaseMesh::sendData(ID3D11DeviceContext* deviceContext, D3D_PRIMITIVE_TOPOLOGY top)
 {
+	StateCache* stateCache = StateCache::get(deviceContext);
+
 	unsigned int stride;
 	unsigned int offset;
 	
 	// Set vertex buffer stride and offset.
-	stride = sizeof(VertexType);
+	stride = vertexStride;
 	offset = 0;
 
-	deviceContext->IASetVertexBuffers(0, 1, &vertexBuffer, &stride, &offset);
-	deviceContext->IASetIndexBuffer(indexBuffer, DXGI_FORMAT_R32_UINT, 0);
-	deviceContext->IASetPrimitiveTopology(top);
+	stateCache->IASetVertexBuffers(0, 1, &vertexBuffer, &stride, &offset);
+	stateCache->IASetIndexBuffer(indexBuffer, indexFormat, 0);
+	stateCache->IASetPrimitiveTopology(top);
 }
 
 
@@ -14,6 +14,16 @@
 
 #include <d3d11.h>
 #include <directxmath.h>
+#include "CpuMeshStore.h"
+#include "GpuMeshStore.h"
+#include "MeshletBuilder.h"
+#include "MeshSimplifier.h"
+#include "PrimitiveShapes.h"
+#include "StateCache.h"
+#include "VertexQuantiser.h"
+#include <memory>
+#include <string>
+#include <vector>
 
 using namespace DirectX;
 
@@ -43,7 +53,25 @@ protected:
 		XMFLOAT2 texture;
 	};
 
+	/// Packed 16 byte version of VertexType, used when the mesh is quantised. See VertexQuantiser.
+	typedef VertexQuantiser::QuantisedVertexType VertexType_Quantised;
+
 public:
+	/// One part of a mesh built from several (such as the objects of an imported building). Its indices count from baseVertex.
+	struct SubmeshType
+	{
+		unsigned int indexStart;		///< Level 0 range of the index buffer
+		unsigned int indexCount;
+		int baseVertex;					///< Added to every index of the part by DrawIndexed()
+		unsigned int vertexCount;
+		unsigned int materialIndex;		///< Material of the part in the source file
+		unsigned int meshletStart;		///< Meshlets of the part's level 0
+		unsigned int meshletCount;
+		float boundsMin[3];				///< Box around the part, in model space
+		float boundsMax[3];
+		unsigned int padding;
+	};
+
 	/// Empty constructor
 	BaseMesh();
 	~BaseMesh();
@@ -51,14 +79,103 @@ public:
 	/// Transfers mesh data to the GPU.
 	virtual void sendData(ID3D11DeviceContext* deviceContext, D3D_PRIMITIVE_TOPOLOGY top = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 	int getIndexCount();			///< Returns total index value of the mesh
+	bool isQuantised();				///< True if the vertex buffer holds VertexType_Quantised, which needs a shader loaded with loadQuantisedVertexShader()
+	XMMATRIX getDecodeMatrix();		///< Maps quantised positions back to model space. Multiply it in front of the world matrix (identity for float meshes)
+
+	int getLodCount();						///< Number of levels of detail, 1 if the mesh has none
+	int getLodIndexCount(int lod);			///< Index count of a level, level 0 is the full mesh
+	int getLodIndexStart(int lod);			///< First index of a level, pass it to the shader's render(). Meshes with several parts need getLodRanges()
+
+	/// Appends the index ranges of a level of detail, one per part. Draw them with the shader's render().
+	void getLodRanges(int lod, std::vector<MeshletBuilder::RangeType>& ranges);
+
+	/** \brief Picks the coarsest level of detail whose error stays under pixelError pixels on screen.
+	* Works for the camera and for light views, perspective or orthographic. Shadow passes can pass a larger pixelError.
+	* @param world, view and projection are the matrices the mesh will be drawn with
+	* @param viewportHeight is the height of the render target in pixels
+	* @param pixelError is the largest acceptable error in pixels
+	*/
+	int selectLod(const XMMATRIX& world, const XMMATRIX& view, const XMMATRIX& projection, float viewportHeight, float pixelError = 1.0f);
+
+	int getSubmeshCount();					///< Number of parts, 1 if the mesh isn't split into parts
+	const SubmeshType* getSubmesh(int submesh);	///< A part's ranges, material and bounds, null if the mesh isn't split into parts
+
+	/** \brief Culls each part against a view and appends the index ranges of the parts that may be visible.
+	* A mesh without parts is tested as a whole, against its bounding sphere.
+	* @param world, view and projection are the matrices the mesh will be drawn with, without the decode matrix
+	* @param lod is the level of detail to draw the visible parts at
+	* @param ranges receives the index ranges, draw them with the shader's render()
+	* @return the number of parts that passed
+	*/
+	int cullSubmeshes(const XMMATRIX& world, const XMMATRIX& view, const XMMATRIX& projection, int lod, std::vector<MeshletBuilder::RangeType>& ranges);
+
+	int getMeshletCount();					///< Number of meshlets level 0 is split into, 0 if it isn't
+
+	/** \brief Culls the meshlets of level 0 against a view and appends the index ranges that may be visible.
+	* Rejects parts and meshlets outside the frustum, and meshlets whose triangles all face away from the viewer. Without meshlets the whole of level 0 is appended.
+	* @param world, view and projection are the matrices the mesh will be drawn with, without the decode matrix
+	* @param ranges receives the index ranges, draw them with the shader's render()
+	* @param displacementY is how far a vertex shader may move vertices up along model space y (such as a height map), 0 if it doesn't
+	* @return the number of meshlets that passed
+	*/
+	int cullMeshlets(const XMMATRIX& world, const XMMATRIX& view, const XMMATRIX& projection, std::vector<MeshletBuilder::RangeType>& ranges, float displacementY = 0.0f);
+
+	/// Level 0 positions and indices kept on the CPU, null unless the mesh opted in (see CpuMeshStore). Shared with other meshes from the same source.
+	std::shared_ptr<const CpuMeshStore::MeshType> getCpuMesh();
+	size_t getGpuBytes();			///< Size of the vertex and index buffers
+	size_t getCpuBytes();			///< CPU memory the mesh holds after upload: ranges, meshlets, parts and any retained copy
 	//D3D11_INPUT_ELEMENT_DESC getInputLayout();
 
 protected:
 	virtual void initBuffers(ID3D11Device*) = 0;
 
+	/// Creates the vertex buffer from vertexCount vertices, packing them first if quantised is set.
+	void createVertexBuffer(ID3D11Device* device, const VertexType* vertices);
+	/// Creates the index buffer from indexCount indices, as 16 bit indices when vertexCount (or every part's vertex count) allows it.
+	void createIndexBuffer(ID3D11Device* device, const unsigned long* indices);
+	/// Creates the vertex buffer from a primitive's table (see PrimitiveShapes), which has the same layout as VertexType.
+	void createVertexBuffer(ID3D11Device* device, const PrimitiveShapes::VertexType* vertices);
+	/// Creates a 16 bit index buffer from indexCount indices that are already 16 bit.
+	void createIndexBuffer(ID3D11Device* device, const unsigned short* indices);
+	/// Takes the buffers another mesh offered under key on this device, instead of creating new ones. False if there are none yet.
+	bool acquireSharedBuffers(ID3D11Device* device, const std::string& key);
+	/// Offers this mesh's buffers to later meshes of the same shape. Call once both buffers exist.
+	void shareBuffers(ID3D11Device* device, const std::string& key);
+	/// Uses the buffers of a primitive table, uploading it only if no live mesh on this device already has.
+	void createSharedBuffers(ID3D11Device* device, const std::string& key, const PrimitiveShapes::VertexType* vertices, int vertexCount, const unsigned short* indices, int indexCount);
+	/// Splits the first indexCount indices into meshlets, reordering them in place. Call before createIndexBuffer().
+	void buildMeshlets(const VertexType* vertices, unsigned long* indices);
+	/// Keeps level 0 in the shared CpuMeshStore under key, if keepCpuMesh is set. Call while the arrays are still alive.
+	void retainCpuMesh(const std::string& key, const VertexType* vertices, const unsigned long* indices);
+
+	/// Six frustum planes in model space, (a, b, c, d) with the inside where ax + by + cz + d >= 0.
+	static void getFrustumPlanes(const XMMATRIX& worldViewProjection, XMFLOAT4* planes);
+	/// False if the box is entirely outside one of the planes.
+	static bool boxInFrustum(const float* minimum, const float* maximum, const XMFLOAT4* planes);
+
 	ID3D11Buffer *vertexBuffer, *indexBuffer;
 	//D3D11_INPUT_ELEMENT_DESC *inputLayout;
 	int vertexCount, indexCount;
+
+	bool quantised;							///< Set before initBuffers() to store VertexType_Quantised
+	bool keepCpuMesh;						///< Set before initBuffers() to keep a read-only copy of the geometry after upload
+	unsigned int vertexStride;				///< Size of one vertex in the vertex buffer
+	DXGI_FORMAT indexFormat;				///< R16_UINT or R32_UINT
+	VertexQuantiser::DecodeType decode;		///< Position decode for quantised meshes
+
+	std::vector<MeshSimplifier::LodType> lods;	///< Set before createIndexBuffer() if the indices hold several levels. indexCount stays the level 0 count.
+	std::vector<MeshletBuilder::MeshletType> meshlets;	///< Ranges of level 0, set by buildMeshlets() or loaded with the mesh
+	std::vector<SubmeshType> submeshes;		///< Parts of the mesh, empty if it is a single part. Set before createIndexBuffer().
+	std::vector<MeshSimplifier::LodType> submeshLods;	///< Range of every part at every level, level by level. lods then hold each level's total.
+	XMFLOAT3 boundsCentre;					///< Bounding sphere in model space, set by createVertexBuffer()
+	float boundsRadius;
+	size_t vertexBufferBytes, indexBufferBytes;
+	std::shared_ptr<const CpuMeshStore::MeshType> cpuMesh;
+	std::shared_ptr<const GpuMeshStore::BuffersType> sharedBuffers;	///< Set if the buffers are shared with other meshes of the same shape
+
+private:
+	/// Creates the index buffer from bufferIndexCount indices of indexSize bytes, in indexFormat.
+	void uploadIndexBuffer(ID3D11Device* device, const void* indices, unsigned int indexSize, unsigned int bufferIndexCount);
 };
 
 #endif
\ No newline at end of file
@@ -50,13 +50,12 @@ BaseShader::~BaseShader()
 	}
 }
 
-// Given pre-compiled file, load and create vertex shader.
-void BaseShader::loadVertexShader(const wchar_t* filename)
+// Given pre-compiled file, load and create vertex shader, with an input layout of elementCount elements.
+// The variants below only differ in the layout they pass.
+void BaseShader::loadVertexShader(const wchar_t* filename, const D3D11_INPUT_ELEMENT_DESC* elements, UINT elementCount)
 {
 	ID3DBlob* vertexShaderBuffer;
 	
-	unsigned int numElements;
-	
 	vertexShaderBuffer = 0;
 
 	// check file extension for correct loading function.
@@ -94,154 +93,88 @@ void BaseShader::loadVertexShader(const wchar_t* filename)
 	
 	// Create the vertex shader from the buffer.
 	renderer->CreateVertexShader(vertexShaderBuffer->GetBufferPointer(), vertexShaderBuffer->GetBufferSize(), NULL, &vertexShader);
-	
-	// Create the vertex input layout description.
-	// This setup needs to match the VertexType stucture in the MeshClass and in the shader.
-	D3D11_INPUT_ELEMENT_DESC polygonLayout[] = {
-		{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-		{ "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0},
-		{ "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 }
-	};
-
-	// Get a count of the elements in the layout.
-	numElements = sizeof(polygonLayout) / sizeof(polygonLayout[0]);
 
 	// Create the vertex input layout.
-	renderer->CreateInputLayout(polygonLayout, numElements, vertexShaderBuffer->GetBufferPointer(), vertexShaderBuffer->GetBufferSize(), &layout);
+	renderer->CreateInputLayout(elements, elementCount, vertexShaderBuffer->GetBufferPointer(), vertexShaderBuffer->GetBufferSize(), &layout);
 	
 	// Release the vertex shader buffer and pixel shader buffer since they are no longer needed.
 	vertexShaderBuffer->Release();
 	vertexShaderBuffer = 0;
 }
 
-
-void BaseShader::loadTextureVertexShader(const wchar_t* filename)
+// Given pre-compiled file, load and create vertex shader.
+void BaseShader::loadVertexShader(const wchar_t* filename)
 {
-	ID3DBlob* vertexShaderBuffer;
-	
-	unsigned int numElements;
-
-	vertexShaderBuffer = 0;
-
-	// check file extension for correct loading function.
-	std::wstring fn(filename);
-	std::string::size_type idx;
-	std::wstring extension;
-
-	idx = fn.rfind('.');
-
-	if (idx != std::string::npos)
-	{
-		extension = fn.substr(idx + 1);
-	}
-	else
-	{
-		// No extension found
-		MessageBox(hwnd, L"Error finding vertex shader file", L"ERROR", MB_OK);
-		exit(0);
-	}
+	// This setup needs to match the VertexType stucture in the MeshClass and in the shader.
+	const D3D11_INPUT_ELEMENT_DESC polygonLayout[] = {
+		{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0},
+		{ "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 }
+	};
+	loadVertexShader(filename, polygonLayout, sizeof(polygonLayout) / sizeof(polygonLayout[0]));
+}
 
-	// Load the texture in.
-	if (extension != L"cso")
-	{
-		MessageBox(hwnd, L"Incorrect vertex shader file type", L"ERROR", MB_OK);
-		exit(0);
-	}
+// Given pre-compiled file, load and create a vertex shader for quantised meshes.
+void BaseShader::loadQuantisedVertexShader(const wchar_t* filename)
+{
+	// This setup needs to match VertexQuantiser::QuantisedVertexType. Positions still arrive as a float4 (w is stored as 1),
+	// the octahedral normal arrives as a float2 and needs decoding in the shader.
+	const D3D11_INPUT_ELEMENT_DESC polygonLayout[] = {
+		{ "POSITION", 0, DXGI_FORMAT_R16G16B16A16_SNORM, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "NORMAL", 0, DXGI_FORMAT_R16G16_SNORM, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "TEXCOORD", 0, DXGI_FORMAT_R16G16_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 }
+	};
+	loadVertexShader(filename, polygonLayout, sizeof(polygonLayout) / sizeof(polygonLayout[0]));
+}
 
-	// Reads compiled shader into buffer (bytecode).
-	HRESULT result = D3DReadFileToBlob(filename, &vertexShaderBuffer);
-	if (result != S_OK)
-	{
-		MessageBox(NULL, filename, L"File ERROR", MB_OK);
-		exit(0);
-	}
+// Given pre-compiled file, load and create a vertex shader for instanced meshes.
+void BaseShader::loadInstancedVertexShader(const wchar_t* filename)
+{
+	// Slot 0 matches the VertexType stucture in the MeshClass, as loadVertexShader(). Slot 1 streams one world matrix per instance,
+	// a row per element, from InstanceBuffer.
+	const D3D11_INPUT_ELEMENT_DESC polygonLayout[] = {
+		{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0},
+		{ "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "WORLD", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, InstanceBuffer::slot, 0, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+		{ "WORLD", 1, DXGI_FORMAT_R32G32B32A32_FLOAT, InstanceBuffer::slot, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+		{ "WORLD", 2, DXGI_FORMAT_R32G32B32A32_FLOAT, InstanceBuffer::slot, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+		{ "WORLD", 3, DXGI_FORMAT_R32G32B32A32_FLOAT, InstanceBuffer::slot, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1 }
+	};
+	loadVertexShader(filename, polygonLayout, sizeof(polygonLayout) / sizeof(polygonLayout[0]));
+}
 
-	// Create the vertex shader from the buffer.
-	renderer->CreateVertexShader(vertexShaderBuffer->GetBufferPointer(), vertexShaderBuffer->GetBufferSize(), NULL, &vertexShader);
+// Given pre-compiled file, load and create a vertex shader for particles streamed as points.
+void BaseShader::loadPointVertexShader(const wchar_t* filename)
+{
+	// One point per particle: its centre and the size of the quad the geometry shader builds around it.
+	const D3D11_INPUT_ELEMENT_DESC polygonLayout[] = {
+		{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "PSIZE", 0, DXGI_FORMAT_R32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 }
+	};
+	loadVertexShader(filename, polygonLayout, sizeof(polygonLayout) / sizeof(polygonLayout[0]));
+}
 
-	// Create the vertex input layout description.
+void BaseShader::loadTextureVertexShader(const wchar_t* filename)
+{
 	// This setup needs to match the VertexType stucture in the MeshClass and in the shader.
-
-	D3D11_INPUT_ELEMENT_DESC polygonLayout[] = {
+	const D3D11_INPUT_ELEMENT_DESC polygonLayout[] = {
 		{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
 		{ "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 }
 	};
-
-	// Get a count of the elements in the layout.
-	numElements = sizeof(polygonLayout) / sizeof(polygonLayout[0]);
-
-	// Create the vertex input layout.
-	renderer->CreateInputLayout(polygonLayout, numElements, vertexShaderBuffer->GetBufferPointer(), vertexShaderBuffer->GetBufferSize(), &layout);
-
-	// Release the vertex shader buffer and pixel shader buffer since they are no longer needed.
-	vertexShaderBuffer->Release();
-	vertexShaderBuffer = 0;
+	loadVertexShader(filename, polygonLayout, sizeof(polygonLayout) / sizeof(polygonLayout[0]));
 }
 
 void BaseShader::loadColourVertexShader(const wchar_t* filename)
 {
-	ID3DBlob* vertexShaderBuffer;
-	
-	unsigned int numElements;
-
-	vertexShaderBuffer = 0;
-
-	// check file extension for correct loading function.
-	std::wstring fn(filename);
-	std::string::size_type idx;
-	std::wstring extension;
-
-	idx = fn.rfind('.');
-
-	if (idx != std::string::npos)
-	{
-		extension = fn.substr(idx + 1);
-	}
-	else
-	{
-		// No extension found
-		MessageBox(hwnd, L"Error finding vertex shader file", L"ERROR", MB_OK);
-		exit(0);
-	}
-
-	// Load the texture in.
-	if (extension != L"cso")
-	{
-		MessageBox(hwnd, L"Incorrect vertex shader file type", L"ERROR", MB_OK);
-		exit(0);
-	}
-
-	// Reads compiled shader into buffer (bytecode).
-	HRESULT result = D3DReadFileToBlob(filename, &vertexShaderBuffer);
-	if (result != S_OK)
-	{
-		MessageBox(NULL, filename, L"File ERROR", MB_OK);
-		exit(0);
-	}
-
-	// Create the vertex shader from the buffer.
-	renderer->CreateVertexShader(vertexShaderBuffer->GetBufferPointer(), vertexShaderBuffer->GetBufferSize(), NULL, &vertexShader);
-
-	// Create the vertex input layout description.
 	// This setup needs to match the VertexType stucture in the MeshClass and in the shader.
-	D3D11_INPUT_ELEMENT_DESC polygonLayout[] = {
+	const D3D11_INPUT_ELEMENT_DESC polygonLayout[] = {
 		{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
 		{ "COLOR", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 }
 	};
-
-	// Get a count of the elements in the layout.
-	numElements = sizeof(polygonLayout) / sizeof(polygonLayout[0]);
-
-	// Create the vertex input layout.
-	renderer->CreateInputLayout(polygonLayout, numElements, vertexShaderBuffer->GetBufferPointer(), vertexShaderBuffer->GetBufferSize(), &layout);
-
-	// Release the vertex shader buffer and pixel shader buffer since they are no longer needed.
-	vertexShaderBuffer->Release();
-	vertexShaderBuffer = 0;
+	loadVertexShader(filename, polygonLayout, sizeof(polygonLayout) / sizeof(polygonLayout[0]));
 }
 
-
-
 // Given pre-compiled file, load and create pixel shader.
 void BaseShader::loadPixelShader(const wchar_t* filename)
 {
@@ -462,45 +395,83 @@ void BaseShader::loadComputeShader(const wchar_t* filename)
 }
 
 // De/Activate shader stages and send shaders to GPU.
-void BaseShader::render(ID3D11DeviceContext* deviceContext, int indexCount)
+void BaseShader::setShaders(ID3D11DeviceContext* deviceContext)
 {
+	StateCache* stateCache = StateCache::get(deviceContext);
+
 	// Set the vertex input layout.
-	deviceContext->IASetInputLayout(layout);
+	stateCache->IASetInputLayout(layout);
 
 	// Set the vertex and pixel shaders that will be used to render.
-	deviceContext->VSSetShader(vertexShader, NULL, 0);
-	deviceContext->PSSetShader(pixelShader, NULL, 0);
-	deviceContext->CSSetShader(NULL, NULL, 0);
+	stateCache->VSSetShader(vertexShader);
+	stateCache->PSSetShader(pixelShader);
+	stateCache->CSSetShader(NULL);
 	
 	// if Hull shader is not null then set HS and DS
 	if (hullShader)
 	{
-		deviceContext->HSSetShader(hullShader, NULL, 0);
-		deviceContext->DSSetShader(domainShader, NULL, 0);
+		stateCache->HSSetShader(hullShader);
+		stateCache->DSSetShader(domainShader);
 	}
 	else
 	{
-		deviceContext->HSSetShader(NULL, NULL, 0);
-		deviceContext->DSSetShader(NULL, NULL, 0);
+		stateCache->HSSetShader(NULL);
+		stateCache->DSSetShader(NULL);
 	}
 
 	// if geometry shader is not null then set GS
 	if (geometryShader)
 	{
-		deviceContext->GSSetShader(geometryShader, NULL, 0);
+		stateCache->GSSetShader(geometryShader);
 	}
 	else
 	{
-		deviceContext->GSSetShader(NULL, NULL, 0);
+		stateCache->GSSetShader(NULL);
 	}
+}
+
+void BaseShader::render(ID3D11DeviceContext* deviceContext, int indexCount, int startIndex)
+{
+	setShaders(deviceContext);
 
 	// Render the triangle.
-	deviceContext->DrawIndexed(indexCount, 0, 0);
+	deviceContext->DrawIndexed(indexCount, startIndex, 0);
+}
+
+void BaseShader::renderVertices(ID3D11DeviceContext* deviceContext, int vertexCount, int startVertex)
+{
+	setShaders(deviceContext);
+
+	// Render the vertices in order, without an index buffer.
+	deviceContext->Draw(vertexCount, startVertex);
+}
+
+void BaseShader::renderInstanced(ID3D11DeviceContext* deviceContext, int indexCount, int startIndex, int instanceCount)
+{
+	setShaders(deviceContext);
+
+	// Render every instance of the triangles, with the world matrices bound by InstanceBuffer::write().
+	deviceContext->DrawIndexedInstanced(indexCount, instanceCount, startIndex, 0, 0);
+}
+
+void BaseShader::render(ID3D11DeviceContext* deviceContext, const std::vector<MeshletBuilder::RangeType>& ranges)
+{
+	render(deviceContext, ranges.data(), ranges.size());
+}
+
+void BaseShader::render(ID3D11DeviceContext* deviceContext, const MeshletBuilder::RangeType* ranges, size_t rangeCount)
+{
+	setShaders(deviceContext);
+
+	for (size_t i = 0; i < rangeCount; i++)
+	{
+		deviceContext->DrawIndexed(ranges[i].indexCount, ranges[i].indexStart, ranges[i].baseVertex);
+	}
 }
 
 // Dispatch the compute shader.
 void BaseShader::compute(ID3D11DeviceContext* dc, int x, int y, int z)
 {
-	dc->CSSetShader(computeShader, NULL, 0);
+	StateCache::get(dc)->CSSetShader(computeShader);
 	dc->Dispatch(x, y, z);
 }
\ No newline at end of file
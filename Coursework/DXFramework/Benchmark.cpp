@@ -0,0 +1,30 @@
+// Benchmark
+// Report and timing helpers for the headless benchmarks.
+#include "Benchmark.h"
+#include <windows.h>
+#include <cstdarg>
+
+void Benchmark::report(FILE* out, const char* format, ...)
+{
+	char line[512];
+	va_list args;
+	va_start(args, format);
+	vsnprintf(line, sizeof(line), format, args);
+	va_end(args);
+
+	fputs(line, out);
+	OutputDebugStringA(line);
+}
+
+double Benchmark::seconds()
+{
+	static LARGE_INTEGER frequency = {};
+	if (frequency.QuadPart == 0)
+	{
+		QueryPerformanceFrequency(&frequency);
+	}
+
+	LARGE_INTEGER counter;
+	QueryPerformanceCounter(&counter);
+	return (double)counter.QuadPart / (double)frequency.QuadPart;
+}
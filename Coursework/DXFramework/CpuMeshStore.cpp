@@ -0,0 +1,119 @@
+// CPU mesh store
+// Compact, shared position and index copies for meshes that opt in to keeping their geometry.
+#include "CpuMeshStore.h"
+#include "Benchmark.h"
+#include "VertexWelder.h"
+#include <algorithm>
+#include <cfloat>
+
+size_t CpuMeshStore::MeshType::getBytes() const
+{
+	return sizeof(MeshType) + positions.capacity() * sizeof(XMFLOAT3) + shortIndices.capacity() * sizeof(unsigned short) + longIndices.capacity() * sizeof(unsigned int);
+}
+
+CpuMeshStore& CpuMeshStore::shared()
+{
+	static CpuMeshStore store;
+	return store;
+}
+
+std::shared_ptr<const CpuMeshStore::MeshType> CpuMeshStore::acquire(const std::string& key, const void* vertices, unsigned long vertexCount, unsigned int stride, const unsigned long* indices, unsigned long indexCount)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	std::shared_ptr<const MeshType> existing = meshes[key].lock();
+	if (existing)
+	{
+		return existing;
+	}
+
+	std::shared_ptr<MeshType> mesh = std::make_shared<MeshType>();
+
+	// Only positions are kept, so corners split by UVs or normals weld back into one.
+	std::vector<XMFLOAT3> positions(vertexCount);
+	for (unsigned long i = 0; i < vertexCount; i++)
+	{
+		positions[i] = *(const XMFLOAT3*)((const char*)vertices + (size_t)i * stride);
+	}
+	std::vector<unsigned long> remap(vertexCount);
+	unsigned long positionCount = vertexCount ? VertexWelder::weld(positions.data(), vertexCount, sizeof(XMFLOAT3), positions.data(), remap.data()) : 0;
+	mesh->positions.assign(positions.begin(), positions.begin() + positionCount);
+
+	if (positionCount < 65536)
+	{
+		mesh->shortIndices.resize(indexCount);
+		for (unsigned long i = 0; i < indexCount; i++)
+		{
+			mesh->shortIndices[i] = (unsigned short)remap[indices[i]];
+		}
+	}
+	else
+	{
+		mesh->longIndices.resize(indexCount);
+		for (unsigned long i = 0; i < indexCount; i++)
+		{
+			mesh->longIndices[i] = (unsigned int)remap[indices[i]];
+		}
+	}
+
+	mesh->boundsMin = XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX);
+	mesh->boundsMax = XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	for (size_t i = 0; i < mesh->positions.size(); i++)
+	{
+		const XMFLOAT3& p = mesh->positions[i];
+		mesh->boundsMin = XMFLOAT3(std::min(mesh->boundsMin.x, p.x), std::min(mesh->boundsMin.y, p.y), std::min(mesh->boundsMin.z, p.z));
+		mesh->boundsMax = XMFLOAT3(std::max(mesh->boundsMax.x, p.x), std::max(mesh->boundsMax.y, p.y), std::max(mesh->boundsMax.z, p.z));
+	}
+
+	meshes[key] = mesh;
+	return mesh;
+}
+
+std::shared_ptr<const CpuMeshStore::MeshType> CpuMeshStore::find(const std::string& key)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	std::map<std::string, std::weak_ptr<const MeshType>>::iterator found = meshes.find(key);
+	return found == meshes.end() ? nullptr : found->second.lock();
+}
+
+size_t CpuMeshStore::getBytes()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	size_t bytes = 0;
+	for (std::map<std::string, std::weak_ptr<const MeshType>>::iterator i = meshes.begin(); i != meshes.end(); ++i)
+	{
+		std::shared_ptr<const MeshType> mesh = i->second.lock();
+		if (mesh)
+		{
+			bytes += mesh->getBytes();
+		}
+	}
+	return bytes;
+}
+
+void CpuMeshStore::report(FILE* out)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	Benchmark::report(out, "Retained CPU meshes\n");
+	Benchmark::report(out, "%-48s %10s %10s %10s %6s\n", "key", "positions", "triangles", "KB", "users");
+
+	size_t total = 0;
+	int count = 0;
+	for (std::map<std::string, std::weak_ptr<const MeshType>>::iterator i = meshes.begin(); i != meshes.end();)
+	{
+		std::shared_ptr<const MeshType> mesh = i->second.lock();
+		if (!mesh)
+		{
+			// Every mesh using it has been deleted.
+			i = meshes.erase(i);
+			continue;
+		}
+
+		// One use is the lock above.
+		Benchmark::report(out, "%-48s %10zu %10zu %10.1f %6ld\n", i->first.c_str(), mesh->positions.size(), mesh->getIndexCount() / 3,
+			mesh->getBytes() / 1024.0, mesh.use_count() - 1);
+		total += mesh->getBytes();
+		count++;
+		++i;
+	}
+	Benchmark::report(out, "%d retained, %.1f KB\n", count, total / 1024.0);
+}
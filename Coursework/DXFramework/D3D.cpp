@@ -1,6 +1,7 @@
 // D3D.cpp
 // Direct3D setup
 #include "d3d.h"
+#include "StateCache.h"
 #include <string>
 
 // Configures and initilises a DirectX renderer.
@@ -353,6 +354,7 @@ D3D::~D3D()
 
 	if (deviceContext)
 	{
+		StateCache::release(deviceContext);
 		deviceContext->Release();
 		deviceContext = 0;
 	}
@@ -0,0 +1,62 @@
+// GPU mesh store
+// Buffers of the fixed primitives, uploaded once per device and shared by every mesh of that shape.
+#include "GpuMeshStore.h"
+#include "Benchmark.h"
+
+GpuMeshStore& GpuMeshStore::shared()
+{
+	static GpuMeshStore store;
+	return store;
+}
+
+std::shared_ptr<const GpuMeshStore::BuffersType> GpuMeshStore::find(ID3D11Device* device, const std::string& key)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	std::map<KeyType, std::weak_ptr<const BuffersType>>::iterator found = shapes.find(KeyType(device, key));
+	return found == shapes.end() ? nullptr : found->second.lock();
+}
+
+std::shared_ptr<const GpuMeshStore::BuffersType> GpuMeshStore::add(ID3D11Device* device, const std::string& key, const BuffersType& buffers)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	std::weak_ptr<const BuffersType>& entry = shapes[KeyType(device, key)];
+	std::shared_ptr<const BuffersType> existing = entry.lock();
+	if (existing)
+	{
+		return existing;
+	}
+
+	std::shared_ptr<const BuffersType> added = std::make_shared<BuffersType>(buffers);
+	entry = added;
+	return added;
+}
+
+void GpuMeshStore::report(FILE* out)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	Benchmark::report(out, "Shared primitive buffers\n");
+	Benchmark::report(out, "%-48s %10s %10s %10s %6s\n", "key", "vertices", "triangles", "KB", "users");
+
+	size_t total = 0, saved = 0;
+	int count = 0;
+	for (std::map<KeyType, std::weak_ptr<const BuffersType>>::iterator i = shapes.begin(); i != shapes.end();)
+	{
+		std::shared_ptr<const BuffersType> shape = i->second.lock();
+		if (!shape)
+		{
+			// Every mesh using it has been deleted.
+			i = shapes.erase(i);
+			continue;
+		}
+
+		// One use is the lock above. Every user past the first would have had its own copy.
+		long users = shape.use_count() - 1;
+		size_t bytes = shape->vertexBufferBytes + shape->indexBufferBytes;
+		Benchmark::report(out, "%-48s %10d %10d %10.1f %6ld\n", i->first.second.c_str(), shape->vertexCount, shape->indexCount / 3, bytes / 1024.0, users);
+		total += bytes;
+		saved += bytes * (users - 1);
+		count++;
+		++i;
+	}
+	Benchmark::report(out, "%d shapes, %.1f KB, %.1f KB saved by sharing\n", count, total / 1024.0, saved / 1024.0);
+}
@@ -0,0 +1,485 @@
+// Heightmap
+// Red channel of a decoded image, with bilinear wrapped sampling that matches the GPU and a min/max quadtree for bounds and rays.
+#include "Heightmap.h"
+#include "AssetLoader.h"
+#include "Benchmark.h"
+#include <windows.h>
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <string>
+
+namespace
+{
+	// Narrows [nearest, farthest] to where the ray is inside the box. An axis the ray doesn't move along only has to contain the origin.
+	bool clipToBox(const double* origin, const double* direction, const double* boxMin, const double* boxMax, double& nearest, double& farthest)
+	{
+		for (int axis = 0; axis < 3; axis++)
+		{
+			if (direction[axis] == 0.0)
+			{
+				if (origin[axis] < boxMin[axis] || origin[axis] > boxMax[axis])
+				{
+					return false;
+				}
+				continue;
+			}
+			double enter = (boxMin[axis] - origin[axis]) / direction[axis];
+			double exit = (boxMax[axis] - origin[axis]) / direction[axis];
+			if (enter > exit)
+			{
+				std::swap(enter, exit);
+			}
+			nearest = std::max(nearest, enter);
+			farthest = std::min(farthest, exit);
+		}
+		return nearest <= farthest;
+	}
+
+	inline unsigned char toByte(float value)
+	{
+		return (unsigned char)std::min(std::max(floorf(value * 255.0f + 0.5f), 0.0f), 255.0f);
+	}
+}
+
+Heightmap::Heightmap()
+{
+	width = 0;
+	height = 0;
+	version = 0;
+}
+
+void Heightmap::setPixels(const unsigned char* rgba, int lwidth, int lheight)
+{
+	width = lwidth;
+	height = lheight;
+	heights.resize((size_t)width * height);
+	for (size_t i = 0; i < heights.size(); i++)
+	{
+		heights[i] = rgba[i * 4] / 255.0f;
+	}
+	buildQuadtree();
+	version++;
+}
+
+float Heightmap::sample(float u, float v) const
+{
+	if (heights.empty())
+	{
+		return 0.0f;
+	}
+
+	// Texel centres sit at half texel offsets.
+	float x = u * width - 0.5f;
+	float y = v * height - 0.5f;
+	float fx = floorf(x);
+	float fy = floorf(y);
+	float tx = x - fx;
+	float ty = y - fy;
+
+	// Wrap both neighbours into the image, including negative coordinates.
+	int x0 = ((int)fx % width + width) % width;
+	int y0 = ((int)fy % height + height) % height;
+	int x1 = (x0 + 1) % width;
+	int y1 = (y0 + 1) % height;
+
+	float top = heights[(size_t)y0 * width + x0] + (heights[(size_t)y0 * width + x1] - heights[(size_t)y0 * width + x0]) * tx;
+	float bottom = heights[(size_t)y1 * width + x0] + (heights[(size_t)y1 * width + x1] - heights[(size_t)y1 * width + x0]) * tx;
+	return top + (bottom - top) * ty;
+}
+
+void Heightmap::buildQuadtree()
+{
+	levels.clear();
+	if (heights.empty())
+	{
+		return;
+	}
+
+	// Halve the previous level until a single node covers everything. Nodes along the far edges may have fewer children.
+	int level = 1;
+	do
+	{
+		int childWidth = getLevelWidth(level - 1);
+		int childHeight = getLevelHeight(level - 1);
+		LevelType node;
+		node.width = (childWidth + 1) / 2;
+		node.height = (childHeight + 1) / 2;
+		node.lowest.resize((size_t)node.width * node.height);
+		node.highest.resize(node.lowest.size());
+
+		for (int z = 0; z < node.height; z++)
+		{
+			for (int x = 0; x < node.width; x++)
+			{
+				float lowest = 1.0f, highest = 0.0f;
+				for (int cz = z * 2; cz < std::min(z * 2 + 2, childHeight); cz++)
+				{
+					for (int cx = x * 2; cx < std::min(x * 2 + 2, childWidth); cx++)
+					{
+						float childLowest, childHighest;
+						getNodeRange(level - 1, cx, cz, childLowest, childHighest);
+						lowest = std::min(lowest, childLowest);
+						highest = std::max(highest, childHighest);
+					}
+				}
+				node.lowest[(size_t)z * node.width + x] = toByte(lowest);
+				node.highest[(size_t)z * node.width + x] = toByte(highest);
+			}
+		}
+		levels.push_back(node);
+		level++;
+	} while (levels.back().width > 1 || levels.back().height > 1);
+}
+
+void Heightmap::getNodeRange(int level, int x, int z, float& lowest, float& highest) const
+{
+	if (level > 0)
+	{
+		const LevelType& node = levels[level - 1];
+		lowest = node.lowest[(size_t)z * node.width + x] / 255.0f;
+		highest = node.highest[(size_t)z * node.width + x] / 255.0f;
+		return;
+	}
+
+	// Leaf x lies between texel x - 1 and texel x, wrapped. Bilinear patches peak at their corners.
+	size_t left = (x + width - 1) % width;
+	size_t right = x % width;
+	size_t bottom = (size_t)((z + height - 1) % height) * width;
+	size_t top = (size_t)(z % height) * width;
+	float a = heights[bottom + left], b = heights[bottom + right], c = heights[top + left], d = heights[top + right];
+	lowest = std::min(std::min(a, b), std::min(c, d));
+	highest = std::max(std::max(a, b), std::max(c, d));
+}
+
+void Heightmap::getRange(float u0, float v0, float u1, float v1, float& lowest, float& highest) const
+{
+	lowest = 0.0f;
+	highest = 0.0f;
+	if (heights.empty())
+	{
+		return;
+	}
+
+	// Leaf x covers texture coordinates from (x - 0.5) / width to (x + 0.5) / width.
+	auto toLeaf = [](float coordinate, int size) { return (int)floorf(std::min(std::max(coordinate, 0.0f), 1.0f) * size + 0.5f); };
+	int leaves[4] = { toLeaf(std::min(u0, u1), width), toLeaf(std::min(v0, v1), height), toLeaf(std::max(u0, u1), width), toLeaf(std::max(v0, v1), height) };
+
+	lowest = 1.0f;
+	highest = 0.0f;
+	queryRange((int)levels.size(), 0, 0, leaves, lowest, highest);
+}
+
+void Heightmap::queryRange(int level, int x, int z, const int* leaves, float& lowest, float& highest) const
+{
+	int size = 1 << level;
+	int nodeX0 = x * size, nodeZ0 = z * size;
+	int nodeX1 = nodeX0 + size - 1, nodeZ1 = nodeZ0 + size - 1;
+	if (nodeX0 > leaves[2] || nodeX1 < leaves[0] || nodeZ0 > leaves[3] || nodeZ1 < leaves[1])
+	{
+		return;
+	}
+
+	// Nodes entirely inside the rectangle answer for everything under them.
+	if (level == 0 || (nodeX0 >= leaves[0] && nodeX1 <= leaves[2] && nodeZ0 >= leaves[1] && nodeZ1 <= leaves[3]))
+	{
+		float nodeLowest, nodeHighest;
+		getNodeRange(level, x, z, nodeLowest, nodeHighest);
+		lowest = std::min(lowest, nodeLowest);
+		highest = std::max(highest, nodeHighest);
+		return;
+	}
+
+	for (int cz = z * 2; cz < std::min(z * 2 + 2, getLevelHeight(level - 1)); cz++)
+	{
+		for (int cx = x * 2; cx < std::min(x * 2 + 2, getLevelWidth(level - 1)); cx++)
+		{
+			queryRange(level - 1, cx, cz, leaves, lowest, highest);
+		}
+	}
+}
+
+bool Heightmap::intersect(const XMFLOAT3& origin, const XMFLOAT3& direction, float amplitude, float maxDistance, float& distance) const
+{
+	if (heights.empty())
+	{
+		return false;
+	}
+
+	// Work in leaf units, where leaf x spans x to x + 1 and texture coordinates 0 to 1 span 0.5 to size + 0.5. Distances along the ray don't change.
+	double leafOrigin[3] = { origin.x * (double)width + 0.5, origin.y, origin.z * (double)height + 0.5 };
+	double leafDirection[3] = { direction.x * (double)width, direction.y, direction.z * (double)height };
+
+	float rootLowest, rootHighest;
+	int root = (int)levels.size();
+	getNodeRange(root, 0, 0, rootLowest, rootHighest);
+	double boxMin[3] = { 0.5, rootLowest * (double)amplitude, 0.5 };
+	double boxMax[3] = { width + 0.5, rootHighest * (double)amplitude, height + 0.5 };
+	if (boxMin[1] > boxMax[1])
+	{
+		std::swap(boxMin[1], boxMax[1]);
+	}
+
+	double nearest = 0.0, farthest = maxDistance;
+	if (!clipToBox(leafOrigin, leafDirection, boxMin, boxMax, nearest, farthest))
+	{
+		return false;
+	}
+
+	double hit = farthest + 1.0;
+	intersectNode(root, 0, 0, leafOrigin, leafDirection, amplitude, nearest, farthest, hit);
+	if (hit > farthest)
+	{
+		return false;
+	}
+	distance = (float)hit;
+	return true;
+}
+
+void Heightmap::intersectNode(int level, int x, int z, const double* origin, const double* direction, float amplitude, double nearest, double farthest, double& hit) const
+{
+	if (level == 0)
+	{
+		// The patch's height along the ray is quadratic in the distance, so solve for where the ray's height meets it.
+		size_t left = (x + width - 1) % width;
+		size_t right = x % width;
+		size_t bottom = (size_t)((z + height - 1) % height) * width;
+		size_t top = (size_t)(z % height) * width;
+		double h00 = heights[bottom + left] * (double)amplitude, h10 = heights[bottom + right] * (double)amplitude;
+		double h01 = heights[top + left] * (double)amplitude, h11 = heights[top + right] * (double)amplitude;
+		double fx = origin[0] - x, fz = origin[2] - z;
+		double slopeX = h10 - h00, slopeZ = h01 - h00, twist = h00 - h10 - h01 + h11;
+
+		double a = -twist * direction[0] * direction[2];
+		double b = direction[1] - (slopeX * direction[0] + slopeZ * direction[2] + twist * (fx * direction[2] + fz * direction[0]));
+		double c = origin[1] - (h00 + slopeX * fx + slopeZ * fz + twist * fx * fz);
+
+		double roots[2];
+		int rootCount = 0;
+		if (fabs(a) < 1e-12)
+		{
+			if (b != 0.0)
+			{
+				roots[rootCount++] = -c / b;
+			}
+		}
+		else
+		{
+			double discriminant = b * b - 4.0 * a * c;
+			if (discriminant >= 0.0)
+			{
+				// The stable form, avoiding cancellation when b is much larger than a.
+				double q = -0.5 * (b + (b >= 0.0 ? sqrt(discriminant) : -sqrt(discriminant)));
+				roots[rootCount++] = q / a;
+				if (q != 0.0)
+				{
+					roots[rootCount++] = c / q;
+				}
+			}
+		}
+
+		const double tolerance = 1e-9;
+		for (int i = 0; i < rootCount; i++)
+		{
+			if (roots[i] >= nearest - tolerance && roots[i] <= farthest + tolerance && roots[i] < hit)
+			{
+				hit = std::max(roots[i], nearest);
+			}
+		}
+		return;
+	}
+
+	// Clip the ray to each child's box, then visit them nearest first until the closest hit is nearer than the next child.
+	struct ChildType
+	{
+		double nearest;
+		double farthest;
+		int x;
+		int z;
+	};
+	ChildType children[4];
+	int childCount = 0;
+	int childSize = 1 << (level - 1);
+	for (int cz = z * 2; cz < std::min(z * 2 + 2, getLevelHeight(level - 1)); cz++)
+	{
+		for (int cx = x * 2; cx < std::min(x * 2 + 2, getLevelWidth(level - 1)); cx++)
+		{
+			float lowest, highest;
+			getNodeRange(level - 1, cx, cz, lowest, highest);
+			double boxMin[3] = { (double)cx * childSize, std::min(lowest * (double)amplitude, highest * (double)amplitude), (double)cz * childSize };
+			double boxMax[3] = { (double)(cx + 1) * childSize, std::max(lowest * (double)amplitude, highest * (double)amplitude), (double)(cz + 1) * childSize };
+
+			ChildType child = { nearest, farthest, cx, cz };
+			if (clipToBox(origin, direction, boxMin, boxMax, child.nearest, child.farthest))
+			{
+				int i = childCount++;
+				for (; i > 0 && children[i - 1].nearest > child.nearest; i--)
+				{
+					children[i] = children[i - 1];
+				}
+				children[i] = child;
+			}
+		}
+	}
+
+	for (int i = 0; i < childCount && children[i].nearest < hit; i++)
+	{
+		intersectNode(level - 1, children[i].x, children[i].z, origin, direction, amplitude, children[i].nearest, children[i].farthest, hit);
+	}
+}
+
+size_t Heightmap::getBytes() const
+{
+	size_t bytes = heights.capacity() * sizeof(float);
+	for (size_t i = 0; i < levels.size(); i++)
+	{
+		bytes += levels[i].lowest.capacity() + levels[i].highest.capacity();
+	}
+	return bytes;
+}
+
+void Heightmap::benchmark(const char* directory, FILE* report)
+{
+	const int rangeQueries = 100000;
+	const int rayQueries = 100000;
+	const int scannedQueries = 200;
+	const float amplitude = 30.0f;
+
+	std::string pattern = std::string(directory) + "\\*height*.png";
+	WIN32_FIND_DATAA findData;
+	HANDLE find = FindFirstFileA(pattern.c_str(), &findData);
+	if (find == INVALID_HANDLE_VALUE)
+	{
+		Benchmark::report(report, "Height map quadtree: no height map images in %s\n", directory);
+		return;
+	}
+
+	Benchmark::report(report, "Height map min/max quadtree. Query times in microseconds, against scanning the pixels (bounds) or marching a quarter texel at a time (rays)\n");
+	Benchmark::report(report, "%-24s %11s %9s %11s %11s %10s %10s %10s %10s %10s %8s\n", "file", "size", "build ms", "heights KB", "tree KB",
+		"bounds us", "scan us", "ray us", "march us", "hit rate", "agree");
+
+	do
+	{
+		std::string path = std::string(directory) + "\\" + findData.cFileName;
+
+		// Decode once, then time building the tree from the pixels the way the loader does.
+		Heightmap source;
+		if (!AssetLoader::loadHeightmap(path.c_str(), source))
+		{
+			Benchmark::report(report, "%-24s decode failed\n", findData.cFileName);
+			continue;
+		}
+		double start = Benchmark::seconds();
+		source.buildQuadtree();
+		double buildTime = Benchmark::seconds() - start;
+		size_t heightBytes = source.heights.capacity() * sizeof(float);
+		size_t treeBytes = source.getBytes() - heightBytes;
+
+		// Bounds of random rectangles up to a quarter of the map across. The scan reads every leaf under a few of them.
+		std::mt19937 random(1);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		std::vector<float> rectangles((size_t)rangeQueries * 4);
+		for (int i = 0; i < rangeQueries; i++)
+		{
+			float u = unit(random), v = unit(random);
+			rectangles[i * 4] = u;
+			rectangles[i * 4 + 1] = v;
+			rectangles[i * 4 + 2] = std::min(u + unit(random) * 0.25f, 1.0f);
+			rectangles[i * 4 + 3] = std::min(v + unit(random) * 0.25f, 1.0f);
+		}
+
+		start = Benchmark::seconds();
+		for (int i = 0; i < rangeQueries; i++)
+		{
+			float lowest, highest;
+			source.getRange(rectangles[i * 4], rectangles[i * 4 + 1], rectangles[i * 4 + 2], rectangles[i * 4 + 3], lowest, highest);
+		}
+		double rangeTime = (Benchmark::seconds() - start) / rangeQueries;
+
+		start = Benchmark::seconds();
+		for (int i = 0; i < scannedQueries; i++)
+		{
+			int x0 = (int)floorf(rectangles[i * 4] * source.width + 0.5f), z0 = (int)floorf(rectangles[i * 4 + 1] * source.height + 0.5f);
+			int x1 = (int)floorf(rectangles[i * 4 + 2] * source.width + 0.5f), z1 = (int)floorf(rectangles[i * 4 + 3] * source.height + 0.5f);
+			float lowest = 1.0f, highest = 0.0f;
+			for (int z = z0; z <= z1; z++)
+			{
+				for (int x = x0; x <= x1; x++)
+				{
+					float leafLowest, leafHighest;
+					source.getNodeRange(0, x, z, leafLowest, leafHighest);
+					lowest = std::min(lowest, leafLowest);
+					highest = std::max(highest, leafHighest);
+				}
+			}
+		}
+		double scanTime = (Benchmark::seconds() - start) / scannedQueries;
+
+		// Rays from above the terrain, looking down at up to 45 degrees across a map 100 units wide, like the scene's ground.
+		std::vector<XMFLOAT3> origins(rayQueries), directions(rayQueries);
+		for (int i = 0; i < rayQueries; i++)
+		{
+			origins[i] = XMFLOAT3(unit(random), amplitude * (1.0f + unit(random)), unit(random));
+			directions[i] = XMFLOAT3((unit(random) - 0.5f) * 0.02f, -1.0f, (unit(random) - 0.5f) * 0.02f);
+		}
+
+		int hits = 0;
+		std::vector<float> distances(rayQueries, -1.0f);
+		start = Benchmark::seconds();
+		for (int i = 0; i < rayQueries; i++)
+		{
+			float distance;
+			if (source.intersect(origins[i], directions[i], amplitude, 1000.0f, distance))
+			{
+				distances[i] = distance;
+				hits++;
+			}
+		}
+		double rayTime = (Benchmark::seconds() - start) / rayQueries;
+
+		// March each ray a quarter texel at a time and refine the first crossing, which can miss thin peaks the tree finds.
+		int agree = 0;
+		start = Benchmark::seconds();
+		for (int i = 0; i < scannedQueries; i++)
+		{
+			const XMFLOAT3& o = origins[i];
+			const XMFLOAT3& d = directions[i];
+			float horizontal = sqrtf(d.x * d.x * source.width * source.width + d.z * d.z * source.height * source.height);
+			float step = 0.25f / std::max(horizontal, 0.25f);
+			float previous = 0.0f, found = -1.0f;
+			for (float t = 0.0f; t <= 1000.0f; t += step)
+			{
+				float u = o.x + d.x * t, v = o.z + d.z * t;
+				if (u < 0.0f || u > 1.0f || v < 0.0f || v > 1.0f)
+				{
+					break;
+				}
+				if (o.y + d.y * t <= source.sample(u, v) * amplitude)
+				{
+					// Halve the last step a few times.
+					float low = previous, high = t;
+					for (int k = 0; k < 20; k++)
+					{
+						float middle = (low + high) * 0.5f;
+						bool below = o.y + d.y * middle <= source.sample(o.x + d.x * middle, o.z + d.z * middle) * amplitude;
+						(below ? high : low) = middle;
+					}
+					found = high;
+					break;
+				}
+				previous = t;
+			}
+			if ((found < 0.0f && distances[i] < 0.0f) || (found >= 0.0f && distances[i] >= 0.0f && fabsf(found - distances[i]) < 1e-3f * std::max(found, 1.0f)))
+			{
+				agree++;
+			}
+		}
+		double marchTime = (Benchmark::seconds() - start) / scannedQueries;
+
+		char size[32];
+		sprintf_s(size, "%dx%d", source.width, source.height);
+		Benchmark::report(report, "%-24s %11s %9.2f %11.1f %11.1f %10.3f %10.1f %10.3f %10.1f %9.1f%% %4d/%d\n", findData.cFileName, size, buildTime * 1000.0,
+			heightBytes / 1024.0, treeBytes / 1024.0, rangeTime * 1e6, scanTime * 1e6, rayTime * 1e6, marchTime * 1e6, hits * 100.0 / rayQueries, agree, scannedQueries);
+	} while (FindNextFileA(find, &findData));
+	FindClose(find);
+}
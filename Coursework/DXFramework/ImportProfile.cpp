@@ -0,0 +1,232 @@
+// Import profile
+// Maps the attributes a vertex layout reads and a per asset policy to Assimp post processing.
+#include "ImportProfile.h"
+#include "Benchmark.h"
+#include "assimp\scene.h"
+#include "assimp\postprocess.h"
+#include <windows.h>
+#include <cmath>
+#include <string>
+
+namespace
+{
+	// What AModel asked every import for before profiles. Tangents were computed and then dropped.
+	const unsigned int legacyFlags =
+		aiProcess_CalcTangentSpace |
+		aiProcess_Triangulate |
+		aiProcess_JoinIdenticalVertices |
+		aiProcess_SortByPType |
+		aiProcess_MakeLeftHanded |
+		aiProcess_FlipUVs;
+
+	// Smoothing angle used when normals are regenerated, in degrees. Sharper edges keep split normals.
+	const float regeneratedNormalAngle = 80.0f;
+
+	inline unsigned int hashValue(unsigned int hash, unsigned int value)
+	{
+		for (int i = 0; i < 4; i++)
+		{
+			hash = (hash ^ ((value >> (i * 8)) & 0xffu)) * 16777619u;
+		}
+		return hash;
+	}
+}
+
+ImportProfile::ImportProfile(unsigned int lattributes, unsigned int lpolicy)
+{
+	attributes = lattributes | AttributePosition;
+	policy = lpolicy;
+}
+
+ImportProfile ImportProfile::legacy()
+{
+	return ImportProfile(AttributePosition | AttributeTexture | AttributeNormal | AttributeTangent, PolicyLegacy);
+}
+
+unsigned int ImportProfile::getPostProcessFlags() const
+{
+	if (policy & PolicyLegacy)
+	{
+		return legacyFlags;
+	}
+
+	// Always needed: triangles only, in the framework's handedness.
+	unsigned int flags = aiProcess_Triangulate | aiProcess_SortByPType | aiProcess_MakeLeftHanded;
+
+	if (attributes & AttributeTexture)
+	{
+		flags |= aiProcess_FlipUVs;
+	}
+	// Only fills in meshes that have no normals, unless the file's normals were removed by the policy.
+	if (attributes & AttributeNormal)
+	{
+		flags |= aiProcess_GenSmoothNormals;
+	}
+	if (attributes & AttributeTangent)
+	{
+		flags |= aiProcess_CalcTangentSpace;
+	}
+	if (policy & PolicyWeld)
+	{
+		flags |= aiProcess_JoinIdenticalVertices;
+	}
+	if (policy & PolicyValidate)
+	{
+		flags |= aiProcess_ValidateDataStructure;
+	}
+	if (getRemovedComponents())
+	{
+		flags |= aiProcess_RemoveComponent;
+	}
+	return flags;
+}
+
+unsigned int ImportProfile::getRemovedComponents() const
+{
+	if (policy & PolicyLegacy)
+	{
+		return 0;
+	}
+
+	// Nothing in the framework animates, skins or reads lights, cameras or embedded textures from a model.
+	unsigned int removed = aiComponent_BONEWEIGHTS | aiComponent_ANIMATIONS | aiComponent_LIGHTS | aiComponent_CAMERAS | aiComponent_TEXTURES;
+
+	if (!(attributes & AttributeTexture))
+	{
+		removed |= aiComponent_TEXCOORDS;
+	}
+	else
+	{
+		// Only the first UV set is read. Set 7 has no flag of its own.
+		for (unsigned int set = 1; set + 25u < 32u; set++)
+		{
+			removed |= aiComponent_TEXCOORDSn(set);
+		}
+	}
+	if (!(attributes & AttributeColour))
+	{
+		removed |= aiComponent_COLORS;
+	}
+	if (!(attributes & AttributeNormal) || (policy & PolicyRegenerateNormals))
+	{
+		removed |= aiComponent_NORMALS;
+	}
+	if (!(attributes & AttributeTangent))
+	{
+		removed |= aiComponent_TANGENTS_AND_BITANGENTS;
+	}
+	return removed;
+}
+
+void ImportProfile::configure(Assimp::Importer& importer) const
+{
+	if (policy & PolicyLegacy)
+	{
+		return;
+	}
+
+	importer.SetPropertyInteger(AI_CONFIG_PP_RVC_FLAGS, (int)getRemovedComponents());
+	// Points and lines are never drawn, drop them instead of sorting them into meshes of their own.
+	importer.SetPropertyInteger(AI_CONFIG_PP_SBP_REMOVE, aiPrimitiveType_POINT | aiPrimitiveType_LINE);
+	if (policy & PolicyRegenerateNormals)
+	{
+		importer.SetPropertyFloat(AI_CONFIG_PP_GSN_MAX_SMOOTHING_ANGLE, regeneratedNormalAngle);
+	}
+}
+
+unsigned int ImportProfile::getCacheKey() const
+{
+	unsigned int hash = 2166136261u;
+	hash = hashValue(hash, getPostProcessFlags());
+	hash = hashValue(hash, getRemovedComponents());
+	hash = hashValue(hash, policy);
+	return hash;
+}
+
+void ImportProfile::benchmark(const char* directory, FILE* report)
+{
+	const int runs = 3;
+	const char* patterns[] = { "*.obj", "*.fbx" };
+
+	const char* names[] = { "legacy", "default", "position only" };
+	ImportProfile profiles[] = { legacy(), ImportProfile(), ImportProfile(AttributePosition) };
+	const int profileCount = 3;
+
+	Benchmark::report(report, "Assimp import per profile, best of %d runs\n", runs);
+	Benchmark::report(report, "%-24s %14s %14s %14s %14s %12s\n", "file", "legacy ms", "default ms", "position ms", "legacy verts", "default verts");
+
+	double totals[profileCount] = {};
+	int files = 0;
+	for (int p = 0; p < 2; p++)
+	{
+		std::string pattern = std::string(directory) + "\\" + patterns[p];
+		WIN32_FIND_DATAA findData;
+		HANDLE find = FindFirstFileA(pattern.c_str(), &findData);
+		if (find == INVALID_HANDLE_VALUE)
+		{
+			continue;
+		}
+
+		do
+		{
+			std::string path = std::string(directory) + "\\" + findData.cFileName;
+
+			double best[profileCount];
+			unsigned int vertexCounts[profileCount] = {};
+			bool failed = false;
+			for (int profile = 0; profile < profileCount && !failed; profile++)
+			{
+				best[profile] = 1e30;
+				for (int run = 0; run < runs; run++)
+				{
+					// A fresh importer each run, so every profile pays the same setup cost.
+					Assimp::Importer importer;
+					profiles[profile].configure(importer);
+
+					double start = Benchmark::seconds();
+					const aiScene* scene = importer.ReadFile(path, profiles[profile].getPostProcessFlags());
+					double time = Benchmark::seconds() - start;
+					if (!scene)
+					{
+						failed = true;
+						break;
+					}
+
+					best[profile] = fmin(best[profile], time);
+					vertexCounts[profile] = 0;
+					for (unsigned int m = 0; m < scene->mNumMeshes; m++)
+					{
+						vertexCounts[profile] += scene->mMeshes[m]->mNumVertices;
+					}
+				}
+			}
+
+			if (failed)
+			{
+				Benchmark::report(report, "%-24s import failed\n", findData.cFileName);
+				continue;
+			}
+
+			Benchmark::report(report, "%-24s %14.2f %14.2f %14.2f %14u %12u\n", findData.cFileName,
+				best[0] * 1000.0, best[1] * 1000.0, best[2] * 1000.0, vertexCounts[0], vertexCounts[1]);
+			for (int profile = 0; profile < profileCount; profile++)
+			{
+				totals[profile] += best[profile];
+			}
+			files++;
+		} while (FindNextFileA(find, &findData));
+		FindClose(find);
+	}
+
+	if (files == 0)
+	{
+		Benchmark::report(report, "Import profiles: no .obj or .fbx files in %s\n", directory);
+		return;
+	}
+
+	Benchmark::report(report, "%-24s %14.2f %14.2f %14.2f\n", "total", totals[0] * 1000.0, totals[1] * 1000.0, totals[2] * 1000.0);
+	for (int profile = 1; profile < profileCount; profile++)
+	{
+		Benchmark::report(report, "%s: %.1fx the speed of legacy\n", names[profile], totals[0] / totals[profile]);
+	}
+}
@@ -0,0 +1,72 @@
+/**
+* \class ImportProfile
+*
+* \brief Chooses the Assimp post processing for a model from the attributes its vertex layout reads
+*
+* Assimp steps cost time on every import, and several of them (tangent space, extra UV and colour sets) build data
+* the framework's vertex layouts never read. A profile lists the attributes the layout consumes and a per asset policy,
+* and turns them into post processing flags and importer settings. Attributes the layout doesn't read are stripped
+* before the expensive steps run, so vertices aren't split or compared on them either.
+*
+* The default profile matches BaseMesh::VertexType: position, one UV set and normals.
+*/
+
+
+#ifndef _IMPORTPROFILE_H_
+#define _IMPORTPROFILE_H_
+
+#include "assimp\Importer.hpp"
+#include <cstdio>
+
+class ImportProfile
+{
+public:
+	/// Vertex attributes a layout reads.
+	enum AttributeFlags
+	{
+		AttributePosition = 0x1,
+		AttributeTexture = 0x2,		///< First UV set
+		AttributeNormal = 0x4,
+		AttributeTangent = 0x8,		///< Tangents and bitangents
+		AttributeColour = 0x10,		///< First vertex colour set
+	};
+
+	/// Per asset choices.
+	enum PolicyFlags
+	{
+		PolicyWeld = 0x1,				///< Merge identical vertices, needed for an indexed mesh from OBJ and FBX
+		PolicyRegenerateNormals = 0x2,	///< Replace the file's normals with smoothed ones, for assets with broken normals
+		PolicyValidate = 0x4,			///< Check the imported scene, for assets from untrusted sources
+		PolicyLegacy = 0x8,				///< The fixed flags AModel used before profiles, attributes are ignored
+	};
+
+	ImportProfile(unsigned int attributes = AttributePosition | AttributeTexture | AttributeNormal, unsigned int policy = PolicyWeld);
+
+	/// The flags every model was imported with before profiles, tangents included.
+	static ImportProfile legacy();
+
+	unsigned int getAttributes() const { return attributes; }
+	unsigned int getPolicy() const { return policy; }
+
+	/// The aiProcess flags to pass to ReadFile().
+	unsigned int getPostProcessFlags() const;
+	/// The components aiProcess_RemoveComponent strips, 0 if none.
+	unsigned int getRemovedComponents() const;
+	/// Applies the profile's importer properties. Call before ReadFile().
+	void configure(Assimp::Importer& importer) const;
+	/// Identifies the profile's output, for MeshCache. Changes whenever the imported data would.
+	unsigned int getCacheKey() const;
+
+	/** \brief Times the Assimp import of every .obj and .fbx file in a directory under the legacy, default and position only profiles.
+	* Writes the best time of several runs and the imported vertex count for each file and profile.
+	* @param directory is the folder to search, e.g. "res"
+	* @param report is an open file to write the results to
+	*/
+	static void benchmark(const char* directory, FILE* report);
+
+private:
+	unsigned int attributes;
+	unsigned int policy;
+};
+
+#endif
@@ -0,0 +1,79 @@
+// Instance buffer
+// Per-instance world matrices, appended batch after batch.
+#include "InstanceBuffer.h"
+#include "StateCache.h"
+#include <algorithm>
+#include <cstring>
+
+InstanceBuffer::InstanceBuffer(ID3D11Device* ldevice, int lcapacity)
+{
+	device = ldevice;
+	buffer = nullptr;
+	// At least one matrix, so the buffer can be created and doubling it grows.
+	create(std::max(lcapacity, 1));
+}
+
+InstanceBuffer::~InstanceBuffer()
+{
+	if (buffer)
+	{
+		buffer->Release();
+		buffer = nullptr;
+	}
+}
+
+void InstanceBuffer::create(int lcapacity)
+{
+	if (buffer)
+	{
+		buffer->Release();
+		buffer = nullptr;
+	}
+
+	capacity = lcapacity;
+	// Full, so the first write discards.
+	used = capacity;
+
+	D3D11_BUFFER_DESC instanceBufferDesc;
+	instanceBufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+	instanceBufferDesc.ByteWidth = sizeof(XMFLOAT4X4) * capacity;
+	instanceBufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+	instanceBufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	instanceBufferDesc.MiscFlags = 0;
+	instanceBufferDesc.StructureByteStride = 0;
+	device->CreateBuffer(&instanceBufferDesc, NULL, &buffer);
+}
+
+void InstanceBuffer::write(ID3D11DeviceContext* deviceContext, const XMFLOAT4X4* worlds, int count)
+{
+	if (count > capacity)
+	{
+		int grown = capacity;
+		while (grown < count)
+		{
+			grown *= 2;
+		}
+		create(grown);
+	}
+
+	// Append while the batch fits, otherwise start again on a fresh buffer.
+	D3D11_MAP mapType = D3D11_MAP_WRITE_NO_OVERWRITE;
+	if (used + count > capacity)
+	{
+		mapType = D3D11_MAP_WRITE_DISCARD;
+		used = 0;
+	}
+
+	D3D11_MAPPED_SUBRESOURCE mappedResource;
+	if (FAILED(deviceContext->Map(buffer, 0, mapType, 0, &mappedResource)))
+	{
+		return;
+	}
+	memcpy((XMFLOAT4X4*)mappedResource.pData + used, worlds, sizeof(XMFLOAT4X4) * count);
+	deviceContext->Unmap(buffer, 0);
+
+	unsigned int stride = sizeof(XMFLOAT4X4);
+	unsigned int offset = sizeof(XMFLOAT4X4) * used;
+	StateCache::get(deviceContext)->IASetVertexBuffers(slot, 1, &buffer, &stride, &offset);
+	used += count;
+}
@@ -0,0 +1,49 @@
+/**
+* \class InstanceBuffer
+*
+* \brief Dynamic vertex buffer of per-instance world matrices, for drawing many copies of a mesh in one call
+*
+* Each batch of world matrices is appended after the previous one with D3D11_MAP_WRITE_NO_OVERWRITE, so the GPU can
+* still read earlier batches of the frame. The buffer is discarded and written from the start again when a batch
+* doesn't fit, and grows when a single batch is larger than the whole buffer.
+*
+* The matrices are bound to input slot 1, 64 bytes each, and read by the instanced vertex shaders as WORLD0 to WORLD3
+* (see BaseShader::loadInstancedVertexShader()). They are not transposed: each row of the XMMATRIX is one element.
+*/
+
+
+#ifndef _INSTANCEBUFFER_H_
+#define _INSTANCEBUFFER_H_
+
+#include <d3d11.h>
+#include <directxmath.h>
+
+using namespace DirectX;
+
+class InstanceBuffer
+{
+public:
+	static const unsigned int slot = 1;		///< Input slot the instances are bound to
+
+	/// @param capacity is the number of matrices the buffer holds before it has to be discarded, at least one
+	InstanceBuffer(ID3D11Device* device, int capacity = 4096);
+	~InstanceBuffer();
+
+	/// Copies count world matrices after the last batch and binds them to slot. Draw them with instances 0 to count - 1.
+	void write(ID3D11DeviceContext* deviceContext, const XMFLOAT4X4* worlds, int count);
+
+	int getCapacity() { return capacity; }
+
+private:
+	InstanceBuffer(const InstanceBuffer&);
+	InstanceBuffer& operator=(const InstanceBuffer&);
+
+	void create(int capacity);
+
+	ID3D11Device* device;
+	ID3D11Buffer* buffer;
+	int capacity;
+	int used;		///< Matrices written since the buffer was last discarded
+};
+
+#endif
@@ -1,5 +1,6 @@
 // Mesh.cpp
 #include "mesh.h"
+#include "StateCache.h"
 
 Mesh::Mesh(ID3D11Device* device, ID3D11DeviceContext* deviceContext, WCHAR* textureFilename)
 {
@@ -152,6 +153,8 @@ bool Mesh::InitBuffers(ID3D11Device* device)
 
 void Mesh::SendData(ID3D11DeviceContext* deviceContext)
 {
+	StateCache* stateCache = StateCache::get(deviceContext);
+
 	unsigned int stride;
 	unsigned int offset;
 
@@ -161,13 +164,13 @@ void Mesh::SendData(ID3D11DeviceContext* deviceContext)
 	offset = 0;
 
 	// Set the vertex buffer to active in the input assembler so it can be rendered.
-	deviceContext->IASetVertexBuffers(0, 1, &m_vertexBuffer, &stride, &offset);
+	stateCache->IASetVertexBuffers(0, 1, &m_vertexBuffer, &stride, &offset);
 
 	// Set the index buffer to active in the input assembler so it can be rendered.
-	deviceContext->IASetIndexBuffer(m_indexBuffer, DXGI_FORMAT_R32_UINT, 0);
+	stateCache->IASetIndexBuffer(m_indexBuffer, DXGI_FORMAT_R32_UINT, 0);
 
 	// Set the type of primitive that should be rendered from this vertex buffer, in this case triangles.
-	deviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	stateCache->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 }
 
 void Mesh::LoadTexture(ID3D11Device* device, ID3D11DeviceContext* deviceContext, WCHAR* filename)
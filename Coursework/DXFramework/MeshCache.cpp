@@ -0,0 +1,288 @@
+// Mesh cache
+// Reads and writes cooked mesh files, so imported models can skip the importer on later runs.
+#include "MeshCache.h"
+#include <cfloat>
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+	const char magic[4] = { 'M', 'E', 'S', 'H' };
+
+	// FNV-1a (64 bit) over the file, 8 bytes at a time.
+	unsigned long long hashData(const char* data, size_t size)
+	{
+		unsigned long long hash = 14695981039346656037ull;
+		size_t i = 0;
+		for (; i + 8 <= size; i += 8)
+		{
+			unsigned long long word;
+			memcpy(&word, data + i, 8);
+			hash = (hash ^ word) * 1099511628211ull;
+		}
+		for (; i < size; i++)
+		{
+			hash = (hash ^ (unsigned char)data[i]) * 1099511628211ull;
+		}
+		return hash;
+	}
+
+	inline unsigned int alignTo16(size_t offset)
+	{
+		return (unsigned int)((offset + 15) & ~(size_t)15);
+	}
+}
+
+MeshCache::MeshCache()
+{
+	header = nullptr;
+	sourceHash = 0;
+	importFlags = 0;
+	vertexStride = 0;
+}
+
+MeshCache::~MeshCache()
+{
+	close();
+}
+
+std::string MeshCache::getCachePath(const char* sourceFile, unsigned int importFlags)
+{
+	char flags[16];
+	sprintf_s(flags, ".%08x", importFlags);
+	return std::string(sourceFile) + flags + ".mesh";
+}
+
+bool MeshCache::open(const char* sourceFile, unsigned int limportFlags, unsigned int lvertexStride)
+{
+	close();
+	cachePath = getCachePath(sourceFile, limportFlags);
+	importFlags = limportFlags;
+	vertexStride = lvertexStride;
+
+	// Hash the source, so any edit to it invalidates the cooked copy.
+	MappedFile source;
+	if (!source.open(sourceFile))
+	{
+		cachePath.clear();
+		return false;
+	}
+	sourceHash = hashData(source.getData(), source.getSize());
+	source.close();
+
+	if (!file.open(cachePath.c_str()) || file.getSize() < sizeof(HeaderType))
+	{
+		file.close();
+		return false;
+	}
+
+	// Check the header matches, and the streams it describes fit in the file.
+	const HeaderType* candidate = (const HeaderType*)file.getData();
+	unsigned long long vertexEnd = (unsigned long long)candidate->vertexOffset + (unsigned long long)candidate->vertexCount * candidate->vertexStride;
+	unsigned long long indexEnd = (unsigned long long)candidate->indexOffset + (unsigned long long)candidate->indexCount * candidate->indexSize;
+	unsigned long long lodEnd = (unsigned long long)sizeof(HeaderType) + (unsigned long long)candidate->lodCount * sizeof(MeshSimplifier::LodType);
+	unsigned long long meshletEnd = lodEnd + (unsigned long long)candidate->meshletCount * sizeof(MeshletBuilder::MeshletType);
+	unsigned long long tableEnd = meshletEnd + (unsigned long long)candidate->submeshCount * (sizeof(BaseMesh::SubmeshType) + candidate->lodCount * sizeof(MeshSimplifier::LodType));
+	if (memcmp(candidate->magic, magic, sizeof(magic)) != 0 ||
+		candidate->version != version ||
+		candidate->sourceHash != sourceHash ||
+		candidate->importFlags != importFlags ||
+		candidate->vertexStride != vertexStride ||
+		candidate->indexSize != sizeof(unsigned long) ||
+		vertexEnd > file.getSize() || indexEnd > file.getSize() || tableEnd > candidate->vertexOffset ||
+		(candidate->submeshCount > 0 && candidate->lodCount == 0))
+	{
+		file.close();
+		return false;
+	}
+
+	// Every level of detail has to be a range of the index stream.
+	const MeshSimplifier::LodType* lods = (const MeshSimplifier::LodType*)((const char*)candidate + sizeof(HeaderType));
+	for (unsigned int i = 0; i < candidate->lodCount; i++)
+	{
+		if ((unsigned long long)lods[i].indexStart + lods[i].indexCount > candidate->indexCount)
+		{
+			file.close();
+			return false;
+		}
+	}
+
+	// And so does every meshlet.
+	const MeshletBuilder::MeshletType* meshlets = (const MeshletBuilder::MeshletType*)(lods + candidate->lodCount);
+	for (unsigned int i = 0; i < candidate->meshletCount; i++)
+	{
+		if ((unsigned long long)meshlets[i].indexStart + meshlets[i].indexCount > candidate->indexCount)
+		{
+			file.close();
+			return false;
+		}
+	}
+
+	// Parts have to be ranges of the streams and the meshlet table, and so do their levels.
+	const BaseMesh::SubmeshType* submeshes = (const BaseMesh::SubmeshType*)(meshlets + candidate->meshletCount);
+	const MeshSimplifier::LodType* submeshLods = (const MeshSimplifier::LodType*)(submeshes + candidate->submeshCount);
+	for (unsigned int i = 0; i < candidate->submeshCount; i++)
+	{
+		bool valid = (unsigned long long)submeshes[i].indexStart + submeshes[i].indexCount <= candidate->indexCount &&
+			submeshes[i].baseVertex >= 0 && (unsigned long long)submeshes[i].baseVertex + submeshes[i].vertexCount <= candidate->vertexCount &&
+			(unsigned long long)submeshes[i].meshletStart + submeshes[i].meshletCount <= candidate->meshletCount;
+		for (unsigned int lod = 0; valid && lod < candidate->lodCount; lod++)
+		{
+			const MeshSimplifier::LodType& level = submeshLods[lod * candidate->submeshCount + i];
+			valid = (unsigned long long)level.indexStart + level.indexCount <= candidate->indexCount;
+		}
+		if (!valid)
+		{
+			file.close();
+			return false;
+		}
+	}
+
+	header = candidate;
+	return true;
+}
+
+void MeshCache::close()
+{
+	file.close();
+	header = nullptr;
+}
+
+bool MeshCache::write(const void* vertices, unsigned int vertexCount, const unsigned long* indices, unsigned int indexCount, const MeshSimplifier::LodType* lods, unsigned int lodCount,
+	const MeshletBuilder::MeshletType* meshlets, unsigned int meshletCount, const BaseMesh::SubmeshType* submeshes, unsigned int submeshCount, const MeshSimplifier::LodType* submeshLods)
+{
+	if (cachePath.empty())
+	{
+		return false;
+	}
+
+	HeaderType newHeader;
+	memset(&newHeader, 0, sizeof(newHeader));
+	memcpy(newHeader.magic, magic, sizeof(magic));
+	newHeader.version = version;
+	newHeader.sourceHash = sourceHash;
+	newHeader.importFlags = importFlags;
+	newHeader.vertexStride = vertexStride;
+	newHeader.vertexCount = vertexCount;
+	newHeader.indexSize = sizeof(unsigned long);
+	newHeader.indexCount = indexCount;
+	newHeader.lodCount = lodCount;
+	newHeader.meshletCount = meshletCount;
+	newHeader.submeshCount = submeshCount;
+	size_t tableEnd = sizeof(newHeader) + (size_t)lodCount * sizeof(MeshSimplifier::LodType) + (size_t)meshletCount * sizeof(MeshletBuilder::MeshletType) +
+		(size_t)submeshCount * (sizeof(BaseMesh::SubmeshType) + (size_t)lodCount * sizeof(MeshSimplifier::LodType));
+	newHeader.vertexOffset = alignTo16(tableEnd);
+	newHeader.indexOffset = alignTo16(newHeader.vertexOffset + (size_t)vertexCount * vertexStride);
+
+	// Bounds of the positions, which are the first three floats of every vertex.
+	for (int axis = 0; axis < 3; axis++)
+	{
+		newHeader.boundsMin[axis] = vertexCount ? FLT_MAX : 0.0f;
+		newHeader.boundsMax[axis] = vertexCount ? -FLT_MAX : 0.0f;
+	}
+	for (unsigned int i = 0; i < vertexCount; i++)
+	{
+		float position[3];
+		memcpy(position, (const char*)vertices + (size_t)i * vertexStride, sizeof(position));
+		for (int axis = 0; axis < 3; axis++)
+		{
+			newHeader.boundsMin[axis] = position[axis] < newHeader.boundsMin[axis] ? position[axis] : newHeader.boundsMin[axis];
+			newHeader.boundsMax[axis] = position[axis] > newHeader.boundsMax[axis] ? position[axis] : newHeader.boundsMax[axis];
+		}
+	}
+
+	// Write to a temporary file and swap it in, so a failed write never leaves a half written cache behind.
+	std::string tempPath = cachePath + ".tmp";
+	FILE* out;
+	if (fopen_s(&out, tempPath.c_str(), "wb") != 0)
+	{
+		return false;
+	}
+
+	const char zeros[16] = {};
+	bool written = fwrite(&newHeader, sizeof(newHeader), 1, out) == 1;
+	written = written && fwrite(lods, sizeof(MeshSimplifier::LodType), lodCount, out) == lodCount;
+	written = written && fwrite(meshlets, sizeof(MeshletBuilder::MeshletType), meshletCount, out) == meshletCount;
+	written = written && fwrite(submeshes, sizeof(BaseMesh::SubmeshType), submeshCount, out) == submeshCount;
+	written = written && fwrite(submeshLods, sizeof(MeshSimplifier::LodType), submeshCount * lodCount, out) == submeshCount * lodCount;
+	written = written && fwrite(zeros, 1, newHeader.vertexOffset - tableEnd, out) == newHeader.vertexOffset - tableEnd;
+	written = written && fwrite(vertices, vertexStride, vertexCount, out) == vertexCount;
+	size_t vertexEnd = (size_t)newHeader.vertexOffset + (size_t)vertexCount * vertexStride;
+	written = written && fwrite(zeros, 1, newHeader.indexOffset - vertexEnd, out) == newHeader.indexOffset - vertexEnd;
+	written = written && fwrite(indices, sizeof(unsigned long), indexCount, out) == indexCount;
+	written = (fclose(out) == 0) && written;
+
+	// The existing cache may still be mapped by this object.
+	close();
+	if (!written || !MoveFileExA(tempPath.c_str(), cachePath.c_str(), MOVEFILE_REPLACE_EXISTING))
+	{
+		DeleteFileA(tempPath.c_str());
+		return false;
+	}
+	return true;
+}
+
+const void* MeshCache::getVertices() const
+{
+	return header ? (const char*)header + header->vertexOffset : nullptr;
+}
+
+const unsigned long* MeshCache::getIndices() const
+{
+	return header ? (const unsigned long*)((const char*)header + header->indexOffset) : nullptr;
+}
+
+unsigned int MeshCache::getVertexCount() const
+{
+	return header ? header->vertexCount : 0;
+}
+
+unsigned int MeshCache::getIndexCount() const
+{
+	return header ? header->indexCount : 0;
+}
+
+const MeshSimplifier::LodType* MeshCache::getLods() const
+{
+	return header ? (const MeshSimplifier::LodType*)((const char*)header + sizeof(HeaderType)) : nullptr;
+}
+
+unsigned int MeshCache::getLodCount() const
+{
+	return header ? header->lodCount : 0;
+}
+
+const MeshletBuilder::MeshletType* MeshCache::getMeshlets() const
+{
+	return header ? (const MeshletBuilder::MeshletType*)(getLods() + header->lodCount) : nullptr;
+}
+
+unsigned int MeshCache::getMeshletCount() const
+{
+	return header ? header->meshletCount : 0;
+}
+
+const BaseMesh::SubmeshType* MeshCache::getSubmeshes() const
+{
+	return header ? (const BaseMesh::SubmeshType*)(getMeshlets() + header->meshletCount) : nullptr;
+}
+
+unsigned int MeshCache::getSubmeshCount() const
+{
+	return header ? header->submeshCount : 0;
+}
+
+const MeshSimplifier::LodType* MeshCache::getSubmeshLods() const
+{
+	return header ? (const MeshSimplifier::LodType*)(getSubmeshes() + header->submeshCount) : nullptr;
+}
+
+const float* MeshCache::getBoundsMin() const
+{
+	return header ? header->boundsMin : nullptr;
+}
+
+const float* MeshCache::getBoundsMax() const
+{
+	return header ? header->boundsMax : nullptr;
+}
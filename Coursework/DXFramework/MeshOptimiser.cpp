@@ -0,0 +1,453 @@
+// Mesh optimiser
+// Vertex cache, overdraw and vertex fetch ordering for indexed triangle lists.
+#include "MeshOptimiser.h"
+#include "Benchmark.h"
+#include "ObjParser.h"
+#include "VertexWelder.h"
+#include <windows.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace
+{
+	// Forsyth's scoring constants. The LRU cache modelled while reordering is larger than the hardware FIFO on purpose.
+	const int maxCacheSize = 32;
+	const float cacheDecayPower = 1.5f;
+	const float lastTriangleScore = 0.75f;
+	const float valenceBoostScale = 2.0f;
+	const float valenceBoostPower = 0.5f;
+
+	// Cache size used to find cluster boundaries for the overdraw pass.
+	const unsigned int clusterCacheSize = 16;
+
+	float vertexScore(int cachePosition, unsigned int remainingTriangles)
+	{
+		if (remainingTriangles == 0)
+		{
+			// No triangles left to use this vertex.
+			return -1.0f;
+		}
+
+		float score = 0.0f;
+		if (cachePosition >= 0)
+		{
+			if (cachePosition < 3)
+			{
+				// Used by the last triangle, a fixed score stops the same strip being favoured forever.
+				score = lastTriangleScore;
+			}
+			else
+			{
+				score = powf(1.0f - (float)(cachePosition - 3) / (maxCacheSize - 3), cacheDecayPower);
+			}
+		}
+
+		// Boost vertices with few triangles left, so they get finished off rather than left as stragglers.
+		score += valenceBoostScale * powf((float)remainingTriangles, -valenceBoostPower);
+		return score;
+	}
+
+	// FIFO post-transform cache model. A vertex is cached if it missed within the last size misses.
+	class FifoCache
+	{
+	public:
+		FifoCache(unsigned long vertexCount, unsigned int lsize) : timestamps(vertexCount, 0), time(lsize + 1), size(lsize)
+		{
+		}
+
+		// Returns true on a miss.
+		bool access(unsigned long vertex)
+		{
+			if (time - timestamps[vertex] > size)
+			{
+				timestamps[vertex] = time++;
+				return true;
+			}
+			return false;
+		}
+
+	private:
+		std::vector<unsigned int> timestamps;
+		unsigned int time, size;
+	};
+
+	inline const float* positionOf(const void* vertices, unsigned int stride, unsigned long vertex)
+	{
+		return (const float*)((const char*)vertices + (size_t)vertex * stride);
+	}
+
+	// Centroid and unnormalised normal (length is twice the area) of one triangle.
+	void triangleGeometry(const void* vertices, unsigned int stride, const unsigned long* triangle, float centroid[3], float normal[3])
+	{
+		const float* a = positionOf(vertices, stride, triangle[0]);
+		const float* b = positionOf(vertices, stride, triangle[1]);
+		const float* c = positionOf(vertices, stride, triangle[2]);
+
+		float ab[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+		float ac[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+		normal[0] = ab[1] * ac[2] - ab[2] * ac[1];
+		normal[1] = ab[2] * ac[0] - ab[0] * ac[2];
+		normal[2] = ab[0] * ac[1] - ab[1] * ac[0];
+
+		for (int axis = 0; axis < 3; axis++)
+		{
+			centroid[axis] = (a[axis] + b[axis] + c[axis]) / 3.0f;
+		}
+	}
+
+	struct ClusterType
+	{
+		unsigned long firstTriangle, triangleCount;
+		float sortKey;
+	};
+}
+
+unsigned long MeshOptimiser::optimise(void* vertices, unsigned long vertexCount, unsigned int stride, unsigned long* indices, unsigned long indexCount)
+{
+	optimiseVertexCache(indices, indexCount, vertexCount);
+	optimiseOverdraw(indices, indexCount, vertices, vertexCount, stride);
+	return optimiseVertexFetch(vertices, vertexCount, stride, indices, indexCount);
+}
+
+void MeshOptimiser::optimiseVertexCache(unsigned long* indices, unsigned long indexCount, unsigned long vertexCount)
+{
+	const unsigned long triangleCount = indexCount / 3;
+	if (triangleCount == 0)
+	{
+		return;
+	}
+
+	// Triangles using each vertex. Each vertex's list is kept with its remaining (unemitted) triangles first.
+	std::vector<unsigned int> remaining(vertexCount, 0);
+	for (unsigned long i = 0; i < triangleCount * 3; i++)
+	{
+		remaining[indices[i]]++;
+	}
+
+	std::vector<unsigned int> adjacencyOffsets(vertexCount + 1, 0);
+	for (unsigned long v = 0; v < vertexCount; v++)
+	{
+		adjacencyOffsets[v + 1] = adjacencyOffsets[v] + remaining[v];
+	}
+
+	std::vector<unsigned int> adjacency(triangleCount * 3);
+	std::vector<unsigned int> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+	for (unsigned long t = 0; t < triangleCount; t++)
+	{
+		for (int c = 0; c < 3; c++)
+		{
+			adjacency[fill[indices[t * 3 + c]]++] = (unsigned int)t;
+		}
+	}
+
+	// Initial scores, with every vertex outside the cache.
+	std::vector<int> cachePositions(vertexCount, -1);
+	std::vector<float> vertexScores(vertexCount);
+	for (unsigned long v = 0; v < vertexCount; v++)
+	{
+		vertexScores[v] = vertexScore(-1, remaining[v]);
+	}
+
+	std::vector<float> triangleScores(triangleCount);
+	std::vector<bool> emitted(triangleCount, false);
+	long bestTriangle = -1;
+	float bestScore = -1.0f;
+	for (unsigned long t = 0; t < triangleCount; t++)
+	{
+		triangleScores[t] = vertexScores[indices[t * 3]] + vertexScores[indices[t * 3 + 1]] + vertexScores[indices[t * 3 + 2]];
+		if (triangleScores[t] > bestScore)
+		{
+			bestScore = triangleScores[t];
+			bestTriangle = (long)t;
+		}
+	}
+
+	std::vector<unsigned long> output(triangleCount * 3);
+	unsigned long cache[maxCacheSize + 3];
+	unsigned long newCache[maxCacheSize + 3];
+	int cacheCount = 0;
+	unsigned long nextInputTriangle = 0;
+
+	for (unsigned long outputTriangle = 0; outputTriangle < triangleCount; outputTriangle++)
+	{
+		if (bestTriangle < 0)
+		{
+			// Nothing in the cache connects to a remaining triangle, start again from the next one in input order.
+			while (emitted[nextInputTriangle])
+			{
+				nextInputTriangle++;
+			}
+			bestTriangle = (long)nextInputTriangle;
+		}
+
+		const unsigned long* triangle = &indices[bestTriangle * 3];
+		emitted[bestTriangle] = true;
+		output[outputTriangle * 3 + 0] = triangle[0];
+		output[outputTriangle * 3 + 1] = triangle[1];
+		output[outputTriangle * 3 + 2] = triangle[2];
+
+		// Move the emitted triangle out of its vertices' remaining lists.
+		for (int c = 0; c < 3; c++)
+		{
+			unsigned long v = triangle[c];
+			unsigned int* list = &adjacency[adjacencyOffsets[v]];
+			for (unsigned int i = 0; i < remaining[v]; i++)
+			{
+				if (list[i] == (unsigned int)bestTriangle)
+				{
+					std::swap(list[i], list[remaining[v] - 1]);
+					break;
+				}
+			}
+			remaining[v]--;
+		}
+
+		// The triangle's vertices go to the front of the LRU cache, the rest shuffle back.
+		int newCount = 0;
+		for (int c = 0; c < 3; c++)
+		{
+			newCache[newCount++] = triangle[c];
+		}
+		for (int i = 0; i < cacheCount; i++)
+		{
+			unsigned long v = cache[i];
+			if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+			{
+				newCache[newCount++] = v;
+			}
+		}
+
+		// Rescore everything that moved, including vertices pushed out the end.
+		for (int i = 0; i < newCount; i++)
+		{
+			unsigned long v = newCache[i];
+			cachePositions[v] = i < maxCacheSize ? i : -1;
+
+			float score = vertexScore(cachePositions[v], remaining[v]);
+			float delta = score - vertexScores[v];
+			vertexScores[v] = score;
+
+			const unsigned int* list = &adjacency[adjacencyOffsets[v]];
+			for (unsigned int j = 0; j < remaining[v]; j++)
+			{
+				triangleScores[list[j]] += delta;
+			}
+		}
+
+		cacheCount = newCount < maxCacheSize ? newCount : maxCacheSize;
+		memcpy(cache, newCache, cacheCount * sizeof(unsigned long));
+
+		// Next triangle is the best one touching the cache.
+		bestTriangle = -1;
+		bestScore = -1.0f;
+		for (int i = 0; i < cacheCount; i++)
+		{
+			unsigned long v = cache[i];
+			const unsigned int* list = &adjacency[adjacencyOffsets[v]];
+			for (unsigned int j = 0; j < remaining[v]; j++)
+			{
+				if (triangleScores[list[j]] > bestScore)
+				{
+					bestScore = triangleScores[list[j]];
+					bestTriangle = (long)list[j];
+				}
+			}
+		}
+	}
+
+	memcpy(indices, output.data(), output.size() * sizeof(unsigned long));
+}
+
+void MeshOptimiser::optimiseOverdraw(unsigned long* indices, unsigned long indexCount, const void* vertices, unsigned long vertexCount, unsigned int stride)
+{
+	const unsigned long triangleCount = indexCount / 3;
+	if (triangleCount < 2)
+	{
+		return;
+	}
+
+	// Cluster boundaries are where the cache restarts (every vertex of a triangle misses). Reordering whole clusters keeps
+	// the vertex cache behaviour inside each of them.
+	std::vector<ClusterType> clusters;
+	FifoCache fifo(vertexCount, clusterCacheSize);
+	for (unsigned long t = 0; t < triangleCount; t++)
+	{
+		int misses = 0;
+		for (int c = 0; c < 3; c++)
+		{
+			misses += fifo.access(indices[t * 3 + c]);
+		}
+
+		if (t == 0 || misses == 3)
+		{
+			ClusterType cluster = { t, 0, 0.0f };
+			clusters.push_back(cluster);
+		}
+		clusters.back().triangleCount++;
+	}
+
+	if (clusters.size() < 2)
+	{
+		return;
+	}
+
+	// Area weighted centroid and normal per cluster, and for the whole mesh.
+	std::vector<float> clusterCentroids(clusters.size() * 3, 0.0f), clusterNormals(clusters.size() * 3, 0.0f);
+	float meshCentroid[3] = { 0.0f, 0.0f, 0.0f };
+	float meshArea = 0.0f;
+	for (size_t i = 0; i < clusters.size(); i++)
+	{
+		float clusterArea = 0.0f;
+		for (unsigned long t = clusters[i].firstTriangle; t < clusters[i].firstTriangle + clusters[i].triangleCount; t++)
+		{
+			float centroid[3], normal[3];
+			triangleGeometry(vertices, stride, &indices[t * 3], centroid, normal);
+			float area = sqrtf(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+			for (int axis = 0; axis < 3; axis++)
+			{
+				clusterCentroids[i * 3 + axis] += centroid[axis] * area;
+				clusterNormals[i * 3 + axis] += normal[axis];
+				meshCentroid[axis] += centroid[axis] * area;
+			}
+			clusterArea += area;
+		}
+
+		for (int axis = 0; axis < 3; axis++)
+		{
+			clusterCentroids[i * 3 + axis] /= clusterArea > 0.0f ? clusterArea : 1.0f;
+		}
+		meshArea += clusterArea;
+	}
+	for (int axis = 0; axis < 3; axis++)
+	{
+		meshCentroid[axis] /= meshArea > 0.0f ? meshArea : 1.0f;
+	}
+
+	// Clusters far out from the centre and facing away from it are likely to occlude the rest, so they sort first.
+	float orientation = 0.0f;
+	for (size_t i = 0; i < clusters.size(); i++)
+	{
+		float* normal = &clusterNormals[i * 3];
+		float length = sqrtf(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+		float key = 0.0f;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			float offset = clusterCentroids[i * 3 + axis] - meshCentroid[axis];
+			key += offset * (length > 0.0f ? normal[axis] / length : 0.0f);
+			orientation += offset * normal[axis];
+		}
+		clusters[i].sortKey = key;
+	}
+
+	// The normals' sign depends on the winding convention. If they point inwards on the whole, flip the keys.
+	if (orientation < 0.0f)
+	{
+		for (size_t i = 0; i < clusters.size(); i++)
+		{
+			clusters[i].sortKey = -clusters[i].sortKey;
+		}
+	}
+
+	std::stable_sort(clusters.begin(), clusters.end(), [](const ClusterType& a, const ClusterType& b)
+	{
+		return a.sortKey > b.sortKey;
+	});
+
+	std::vector<unsigned long> output;
+	output.reserve(triangleCount * 3);
+	for (size_t i = 0; i < clusters.size(); i++)
+	{
+		const unsigned long* first = &indices[clusters[i].firstTriangle * 3];
+		output.insert(output.end(), first, first + clusters[i].triangleCount * 3);
+	}
+	memcpy(indices, output.data(), output.size() * sizeof(unsigned long));
+}
+
+unsigned long MeshOptimiser::optimiseVertexFetch(void* vertices, unsigned long vertexCount, unsigned int stride, unsigned long* indices, unsigned long indexCount)
+{
+	const unsigned long unused = 0xffffffff;
+	std::vector<unsigned long> remap(vertexCount, unused);
+	std::vector<char> reordered((size_t)vertexCount * stride);
+
+	// Number vertices by first use, dropping any that aren't referenced.
+	unsigned long nextVertex = 0;
+	for (unsigned long i = 0; i < indexCount; i++)
+	{
+		unsigned long v = indices[i];
+		if (remap[v] == unused)
+		{
+			remap[v] = nextVertex;
+			memcpy(&reordered[(size_t)nextVertex * stride], (const char*)vertices + (size_t)v * stride, stride);
+			nextVertex++;
+		}
+		indices[i] = remap[v];
+	}
+
+	memcpy(vertices, reordered.data(), (size_t)nextVertex * stride);
+	return nextVertex;
+}
+
+MeshOptimiser::StatsType MeshOptimiser::analyse(const unsigned long* indices, unsigned long indexCount, unsigned long vertexCount, unsigned int cacheSize)
+{
+	StatsType stats = { 0.0f, 0.0f };
+	if (indexCount < 3 || vertexCount == 0)
+	{
+		return stats;
+	}
+
+	FifoCache fifo(vertexCount, cacheSize);
+	unsigned long misses = 0;
+	for (unsigned long i = 0; i < indexCount; i++)
+	{
+		misses += fifo.access(indices[i]);
+	}
+
+	stats.acmr = (float)misses / (float)(indexCount / 3);
+	stats.atvr = (float)misses / (float)vertexCount;
+	return stats;
+}
+
+void MeshOptimiser::benchmark(const char* directory, FILE* report)
+{
+	std::string pattern = std::string(directory) + "\\*.obj";
+	WIN32_FIND_DATAA findData;
+	HANDLE find = FindFirstFileA(pattern.c_str(), &findData);
+	if (find == INVALID_HANDLE_VALUE)
+	{
+		Benchmark::report(report, "Mesh optimiser: no .obj files in %s\n", directory);
+		return;
+	}
+
+	Benchmark::report(report, "Mesh optimiser, 16 entry FIFO cache\n");
+	Benchmark::report(report, "%-24s %10s %10s %16s %16s %10s\n", "file", "triangles", "vertices", "ACMR before/after", "ATVR before/after", "time ms");
+
+	do
+	{
+		std::string path = std::string(directory) + "\\" + findData.cFileName;
+
+		std::vector<ObjParser::VertexType> vertices;
+		if (!ObjParser::load(path.c_str(), vertices))
+		{
+			Benchmark::report(report, "%-24s parse failed\n", findData.cFileName);
+			continue;
+		}
+
+		// Weld first, the same as the loaders, so the "before" figures are for the indexed mesh in file order.
+		std::vector<unsigned long> indices(vertices.size());
+		unsigned long vertexCount = VertexWelder::weld(vertices.data(), (unsigned long)vertices.size(), sizeof(ObjParser::VertexType), vertices.data(), indices.data());
+		unsigned long indexCount = (unsigned long)indices.size();
+
+		StatsType before = analyse(indices.data(), indexCount, vertexCount);
+		double start = Benchmark::seconds();
+		vertexCount = optimise(vertices.data(), vertexCount, sizeof(ObjParser::VertexType), indices.data(), indexCount);
+		double time = Benchmark::seconds() - start;
+		StatsType after = analyse(indices.data(), indexCount, vertexCount);
+
+		Benchmark::report(report, "%-24s %10lu %10lu %7.3f / %6.3f %7.3f / %6.3f %10.2f\n", findData.cFileName, indexCount / 3, vertexCount,
+			before.acmr, after.acmr, before.atvr, after.atvr, time * 1000.0);
+	} while (FindNextFileA(find, &findData));
+	FindClose(find);
+}
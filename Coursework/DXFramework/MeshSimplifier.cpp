@@ -0,0 +1,501 @@
+// Mesh simplifier
+// Quadric edge collapse, used to build coarser levels of detail that share the full mesh's vertices.
+#include "MeshSimplifier.h"
+#include "Benchmark.h"
+#include "MeshOptimiser.h"
+#include "ObjParser.h"
+#include "VertexWelder.h"
+#include <windows.h>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <string>
+
+namespace
+{
+	const unsigned long noVertex = ~0ul;
+
+	// Sum of squared distances to a set of planes, as a symmetric 4x4 matrix.
+	struct QuadricType
+	{
+		double a00, a11, a22, a01, a02, a12;
+		double b0, b1, b2;
+		double c;
+		double weight;
+	};
+
+	void addPlane(QuadricType& quadric, const double* normal, double distance, double weight)
+	{
+		quadric.a00 += weight * normal[0] * normal[0];
+		quadric.a11 += weight * normal[1] * normal[1];
+		quadric.a22 += weight * normal[2] * normal[2];
+		quadric.a01 += weight * normal[0] * normal[1];
+		quadric.a02 += weight * normal[0] * normal[2];
+		quadric.a12 += weight * normal[1] * normal[2];
+		quadric.b0 += weight * normal[0] * distance;
+		quadric.b1 += weight * normal[1] * distance;
+		quadric.b2 += weight * normal[2] * distance;
+		quadric.c += weight * distance * distance;
+		quadric.weight += weight;
+	}
+
+	QuadricType addQuadrics(const QuadricType& a, const QuadricType& b)
+	{
+		QuadricType sum;
+		sum.a00 = a.a00 + b.a00;
+		sum.a11 = a.a11 + b.a11;
+		sum.a22 = a.a22 + b.a22;
+		sum.a01 = a.a01 + b.a01;
+		sum.a02 = a.a02 + b.a02;
+		sum.a12 = a.a12 + b.a12;
+		sum.b0 = a.b0 + b.b0;
+		sum.b1 = a.b1 + b.b1;
+		sum.b2 = a.b2 + b.b2;
+		sum.c = a.c + b.c;
+		sum.weight = a.weight + b.weight;
+		return sum;
+	}
+
+	// Area weighted mean of the squared distances from the point to the planes.
+	double evaluate(const QuadricType& quadric, const float* point)
+	{
+		double x = point[0], y = point[1], z = point[2];
+		double result = quadric.a00 * x * x + quadric.a11 * y * y + quadric.a22 * z * z +
+			2.0 * (quadric.a01 * x * y + quadric.a02 * x * z + quadric.a12 * y * z) +
+			2.0 * (quadric.b0 * x + quadric.b1 * y + quadric.b2 * z) + quadric.c;
+		return quadric.weight > 0.0 ? fabs(result) / quadric.weight : 0.0;
+	}
+
+	void triangleNormal(const float* a, const float* b, const float* c, double* normal)
+	{
+		double e1[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+		double e2[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+		normal[0] = e1[1] * e2[2] - e1[2] * e2[1];
+		normal[1] = e1[2] * e2[0] - e1[0] * e2[2];
+		normal[2] = e1[0] * e2[1] - e1[1] * e2[0];
+	}
+
+	struct CollapseType
+	{
+		unsigned long from;		///< Vertex whose position moves
+		unsigned long to;		///< Vertex it moves onto
+		double error;
+	};
+
+	bool operator<(const CollapseType& a, const CollapseType& b)
+	{
+		return a.error < b.error;
+	}
+}
+
+unsigned long MeshSimplifier::simplify(const void* vertices, unsigned long vertexCount, unsigned int stride, const unsigned long* indices, unsigned long indexCount,
+	unsigned long targetIndexCount, float targetError, unsigned long* destination, float* resultError)
+{
+	std::vector<float> positions(vertexCount * 3);
+	for (unsigned long i = 0; i < vertexCount; i++)
+	{
+		memcpy(&positions[i * 3], (const char*)vertices + (size_t)i * stride, sizeof(float) * 3);
+	}
+
+	// Group vertices that share a position (split by normals or texture seams). remap points at the first vertex of each group,
+	// and nextWedge links each group into a ring.
+	std::vector<unsigned long> remap(vertexCount), nextWedge(vertexCount), order(vertexCount);
+	for (unsigned long i = 0; i < vertexCount; i++)
+	{
+		order[i] = i;
+	}
+	std::sort(order.begin(), order.end(), [&positions](unsigned long a, unsigned long b)
+	{
+		int compare = memcmp(&positions[a * 3], &positions[b * 3], sizeof(float) * 3);
+		return compare != 0 ? compare < 0 : a < b;
+	});
+	for (unsigned long i = 0; i < vertexCount;)
+	{
+		unsigned long end = i + 1;
+		while (end < vertexCount && memcmp(&positions[order[i] * 3], &positions[order[end] * 3], sizeof(float) * 3) == 0)
+		{
+			end++;
+		}
+		for (unsigned long j = i; j < end; j++)
+		{
+			remap[order[j]] = order[i];
+			nextWedge[order[j]] = order[j + 1 < end ? j + 1 : i];
+		}
+		i = end;
+	}
+
+	if (destination != indices)
+	{
+		memcpy(destination, indices, indexCount * sizeof(unsigned long));
+	}
+	unsigned long count = indexCount;
+
+	// Lock positions on open borders or non-manifold edges, moving those would open holes.
+	std::vector<bool> locked(vertexCount, false);
+	{
+		std::vector<unsigned long long> edges;
+		edges.reserve(count);
+		for (unsigned long i = 0; i < count; i += 3)
+		{
+			for (int e = 0; e < 3; e++)
+			{
+				unsigned long long a = remap[destination[i + e]];
+				unsigned long long b = remap[destination[i + (e + 1) % 3]];
+				edges.push_back(a < b ? (a << 32) | b : (b << 32) | a);
+			}
+		}
+		std::sort(edges.begin(), edges.end());
+		for (size_t i = 0; i < edges.size();)
+		{
+			size_t end = i + 1;
+			while (end < edges.size() && edges[end] == edges[i])
+			{
+				end++;
+			}
+			if (end - i != 2)
+			{
+				locked[(unsigned long)(edges[i] >> 32)] = true;
+				locked[(unsigned long)(edges[i] & 0xffffffffull)] = true;
+			}
+			i = end;
+		}
+	}
+
+	// Accumulate the area weighted triangle planes at each position.
+	std::vector<QuadricType> quadrics(vertexCount);
+	memset(quadrics.data(), 0, quadrics.size() * sizeof(QuadricType));
+	for (unsigned long i = 0; i < count; i += 3)
+	{
+		const float* p0 = &positions[destination[i] * 3];
+		const float* p1 = &positions[destination[i + 1] * 3];
+		const float* p2 = &positions[destination[i + 2] * 3];
+		double normal[3];
+		triangleNormal(p0, p1, p2, normal);
+		double length = sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+		if (length <= 0.0)
+		{
+			continue;
+		}
+		normal[0] /= length;
+		normal[1] /= length;
+		normal[2] /= length;
+		double distance = -(normal[0] * p0[0] + normal[1] * p0[1] + normal[2] * p0[2]);
+		for (int corner = 0; corner < 3; corner++)
+		{
+			addPlane(quadrics[remap[destination[i + corner]]], normal, distance, length * 0.5);
+		}
+	}
+
+	double errorLimit = (double)targetError * targetError;
+	double maxError = 0.0;
+
+	std::vector<unsigned long> triangleOffsets(vertexCount + 1), triangles;
+	std::vector<bool> passLocked(vertexCount), referenced(vertexCount);
+	std::vector<unsigned long> collapseTarget(vertexCount, noVertex);
+	std::vector<unsigned long> touched;
+	std::vector<CollapseType> collapses;
+
+	// Each pass picks the cheapest collapses that don't touch each other, applies them and rebuilds the triangle list.
+	while (count > targetIndexCount)
+	{
+		// Triangles around each position.
+		std::fill(triangleOffsets.begin(), triangleOffsets.end(), 0);
+		std::fill(referenced.begin(), referenced.end(), false);
+		for (unsigned long i = 0; i < count; i++)
+		{
+			triangleOffsets[remap[destination[i]] + 1]++;
+			referenced[destination[i]] = true;
+		}
+		for (unsigned long i = 0; i < vertexCount; i++)
+		{
+			triangleOffsets[i + 1] += triangleOffsets[i];
+		}
+		triangles.resize(count);
+		{
+			std::vector<unsigned long> fill(triangleOffsets.begin(), triangleOffsets.end() - 1);
+			for (unsigned long i = 0; i < count; i++)
+			{
+				triangles[fill[remap[destination[i]]]++] = i / 3;
+			}
+		}
+
+		// Cost both directions of every edge and keep the cheaper one that is allowed.
+		collapses.clear();
+		for (unsigned long i = 0; i < count; i += 3)
+		{
+			for (int e = 0; e < 3; e++)
+			{
+				unsigned long v0 = destination[i + e];
+				unsigned long v1 = destination[i + (e + 1) % 3];
+				unsigned long p0 = remap[v0];
+				unsigned long p1 = remap[v1];
+				if (p0 == p1 || (locked[p0] && locked[p1]))
+				{
+					continue;
+				}
+
+				QuadricType sum = addQuadrics(quadrics[p0], quadrics[p1]);
+				double error01 = locked[p0] ? DBL_MAX : evaluate(sum, &positions[p1 * 3]);
+				double error10 = locked[p1] ? DBL_MAX : evaluate(sum, &positions[p0 * 3]);
+
+				CollapseType collapse;
+				collapse.from = error01 <= error10 ? v0 : v1;
+				collapse.to = error01 <= error10 ? v1 : v0;
+				collapse.error = error01 <= error10 ? error01 : error10;
+				if (collapse.error <= errorLimit)
+				{
+					collapses.push_back(collapse);
+				}
+			}
+		}
+		std::sort(collapses.begin(), collapses.end());
+
+		std::fill(passLocked.begin(), passLocked.end(), false);
+		unsigned long trianglesToRemove = (count - targetIndexCount) / 3 + 1;
+		unsigned long trianglesRemoved = 0;
+		touched.clear();
+
+		for (size_t c = 0; c < collapses.size() && trianglesRemoved < trianglesToRemove; c++)
+		{
+			unsigned long p0 = remap[collapses[c].from];
+			unsigned long p1 = remap[collapses[c].to];
+			if (passLocked[p0] || passLocked[p1])
+			{
+				continue;
+			}
+
+			// Every vertex at the moving position needs a partner at the target that it shares a triangle with,
+			// otherwise the collapse would pull a texture seam across the surface.
+			bool valid = true;
+			size_t firstTouched = touched.size();
+			unsigned long wedge = p0;
+			do
+			{
+				if (referenced[wedge])
+				{
+					unsigned long target = noVertex;
+					for (unsigned long t = triangleOffsets[p0]; t < triangleOffsets[p0 + 1] && target == noVertex; t++)
+					{
+						const unsigned long* triangle = &destination[triangles[t] * 3];
+						if (triangle[0] != wedge && triangle[1] != wedge && triangle[2] != wedge)
+						{
+							continue;
+						}
+						for (int corner = 0; corner < 3; corner++)
+						{
+							if (remap[triangle[corner]] == p1)
+							{
+								target = triangle[corner];
+							}
+						}
+					}
+					if (target == noVertex)
+					{
+						valid = false;
+						break;
+					}
+					collapseTarget[wedge] = target;
+					touched.push_back(wedge);
+				}
+				wedge = nextWedge[wedge];
+			} while (wedge != p0);
+
+			// Reject collapses that would fold a remaining triangle over.
+			unsigned long removed = 0;
+			for (unsigned long t = triangleOffsets[p0]; t < triangleOffsets[p0 + 1] && valid; t++)
+			{
+				const unsigned long* triangle = &destination[triangles[t] * 3];
+				const float* corners[3];
+				const float* moved[3];
+				bool degenerate = false;
+				for (int corner = 0; corner < 3; corner++)
+				{
+					unsigned long position = remap[triangle[corner]];
+					degenerate = degenerate || position == p1;
+					corners[corner] = &positions[position * 3];
+					moved[corner] = position == p0 ? &positions[p1 * 3] : corners[corner];
+				}
+				if (degenerate)
+				{
+					removed++;
+					continue;
+				}
+
+				double before[3], after[3];
+				triangleNormal(corners[0], corners[1], corners[2], before);
+				triangleNormal(moved[0], moved[1], moved[2], after);
+				double dot = before[0] * after[0] + before[1] * after[1] + before[2] * after[2];
+				double lengths = sqrt(before[0] * before[0] + before[1] * before[1] + before[2] * before[2]) * sqrt(after[0] * after[0] + after[1] * after[1] + after[2] * after[2]);
+				valid = dot > 1e-2 * lengths;
+			}
+
+			if (!valid)
+			{
+				for (size_t i = firstTouched; i < touched.size(); i++)
+				{
+					collapseTarget[touched[i]] = noVertex;
+				}
+				touched.resize(firstTouched);
+				continue;
+			}
+
+			// Commit, and lock the neighbourhood so later collapses this pass see the geometry they were checked against.
+			quadrics[p1] = addQuadrics(quadrics[p1], quadrics[p0]);
+			maxError = std::max(maxError, collapses[c].error);
+			trianglesRemoved += removed;
+			for (unsigned long t = triangleOffsets[p0]; t < triangleOffsets[p0 + 1]; t++)
+			{
+				for (int corner = 0; corner < 3; corner++)
+				{
+					passLocked[remap[destination[triangles[t] * 3 + corner]]] = true;
+				}
+			}
+			passLocked[p0] = true;
+			passLocked[p1] = true;
+		}
+
+		if (touched.empty())
+		{
+			break;
+		}
+
+		// Apply the collapses and drop the triangles that lost an edge.
+		unsigned long written = 0;
+		for (unsigned long i = 0; i < count; i += 3)
+		{
+			unsigned long triangle[3];
+			for (int corner = 0; corner < 3; corner++)
+			{
+				unsigned long vertex = destination[i + corner];
+				triangle[corner] = collapseTarget[vertex] != noVertex ? collapseTarget[vertex] : vertex;
+			}
+			unsigned long r0 = remap[triangle[0]], r1 = remap[triangle[1]], r2 = remap[triangle[2]];
+			if (r0 == r1 || r1 == r2 || r0 == r2)
+			{
+				continue;
+			}
+			destination[written++] = triangle[0];
+			destination[written++] = triangle[1];
+			destination[written++] = triangle[2];
+		}
+		count = written;
+
+		for (size_t i = 0; i < touched.size(); i++)
+		{
+			collapseTarget[touched[i]] = noVertex;
+		}
+	}
+
+	if (resultError)
+	{
+		*resultError = (float)sqrt(maxError);
+	}
+	return count;
+}
+
+void MeshSimplifier::generateLods(const void* vertices, unsigned long vertexCount, unsigned int stride, std::vector<unsigned long>& indices, std::vector<LodType>& lods,
+	int maxLods, float reduction, float maxError)
+{
+	lods.clear();
+
+	LodType full;
+	full.indexStart = 0;
+	full.indexCount = (unsigned int)indices.size();
+	full.error = 0.0f;
+	full.padding = 0;
+	lods.push_back(full);
+
+	// The error budget is relative to the size of the mesh, so one setting suits every model.
+	float minimum[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+	float maximum[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	for (unsigned long i = 0; i < vertexCount; i++)
+	{
+		const float* position = (const float*)((const char*)vertices + (size_t)i * stride);
+		for (int axis = 0; axis < 3; axis++)
+		{
+			minimum[axis] = std::min(minimum[axis], position[axis]);
+			maximum[axis] = std::max(maximum[axis], position[axis]);
+		}
+	}
+	float radius = 0.0f;
+	for (int axis = 0; axis < 3 && vertexCount > 0; axis++)
+	{
+		radius += (maximum[axis] - minimum[axis]) * (maximum[axis] - minimum[axis]);
+	}
+	radius = sqrtf(radius) * 0.5f;
+
+	std::vector<unsigned long> simplified;
+	while ((int)lods.size() < maxLods)
+	{
+		// Simplify from the previous level, which is already most of the way there.
+		const LodType& previous = lods.back();
+		unsigned long target = (unsigned long)(previous.indexCount * reduction) / 3 * 3;
+		simplified.resize(previous.indexCount);
+		float error = 0.0f;
+		unsigned long count = simplify(vertices, vertexCount, stride, &indices[previous.indexStart], previous.indexCount, target, maxError * radius, simplified.data(), &error);
+
+		// Out of error budget, a level this close to the last isn't worth a draw call's worth of memory.
+		if (count == 0 || count > previous.indexCount - previous.indexCount / 10)
+		{
+			break;
+		}
+
+		MeshOptimiser::optimiseVertexCache(simplified.data(), count, vertexCount);
+
+		LodType lod;
+		lod.indexStart = (unsigned int)indices.size();
+		lod.indexCount = (unsigned int)count;
+		lod.error = std::max(error, previous.error);
+		lod.padding = 0;
+		indices.insert(indices.end(), simplified.begin(), simplified.begin() + count);
+		lods.push_back(lod);
+	}
+}
+
+void MeshSimplifier::benchmark(const char* directory, FILE* report)
+{
+	std::string pattern = std::string(directory) + "\\*.obj";
+	WIN32_FIND_DATAA findData;
+	HANDLE find = FindFirstFileA(pattern.c_str(), &findData);
+	if (find == INVALID_HANDLE_VALUE)
+	{
+		Benchmark::report(report, "Mesh simplifier: no .obj files in %s\n", directory);
+		return;
+	}
+
+	Benchmark::report(report, "Mesh simplifier, up to 4 levels at half the triangles each, 2%% error budget\n");
+	Benchmark::report(report, "%-24s %10s %40s %10s\n", "file", "vertices", "triangles (error) per level", "time ms");
+
+	do
+	{
+		std::string path = std::string(directory) + "\\" + findData.cFileName;
+
+		std::vector<ObjParser::VertexType> vertices;
+		if (!ObjParser::load(path.c_str(), vertices))
+		{
+			Benchmark::report(report, "%-24s parse failed\n", findData.cFileName);
+			continue;
+		}
+
+		// Weld first, the same as the loaders.
+		std::vector<unsigned long> indices(vertices.size());
+		unsigned long vertexCount = VertexWelder::weld(vertices.data(), (unsigned long)vertices.size(), sizeof(ObjParser::VertexType), vertices.data(), indices.data());
+
+		std::vector<LodType> lods;
+		double start = Benchmark::seconds();
+		generateLods(vertices.data(), vertexCount, sizeof(ObjParser::VertexType), indices, lods);
+		double time = Benchmark::seconds() - start;
+
+		std::string levels;
+		for (size_t i = 0; i < lods.size(); i++)
+		{
+			char level[64];
+			sprintf_s(level, "%s%u (%.4f)", i ? ", " : "", lods[i].indexCount / 3, lods[i].error);
+			levels += level;
+		}
+
+		Benchmark::report(report, "%-24s %10lu %40s %10.2f\n", findData.cFileName, vertexCount, levels.c_str(), time * 1000.0);
+	} while (FindNextFileA(find, &findData));
+	FindClose(find);
+}
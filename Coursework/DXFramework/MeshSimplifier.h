@@ -0,0 +1,63 @@
+/**
+* \class Mesh Simplifier
+*
+* \brief Builds levels of detail for indexed triangle lists by quadric edge collapse
+*
+* Each vertex position accumulates the planes of the triangles around it (Garland and Heckbert quadrics).
+* Collapsing an edge moves one end onto the other, so the coarser levels only need a new index buffer and share the vertices of the full mesh.
+* Vertices on open borders are kept, and positions split by texture seams only collapse along the seam, so neither opens cracks.
+*
+* Vertices are treated as opaque blocks of stride bytes, with the position in the first three floats.
+*/
+
+
+#ifndef _MESHSIMPLIFIER_H_
+#define _MESHSIMPLIFIER_H_
+
+#include <cstdio>
+#include <vector>
+
+class MeshSimplifier
+{
+public:
+	/// One level of detail, a range of a combined index buffer.
+	struct LodType
+	{
+		unsigned int indexStart;
+		unsigned int indexCount;
+		float error;				///< Approximate distance from the full mesh, in model space units
+		unsigned int padding;
+	};
+
+	/** \brief Collapses edges until the index count or error target is reached.
+	* @param vertices is the vertex array, which isn't changed
+	* @param vertexCount is the number of vertices
+	* @param stride is the size of one vertex in bytes
+	* @param indices is the triangle list to simplify
+	* @param indexCount is the number of indices
+	* @param targetIndexCount stops collapsing once the result has this many indices or fewer
+	* @param targetError is the largest error, in model space units, a collapse may introduce
+	* @param destination receives the simplified triangle list, up to indexCount indices. May be the same array as indices.
+	* @param resultError receives the error of the result, if not null
+	* @return the number of indices written to destination
+	*/
+	static unsigned long simplify(const void* vertices, unsigned long vertexCount, unsigned int stride, const unsigned long* indices, unsigned long indexCount,
+		unsigned long targetIndexCount, float targetError, unsigned long* destination, float* resultError);
+
+	/** \brief Appends coarser levels of detail to an index buffer.
+	* The existing indices become level 0. Each further level aims for reduction times the triangles of the one before,
+	* and generation stops early once the error budget stops it making progress.
+	* @param indices is the full detail triangle list, the levels are appended to it
+	* @param lods receives the range and error of each level, including level 0
+	* @param maxLods is the most levels to produce, including level 0
+	* @param reduction is the fraction of triangles each level keeps
+	* @param maxError is the error budget, as a fraction of the mesh's bounding radius
+	*/
+	static void generateLods(const void* vertices, unsigned long vertexCount, unsigned int stride, std::vector<unsigned long>& indices, std::vector<LodType>& lods,
+		int maxLods = 4, float reduction = 0.5f, float maxError = 0.02f);
+
+	/// Builds the levels of every .obj in directory and writes the triangle counts, errors and times to the report.
+	static void benchmark(const char* directory, FILE* report);
+};
+
+#endif
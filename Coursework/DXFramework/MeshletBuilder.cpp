@@ -0,0 +1,454 @@
+// Meshlet builder
+// Groups neighbouring triangles into small clusters with bounds, so hidden parts of a mesh can be skipped per view.
+#include "MeshletBuilder.h"
+#include "Benchmark.h"
+#include "ObjParser.h"
+#include "VertexWelder.h"
+#include <windows.h>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <string>
+
+namespace
+{
+	const float* positionAt(const void* vertices, unsigned long index, unsigned int stride)
+	{
+		return (const float*)((const char*)vertices + (size_t)index * stride);
+	}
+
+	float dot(const float* a, const float* b)
+	{
+		return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+	}
+
+	// Unit normal of a triangle's front face, false if it has no area.
+	// The framework is left handed and draws counter-clockwise triangles as front faces (see D3D::createDefaultRasterState()),
+	// so the front is on the side of (c - a) x (b - a), not (b - a) x (c - a).
+	bool triangleNormal(const float* a, const float* b, const float* c, float* normal)
+	{
+		float e1[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+		float e2[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+		normal[0] = e1[1] * e2[2] - e1[2] * e2[1];
+		normal[1] = e1[2] * e2[0] - e1[0] * e2[2];
+		normal[2] = e1[0] * e2[1] - e1[1] * e2[0];
+
+		float length = sqrtf(dot(normal, normal));
+		if (length <= 0.0f)
+		{
+			return false;
+		}
+		normal[0] /= length;
+		normal[1] /= length;
+		normal[2] /= length;
+		return true;
+	}
+
+	// Fills in the bounding sphere and normal cone of a finished meshlet.
+	void computeBounds(const void* vertices, unsigned int stride, const unsigned long* indices, MeshletBuilder::MeshletType& meshlet)
+	{
+		const unsigned long* triangles = indices + meshlet.indexStart;
+
+		// Sphere around the box of the positions.
+		float minimum[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+		float maximum[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		for (unsigned int i = 0; i < meshlet.indexCount; i++)
+		{
+			const float* position = positionAt(vertices, triangles[i], stride);
+			for (int axis = 0; axis < 3; axis++)
+			{
+				minimum[axis] = std::min(minimum[axis], position[axis]);
+				maximum[axis] = std::max(maximum[axis], position[axis]);
+			}
+		}
+		float radiusSquared = 0.0f;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			meshlet.centre[axis] = (minimum[axis] + maximum[axis]) * 0.5f;
+		}
+		for (unsigned int i = 0; i < meshlet.indexCount; i++)
+		{
+			const float* position = positionAt(vertices, triangles[i], stride);
+			float offset[3] = { position[0] - meshlet.centre[0], position[1] - meshlet.centre[1], position[2] - meshlet.centre[2] };
+			radiusSquared = std::max(radiusSquared, dot(offset, offset));
+		}
+		meshlet.radius = sqrtf(radiusSquared);
+
+		// The cone axis is the mean of the face normals, and the cone is as wide as the normal furthest from it.
+		std::vector<float> normals(meshlet.indexCount);
+		float axis[3] = { 0.0f, 0.0f, 0.0f };
+		unsigned int faces = 0;
+		for (unsigned int i = 0; i < meshlet.indexCount; i += 3)
+		{
+			float* normal = &normals[i];
+			if (triangleNormal(positionAt(vertices, triangles[i], stride), positionAt(vertices, triangles[i + 1], stride), positionAt(vertices, triangles[i + 2], stride), normal))
+			{
+				axis[0] += normal[0];
+				axis[1] += normal[1];
+				axis[2] += normal[2];
+				faces++;
+			}
+			else
+			{
+				normal[0] = normal[1] = normal[2] = 0.0f;
+			}
+		}
+
+		meshlet.coneApex[0] = meshlet.centre[0];
+		meshlet.coneApex[1] = meshlet.centre[1];
+		meshlet.coneApex[2] = meshlet.centre[2];
+		meshlet.coneAxis[0] = 0.0f;
+		meshlet.coneAxis[1] = 0.0f;
+		meshlet.coneAxis[2] = 1.0f;
+		meshlet.coneCutoff = 1.0f;
+
+		float length = sqrtf(dot(axis, axis));
+		if (faces == 0 || length <= 0.0f)
+		{
+			return;
+		}
+		axis[0] /= length;
+		axis[1] /= length;
+		axis[2] /= length;
+
+		float minimumDot = 1.0f;
+		for (unsigned int i = 0; i < meshlet.indexCount; i += 3)
+		{
+			if (normals[i] != 0.0f || normals[i + 1] != 0.0f || normals[i + 2] != 0.0f)
+			{
+				minimumDot = std::min(minimumDot, dot(axis, &normals[i]));
+			}
+		}
+
+		// Close to a hemisphere of normals, some triangle always faces the viewer.
+		if (minimumDot <= 0.1f)
+		{
+			return;
+		}
+
+		// Move the apex back along the axis until it is behind every triangle's plane, on the side their back faces show to.
+		float furthest = 0.0f;
+		for (unsigned int i = 0; i < meshlet.indexCount; i += 3)
+		{
+			const float* normal = &normals[i];
+			float denominator = dot(axis, normal);
+			if (denominator <= 0.0f)
+			{
+				continue;
+			}
+			const float* corner = positionAt(vertices, triangles[i], stride);
+			float toCentre[3] = { meshlet.centre[0] - corner[0], meshlet.centre[1] - corner[1], meshlet.centre[2] - corner[2] };
+			furthest = std::max(furthest, dot(toCentre, normal) / denominator);
+		}
+
+		for (int i = 0; i < 3; i++)
+		{
+			meshlet.coneApex[i] = meshlet.centre[i] - axis[i] * furthest;
+			meshlet.coneAxis[i] = axis[i];
+		}
+		meshlet.coneCutoff = sqrtf(1.0f - minimumDot * minimumDot);
+	}
+}
+
+void MeshletBuilder::build(const void* vertices, unsigned long vertexCount, unsigned int stride, unsigned long* indices, unsigned long indexCount, std::vector<MeshletType>& meshlets)
+{
+	unsigned long triangleCount = indexCount / 3;
+	meshlets.clear();
+	if (triangleCount == 0)
+	{
+		return;
+	}
+
+	// Neighbours are found through shared positions rather than shared vertices, so faceted meshes with split normals still grow.
+	std::vector<float> positions(vertexCount * 3);
+	for (unsigned long v = 0; v < vertexCount; v++)
+	{
+		std::copy(positionAt(vertices, v, stride), positionAt(vertices, v, stride) + 3, &positions[v * 3]);
+	}
+	std::vector<unsigned long> positionIndex(vertexCount);
+	unsigned long positionCount = VertexWelder::weld(positions.data(), vertexCount, sizeof(float) * 3, positions.data(), positionIndex.data());
+
+	// Triangles around each position, packed into one array.
+	std::vector<unsigned long> adjacencyStart(positionCount + 1, 0);
+	for (unsigned long i = 0; i < triangleCount * 3; i++)
+	{
+		adjacencyStart[positionIndex[indices[i]] + 1]++;
+	}
+	for (unsigned long p = 0; p < positionCount; p++)
+	{
+		adjacencyStart[p + 1] += adjacencyStart[p];
+	}
+	std::vector<unsigned long> adjacency(triangleCount * 3);
+	std::vector<unsigned long> fill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+	for (unsigned long i = 0; i < triangleCount * 3; i++)
+	{
+		adjacency[fill[positionIndex[indices[i]]]++] = i / 3;
+	}
+
+	// Triangle centres, to keep each meshlet compact.
+	std::vector<float> centres(triangleCount * 3);
+	for (unsigned long t = 0; t < triangleCount; t++)
+	{
+		for (int corner = 0; corner < 3; corner++)
+		{
+			const float* position = positionAt(vertices, indices[t * 3 + corner], stride);
+			for (int axis = 0; axis < 3; axis++)
+			{
+				centres[t * 3 + axis] += position[axis] / 3.0f;
+			}
+		}
+	}
+
+	std::vector<unsigned long> result;
+	result.reserve(triangleCount * 3);
+	std::vector<bool> emitted(triangleCount, false);
+	std::vector<unsigned int> vertexMeshlet(vertexCount, 0);	// Meshlet number plus one, for vertices in the current meshlet
+	std::vector<unsigned long> candidates;
+	unsigned long seed = 0;
+
+	while (result.size() < triangleCount * 3)
+	{
+		MeshletType meshlet = {};
+		meshlet.indexStart = (unsigned int)result.size();
+		unsigned int mark = (unsigned int)meshlets.size() + 1;
+		float centre[3] = { 0.0f, 0.0f, 0.0f };
+
+		// Start from a triangle next to the last meshlet if one is left, so neighbouring meshlets sit next to each other in the buffer.
+		unsigned long next = ~0ul;
+		for (size_t i = 0; i < candidates.size() && next == ~0ul; i++)
+		{
+			if (!emitted[candidates[i]])
+			{
+				next = candidates[i];
+			}
+		}
+		if (next == ~0ul)
+		{
+			while (emitted[seed])
+			{
+				seed++;
+			}
+			next = seed;
+		}
+		candidates.clear();
+
+		while (next != ~0ul)
+		{
+			// Add the triangle and queue the unused triangles around its new vertices.
+			emitted[next] = true;
+			for (int corner = 0; corner < 3; corner++)
+			{
+				unsigned long vertex = indices[next * 3 + corner];
+				result.push_back(vertex);
+				if (vertexMeshlet[vertex] != mark)
+				{
+					vertexMeshlet[vertex] = mark;
+					meshlet.vertexCount++;
+					unsigned long position = positionIndex[vertex];
+					for (unsigned long a = adjacencyStart[position]; a < adjacencyStart[position + 1]; a++)
+					{
+						if (!emitted[adjacency[a]])
+						{
+							candidates.push_back(adjacency[a]);
+						}
+					}
+				}
+			}
+			meshlet.indexCount += 3;
+			float count = (float)(meshlet.indexCount / 3);
+			for (int axis = 0; axis < 3; axis++)
+			{
+				centre[axis] += (centres[next * 3 + axis] - centre[axis]) / count;
+			}
+
+			if (meshlet.indexCount / 3 >= maxTriangles)
+			{
+				break;
+			}
+
+			// Prefer the neighbour adding the fewest vertices, then the one closest to the meshlet's centre.
+			next = ~0ul;
+			unsigned int bestNew = 4;
+			float bestDistance = FLT_MAX;
+			for (size_t i = 0; i < candidates.size();)
+			{
+				unsigned long triangle = candidates[i];
+				if (emitted[triangle])
+				{
+					candidates[i] = candidates.back();
+					candidates.pop_back();
+					continue;
+				}
+				i++;
+
+				unsigned int added = 0;
+				for (int corner = 0; corner < 3; corner++)
+				{
+					added += vertexMeshlet[indices[triangle * 3 + corner]] != mark ? 1 : 0;
+				}
+				if (meshlet.vertexCount + added > maxVertices || added > bestNew)
+				{
+					continue;
+				}
+
+				float offset[3] = { centres[triangle * 3] - centre[0], centres[triangle * 3 + 1] - centre[1], centres[triangle * 3 + 2] - centre[2] };
+				float distance = dot(offset, offset);
+				if (added < bestNew || distance < bestDistance)
+				{
+					next = triangle;
+					bestNew = added;
+					bestDistance = distance;
+				}
+			}
+		}
+
+		meshlets.push_back(meshlet);
+	}
+
+	std::copy(result.begin(), result.end(), indices);
+
+	for (size_t i = 0; i < meshlets.size(); i++)
+	{
+		computeBounds(vertices, stride, indices, meshlets[i]);
+	}
+}
+
+unsigned int MeshletBuilder::cull(const MeshletType* meshlets, unsigned int meshletCount, const XMFLOAT4* planes, const XMFLOAT4& viewer, float displacementY, std::vector<RangeType>& ranges,
+	int baseVertex)
+{
+	unsigned int visible = 0;
+	float lift = displacementY * 0.5f;
+
+	for (unsigned int i = 0; i < meshletCount; i++)
+	{
+		const MeshletType& meshlet = meshlets[i];
+
+		// Displacement moves the geometry up by up to displacementY, so grow the sphere to cover the whole range.
+		float centre[3] = { meshlet.centre[0], meshlet.centre[1] + lift, meshlet.centre[2] };
+		float radius = meshlet.radius + fabsf(lift);
+
+		bool inside = true;
+		for (int p = 0; p < 6 && inside; p++)
+		{
+			inside = planes[p].x * centre[0] + planes[p].y * centre[1] + planes[p].z * centre[2] + planes[p].w >= -radius;
+		}
+		if (!inside)
+		{
+			continue;
+		}
+
+		// Every triangle faces away if the view direction at the apex lies within the cone.
+		if (displacementY == 0.0f && meshlet.coneCutoff < 1.0f)
+		{
+			float direction[3] = { viewer.x, viewer.y, viewer.z };
+			if (viewer.w != 0.0f)
+			{
+				direction[0] = meshlet.coneApex[0] - viewer.x;
+				direction[1] = meshlet.coneApex[1] - viewer.y;
+				direction[2] = meshlet.coneApex[2] - viewer.z;
+			}
+			float length = sqrtf(dot(direction, direction));
+			if (length > 0.0f && dot(direction, meshlet.coneAxis) >= meshlet.coneCutoff * length)
+			{
+				continue;
+			}
+		}
+
+		// Merge with the previous range when they touch, fewer draws for the same triangles.
+		if (!ranges.empty() && ranges.back().indexStart + ranges.back().indexCount == meshlet.indexStart && ranges.back().baseVertex == baseVertex)
+		{
+			ranges.back().indexCount += meshlet.indexCount;
+		}
+		else
+		{
+			RangeType range = { meshlet.indexStart, meshlet.indexCount, baseVertex };
+			ranges.push_back(range);
+		}
+		visible++;
+	}
+
+	return visible;
+}
+
+void MeshletBuilder::benchmark(const char* directory, FILE* report)
+{
+	std::string pattern = std::string(directory) + "\\*.obj";
+	WIN32_FIND_DATAA findData;
+	HANDLE find = FindFirstFileA(pattern.c_str(), &findData);
+	if (find == INVALID_HANDLE_VALUE)
+	{
+		Benchmark::report(report, "Meshlet builder: no .obj files in %s\n", directory);
+		return;
+	}
+
+	// Looking along each axis from outside the bounds, with an orthographic view, so only the normal cones reject anything.
+	const float views[6][3] = { { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 } };
+	const XMFLOAT4 everywhere[6] = {};
+
+	Benchmark::report(report, "Meshlet builder, up to %u vertices and %u triangles per meshlet\n", maxVertices, maxTriangles);
+	Benchmark::report(report, "%-24s %10s %10s %14s %14s %18s %10s %8s\n", "file", "triangles", "meshlets", "avg vertices", "avg triangles", "cone culled avg %", "time ms",
+		"errors");
+
+	do
+	{
+		std::string path = std::string(directory) + "\\" + findData.cFileName;
+
+		std::vector<ObjParser::VertexType> vertices;
+		if (!ObjParser::load(path.c_str(), vertices))
+		{
+			Benchmark::report(report, "%-24s parse failed\n", findData.cFileName);
+			continue;
+		}
+
+		// Weld first, the same as the loaders.
+		std::vector<unsigned long> indices(vertices.size());
+		unsigned long vertexCount = VertexWelder::weld(vertices.data(), (unsigned long)vertices.size(), sizeof(ObjParser::VertexType), vertices.data(), indices.data());
+
+		std::vector<MeshletType> meshlets;
+		double start = Benchmark::seconds();
+		build(vertices.data(), vertexCount, sizeof(ObjParser::VertexType), indices.data(), (unsigned long)indices.size(), meshlets);
+		double time = Benchmark::seconds() - start;
+
+		unsigned long meshletVertices = 0;
+		for (size_t i = 0; i < meshlets.size(); i++)
+		{
+			meshletVertices += meshlets[i].vertexCount;
+		}
+
+		// Triangles the cones reject, averaged over the six views.
+		// Any rejected triangle whose front face points back along the view would have been drawn, and is an error.
+		unsigned long culledTriangles = 0;
+		unsigned long errors = 0;
+		for (int v = 0; v < 6; v++)
+		{
+			std::vector<RangeType> ranges;
+			cull(meshlets.data(), (unsigned int)meshlets.size(), everywhere, XMFLOAT4(views[v][0], views[v][1], views[v][2], 0.0f), 0.0f, ranges);
+			std::vector<bool> drawn(indices.size() / 3, false);
+			for (size_t r = 0; r < ranges.size(); r++)
+			{
+				std::fill(drawn.begin() + ranges[r].indexStart / 3, drawn.begin() + (ranges[r].indexStart + ranges[r].indexCount) / 3, true);
+			}
+			for (size_t t = 0; t < drawn.size(); t++)
+			{
+				if (drawn[t])
+				{
+					continue;
+				}
+				culledTriangles++;
+
+				float normal[3];
+				if (triangleNormal(positionAt(vertices.data(), indices[t * 3], sizeof(ObjParser::VertexType)), positionAt(vertices.data(), indices[t * 3 + 1], sizeof(ObjParser::VertexType)),
+					positionAt(vertices.data(), indices[t * 3 + 2], sizeof(ObjParser::VertexType)), normal) && dot(views[v], normal) < -1e-4f)
+				{
+					errors++;
+				}
+			}
+		}
+
+		size_t count = std::max<size_t>(meshlets.size(), 1);
+		const char* note = errors > 0 ? "FRONT FACES CULLED" : "";
+		Benchmark::report(report, "%-24s %10lu %10u %14.1f %14.1f %18.1f %10.2f %8lu %s\n", findData.cFileName, (unsigned long)(indices.size() / 3), (unsigned int)meshlets.size(),
+			(double)meshletVertices / count, indices.size() / 3.0 / count, 100.0 * culledTriangles / (6.0 * std::max<size_t>(indices.size() / 3, 1)), time * 1000.0, errors, note);
+	} while (FindNextFileA(find, &findData));
+	FindClose(find);
+}
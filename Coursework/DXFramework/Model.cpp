@@ -1,83 +1,111 @@
 // Model mesh and load
 // Loads a .obj and creates a mesh object from the data
 #include "model.h"
+#include "VertexWelder.h"
+#include "MeshOptimiser.h"
+#include "MeshSimplifier.h"
+
+// Identifies how this loader cooks meshes (z flipped, welded). Part of the cooked mesh key, change it if that processing changes.
+const unsigned int Model::importFlags = 1;
 
 // load model datat, initialise buffers (with model data) and load texture.
-Model::Model(ID3D11Device* device, ID3D11DeviceContext* deviceContext, const char* filename)
+Model::Model(ID3D11Device* device, ID3D11DeviceContext* deviceContext, const char* filename, bool quantise, bool lkeepCpuMesh) : file(filename)
 {
-	loadModel(filename);
+	quantised = quantise;
+	keepCpuMesh = lkeepCpuMesh;
+	load(filename);
 	initBuffers(device);
 }
 
+// Load and cook the model data only. The buffers are created later by createBuffers().
+Model::Model(const char* filename, bool quantise, bool lkeepCpuMesh) : file(filename)
+{
+	quantised = quantise;
+	keepCpuMesh = lkeepCpuMesh;
+	load(filename);
+}
+
 // Release resources.
 Model::~Model()
 {
-	// Run parent deconstructor
-	BaseMesh::~BaseMesh();
+	// BaseMesh's destructor runs after this one and releases the buffers.
+}
+
+void Model::createBuffers(ID3D11Device* device)
+{
+	initBuffers(device);
+}
 
-	if (model)
+// Use the cooked mesh if it is up to date, otherwise parse the OBJ and cook it for next time.
+void Model::load(const char* filename)
+{
+	if (cache.open(filename, importFlags, sizeof(VertexType)))
+	{
+		vertexCount = (int)cache.getVertexCount();
+		lods.assign(cache.getLods(), cache.getLods() + cache.getLodCount());
+		meshlets.assign(cache.getMeshlets(), cache.getMeshlets() + cache.getMeshletCount());
+		indexCount = lods.empty() ? (int)cache.getIndexCount() : (int)lods[0].indexCount;
+	}
+	else
 	{
-		delete[] model;
-		model = 0;
+		loadModel(filename);
+		cookModel();
+		VertexWelder::report(filename, indexCount, vertexCount);
 	}
 }
 
-
-// Initialise buffers with model data.
-void Model::initBuffers(ID3D11Device* device)
+// Build the indexed mesh from the parsed triangles and save it in the cooked mesh.
+void Model::cookModel()
 {
-	VertexType* vertices;
-	unsigned long* indices;
-	D3D11_BUFFER_DESC vertexBufferDesc, indexBufferDesc;
-	D3D11_SUBRESOURCE_DATA vertexData, indexData;
-		
-	vertices = new VertexType[vertexCount];
-	indices = new unsigned long[indexCount];
-	
+	vertices.resize(vertexCount);
+	indices.resize(indexCount);
+
 	// Load the vertex array and index array with data.
 	for (int i = 0; i<vertexCount; i++)
 	{
 		vertices[i].position = XMFLOAT3(model[i].x, model[i].y, -model[i].z);
 		vertices[i].texture = XMFLOAT2(model[i].tu, model[i].tv);
 		vertices[i].normal = XMFLOAT3(model[i].nx, model[i].ny, -model[i].nz);
-
-		indices[i] = i;
 	}
+	std::vector<ModelType>().swap(model);
 
-	// Set up the description of the static vertex buffer.
-	vertexBufferDesc.Usage = D3D11_USAGE_DEFAULT;
-	vertexBufferDesc.ByteWidth = sizeof(VertexType)* vertexCount;
-	vertexBufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-	vertexBufferDesc.CPUAccessFlags = 0;
-	vertexBufferDesc.MiscFlags = 0;
-	vertexBufferDesc.StructureByteStride = 0;
-	// Give the subresource structure a pointer to the vertex data.
-	vertexData.pSysMem = vertices;
-	vertexData.SysMemPitch = 0;
-	vertexData.SysMemSlicePitch = 0;
-	// Now create the vertex buffer.
-	device->CreateBuffer(&vertexBufferDesc, &vertexData, &vertexBuffer);
+	// Merge corners shared between triangles, so each unique vertex is stored (and transformed) once.
+	vertexCount = VertexWelder::weld(vertices.data(), vertexCount, sizeof(VertexType), vertices.data(), indices.data());
 
-	// Set up the description of the static index buffer.
-	indexBufferDesc.Usage = D3D11_USAGE_DEFAULT;
-	indexBufferDesc.ByteWidth = sizeof(unsigned long)* indexCount;
-	indexBufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
-	indexBufferDesc.CPUAccessFlags = 0;
-	indexBufferDesc.MiscFlags = 0;
-	indexBufferDesc.StructureByteStride = 0;
-	// Give the subresource structure a pointer to the index data.
-	indexData.pSysMem = indices;
-	indexData.SysMemPitch = 0;
-	indexData.SysMemSlicePitch = 0;
-	// Create the index buffer.
-	device->CreateBuffer(&indexBufferDesc, &indexData, &indexBuffer);
-	
-	// Release the arrays now that the vertex and index buffers have been created and loaded.
-	delete[] vertices;
-	vertices = 0;
+	// Reorder for the vertex cache, overdraw and vertex fetch. Saved in the cooked mesh, so this only runs on import.
+	vertexCount = MeshOptimiser::optimise(vertices.data(), vertexCount, sizeof(VertexType), indices.data(), indexCount);
+	vertices.resize(vertexCount);
+
+	// Split the full detail triangles into meshlets, so views can skip the parts they can't see.
+	buildMeshlets(vertices.data(), indices.data());
+
+	// Append coarser levels of detail for distant and shadow map draws. They share the vertices of level 0.
+	MeshSimplifier::generateLods(vertices.data(), vertexCount, sizeof(VertexType), indices, lods);
+
+	// The cooked mesh keeps full precision floats, quantising happens on upload.
+	cache.write(vertices.data(), vertexCount, indices.data(), (unsigned int)indices.size(), lods.data(), (unsigned int)lods.size(), meshlets.data(), (unsigned int)meshlets.size());
+}
+
+// Initialise buffers with model data, from the cooked mesh or the arrays cookModel() built. The key keeps the copy apart from AModel imports of the same file.
+void Model::initBuffers(ID3D11Device* device)
+{
+	if (cache.getVertices())
+	{
+		createVertexBuffer(device, (const VertexType*)cache.getVertices());
+		createIndexBuffer(device, cache.getIndices());
+		retainCpuMesh(file + "|obj", (const VertexType*)cache.getVertices(), cache.getIndices());
+	}
+	else
+	{
+		createVertexBuffer(device, vertices.data());
+		createIndexBuffer(device, indices.data());
+		retainCpuMesh(file + "|obj", vertices.data(), indices.data());
+	}
+	cache.close();
 
-	delete[] indices;
-	indices = 0;
+	// Release the arrays now that the vertex and index buffers have been created and loaded.
+	std::vector<VertexType>().swap(vertices);
+	std::vector<unsigned long>().swap(indices);
 }
 
 //// Read model file and parse data.
@@ -221,104 +249,14 @@ void Model::initBuffers(ID3D11Device* device)
 //	faces.clear();
 //}
 
-// Modified from a mulit-threaded version by Mark Ropper (CGT).
+// Parse the file in place from a memory mapped view, see ObjParser.
 void Model::loadModel(const char* filename)
 {
-	std::vector<XMFLOAT3> verts;
-	std::vector<XMFLOAT3> norms;
-	std::vector<XMFLOAT2> texCs;
-	std::vector<unsigned int> faces;
-
-	FILE* file;// = fopen(filename, "r");
-	errno_t err;
-	err = fopen_s(&file, filename, "r");
-	if(err != 0)
-	//if (file == NULL)
+	if (!ObjParser::load(filename, model))
 	{
-		return;
+		MessageBoxA(NULL, filename, "Missing or invalid model file", MB_OK);
 	}
 
-	while (true)
-	{
-		char lineHeader[128];
-
-		// Read first word of the line
-		int res = fscanf_s(file, "%s", lineHeader, (int)sizeof(lineHeader));
-		if (res == EOF)
-		{
-			break; // exit loop
-		}
-		else // Parse
-		{
-			if (strcmp(lineHeader, "v") == 0) // Vertex
-			{
-				XMFLOAT3 vertex;
-				fscanf_s(file, "%f %f %f\n", &vertex.x, &vertex.y, &vertex.z);
-				verts.push_back(vertex);
-			}
-			else if (strcmp(lineHeader, "vt") == 0) // Tex Coord
-			{
-				XMFLOAT2 uv;
-				fscanf_s(file, "%f %f\n", &uv.x, &uv.y);
-				texCs.push_back(uv);
-			}
-			else if (strcmp(lineHeader, "vn") == 0) // Normal
-			{
-				XMFLOAT3 normal;
-				fscanf_s(file, "%f %f %f\n", &normal.x, &normal.y, &normal.z);
-				norms.push_back(normal);
-			}
-			else if (strcmp(lineHeader, "f") == 0) // Face
-			{
-				unsigned int face[9];
-				int matches = fscanf_s(file, "%d/%d/%d %d/%d/%d %d/%d/%d\n", &face[0], &face[1], &face[2],
-																			&face[3], &face[4], &face[5],
-																			&face[6], &face[7], &face[8]);
-				if (matches != 9)
-				{
-					// Parser error, or not triangle faces
-					return;
-				}
-
-				for (int i = 0; i < 9; i++)
-				{
-					faces.push_back(face[i]);
-				}
-
-
-			}
-		}
-	}
-
-	int vIndex = 0, nIndex = 0, tIndex = 0;
-	int numFaces = (int)faces.size() / 9;
-
-	//// Create the model using the vertex count that was read in.
-	vertexCount = numFaces * 3;
-	model = new ModelType[vertexCount];
-
-	// "Unroll" the loaded obj information into a list of triangles.
-	for (int f = 0; f < (int)faces.size(); f += 3)
-	{
-		model[vIndex].x = verts[(faces[f + 0] - 1)].x;
-		model[vIndex].y = verts[(faces[f + 0] - 1)].y;
-		model[vIndex].z = verts[(faces[f + 0] - 1)].z;
-		model[vIndex].tu = texCs[(faces[f + 1] - 1)].x;
-		model[vIndex].tv = texCs[(faces[f + 1] - 1)].y;
-		model[vIndex].nx = norms[(faces[f + 2] - 1)].x;
-		model[vIndex].ny = norms[(faces[f + 2] - 1)].y;
-		model[vIndex].nz = norms[(faces[f + 2] - 1)].z;
-
-		//increase index count
-		vIndex++;
-
-	}
-	indexCount = vIndex;
-
-
-	verts.clear();
-	norms.clear();
-	texCs.clear();
-	faces.clear();
-
+	vertexCount = (int)model.size();
+	indexCount = vertexCount;
 }
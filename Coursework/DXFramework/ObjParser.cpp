@@ -0,0 +1,696 @@
+// OBJ parser
+// Parses Wavefront OBJ files in place from a memory mapped view, plus the original fscanf loader for comparison.
+#include "ObjParser.h"
+#include "Benchmark.h"
+#include "MappedFile.h"
+#include "WorkerPool.h"
+#include <atomic>
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <string>
+
+namespace
+{
+	// Exact powers of ten representable as doubles.
+	const double powersOfTen[] =
+	{
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+		1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+
+	inline bool isDigit(char c)
+	{
+		return (unsigned)(c - '0') < 10;
+	}
+
+	inline bool isSpace(char c)
+	{
+		return c == ' ' || c == '\t';
+	}
+
+	inline const char* skipSpace(const char* p, const char* end)
+	{
+		while (p < end && isSpace(*p))
+		{
+			p++;
+		}
+		return p;
+	}
+
+	// Returns the start of the next line, or end.
+	inline const char* nextLine(const char* p, const char* end)
+	{
+		const char* newline = (const char*)memchr(p, '\n', end - p);
+		return newline ? newline + 1 : end;
+	}
+
+	// Returns the end of the current line, excluding any '\r'.
+	inline const char* lineEnd(const char* p, const char* end)
+	{
+		const char* newline = (const char*)memchr(p, '\n', end - p);
+		if (!newline)
+		{
+			newline = end;
+		}
+		if (newline > p && newline[-1] == '\r')
+		{
+			newline--;
+		}
+		return newline;
+	}
+
+	// Reads up to count floats, unread values are left as they are.
+	inline const char* parseFloats(const char* p, const char* end, float* values, int count)
+	{
+		for (int i = 0; i < count; i++)
+		{
+			p = ObjParser::parseFloat(skipSpace(p, end), end, &values[i]);
+		}
+		return p;
+	}
+
+	// Files smaller than this are parsed on the calling thread.
+	const size_t minChunkSize = 1024 * 1024;
+
+	// Stored in a corner when the face didn't give a texture coordinate or normal.
+	const int noIndex = INT_MIN;
+
+	// Flags for corner indices that are relative to the chunk they were read in.
+	const unsigned int relativeV = 1, relativeVT = 2, relativeVN = 4;
+
+	// Turns a stored corner index into an index into the merged arrays. Returns -1 if out of range.
+	inline int resolveIndex(int index, bool relative, size_t chunkOffset, size_t count)
+	{
+		long long resolved = relative ? (long long)chunkOffset + index : (long long)index;
+		return (resolved >= 0 && resolved < (long long)count) ? (int)resolved : -1;
+	}
+
+	bool nearlyEqual(float a, float b)
+	{
+		return fabsf(a - b) <= 1e-6f * fmaxf(1.0f, fabsf(a));
+	}
+
+	bool sameTriangles(const std::vector<ObjParser::VertexType>& a, const std::vector<ObjParser::VertexType>& b)
+	{
+		if (a.size() != b.size())
+		{
+			return false;
+		}
+
+		const int floatsPerVertex = sizeof(ObjParser::VertexType) / sizeof(float);
+		for (size_t i = 0; i < a.size(); i++)
+		{
+			const float* fa = &a[i].x;
+			const float* fb = &b[i].x;
+			for (int j = 0; j < floatsPerVertex; j++)
+			{
+				if (!nearlyEqual(fa[j], fb[j]))
+				{
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+}
+
+const char* ObjParser::parseFloat(const char* begin, const char* end, float* value)
+{
+	const char* p = begin;
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+'))
+	{
+		negative = (*p == '-');
+		p++;
+	}
+
+	// Collect up to 19 significant digits into an integer mantissa and track the decimal exponent separately.
+	unsigned long long mantissa = 0;
+	int significant = 0;
+	int exponent = 0;
+	bool anyDigits = false;
+
+	while (p < end && isDigit(*p))
+	{
+		if (significant < 19)
+		{
+			mantissa = mantissa * 10 + (*p - '0');
+			significant += (mantissa != 0);
+		}
+		else
+		{
+			exponent++;
+		}
+		anyDigits = true;
+		p++;
+	}
+
+	if (p < end && *p == '.')
+	{
+		p++;
+		while (p < end && isDigit(*p))
+		{
+			if (significant < 19)
+			{
+				mantissa = mantissa * 10 + (*p - '0');
+				significant += (mantissa != 0);
+				exponent--;
+			}
+			anyDigits = true;
+			p++;
+		}
+	}
+
+	if (!anyDigits)
+	{
+		return begin;
+	}
+
+	// Optional exponent. Only consumed if at least one digit follows.
+	if (p < end && (*p == 'e' || *p == 'E'))
+	{
+		const char* e = p + 1;
+		bool negativeExponent = false;
+		if (e < end && (*e == '-' || *e == '+'))
+		{
+			negativeExponent = (*e == '-');
+			e++;
+		}
+		if (e < end && isDigit(*e))
+		{
+			int explicitExponent = 0;
+			while (e < end && isDigit(*e))
+			{
+				if (explicitExponent < 1000)
+				{
+					explicitExponent = explicitExponent * 10 + (*e - '0');
+				}
+				e++;
+			}
+			exponent += negativeExponent ? -explicitExponent : explicitExponent;
+			p = e;
+		}
+	}
+
+	double result = (double)mantissa;
+	if (exponent < 0 && exponent >= -22)
+	{
+		result /= powersOfTen[-exponent];
+	}
+	else if (exponent > 0 && exponent <= 22)
+	{
+		result *= powersOfTen[exponent];
+	}
+	else if (exponent != 0)
+	{
+		result *= pow(10.0, exponent);
+	}
+
+	*value = (float)(negative ? -result : result);
+	return p;
+}
+
+const char* ObjParser::parseInt(const char* begin, const char* end, int* value)
+{
+	const char* p = begin;
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+'))
+	{
+		negative = (*p == '-');
+		p++;
+	}
+
+	if (p == end || !isDigit(*p))
+	{
+		return begin;
+	}
+
+	int result = 0;
+	while (p < end && isDigit(*p))
+	{
+		result = result * 10 + (*p - '0');
+		p++;
+	}
+
+	*value = negative ? -result : result;
+	return p;
+}
+
+bool ObjParser::load(const char* filename, std::vector<VertexType>& triangles, bool multithreaded)
+{
+	triangles.clear();
+
+	MappedFile file;
+	if (!file.open(filename))
+	{
+		return false;
+	}
+
+	// Large files are split into chunks of at least minChunkSize, a few per thread so uneven chunks still balance out.
+	size_t chunkCount = 1;
+	if (multithreaded)
+	{
+		size_t maxChunks = (WorkerPool::shared().getThreadCount() + 1) * 4;
+		chunkCount = file.getSize() / minChunkSize;
+		chunkCount = chunkCount < 1 ? 1 : (chunkCount > maxChunks ? maxChunks : chunkCount);
+	}
+
+	if (!parse(file.getData(), file.getData() + file.getSize(), triangles, (int)chunkCount))
+	{
+		triangles.clear();
+		return false;
+	}
+	return true;
+}
+
+bool ObjParser::parse(const char* begin, const char* end, std::vector<VertexType>& triangles, int chunkCount)
+{
+	// Split the file at line starts, so every record belongs to exactly one chunk.
+	std::vector<const char*> bounds;
+	bounds.push_back(begin);
+	for (int i = 1; i < chunkCount; i++)
+	{
+		const char* split = begin + (end - begin) * i / chunkCount;
+		if (split < bounds.back())
+		{
+			split = bounds.back();
+		}
+		bounds.push_back(nextLine(split, end));
+	}
+	bounds.push_back(end);
+
+	std::vector<ChunkType> chunks(chunkCount);
+	if (chunkCount > 1)
+	{
+		WorkerPool::shared().parallelFor(chunkCount, [&](int i)
+		{
+			parseChunk(bounds[i], bounds[i + 1], chunks[i]);
+		});
+	}
+	else
+	{
+		parseChunk(begin, end, chunks[0]);
+	}
+
+	// Prefix sum the per chunk counts. A chunk's relative indices are offset by the records in the chunks before it.
+	std::vector<size_t> positionOffsets(chunkCount), texCoordOffsets(chunkCount), normalOffsets(chunkCount), cornerOffsets(chunkCount);
+	size_t positionCount = 0, texCoordCount = 0, normalCount = 0, cornerCount = 0;
+	for (int i = 0; i < chunkCount; i++)
+	{
+		if (!chunks[i].valid)
+		{
+			// Parser error
+			return false;
+		}
+
+		positionOffsets[i] = positionCount;
+		texCoordOffsets[i] = texCoordCount;
+		normalOffsets[i] = normalCount;
+		cornerOffsets[i] = cornerCount;
+		positionCount += chunks[i].positions.size() / 3;
+		texCoordCount += chunks[i].texCoords.size() / 2;
+		normalCount += chunks[i].normals.size() / 3;
+		cornerCount += chunks[i].corners.size();
+	}
+
+	// Merge the attribute arrays. A single chunk can hand its arrays over as they are.
+	std::vector<float> positions, texCoords, normals;
+	if (chunkCount == 1)
+	{
+		positions.swap(chunks[0].positions);
+		texCoords.swap(chunks[0].texCoords);
+		normals.swap(chunks[0].normals);
+	}
+	else
+	{
+		positions.reserve(positionCount * 3);
+		texCoords.reserve(texCoordCount * 2);
+		normals.reserve(normalCount * 3);
+		for (int i = 0; i < chunkCount; i++)
+		{
+			positions.insert(positions.end(), chunks[i].positions.begin(), chunks[i].positions.end());
+			texCoords.insert(texCoords.end(), chunks[i].texCoords.begin(), chunks[i].texCoords.end());
+			normals.insert(normals.end(), chunks[i].normals.begin(), chunks[i].normals.end());
+		}
+	}
+
+	// "Unroll" the corners into the triangle list. Each chunk writes its own range, so this can also run in parallel.
+	triangles.resize(cornerCount);
+	std::atomic<bool> valid(true);
+	auto unroll = [&](int i)
+	{
+		const std::vector<CornerType>& corners = chunks[i].corners;
+		VertexType* out = triangles.data() + cornerOffsets[i];
+		for (size_t c = 0; c < corners.size(); c++)
+		{
+			const CornerType& corner = corners[c];
+			int v = resolveIndex(corner.v, (corner.relative & relativeV) != 0, positionOffsets[i], positionCount);
+			int vt = corner.vt == noIndex ? noIndex : resolveIndex(corner.vt, (corner.relative & relativeVT) != 0, texCoordOffsets[i], texCoordCount);
+			int vn = corner.vn == noIndex ? noIndex : resolveIndex(corner.vn, (corner.relative & relativeVN) != 0, normalOffsets[i], normalCount);
+			if (v < 0 || vt == -1 || vn == -1)
+			{
+				// Index out of range
+				valid = false;
+				return;
+			}
+
+			VertexType vertex = {};
+			vertex.x = positions[v * 3 + 0];
+			vertex.y = positions[v * 3 + 1];
+			vertex.z = positions[v * 3 + 2];
+			if (vt >= 0)
+			{
+				vertex.tu = texCoords[vt * 2 + 0];
+				vertex.tv = texCoords[vt * 2 + 1];
+			}
+			if (vn >= 0)
+			{
+				vertex.nx = normals[vn * 3 + 0];
+				vertex.ny = normals[vn * 3 + 1];
+				vertex.nz = normals[vn * 3 + 2];
+			}
+			out[c] = vertex;
+		}
+	};
+
+	if (chunkCount > 1)
+	{
+		WorkerPool::shared().parallelFor(chunkCount, unroll);
+	}
+	else
+	{
+		unroll(0);
+	}
+
+	return valid;
+}
+
+void ObjParser::parseChunk(const char* begin, const char* end, ChunkType& chunk)
+{
+	chunk.valid = true;
+
+	// Counting pass, so none of the arrays below need to grow while parsing.
+	size_t positionCount = 0, texCoordCount = 0, normalCount = 0, triangleCount = 0;
+	for (const char* line = begin; line < end; line = nextLine(line, end))
+	{
+		const char* p = skipSpace(line, end);
+		if (end - p < 2)
+		{
+			continue;
+		}
+
+		if (p[0] == 'v')
+		{
+			if (isSpace(p[1]))
+			{
+				positionCount++;
+			}
+			else if (p[1] == 't')
+			{
+				texCoordCount++;
+			}
+			else if (p[1] == 'n')
+			{
+				normalCount++;
+			}
+		}
+		else if (p[0] == 'f' && isSpace(p[1]))
+		{
+			// A polygon with n corners becomes n - 2 triangles.
+			const char* last = lineEnd(p, end);
+			int corners = 0;
+			for (p += 1; p < last; )
+			{
+				p = skipSpace(p, last);
+				if (p == last)
+				{
+					break;
+				}
+				corners++;
+				while (p < last && !isSpace(*p))
+				{
+					p++;
+				}
+			}
+			if (corners >= 3)
+			{
+				triangleCount += corners - 2;
+			}
+		}
+	}
+
+	chunk.positions.reserve(positionCount * 3);
+	chunk.texCoords.reserve(texCoordCount * 2);
+	chunk.normals.reserve(normalCount * 3);
+	chunk.corners.reserve(triangleCount * 3);
+
+	std::vector<CornerType> polygon;
+	polygon.reserve(8);
+
+	// Parse pass.
+	for (const char* line = begin; line < end; line = nextLine(line, end))
+	{
+		const char* p = skipSpace(line, end);
+		if (end - p < 2)
+		{
+			continue;
+		}
+
+		if (p[0] == 'v')
+		{
+			float values[3] = { 0.0f, 0.0f, 0.0f };
+			if (isSpace(p[1])) // Vertex
+			{
+				parseFloats(p + 1, end, values, 3);
+				chunk.positions.insert(chunk.positions.end(), values, values + 3);
+			}
+			else if (p[1] == 't') // Tex Coord
+			{
+				parseFloats(p + 2, end, values, 2);
+				chunk.texCoords.insert(chunk.texCoords.end(), values, values + 2);
+			}
+			else if (p[1] == 'n') // Normal
+			{
+				parseFloats(p + 2, end, values, 3);
+				chunk.normals.insert(chunk.normals.end(), values, values + 3);
+			}
+		}
+		else if (p[0] == 'f' && isSpace(p[1])) // Face, as v, v/vt, v//vn or v/vt/vn
+		{
+			const char* last = lineEnd(p, end);
+			polygon.clear();
+			for (p += 1; ; )
+			{
+				p = skipSpace(p, last);
+				if (p == last)
+				{
+					break;
+				}
+
+				int v = 0, vt = 0, vn = 0;
+				const char* next = parseInt(p, last, &v);
+				if (next == p || v == 0)
+				{
+					// Parser error
+					chunk.valid = false;
+					return;
+				}
+				p = next;
+				if (p < last && *p == '/')
+				{
+					p = parseInt(p + 1, last, &vt);
+					if (p < last && *p == '/')
+					{
+						p = parseInt(p + 1, last, &vn);
+					}
+				}
+
+				// Positive indices are absolute. Negative ones count back from the records read so far, which this chunk
+				// only knows locally, so they are stored against the chunk's own counts and offset when the chunks are merged.
+				CornerType corner;
+				corner.relative = (v < 0 ? relativeV : 0) | (vt < 0 ? relativeVT : 0) | (vn < 0 ? relativeVN : 0);
+				corner.v = v > 0 ? v - 1 : (int)(chunk.positions.size() / 3) + v;
+				corner.vt = vt == 0 ? noIndex : (vt > 0 ? vt - 1 : (int)(chunk.texCoords.size() / 2) + vt);
+				corner.vn = vn == 0 ? noIndex : (vn > 0 ? vn - 1 : (int)(chunk.normals.size() / 3) + vn);
+				polygon.push_back(corner);
+			}
+
+			// Triangulate as a fan around the first corner.
+			for (size_t i = 2; i < polygon.size(); i++)
+			{
+				chunk.corners.push_back(polygon[0]);
+				chunk.corners.push_back(polygon[i - 1]);
+				chunk.corners.push_back(polygon[i]);
+			}
+		}
+	}
+}
+
+// Original single-threaded loader, modified from a mulit-threaded version by Mark Ropper (CGT). Kept as a reference for benchmark().
+bool ObjParser::loadScanf(const char* filename, std::vector<VertexType>& triangles)
+{
+	struct Float3 { float x, y, z; };
+	struct Float2 { float x, y; };
+	std::vector<Float3> verts;
+	std::vector<Float3> norms;
+	std::vector<Float2> texCs;
+	std::vector<unsigned int> faces;
+
+	triangles.clear();
+
+	FILE* file;
+	errno_t err;
+	err = fopen_s(&file, filename, "r");
+	if (err != 0)
+	{
+		return false;
+	}
+
+	while (true)
+	{
+		char lineHeader[128];
+
+		// Read first word of the line
+		int res = fscanf_s(file, "%s", lineHeader, (int)sizeof(lineHeader));
+		if (res == EOF)
+		{
+			break; // exit loop
+		}
+		else // Parse
+		{
+			if (strcmp(lineHeader, "v") == 0) // Vertex
+			{
+				Float3 vertex;
+				fscanf_s(file, "%f %f %f\n", &vertex.x, &vertex.y, &vertex.z);
+				verts.push_back(vertex);
+			}
+			else if (strcmp(lineHeader, "vt") == 0) // Tex Coord
+			{
+				Float2 uv;
+				fscanf_s(file, "%f %f\n", &uv.x, &uv.y);
+				texCs.push_back(uv);
+			}
+			else if (strcmp(lineHeader, "vn") == 0) // Normal
+			{
+				Float3 normal;
+				fscanf_s(file, "%f %f %f\n", &normal.x, &normal.y, &normal.z);
+				norms.push_back(normal);
+			}
+			else if (strcmp(lineHeader, "f") == 0) // Face
+			{
+				unsigned int face[9];
+				int matches = fscanf_s(file, "%d/%d/%d %d/%d/%d %d/%d/%d\n", &face[0], &face[1], &face[2],
+																			&face[3], &face[4], &face[5],
+																			&face[6], &face[7], &face[8]);
+				if (matches != 9)
+				{
+					// Parser error, or not triangle faces
+					fclose(file);
+					return false;
+				}
+
+				for (int i = 0; i < 9; i++)
+				{
+					faces.push_back(face[i]);
+				}
+			}
+		}
+	}
+	fclose(file);
+
+	// "Unroll" the loaded obj information into a list of triangles.
+	triangles.resize(faces.size() / 3);
+	for (size_t f = 0, vIndex = 0; f < faces.size(); f += 3, vIndex++)
+	{
+		triangles[vIndex].x = verts[(faces[f + 0] - 1)].x;
+		triangles[vIndex].y = verts[(faces[f + 0] - 1)].y;
+		triangles[vIndex].z = verts[(faces[f + 0] - 1)].z;
+		triangles[vIndex].tu = texCs[(faces[f + 1] - 1)].x;
+		triangles[vIndex].tv = texCs[(faces[f + 1] - 1)].y;
+		triangles[vIndex].nx = norms[(faces[f + 2] - 1)].x;
+		triangles[vIndex].ny = norms[(faces[f + 2] - 1)].y;
+		triangles[vIndex].nz = norms[(faces[f + 2] - 1)].z;
+	}
+
+	return true;
+}
+
+void ObjParser::benchmark(const char* directory, FILE* report)
+{
+	const int runs = 5;
+
+	std::string pattern = std::string(directory) + "\\*.obj";
+	WIN32_FIND_DATAA findData;
+	HANDLE find = FindFirstFileA(pattern.c_str(), &findData);
+	if (find == INVALID_HANDLE_VALUE)
+	{
+		Benchmark::report(report, "OBJ benchmark: no .obj files in %s\n", directory);
+		return;
+	}
+
+	Benchmark::report(report, "OBJ benchmark, best of %d runs, %u worker threads\n", runs, WorkerPool::shared().getThreadCount());
+	Benchmark::report(report, "%-24s %10s %14s %14s %14s %8s\n", "file", "MB", "fscanf MB/s", "mapped MB/s", "threaded MB/s", "speedup");
+
+	double totalMB = 0.0, totalScanf = 0.0, totalMapped = 0.0, totalThreaded = 0.0;
+	do
+	{
+		std::string path = std::string(directory) + "\\" + findData.cFileName;
+		double megabytes = (double)(((unsigned long long)findData.nFileSizeHigh << 32) | findData.nFileSizeLow) / (1024.0 * 1024.0);
+
+		std::vector<VertexType> scanfTriangles, mappedTriangles, threadedTriangles;
+		double bestScanf = 1e30, bestMapped = 1e30, bestThreaded = 1e30;
+		bool scanfLoaded = true, mappedLoaded = true, threadedLoaded = true;
+
+		for (int run = 0; run < runs; run++)
+		{
+			double start = Benchmark::seconds();
+			scanfLoaded = loadScanf(path.c_str(), scanfTriangles);
+			double scanfDone = Benchmark::seconds();
+			mappedLoaded = load(path.c_str(), mappedTriangles, false);
+			double mappedDone = Benchmark::seconds();
+			threadedLoaded = load(path.c_str(), threadedTriangles, true);
+			double threadedDone = Benchmark::seconds();
+
+			bestScanf = fmin(bestScanf, scanfDone - start);
+			bestMapped = fmin(bestMapped, mappedDone - scanfDone);
+			bestThreaded = fmin(bestThreaded, threadedDone - mappedDone);
+		}
+
+		const char* note = "";
+		if (!mappedLoaded || !threadedLoaded)
+		{
+			note = "parse failed";
+		}
+		else if (!sameTriangles(mappedTriangles, threadedTriangles))
+		{
+			note = "MISMATCH (threaded)";
+		}
+		else if (!scanfLoaded)
+		{
+			note = "fscanf loader unsupported";
+		}
+		else if (!sameTriangles(scanfTriangles, mappedTriangles))
+		{
+			note = "MISMATCH (fscanf)";
+		}
+
+		Benchmark::report(report, "%-24s %10.2f %14.1f %14.1f %14.1f %7.1fx %s\n", findData.cFileName, megabytes,
+			megabytes / bestScanf, megabytes / bestMapped, megabytes / bestThreaded, bestScanf / bestThreaded, note);
+
+		if (scanfLoaded && mappedLoaded && threadedLoaded)
+		{
+			totalMB += megabytes;
+			totalScanf += bestScanf;
+			totalMapped += bestMapped;
+			totalThreaded += bestThreaded;
+		}
+	} while (FindNextFileA(find, &findData));
+	FindClose(find);
+
+	if (totalThreaded > 0.0)
+	{
+		Benchmark::report(report, "%-24s %10.2f %14.1f %14.1f %14.1f %7.1fx\n", "total", totalMB,
+			totalMB / totalScanf, totalMB / totalMapped, totalMB / totalThreaded, totalScanf / totalThreaded);
+	}
+}
@@ -0,0 +1,75 @@
+/**
+* \class OBJ Parser
+*
+* \brief Fast Wavefront OBJ reader used by the Model mesh
+*
+* Memory maps the file and scans it in place. A counting pass sizes the position, texture coordinate, normal and face arrays up front,
+* then a second pass parses the records with hand written number parsers (no scanf, no locale, no per-token strings).
+* Large files are split into newline aligned chunks that are parsed in parallel on the shared WorkerPool, then merged.
+* Faces are unrolled into a flat triangle list, three vertices per triangle, in file order. Polygons are triangulated as fans.
+*
+* The original fscanf based loader is kept as loadScanf() so the two can be compared with benchmark().
+*/
+
+
+#ifndef _OBJPARSER_H_
+#define _OBJPARSER_H_
+
+#include <vector>
+#include <cstdio>
+
+class ObjParser
+{
+public:
+	/// One unrolled triangle corner. Layout matches the Model mesh's ModelType.
+	struct VertexType
+	{
+		float x, y, z;
+		float tu, tv;
+		float nx, ny, nz;
+	};
+
+	/** \brief Parses an OBJ file into a triangle list.
+	* @param filename is the path to the OBJ file
+	* @param triangles receives three vertices per triangle
+	* @param multithreaded allows large files to be parsed in chunks on the worker pool
+	* @return false if the file is missing or malformed, triangles is left empty.
+	*/
+	static bool load(const char* filename, std::vector<VertexType>& triangles, bool multithreaded = true);
+
+	/// Reference loader using fscanf_s. Triangles with v/vt/vn indices only.
+	static bool loadScanf(const char* filename, std::vector<VertexType>& triangles);
+
+	/** \brief Times both loaders over every .obj file in a directory.
+	* Writes MB/s per file and in total to report (and the debug output), and flags any file where the two loaders disagree.
+	* @param directory is the folder to search, e.g. "res"
+	* @param report is an open file to write the results to
+	*/
+	static void benchmark(const char* directory, FILE* report);
+
+	/// Parses a decimal float such as "-1.25e-3". Returns the position after the number, or begin if there was no number.
+	static const char* parseFloat(const char* begin, const char* end, float* value);
+	/// Parses a signed decimal integer. Returns the position after the number, or begin if there was no number.
+	static const char* parseInt(const char* begin, const char* end, int* value);
+
+private:
+	/// Index triple for one triangle corner, 0-based. Relative indices are counted from the start of the chunk they were read in.
+	struct CornerType
+	{
+		int v, vt, vn;
+		unsigned int relative;
+	};
+
+	/// Records read from one newline aligned piece of the file.
+	struct ChunkType
+	{
+		std::vector<float> positions, texCoords, normals;
+		std::vector<CornerType> corners;
+		bool valid;
+	};
+
+	static bool parse(const char* begin, const char* end, std::vector<VertexType>& triangles, int chunkCount);
+	static void parseChunk(const char* begin, const char* end, ChunkType& chunk);
+};
+
+#endif
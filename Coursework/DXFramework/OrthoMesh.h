@@ -5,6 +5,7 @@
 *
 * Added functionality to be position with onscreen coordinates.
 * While normals are define for shape, they are not expected to be used.
+* Every ortho mesh draws the same shared unit quad (see QuadMesh), so draw it with getPlacementMatrix() in front of the world matrix.
 *
 * \author Paul Robertson
 */
@@ -32,6 +33,9 @@ public:
 	OrthoMesh(ID3D11Device* device, ID3D11DeviceContext* deviceContext, int width, int height, int xPosition = 0, int yPosition = 0);
 	~OrthoMesh();
 
+	/// Scales and moves the shared unit quad to the mesh's size and position on screen. Multiply it in front of the world matrix.
+	XMMATRIX getPlacementMatrix();
+
 protected:
 	void initBuffers(ID3D11Device*);
 	int width, height, xPosition, yPosition;
@@ -1,19 +1,24 @@
 // plane mesh
 // Quad mesh made of many quads. Default is 100x100
 #include "planemesh.h"
+#include "VertexGenerator.h"
+#include "Benchmark.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
 
 // Initialise buffer and load texture.
-PlaneMesh::PlaneMesh(ID3D11Device* device, ID3D11DeviceContext* deviceContext, int lresolution)
+PlaneMesh::PlaneMesh(ID3D11Device* device, ID3D11DeviceContext* deviceContext, int lresolution, LayoutType llayout)
 {
 	resolution = lresolution;
+	layout = llayout;
 	initBuffers(device);
 }
 
 // Release resources.
 PlaneMesh::~PlaneMesh()
 {
-	// Run parent deconstructor
-	BaseMesh::~BaseMesh();
+	// BaseMesh's destructor runs after this one and releases the buffers.
 }
 
 // Generate plane (including texture coordinates and normals).
@@ -21,127 +26,30 @@ void PlaneMesh::initBuffers(ID3D11Device* device)
 {
 	VertexType* vertices;
 	unsigned long* indices;
-	int index, i, j;
-	float positionX, positionZ, u, v, increment;
-	D3D11_BUFFER_DESC vertexBufferDesc, indexBufferDesc;
-	D3D11_SUBRESOURCE_DATA vertexData, indexData;
-	
-	// Calculate the number of vertices in the terrain mesh.
-	vertexCount = (resolution - 1) * (resolution - 1) * 6;
-
+	float increment;
 
-	indexCount = vertexCount;
+	// One vertex per grid point, shared by the quads around it.
+	vertexCount = resolution * resolution;
 	vertices = new VertexType[vertexCount];
-	indices = new unsigned long[indexCount];
-	
 
-	index = 0;
-	// UV coords.
-	u = 0;
-	v = 0;
+	// UV coords step the same as the positions, one increment per unit quad.
 	increment = 1.0f / resolution;
-	
-	for (j = 0; j<(resolution - 1); j++)
-	{
-		for (i = 0; i<(resolution - 1); i++)
-		{
-			// Upper left.
-			positionX = (float)i;
-			positionZ = (float)(j);
-
-			vertices[index].position = XMFLOAT3(positionX, 0.0f, positionZ);
-			vertices[index].texture = XMFLOAT2(u, v);
-			vertices[index].normal = XMFLOAT3(0.0, 1.0, 0.0);
-			indices[index] = index;
-			index++;
-
-			// Upper right.
-			positionX = (float)(i + 1);
-			positionZ = (float)(j + 1);
-
-			vertices[index].position = XMFLOAT3(positionX, 0.0f, positionZ);
-			vertices[index].texture = XMFLOAT2(u + increment, v + increment);
-			vertices[index].normal = XMFLOAT3(0.0, 1.0, 0.0);
-			indices[index] = index;
-			index++;
-
-
-			// lower left
-			positionX = (float)(i);
-			positionZ = (float)(j + 1);
-			
-
-			vertices[index].position = XMFLOAT3(positionX, 0.0f, positionZ);
-			vertices[index].texture = XMFLOAT2(u, v + increment);
-			vertices[index].normal = XMFLOAT3(0.0, 1.0, 0.0);
-			indices[index] = index;
-			index++;
-
-			// Upper left
-			positionX = (float)(i);
-			positionZ = (float)(j);
-
-			vertices[index].position = XMFLOAT3(positionX, 0.0f, positionZ);
-			vertices[index].texture = XMFLOAT2(u, v);
-			vertices[index].normal = XMFLOAT3(0.0, 1.0, 0.0);
-			indices[index] = index;
-			index++;
-
-			// Bottom right
-			positionX = (float)(i + 1);
-			positionZ = (float)(j);
-
-			vertices[index].position = XMFLOAT3(positionX, 0.0f, positionZ);
-			vertices[index].texture = XMFLOAT2(u + increment, v);
-			vertices[index].normal = XMFLOAT3(0.0, 1.0, 0.0);
-			indices[index] = index;
-			index++;
-
-			// Upper right.
-			positionX = (float)(i + 1);
-			positionZ = (float)(j + 1);
-
-			vertices[index].position = XMFLOAT3(positionX, 0.0f, positionZ);
-			vertices[index].texture = XMFLOAT2(u + increment, v + increment);
-			vertices[index].normal = XMFLOAT3(0.0, 1.0, 0.0);
-			indices[index] = index;
-			index++;
-
-			u += increment;
-	
-		}
 
-		u = 0;
-		v += increment;
+	VertexGenerator::writeGrid(reinterpret_cast<PrimitiveShapes::VertexType*>(vertices), resolution, resolution, 1.0f, increment);
+
+	indexCount = getIndexCount(resolution, layout);
+	indices = new unsigned long[indexCount];
+	writeIndices(indices, resolution, layout);
+
+	if (layout == LayoutList)
+	{
+		// Split into meshlets, so views can skip the parts of the plane they can't see.
+		buildMeshlets(vertices, indices);
 	}
 
-	// Set up the description of the static vertex buffer.
-	vertexBufferDesc.Usage = D3D11_USAGE_DEFAULT;
-	vertexBufferDesc.ByteWidth = sizeof(VertexType)* vertexCount;
-	vertexBufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-	vertexBufferDesc.CPUAccessFlags = 0;
-	vertexBufferDesc.MiscFlags = 0;
-	vertexBufferDesc.StructureByteStride = 0;
-	// Give the subresource structure a pointer to the vertex data.
-	vertexData.pSysMem = vertices;
-	vertexData.SysMemPitch = 0;
-	vertexData.SysMemSlicePitch = 0;
-	// Now create the vertex buffer.
-	device->CreateBuffer(&vertexBufferDesc, &vertexData, &vertexBuffer);
-	
-	// Set up the description of the static index buffer.
-	indexBufferDesc.Usage = D3D11_USAGE_DEFAULT;
-	indexBufferDesc.ByteWidth = sizeof(unsigned long)* indexCount;
-	indexBufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
-	indexBufferDesc.CPUAccessFlags = 0;
-	indexBufferDesc.MiscFlags = 0;
-	indexBufferDesc.StructureByteStride = 0;
-	// Give the subresource structure a pointer to the index data.
-	indexData.pSysMem = indices;
-	indexData.SysMemPitch = 0;
-	indexData.SysMemSlicePitch = 0;
-	// Create the index buffer.
-	device->CreateBuffer(&indexBufferDesc, &indexData, &indexBuffer);
+	// Create the vertex and index buffers.
+	createVertexBuffer(device, vertices);
+	createIndexBuffer(device, indices);
 	
 	// Release the arrays now that the buffers have been created and loaded.
 	delete[] vertices;
@@ -150,4 +58,252 @@ void PlaneMesh::initBuffers(ID3D11Device* device)
 	indices = 0;
 }
 
+void PlaneMesh::sendData(ID3D11DeviceContext* deviceContext, D3D_PRIMITIVE_TOPOLOGY top)
+{
+	// D3D11 always reads 0xffff (or 0xffffffff) as a strip cut in strip topologies, so only the topology has to change.
+	if (layout == LayoutStrip && top == D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST)
+	{
+		top = D3D_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP;
+	}
+	BaseMesh::sendData(deviceContext, top);
+}
+
+unsigned long PlaneMesh::getIndexCount(int resolution, LayoutType layout)
+{
+	if (layout == LayoutStrip)
+	{
+		return (resolution - 1) * (resolution * 2 + 1);
+	}
+	return (resolution - 1) * (resolution - 1) * 6;
+}
+
+void PlaneMesh::writeIndices(unsigned long* indices, int resolution, LayoutType layout)
+{
+	int index = 0;
+	if (layout == LayoutStrip)
+	{
+		// Each row of quads is one strip, alternating between the far and near row of vertices. It makes the same triangles as the list below.
+		for (int j = 0; j < (resolution - 1); j++)
+		{
+			for (int i = 0; i < resolution; i++)
+			{
+				indices[index++] = (j + 1) * resolution + i;
+				indices[index++] = j * resolution + i;
+			}
+			// Cut the strip. Becomes 0xffff if the buffer is made 16 bit.
+			indices[index++] = 0xffffffff;
+		}
+		return;
+	}
+
+	// Two triangles per quad, split along the diagonal from (i, j) to (i + 1, j + 1).
+	for (int j = 0; j < (resolution - 1); j++)
+	{
+		for (int i = 0; i < (resolution - 1); i++)
+		{
+			unsigned long lowerLeft = j * resolution + i;
+			unsigned long lowerRight = lowerLeft + 1;
+			unsigned long upperLeft = lowerLeft + resolution;
+			unsigned long upperRight = upperLeft + 1;
+
+			indices[index++] = lowerLeft;
+			indices[index++] = upperRight;
+			indices[index++] = upperLeft;
+
+			indices[index++] = lowerLeft;
+			indices[index++] = lowerRight;
+			indices[index++] = upperRight;
+		}
+	}
+}
+
+namespace
+{
+	// One triangle corner, position and texture coordinates.
+	struct CornerType
+	{
+		float x, z, u, v;
+	};
+
+	struct TriangleType
+	{
+		CornerType corners[3];
+	};
+
+	bool cornerLess(const CornerType& a, const CornerType& b)
+	{
+		return a.x < b.x || (a.x == b.x && a.z < b.z);
+	}
+
+	// Starts the triangle at its lowest corner by position, keeping the winding, so equal triangles compare equal however they were listed.
+	TriangleType makeTriangle(const CornerType& a, const CornerType& b, const CornerType& c)
+	{
+		TriangleType triangle = { { a, b, c } };
+		int first = 0;
+		for (int k = 1; k < 3; k++)
+		{
+			if (cornerLess(triangle.corners[k], triangle.corners[first]))
+			{
+				first = k;
+			}
+		}
+		std::rotate(triangle.corners, triangle.corners + first, triangle.corners + 3);
+		return triangle;
+	}
+
+	bool triangleLess(const TriangleType& a, const TriangleType& b)
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			if (cornerLess(a.corners[k], b.corners[k]))
+			{
+				return true;
+			}
+			if (cornerLess(b.corners[k], a.corners[k]))
+			{
+				return false;
+			}
+		}
+		return false;
+	}
+
+	CornerType cornerAt(const PrimitiveShapes::VertexType& vertex)
+	{
+		CornerType corner = { vertex.position[0], vertex.position[2], vertex.texture[0], vertex.texture[1] };
+		return corner;
+	}
+
+	// The triangles PlaneMesh wrote before it shared vertices: six corners per quad, texture coordinates stepped by adding the increment.
+	void referenceTriangles(int resolution, std::vector<TriangleType>& triangles)
+	{
+		float increment = 1.0f / resolution;
+		float u = 0.0f;
+		float v = 0.0f;
+		for (int j = 0; j < (resolution - 1); j++)
+		{
+			for (int i = 0; i < (resolution - 1); i++)
+			{
+				CornerType lowerLeft = { (float)i, (float)j, u, v };
+				CornerType lowerRight = { (float)(i + 1), (float)j, u + increment, v };
+				CornerType upperLeft = { (float)i, (float)(j + 1), u, v + increment };
+				CornerType upperRight = { (float)(i + 1), (float)(j + 1), u + increment, v + increment };
+				triangles.push_back(makeTriangle(lowerLeft, upperRight, upperLeft));
+				triangles.push_back(makeTriangle(lowerLeft, lowerRight, upperRight));
+				u += increment;
+			}
+			u = 0.0f;
+			v += increment;
+		}
+	}
+
+	// Triangles as the input assembler reads the index buffer. Strips flip every other triangle to keep the winding, and restart at cut indices.
+	void assembleTriangles(const std::vector<PrimitiveShapes::VertexType>& vertices, const std::vector<unsigned long>& indices, bool strip,
+		std::vector<TriangleType>& triangles)
+	{
+		if (!strip)
+		{
+			for (size_t i = 0; i + 2 < indices.size(); i += 3)
+			{
+				triangles.push_back(makeTriangle(cornerAt(vertices[indices[i]]), cornerAt(vertices[indices[i + 1]]), cornerAt(vertices[indices[i + 2]])));
+			}
+			return;
+		}
+
+		size_t stripStart = 0;
+		for (size_t i = 0; i < indices.size(); i++)
+		{
+			if (indices[i] == 0xffffffff)
+			{
+				stripStart = i + 1;
+				continue;
+			}
+			if (i < stripStart + 2)
+			{
+				continue;
+			}
+			const CornerType a = cornerAt(vertices[indices[i - 2]]);
+			const CornerType b = cornerAt(vertices[indices[i - 1]]);
+			const CornerType c = cornerAt(vertices[indices[i]]);
+			triangles.push_back((i - stripStart) % 2 == 0 ? makeTriangle(a, b, c) : makeTriangle(b, a, c));
+		}
+	}
+
+	// Triangles missing from either side, and the largest texture coordinate difference between the ones that match.
+	unsigned long compareTriangles(std::vector<TriangleType>& reference, std::vector<TriangleType>& triangles, float& textureError)
+	{
+		std::sort(reference.begin(), reference.end(), triangleLess);
+		std::sort(triangles.begin(), triangles.end(), triangleLess);
+
+		unsigned long mismatched = 0;
+		size_t r = 0, t = 0;
+		while (r < reference.size() || t < triangles.size())
+		{
+			if (t == triangles.size() || (r < reference.size() && triangleLess(reference[r], triangles[t])))
+			{
+				mismatched++;
+				r++;
+			}
+			else if (r == reference.size() || triangleLess(triangles[t], reference[r]))
+			{
+				mismatched++;
+				t++;
+			}
+			else
+			{
+				for (int k = 0; k < 3; k++)
+				{
+					textureError = std::max(textureError, fabsf(reference[r].corners[k].u - triangles[t].corners[k].u));
+					textureError = std::max(textureError, fabsf(reference[r].corners[k].v - triangles[t].corners[k].v));
+				}
+				r++;
+				t++;
+			}
+		}
+		return mismatched;
+	}
+}
+
+void PlaneMesh::benchmark(FILE* report)
+{
+	Benchmark::report(report, "Plane topology against the six corners per quad generator, triangles compared by position and winding\n");
+	Benchmark::report(report, "A texture coordinate more than a thousandth of a quad's step away from the old one is a mismatch\n");
+	Benchmark::report(report, "%10s %10s %10s %14s %14s %14s %14s\n", "resolution", "triangles", "vertices", "list missing", "strip missing", "list uv error", "strip uv error");
 
+	unsigned long flagged = 0;
+	for (int resolution = 2; resolution <= 100; resolution++)
+	{
+		std::vector<PrimitiveShapes::VertexType> vertices(resolution * resolution);
+		VertexGenerator::writeGrid(vertices.data(), resolution, resolution, 1.0f, 1.0f / resolution);
+		float tolerance = 0.001f / resolution;
+
+		unsigned long missing[2];
+		float textureError[2];
+		const LayoutType layouts[2] = { LayoutList, LayoutStrip };
+		for (int l = 0; l < 2; l++)
+		{
+			std::vector<unsigned long> indices(getIndexCount(resolution, layouts[l]));
+			writeIndices(indices.data(), resolution, layouts[l]);
+
+			std::vector<TriangleType> reference;
+			std::vector<TriangleType> triangles;
+			referenceTriangles(resolution, reference);
+			assembleTriangles(vertices, indices, layouts[l] == LayoutStrip, triangles);
+			textureError[l] = 0.0f;
+			missing[l] = compareTriangles(reference, triangles, textureError[l]);
+		}
+
+		// Every resolution up to 10 and every tenth after, plus any that differ.
+		bool mismatch = missing[0] > 0 || missing[1] > 0 || textureError[0] > tolerance || textureError[1] > tolerance;
+		if (mismatch || resolution <= 10 || resolution % 10 == 0)
+		{
+			const char* note = mismatch ? "MISMATCH" : "";
+			Benchmark::report(report, "%10d %10d %10d %14lu %14lu %14.2e %14.2e %s\n", resolution, (resolution - 1) * (resolution - 1) * 2, resolution * resolution,
+				missing[0], missing[1], textureError[0], textureError[1], note);
+		}
+		if (mismatch)
+		{
+			flagged++;
+		}
+	}
+	Benchmark::report(report, "%lu of 99 resolutions differ\n", flagged);
+}
@@ -0,0 +1,149 @@
+/**
+* \brief Vertex and index tables of the fixed primitives
+*
+* The quad, triangle and point meshes only ever hold the same few vertices, so their tables are constexpr data in the
+* executable instead of arrays filled at startup. The cube is too large for that: at the default resolution its table is
+* thousands of vertices, far past the compiler's constexpr step limit. fillCube() writes it the first time a device needs
+* one of each resolution instead. The meshes upload a table once per device and share the buffers (see GpuMeshStore).
+*
+* VertexType matches BaseMesh::VertexType, and every table fits 16 bit indices.
+*/
+
+
+#ifndef _PRIMITIVESHAPES_H_
+#define _PRIMITIVESHAPES_H_
+
+namespace PrimitiveShapes
+{
+	/// Same layout as BaseMesh::VertexType, with plain arrays so the tables can be built at compile time.
+	struct VertexType
+	{
+		float position[3];
+		float texture[2];
+		float normal[3];
+	};
+
+	/// A table of vertices and triangle list indices.
+	template<int VertexCount, int IndexCount>
+	struct ShapeType
+	{
+		static const int vertexCount = VertexCount;
+		static const int indexCount = IndexCount;
+		VertexType vertices[VertexCount];
+		unsigned short indices[IndexCount];
+	};
+
+	/// A cube face: the corner at texture coordinate (0, 0), the directions u and v run in (both span 2 units) and the outward normal.
+	struct FaceType
+	{
+		float origin[3];
+		float uAxis[3];
+		float vAxis[3];
+		float normal[3];
+	};
+
+	/// Front, back, right, left, top and bottom faces of the cube from -1 to 1, as CubeMesh and SphereMesh lay them out.
+	constexpr FaceType cubeFaces[6] = {
+		{ { -1.0f, 1.0f, -1.0f }, { 1.0f, 0.0f, 0.0f }, { 0.0f, -1.0f, 0.0f }, { 0.0f, 0.0f, -1.0f } },
+		{ { 1.0f, 1.0f, 1.0f }, { -1.0f, 0.0f, 0.0f }, { 0.0f, -1.0f, 0.0f }, { 0.0f, 0.0f, 1.0f } },
+		{ { 1.0f, 1.0f, -1.0f }, { 0.0f, 0.0f, 1.0f }, { 0.0f, -1.0f, 0.0f }, { 1.0f, 0.0f, 0.0f } },
+		{ { -1.0f, 1.0f, 1.0f }, { 0.0f, 0.0f, -1.0f }, { 0.0f, -1.0f, 0.0f }, { -1.0f, 0.0f, 0.0f } },
+		{ { -1.0f, 1.0f, 1.0f }, { 1.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, -1.0f }, { 0.0f, 1.0f, 0.0f } },
+		{ { -1.0f, -1.0f, -1.0f }, { 1.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 1.0f }, { 0.0f, -1.0f, 0.0f } }
+	};
+
+	constexpr VertexType makeVertex(float x, float y, float z, float u, float v, float nx, float ny, float nz)
+	{
+		return VertexType{ { x, y, z }, { u, v }, { nx, ny, nz } };
+	}
+
+	constexpr int getCubeVertexCount(int resolution) { return 6 * (resolution + 1) * (resolution + 1); }
+	constexpr int getCubeIndexCount(int resolution) { return 6 * 6 * resolution * resolution; }
+
+	/** \brief Writes a cube from -1 to 1 with resolution x resolution quads per face.
+	* Each face is a grid of vertices shared by the quads around them, with its own texture coordinates from 0 to 1.
+	* @param vertices receives getCubeVertexCount(resolution) vertices
+	* @param indices receives getCubeIndexCount(resolution) indices
+	*/
+	template<typename IndexType>
+	void fillCube(int resolution, VertexType* vertices, IndexType* indices)
+	{
+		int faceSize = resolution + 1;
+		int v = 0;
+		int i = 0;
+		for (int f = 0; f < 6; f++)
+		{
+			const FaceType& face = cubeFaces[f];
+			for (int y = 0; y < faceSize; y++)
+			{
+				for (int x = 0; x < faceSize; x++)
+				{
+					float u = (float)x / resolution;
+					float t = (float)y / resolution;
+					vertices[v++] = makeVertex(face.origin[0] + (face.uAxis[0] * u + face.vAxis[0] * t) * 2.0f,
+						face.origin[1] + (face.uAxis[1] * u + face.vAxis[1] * t) * 2.0f,
+						face.origin[2] + (face.uAxis[2] * u + face.vAxis[2] * t) * 2.0f,
+						u, t, face.normal[0], face.normal[1], face.normal[2]);
+				}
+			}
+
+			// Two triangles per quad, split from bottom left to top right and wound clockwise seen from outside.
+			int faceStart = f * faceSize * faceSize;
+			for (int y = 0; y < resolution; y++)
+			{
+				for (int x = 0; x < resolution; x++)
+				{
+					int topLeft = faceStart + y * faceSize + x;
+					int bottomLeft = topLeft + faceSize;
+
+					indices[i++] = (IndexType)bottomLeft;
+					indices[i++] = (IndexType)(topLeft + 1);
+					indices[i++] = (IndexType)topLeft;
+
+					indices[i++] = (IndexType)bottomLeft;
+					indices[i++] = (IndexType)(bottomLeft + 1);
+					indices[i++] = (IndexType)(topLeft + 1);
+				}
+			}
+		}
+	}
+
+	/// Square from -1 to 1 on x and y, facing -z, with texture coordinates from 0 to 1 and v running down.
+	constexpr ShapeType<4, 6> quad = {
+		{
+			makeVertex(-1.0f, -1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, -1.0f),	// Bottom left.
+			makeVertex(-1.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, -1.0f),	// Top left.
+			makeVertex(1.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, -1.0f),	// Top right.
+			makeVertex(1.0f, -1.0f, 0.0f, 1.0f, 1.0f, 0.0f, 0.0f, -1.0f)	// Bottom right.
+		},
+		{ 0, 2, 1, 0, 3, 2 }
+	};
+
+	/// Triangle with its top at (0, 1) and its base from (-1, 0) to (1, 0), facing -z.
+	constexpr ShapeType<3, 3> triangle = {
+		{
+			makeVertex(0.0f, 1.0f, 0.0f, 0.5f, 0.0f, 0.0f, 0.0f, -1.0f),	// Top.
+			makeVertex(-1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, -1.0f),	// Bottom left.
+			makeVertex(1.0f, 0.0f, 0.0f, 1.0f, 1.0f, 0.0f, 0.0f, -1.0f)		// Bottom right.
+		},
+		{ 0, 1, 2 }
+	};
+
+	/// The triangle's corners with the texture coordinates PointMesh gives them, for geometry shaders that expand points.
+	constexpr ShapeType<3, 3> pointTriangle = {
+		{
+			makeVertex(0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, -1.0f),	// Top.
+			makeVertex(-1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, -1.0f),	// Bottom left.
+			makeVertex(1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, -1.0f)		// Bottom right.
+		},
+		{ 0, 1, 2 }
+	};
+
+	/// A single point at the origin, for particles expanded by a geometry shader.
+	constexpr ShapeType<1, 1> point = {
+		{ makeVertex(0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, -1.0f) },
+		{ 0 }
+	};
+}
+
+#endif
@@ -0,0 +1,272 @@
+// Render queue
+// Draw packets sorted on a packed key, executed with the fewest state changes.
+#include "RenderQueue.h"
+#include "Benchmark.h"
+#include <algorithm>
+#include <cstring>
+#include <random>
+
+namespace
+{
+	const int passBits = 8;
+	const int shaderBits = 10;
+	const int materialBits = 14;
+	const int meshBits = 8;
+	const int depthBits = 24;
+
+	// Positive floats order the same as their bits read as unsigned integers. The low mantissa bits are dropped to make room for the mesh.
+	inline unsigned int depthBitsOf(float depth)
+	{
+		depth = std::max(depth, 0.0f);
+		unsigned int bits;
+		memcpy(&bits, &depth, sizeof(bits));
+		return bits >> (32 - depthBits);
+	}
+}
+
+RenderQueue::RenderQueue()
+{
+	memset(&stats, 0, sizeof(stats));
+	instancing = true;
+}
+
+unsigned int RenderQueue::getNumber(std::unordered_map<const void*, unsigned int>& numbers, const void* pointer)
+{
+	std::unordered_map<const void*, unsigned int>::iterator found = numbers.find(pointer);
+	if (found != numbers.end())
+	{
+		return found->second;
+	}
+	unsigned int number = (unsigned int)numbers.size();
+	numbers[pointer] = number;
+	return number;
+}
+
+unsigned long long RenderQueue::makeKey(const PacketType& packet)
+{
+	unsigned long long pass = (unsigned long long)(packet.pass & ((1 << passBits) - 1));
+	unsigned long long shader = getNumber(shaderNumbers, packet.shader) & ((1 << shaderBits) - 1);
+	unsigned long long material = getNumber(materialNumbers, packet.material) & ((1 << materialBits) - 1);
+	unsigned long long mesh = getNumber(meshNumbers, packet.mesh) & ((1 << meshBits) - 1);
+	unsigned long long depth = depthBitsOf(packet.depth);
+
+	return (pass << (shaderBits + materialBits + meshBits + depthBits)) | (shader << (materialBits + meshBits + depthBits)) |
+		(material << (meshBits + depthBits)) | (mesh << depthBits) | depth;
+}
+
+// Whether packet can be drawn as another instance of first. Only its world matrix and depth may differ.
+bool RenderQueue::canBatch(const PacketType& first, const PacketType& packet)
+{
+	return packet.pass == first.pass && packet.shader == first.shader && packet.material == first.material && packet.mesh == first.mesh &&
+		packet.instancedShader == first.instancedShader && packet.indexCount == first.indexCount && packet.indexStart == first.indexStart &&
+		packet.rangeCount == 0 && memcmp(&packet.parameters, &first.parameters, sizeof(first.parameters)) == 0;
+}
+
+void RenderQueue::submit(const PacketType& packet)
+{
+	SortItem item = { makeKey(packet), (unsigned int)packets.size() };
+	items.push_back(item);
+	packets.push_back(packet);
+	packets.back().rangeStart = 0;
+	packets.back().rangeCount = 0;
+}
+
+void RenderQueue::submit(const PacketType& packet, const std::vector<MeshletBuilder::RangeType>& packetRanges)
+{
+	submit(packet);
+	packets.back().rangeStart = (unsigned int)ranges.size();
+	packets.back().rangeCount = (unsigned int)packetRanges.size();
+	ranges.insert(ranges.end(), packetRanges.begin(), packetRanges.end());
+}
+
+void RenderQueue::sort()
+{
+	double start = Benchmark::seconds();
+
+	// Least significant byte first, eight passes. Each pass is a stable counting sort on one byte.
+	// All eight histograms are counted in one read, and bytes every key shares are skipped: usually the pass and most of the shader bits.
+	size_t count = items.size();
+	size_t histograms[8][256] = {};
+	for (size_t i = 0; i < count; i++)
+	{
+		unsigned long long key = items[i].key;
+		for (int digit = 0; digit < 8; digit++)
+		{
+			histograms[digit][(key >> (digit * 8)) & 0xff]++;
+		}
+	}
+
+	scratch.resize(count);
+	for (int digit = 0; digit < 8; digit++)
+	{
+		size_t* histogram = histograms[digit];
+		if (count == 0 || histogram[(items[0].key >> (digit * 8)) & 0xff] == count)
+		{
+			continue;
+		}
+
+		size_t offset = 0;
+		for (int bucket = 0; bucket < 256; bucket++)
+		{
+			size_t size = histogram[bucket];
+			histogram[bucket] = offset;
+			offset += size;
+		}
+		for (size_t i = 0; i < count; i++)
+		{
+			scratch[histogram[(items[i].key >> (digit * 8)) & 0xff]++] = items[i];
+		}
+		items.swap(scratch);
+	}
+
+	stats.sortTime = Benchmark::seconds() - start;
+}
+
+void RenderQueue::execute(Backend& backend)
+{
+	double sortTime = stats.sortTime;
+	memset(&stats, 0, sizeof(stats));
+	stats.sortTime = sortTime;
+	stats.packets = (int)items.size();
+
+	const PacketType* previous = nullptr;
+	for (size_t i = 0; i < items.size(); i++)
+	{
+		const PacketType& packet = packets[items[i].packet];
+
+		// A new pass may change any state behind the queue's back, so everything is bound again after it.
+		bool newPass = !previous || packet.pass != previous->pass;
+		if (newPass)
+		{
+			backend.beginPass(packet.pass);
+			stats.passChanges++;
+		}
+		if (newPass || packet.shader != previous->shader)
+		{
+			backend.bindShader(packet.shader);
+			stats.shaderChanges++;
+		}
+		if (newPass || packet.material != previous->material)
+		{
+			backend.bindMaterial(packet.material);
+			stats.materialChanges++;
+		}
+		if (newPass || packet.mesh != previous->mesh)
+		{
+			backend.bindMesh(packet.mesh);
+			stats.meshChanges++;
+		}
+
+		// Gather the run of packets that only differ by world matrix into one instanced draw.
+		size_t end = i + 1;
+		if (instancing && packet.instancedShader && packet.rangeCount == 0)
+		{
+			while (end < items.size() && canBatch(packet, packets[items[end].packet]))
+			{
+				end++;
+			}
+		}
+
+		if (end - i > 1)
+		{
+			batchWorlds.clear();
+			for (size_t j = i; j < end; j++)
+			{
+				batchWorlds.push_back(packets[items[j].packet].world);
+			}
+			backend.drawInstanced(packet, &batchWorlds[0], (int)batchWorlds.size());
+			stats.instancedPackets += (int)batchWorlds.size();
+			i = end - 1;
+		}
+		else
+		{
+			backend.draw(packet, packet.rangeCount > 0 ? &ranges[packet.rangeStart] : nullptr);
+		}
+		stats.draws++;
+		previous = &packet;
+	}
+}
+
+void RenderQueue::clear()
+{
+	packets.clear();
+	ranges.clear();
+	items.clear();
+}
+
+float RenderQueue::getViewDepth(const XMMATRIX& world, const XMMATRIX& view)
+{
+	return std::max(XMVectorGetZ(XMVector3TransformCoord(world.r[3], view)), 0.0f);
+}
+
+void RenderQueue::benchmark(FILE* report)
+{
+	const int packetCounts[] = { 1000, 10000, 100000 };
+	const int shaderCount = 8;
+	const int materialCount = 64;
+	const int meshCount = 32;
+	const int passCount = 2;
+	const int runs = 20;
+
+	Benchmark::report(report, "Render queue, random packets over %d passes, %d shaders, %d materials and %d meshes, against a null backend. Best of %d runs\n",
+		passCount, shaderCount, materialCount, meshCount, runs);
+	Benchmark::report(report, "%10s %12s %14s %14s %16s %16s %12s %14s\n", "packets", "radix ms", "std::sort ms", "execute ms", "changes before", "changes sorted",
+		"draws", "instanced draws");
+
+	// Stand ins for the meshes, shaders and materials. Only their addresses matter.
+	char meshes[meshCount], shaders[shaderCount], materials[materialCount];
+
+	for (int c = 0; c < (int)(sizeof(packetCounts) / sizeof(packetCounts[0])); c++)
+	{
+		std::mt19937 random(1);
+		std::uniform_real_distribution<float> depths(0.0f, 500.0f);
+		RenderQueue queue;
+		for (int i = 0; i < packetCounts[c]; i++)
+		{
+			PacketType packet = {};
+			packet.mesh = &meshes[random() % meshCount];
+			packet.shader = &shaders[random() % shaderCount];
+			packet.instancedShader = packet.shader;
+			packet.material = &materials[random() % materialCount];
+			XMStoreFloat4x4(&packet.world, XMMatrixIdentity());
+			packet.depth = depths(random);
+			packet.pass = random() % passCount;
+			packet.indexCount = 36;
+			queue.submit(packet);
+		}
+
+		// Submission order first, as the hand written passes drew.
+		NullBackend backend;
+		queue.execute(backend);
+		StatsType before = queue.getStats();
+		int changesBefore = before.passChanges + before.shaderChanges + before.materialChanges + before.meshChanges;
+
+		std::vector<SortItem> unsorted = queue.items;
+		double radixTime = 1e30, standardTime = 1e30, executeTime = 1e30;
+		for (int run = 0; run < runs; run++)
+		{
+			queue.items = unsorted;
+			queue.sort();
+			radixTime = std::min(radixTime, queue.getStats().sortTime);
+
+			std::vector<SortItem> copy = unsorted;
+			double start = Benchmark::seconds();
+			std::stable_sort(copy.begin(), copy.end(), [](const SortItem& a, const SortItem& b) { return a.key < b.key; });
+			standardTime = std::min(standardTime, Benchmark::seconds() - start);
+
+			start = Benchmark::seconds();
+			queue.execute(backend);
+			executeTime = std::min(executeTime, Benchmark::seconds() - start);
+		}
+		StatsType after = queue.getStats();
+		int changesSorted = after.passChanges + after.shaderChanges + after.materialChanges + after.meshChanges;
+
+		// The same sorted packets drawn one at a time.
+		queue.setInstancing(false);
+		queue.execute(backend);
+		int draws = queue.getStats().draws;
+
+		Benchmark::report(report, "%10d %12.3f %14.3f %14.3f %16d %16d %12d %14d\n", packetCounts[c], radixTime * 1000.0, standardTime * 1000.0, executeTime * 1000.0,
+			changesBefore, changesSorted, draws, after.draws);
+	}
+}
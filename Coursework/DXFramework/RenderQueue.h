@@ -0,0 +1,143 @@
+/**
+* \class RenderQueue
+*
+* \brief Collects draw packets, sorts them on a 64 bit key and draws them with as few state changes as it can
+*
+* Passes submit a packet per draw (mesh, shader, material, world matrix and pass) instead of drawing straight away.
+* Each packet gets a key of pass, then shader, then material, then view depth, and the keys are radix sorted, so
+* packets sharing a shader and texture end up next to each other and are drawn front to back within them.
+* Executing walks the sorted packets and only tells the backend about a pass, mesh, shader or material when it
+* changes. The backend does the drawing; NullBackend draws nothing, so the sort and the state changes it saves can
+* be measured without a device (see benchmark()).
+*
+* Packets that give an instancedShader are batched: a run of them with the same pass, shader, material, mesh, index
+* range and parameters becomes one drawInstanced() call with the run's world matrices, so each repeated object only
+* costs a 64 byte matrix.
+*
+* Key layout, high bits first: pass (8 bits), shader (10), material (14), mesh (8), depth (24). Shaders, materials
+* and meshes are numbered in the order the queue first sees them. Past 1024 shaders, 16384 materials or 256 meshes
+* the numbers wrap, which only costs grouping, never correctness. The depth keeps the top 24 bits of the float.
+*/
+
+
+#ifndef _RENDERQUEUE_H_
+#define _RENDERQUEUE_H_
+
+#include "MeshletBuilder.h"
+#include <directxmath.h>
+#include <cstdio>
+#include <unordered_map>
+#include <vector>
+
+using namespace DirectX;
+
+class RenderQueue
+{
+public:
+	/// One draw. The mesh, shader and material are only compared and handed back to the backend, never used by the queue.
+	struct PacketType
+	{
+		const void* mesh;
+		const void* shader;
+		const void* material;		///< Usually the texture
+		XMFLOAT4X4 world;
+		XMFLOAT4 parameters;		///< Shader specific, such as a specular power or a colour
+		const void* instancedShader;	///< Shader that draws many copies of the mesh in one call, null to always draw the packet alone
+		float depth;				///< View space depth of the object, for front to back order. See getViewDepth().
+		int pass;					///< Packets are drawn pass by pass, in increasing order. 0 to 255.
+		unsigned int indexCount;	///< Index range to draw, when the packet has no ranges
+		unsigned int indexStart;
+		unsigned int rangeStart;	///< Set by submit(), the packet's ranges in the queue
+		unsigned int rangeCount;
+	};
+
+	/// Draws what the queue hands it. Binds are only called when the value changes from the previous packet, and again after every new pass.
+	class Backend
+	{
+	public:
+		virtual ~Backend() {}
+		virtual void beginPass(int pass) {}
+		virtual void bindMesh(const void* mesh) {}
+		virtual void bindShader(const void* shader) {}
+		virtual void bindMaterial(const void* material) {}
+		/// ranges is null when the packet draws its single index range.
+		virtual void draw(const PacketType& packet, const MeshletBuilder::RangeType* ranges) = 0;
+		/// Draws count copies of first's index range with first.instancedShader, one per world matrix. The copies share everything else with first.
+		virtual void drawInstanced(const PacketType& first, const XMFLOAT4X4* worlds, int count) = 0;
+	};
+
+	/// Backend without a device. Counts the draws, for benchmarks and for checking the queue.
+	class NullBackend : public Backend
+	{
+	public:
+		NullBackend() : draws(0) {}
+		void draw(const PacketType& packet, const MeshletBuilder::RangeType* ranges) override { draws++; }
+		void drawInstanced(const PacketType& first, const XMFLOAT4X4* worlds, int count) override { draws++; }
+		int draws;
+	};
+
+	/// What the last execute() did.
+	struct StatsType
+	{
+		int packets;
+		int passChanges;
+		int meshChanges;
+		int shaderChanges;
+		int materialChanges;
+		int draws;					///< Draw calls, counting a batch of instances as one
+		int instancedPackets;		///< Packets drawn in batches
+		double sortTime;			///< Seconds spent in sort()
+	};
+
+	RenderQueue();
+
+	/// Adds a packet that draws its indexCount indices from indexStart.
+	void submit(const PacketType& packet);
+	/// Adds a packet that draws each of ranges, such as the parts left after BaseMesh::cullSubmeshes(). The ranges are copied.
+	void submit(const PacketType& packet, const std::vector<MeshletBuilder::RangeType>& ranges);
+
+	/// Sorts the packets by key. Stable, so packets with the same key keep their submission order.
+	void sort();
+	/// Hands the sorted packets to the backend, binding only what changes, and records the stats.
+	void execute(Backend& backend);
+	/// Empties the queue for the next frame or view. Keeps the memory and the shader and material numbering.
+	void clear();
+	/// Turns batching of instanced packets on or off. On by default.
+	void setInstancing(bool enabled) { instancing = enabled; }
+
+	int getPacketCount() { return (int)packets.size(); }
+	const StatsType& getStats() { return stats; }
+
+	/// View space depth of the world matrix's origin, clamped to 0 behind the viewer.
+	static float getViewDepth(const XMMATRIX& world, const XMMATRIX& view);
+
+	/** \brief Sorts and executes thousands of random packets against a NullBackend.
+	* Compares the radix sort with std::sort, and the state changes of submission order with sorted order.
+	* @param report is an open file to write the results to
+	*/
+	static void benchmark(FILE* report);
+
+private:
+	struct SortItem
+	{
+		unsigned long long key;
+		unsigned int packet;
+	};
+
+	unsigned int getNumber(std::unordered_map<const void*, unsigned int>& numbers, const void* pointer);
+	unsigned long long makeKey(const PacketType& packet);
+	bool canBatch(const PacketType& first, const PacketType& packet);
+
+	std::vector<PacketType> packets;
+	std::vector<MeshletBuilder::RangeType> ranges;
+	std::vector<SortItem> items;
+	std::vector<SortItem> scratch;
+	std::unordered_map<const void*, unsigned int> shaderNumbers;
+	std::unordered_map<const void*, unsigned int> materialNumbers;
+	std::unordered_map<const void*, unsigned int> meshNumbers;
+	std::vector<XMFLOAT4X4> batchWorlds;
+	StatsType stats;
+	bool instancing;
+};
+
+#endif
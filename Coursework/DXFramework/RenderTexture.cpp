@@ -1,6 +1,7 @@
 // render texture
 // alternative render target
 #include "rendertexture.h"
+#include "StateCache.h"
 
 // Initialise texture object based on provided dimensions. Usually to match window.
 RenderTexture::RenderTexture(ID3D11Device* device, int ltextureWidth, int ltextureHeight, float screenNear, float screenFar)
@@ -127,6 +128,7 @@ RenderTexture::~RenderTexture()
 void RenderTexture::setRenderTarget(ID3D11DeviceContext* deviceContext)
 {
 	deviceContext->OMSetRenderTargets(1, &renderTargetView, depthStencilView);
+	StateCache::get(deviceContext)->invalidateShaderResources(); // Binding the texture unbinds its shader resource view.
 	deviceContext->RSSetViewports(1, &viewport);
 }
 
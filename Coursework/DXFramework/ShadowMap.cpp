@@ -1,4 +1,5 @@
 #include "ShadowMap.h"
+#include "StateCache.h"
 
 ShadowMap::ShadowMap(ID3D11Device* device, int mWidth, int mHeight)
 {
@@ -61,6 +62,7 @@ void ShadowMap::BindDsvAndSetNullRenderTarget(ID3D11DeviceContext* dc)
 	// Setting a null render target will disable color writes.
 	//ID3D11RenderTargetView* renderTargets[1] = { 0 };
 	dc->OMSetRenderTargets(1, renderTargets, mDepthMapDSV);
+	StateCache::get(dc)->invalidateShaderResources(); // Binding the depth map unbinds its shader resource view.
 
 	dc->ClearDepthStencilView(mDepthMapDSV, D3D11_CLEAR_DEPTH, 1.0f, 0);
 }
@@ -1,572 +1,193 @@
 // Sphere Mesh
 // Generates a cube sphere.
 #include "spheremesh.h"
+#include "VertexGenerator.h"
+#include <algorithm>
 
 // Store shape resolution (default is 20), initialise buffers and load texture.
 SphereMesh::SphereMesh(ID3D11Device* device, ID3D11DeviceContext* deviceContext, int lresolution)
 {
-	resolution = lresolution;
+	resolution = std::max(lresolution, 1);
 	initBuffers(device);
 }
 
 // Release resources.
 SphereMesh::~SphereMesh()
 {
-	// Run parent deconstructor
-	BaseMesh::~BaseMesh();
+	// BaseMesh's destructor runs after this one and releases the buffers.
 }
 
-// Generate sphere. Generates a cube based on resolution provided. Then normalises vertex positions to create sphere.
+// Generate sphere. Generates a cube based on resolution provided. Then maps the vertex positions evenly onto the sphere.
 // Shape has texture coordinates and normals.
 void SphereMesh::initBuffers(ID3D11Device* device)
 {
 	VertexType* vertices;
 	unsigned long* indices;
-	D3D11_BUFFER_DESC vertexBufferDesc, indexBufferDesc;
-	D3D11_SUBRESOURCE_DATA vertexData, indexData;
-	
-	// 6 vertices per quad, res*res is face, times 6 for each face
-	vertexCount = ((6 * resolution)*resolution) * 6;
-	indexCount = vertexCount;
+	int faceSize = resolution + 1;
 
-	vertices = new VertexType[vertexCount];
-	indices = new unsigned long[indexCount];
-
-	// Vertex variables
-	float yincrement = 2.0f / resolution;
-	float xincrement = 2.0f / resolution;
-	float ystart = 1.0f;
-	float xstart = -1.0f;
-	//UV variables
-	float txu = 0.0f;
-	float txv = 0.0f;
-	float txuinc = 1.0f / resolution;	// UV increment
-	float txvinc = 1.0f / resolution;
-	//Counters
-	int v = 0;	// vertex counter
-	int i = 0;	// index counter
-
-	//front face
-
-	for (int y = 0; y<resolution; y++)	// for each quad in the y direction
+	// A level for every resolution that divides the full one, so the coarser grids land on the full grid's vertices.
+	lodSteps.clear();
+	for (int step = 1; step <= resolution; step++)
 	{
-		for (int x = 0; x < resolution; x++)	// for each quad in the x direction
+		if (resolution % step == 0)
 		{
-			// Load the vertex array with data.
-			//0
-			vertices[v].position = XMFLOAT3(xstart, ystart - yincrement, -1.0f);  // Bottom left. -1. -1. 0
-			vertices[v].texture = XMFLOAT2(txu, txv + txvinc);
-			vertices[v].normal = XMFLOAT3(0.0f, 0.0f, -1.0f);
-
-			indices[i] = i;
-			v++;
-			i++;
-
-			//1
-			vertices[v].position = XMFLOAT3(xstart + xincrement, ystart, -1.0f);  // Top right.	1.0, 1.0 0.0
-			vertices[v].texture = XMFLOAT2(txu+txuinc, txv);
-			vertices[v].normal = XMFLOAT3(0.0f, 0.0f, -1.0f);
-
-			indices[i] = i;
-			v++;
-			i++;
-
-			//2
-			vertices[v].position = XMFLOAT3(xstart, ystart, -1.0f);  // Top left.	-1.0, 1.0
-			vertices[v].texture = XMFLOAT2(txu, txv);
-			vertices[v].normal = XMFLOAT3(0.0f, 0.0f, -1.0f);
-
-			indices[i] = i;
-			v++;
-			i++;
-			
-			//0
-			vertices[v].position = XMFLOAT3(xstart, ystart - yincrement, -1.0f);  // Bottom left. -1. -1. 0
-			vertices[v].texture = XMFLOAT2(txu, txv+txvinc);
-			vertices[v].normal = XMFLOAT3(0.0f, 0.0f, -1.0f);
-
-			indices[i] = i;
-			v++;
-			i++;
-			
-			//3
-			vertices[v].position = XMFLOAT3(xstart + xincrement, ystart - yincrement, -1.0f);  // Bottom right.	1.0, -1.0, 0.0
-			vertices[v].texture = XMFLOAT2(txu+txuinc, txv+txvinc);
-			vertices[v].normal = XMFLOAT3(0.0f, 0.0f, -1.0f);
-
-			indices[i] = i;
-			v++;
-			i++;
-
-			//1
-			vertices[v].position = XMFLOAT3(xstart + xincrement, ystart, -1.0f);  // Top right.	1.0, 1.0 0.0
-			vertices[v].texture = XMFLOAT2(txu+txuinc, txv);
-			vertices[v].normal = XMFLOAT3(0.0f, 0.0f, -1.0f);
-
-			indices[i] = i;
-			v++;
-			i++;
-			
-			// increment
-			xstart += xincrement;
-			txu += txuinc;
-			//ystart -= yincrement;
-
+			lodSteps.push_back(step);
 		}
-
-		ystart -= yincrement;
-		xstart = -1;
-
-		txu = 0;
-		txv += txvinc;
-
 	}
 
-	txv = 0;
+	// (res + 1)^2 vertices per face. The edges aren't shared between faces, as each face has its own texture coordinates.
+	vertexCount = faceSize * faceSize * 6;
+	vertices = new VertexType[vertexCount];
 
-	//back face
-	ystart = 1;
-	xstart = 1;
-	for (int y = 0; y<resolution; y++)	// for each quad in the y direction
+	// Each face's cube points are bent onto the sphere, spreading the vertices more evenly than normalising.
+	for (int face = 0; face < 6; face++)
 	{
-		for (int x = 0; x < resolution; x++)	// for each quad in the x direction
+		for (int y = 0; y < faceSize; y++)
 		{
-			// Load the vertex array with data.
-			//0
-			vertices[v].position = XMFLOAT3(xstart, ystart - yincrement, 1.0f);  // Bottom left. -1. -1. 0
-			vertices[v].texture = XMFLOAT2(txu, txv+txvinc);
-			vertices[v].normal = XMFLOAT3(0.0f, 0.0f, 1.0f);
-
-			indices[i] = i;
-			v++;
-			i++;
-
-			//2
-			vertices[v].position = XMFLOAT3(xstart - xincrement, ystart, 1.0f);  // Top right.	1.0, 1.0 0.0
-			vertices[v].texture = XMFLOAT2(txu+txuinc, txv);
-			vertices[v].normal = XMFLOAT3(0.0f, 0.0f, 1.0f);
-
-			indices[i] = i;
-			v++;
-			i++;
-
-			//1
-			vertices[v].position = XMFLOAT3(xstart, ystart, 1.0f);  // Top left.	-1.0, 1.0
-			vertices[v].texture = XMFLOAT2(txu, txv);
-			vertices[v].normal = XMFLOAT3(0.0f, 0.0f, 1.0f);
-
-			indices[i] = i;
-			v++;
-			i++;
-			
-			//0
-			vertices[v].position = XMFLOAT3(xstart, ystart - yincrement, 1.0f);  // Bottom left. -1. -1. 0
-			vertices[v].texture = XMFLOAT2(txu, txv+txvinc);
-			vertices[v].normal = XMFLOAT3(0.0f, 0.0f, 1.0f);
-
-			indices[i] = i;
-			v++;
-			i++;
-
-			//3
-			vertices[v].position = XMFLOAT3(xstart - xincrement, ystart - yincrement, 1.0f);  // Bottom right.	1.0, -1.0, 0.0
-			vertices[v].texture = XMFLOAT2(txu+txuinc, txv+txvinc);
-			vertices[v].normal = XMFLOAT3(0.0f, 0.0f, 1.0f);
-
-			indices[i] = i;
-			v++;
-			i++;
-
-			//2
-			vertices[v].position = XMFLOAT3(xstart - xincrement, ystart, 1.0f);  // Top right.	1.0, 1.0 0.0
-			vertices[v].texture = XMFLOAT2(txu+txuinc, txv);
-			vertices[v].normal = XMFLOAT3(0.0f, 0.0f, 1.0f);
-
-			indices[i] = i;
-			v++;
-			i++;
-
-			// increment
-			xstart -= xincrement;
-			//ystart -= yincrement;
-			txu += txuinc;
-
+			VertexGenerator::writeSphereRow(reinterpret_cast<PrimitiveShapes::VertexType*>(vertices + (face * faceSize + y) * faceSize), PrimitiveShapes::cubeFaces[face], y, resolution);
 		}
-
-		ystart -= yincrement;
-		xstart = 1;
-
-		txu = 0;
-		txv += txvinc;
-
 	}
 
-	txv = 0;
-
-	//right face
-	ystart = 1;
-	xstart = -1;
-	for (int y = 0; y<resolution; y++)	// for each quad in the y direction
+	// Every level's triangles, one after the other. Six indices per quad on each face.
+	lods.clear();
+	unsigned int totalIndexCount = 0;
+	for (size_t lod = 0; lod < lodSteps.size(); lod++)
 	{
-		for (int x = 0; x < resolution; x++)	// for each quad in the x direction
-		{
-			// Load the vertex array with data.
-			//0
-			vertices[v].position = XMFLOAT3(1.0f, ystart - yincrement, xstart);  // Bottom left. -1. -1. 0
-			vertices[v].texture = XMFLOAT2(txu, txv+txvinc);
-			vertices[v].normal = XMFLOAT3(1.0f, 0.0f, 0.0f);
-
-			indices[i] = i;
-			v++;
-			i++;
-
-			//2
-			vertices[v].position = XMFLOAT3(1.0f, ystart, xstart + xincrement);  // Top right.	1.0, 1.0 0.0
-			vertices[v].texture = XMFLOAT2(txu+txuinc, txv);
-			vertices[v].normal = XMFLOAT3(1.0f, 0.0f, 0.0f);
-
-			indices[i] = i;
-			v++;
-			i++;
-
-			//1
-			vertices[v].position = XMFLOAT3(1.0f, ystart, xstart);  // Top left.	-1.0, 1.0
-			vertices[v].texture = XMFLOAT2(txu, txv);
-			vertices[v].normal = XMFLOAT3(1.0f, 0.0f, 0.0f);
-
-			indices[i] = i;
-			v++;
-			i++;
-			
-			//0
-			vertices[v].position = XMFLOAT3(1.0f, ystart - yincrement, xstart);  // Bottom left. -1. -1. 0
-			vertices[v].texture = XMFLOAT2(txu, txv+txvinc);
-			vertices[v].normal = XMFLOAT3(1.0f, 0.0f, 0.0f);
-
-			indices[i] = i;
-			v++;
-			i++;
-			
-			//3
-			vertices[v].position = XMFLOAT3(1.0f, ystart - yincrement, xstart + xincrement);  // Bottom right.	1.0, -1.0, 0.0
-			vertices[v].texture = XMFLOAT2(txu+txuinc, txv+txvinc);
-			vertices[v].normal = XMFLOAT3(1.0f, 0.0f, 0.0f);
-
-			indices[i] = i;
-			v++;
-			i++;
-
-			//2
-			vertices[v].position = XMFLOAT3(1.0f, ystart, xstart + xincrement);  // Top right.	1.0, 1.0 0.0
-			vertices[v].texture = XMFLOAT2(txu+txuinc, txv);
-			vertices[v].normal = XMFLOAT3(1.0f, 0.0f, 0.0f);
-
-			indices[i] = i;
-			v++;
-			i++;
-			
-			// increment
-			xstart += xincrement;
-			//ystart -= yincrement;
-			txu += txuinc;
-
-		}
-
-		ystart -= yincrement;
-		xstart = -1;
-		txu = 0;
-		txv += txvinc;
+		int quads = resolution / lodSteps[lod];
+		MeshSimplifier::LodType level = { totalIndexCount, (unsigned int)(quads * quads * 6 * 6), 0.0f, 0 };
+		lods.push_back(level);
+		totalIndexCount += level.indexCount;
 	}
+	indexCount = lods[0].indexCount;
+	indices = new unsigned long[totalIndexCount];
 
-	txv = 0;
-
-	//left face
-	ystart = 1;
-	xstart = 1;
-	for (int y = 0; y < resolution; y++)	// for each quad in the y direction
+	int i = 0;
+	for (size_t lod = 0; lod < lodSteps.size(); lod++)
 	{
-		for (int x = 0; x < resolution; x++)	// for each quad in the x direction
+		int step = lodSteps[lod];
+		for (int face = 0; face < 6; face++)
 		{
-			// Load the vertex array with data.
-			//0
-			vertices[v].position = XMFLOAT3(-1.0f, ystart - yincrement, xstart);  // Bottom left. -1. -1. 0
-			vertices[v].texture = XMFLOAT2(txu, txv+txvinc);
-			vertices[v].normal = XMFLOAT3(-1.0f, 0.0f, 0.0f);
-
-			indices[i] = i;
-			v++;
-			i++;
-
-			//2
-			vertices[v].position = XMFLOAT3(-1.0f, ystart, xstart - xincrement);  // Top right.	1.0, 1.0 0.0
-			vertices[v].texture = XMFLOAT2(txu+txuinc, txv);
-			vertices[v].normal = XMFLOAT3(-1.0f, 0.0f, 0.0f);
-
-			indices[i] = i;
-			v++;
-			i++;
-
-			//1
-			vertices[v].position = XMFLOAT3(-1.0f, ystart, xstart);  // Top left.	-1.0, 1.0
-			vertices[v].texture = XMFLOAT2(txu, txv);
-			vertices[v].normal = XMFLOAT3(-1.0f, 0.0f, 0.0f);
-
-			indices[i] = i;
-			v++;
-			i++;
-			
-			//0
-			vertices[v].position = XMFLOAT3(-1.0f, ystart - yincrement, xstart);  // Bottom left. -1. -1. 0
-			vertices[v].texture = XMFLOAT2(txu, txv+txvinc);
-			vertices[v].normal = XMFLOAT3(-1.0f, 0.0f, 0.0f);
-
-			indices[i] = i;
-			v++;
-			i++;
-
-			//3
-			vertices[v].position = XMFLOAT3(-1.0f, ystart - yincrement, xstart - xincrement);  // Bottom right.	1.0, -1.0, 0.0
-			vertices[v].texture = XMFLOAT2(txu+txuinc, txv+txvinc);
-			vertices[v].normal = XMFLOAT3(-1.0f, 0.0f, 0.0f);
-
-			indices[i] = i;
-			v++;
-			i++;
-
-			//2
-			vertices[v].position = XMFLOAT3(-1.0f, ystart, xstart - xincrement);  // Top right.	1.0, 1.0 0.0
-			vertices[v].texture = XMFLOAT2(txu+txuinc, txv);
-			vertices[v].normal = XMFLOAT3(-1.0f, 0.0f, 0.0f);
-
-			indices[i] = i;
-			v++;
-			i++;
-
-			// increment
-			xstart -= xincrement;
-			//ystart -= yincrement;
-			txu += txuinc;
+			unsigned long faceStart = face * faceSize * faceSize;
+			for (int y = 0; y < resolution; y += step)
+			{
+				for (int x = 0; x < resolution; x += step)
+				{
+					unsigned long topLeft = faceStart + y * faceSize + x;
+					unsigned long topRight = topLeft + step;
+					unsigned long bottomLeft = topLeft + step * faceSize;
+					unsigned long bottomRight = bottomLeft + step;
+
+					// Same corners and winding as the quads had with their own vertices.
+					indices[i++] = bottomLeft;
+					indices[i++] = topRight;
+					indices[i++] = topLeft;
+
+					indices[i++] = bottomLeft;
+					indices[i++] = bottomRight;
+					indices[i++] = topRight;
+				}
+			}
 		}
-
-		ystart -= yincrement;
-		xstart = 1;
-		txu = 0;
-		txv += txvinc;
 	}
-	
-	txv = 0;
-
-	//top face
-	ystart = 1;
-	xstart = -1;
-
-	for (int y = 0; y<resolution; y++)	// for each quad in the y direction
-	{
-		for (int x = 0; x < resolution; x++)	// for each quad in the x direction
-		{
-			// Load the vertex array with data.
-			//0
-			vertices[v].position = XMFLOAT3(xstart, 1.0f, ystart - yincrement);  // Bottom left. -1. -1. 0
-			vertices[v].texture = XMFLOAT2(txu, txv+txvinc);
-			vertices[v].normal = XMFLOAT3(0.0f, 1.0f, 0.0f);
-
-			indices[i] = i;
-			v++;
-			i++;
-
-			//2
-			vertices[v].position = XMFLOAT3(xstart + xincrement, 1.0f, ystart);  // Top right.	1.0, 1.0 0.0
-			vertices[v].texture = XMFLOAT2(txu+txuinc, txv);
-			vertices[v].normal = XMFLOAT3(0.0f, 1.0f, 0.0f);
-
-			indices[i] = i;
-			v++;
-			i++;
-
-			//1
-			vertices[v].position = XMFLOAT3(xstart, 1.0f, ystart);  // Top left.	-1.0, 1.0
-			vertices[v].texture = XMFLOAT2(txu, txv);
-			vertices[v].normal = XMFLOAT3(0.0f, 1.0f, 0.0f);
 
-			indices[i] = i;
-			v++;
-			i++;
-			
-			//0
-			vertices[v].position = XMFLOAT3(xstart, 1.0f, ystart - yincrement);  // Bottom left. -1. -1. 0
-			vertices[v].texture = XMFLOAT2(txu, txv+txvinc);
-			vertices[v].normal = XMFLOAT3(0.0f, 1.0f, 0.0f);
+	measureErrors(vertices, indices);
 
-			indices[i] = i;
-			v++;
-			i++;
+	// Create the vertex and index buffers.
+	createVertexBuffer(device, vertices);
+	createIndexBuffer(device, indices);
 
-			//3
-			vertices[v].position = XMFLOAT3(xstart + xincrement, 1.0f, ystart - yincrement);  // Bottom right.	1.0, -1.0, 0.0
-			vertices[v].texture = XMFLOAT2(txu+txuinc, txv+txvinc);
-			vertices[v].normal = XMFLOAT3(0.0f, 1.0f, 0.0f);
+	// Release the arrays now that the vertex and index buffers have been created and loaded.
+	delete[] vertices;
+	vertices = 0;
+	delete[] indices;
+	indices = 0;
+}
 
-			indices[i] = i;
-			v++;
-			i++;
+void SphereMesh::measureErrors(const VertexType* vertices, const unsigned long* indices)
+{
+	// Barycentric points checked on each triangle: the centre and the middle of each edge.
+	const float samples[4][3] = { { 1.0f / 3.0f, 1.0f / 3.0f, 1.0f / 3.0f }, { 0.5f, 0.5f, 0.0f }, { 0.0f, 0.5f, 0.5f }, { 0.5f, 0.0f, 0.5f } };
 
-			//2
-			vertices[v].position = XMFLOAT3(xstart + xincrement, 1.0f, ystart);  // Top right.	1.0, 1.0 0.0
-			vertices[v].texture = XMFLOAT2(txu+txuinc, txv);
-			vertices[v].normal = XMFLOAT3(0.0f, 1.0f, 0.0f);
+	insideErrors.assign(lods.size(), 0.0f);
+	for (size_t lod = 0; lod < lods.size(); lod++)
+	{
+		int faceSize = resolution + 1;
+		int triangles = lods[lod].indexCount / 3;
+		int faceTriangles = triangles / 6;
+		float error = 0.0f;
+		float insideError = 0.0f;
 
-			indices[i] = i;
-			v++;
-			i++;
-			
-			// increment
-			xstart += xincrement;
-			//ystart -= yincrement;
-			txu += txuinc;
+		for (int triangle = 0; triangle < triangles; triangle++)
+		{
+			const unsigned long* corner = indices + lods[lod].indexStart + triangle * 3;
+			XMVECTOR a = XMLoadFloat3(&vertices[corner[0]].position);
+			XMVECTOR b = XMLoadFloat3(&vertices[corner[1]].position);
+			XMVECTOR c = XMLoadFloat3(&vertices[corner[2]].position);
+
+			// The flat triangle is never further inside the sphere than its plane is from the centre.
+			XMVECTOR normal = XMVector3Normalize(XMVector3Cross(b - a, c - a));
+			error = std::max(error, 1.0f - fabsf(XMVectorGetX(XMVector3Dot(normal, a))));
+
+			// From the centre, compare the direction a point's texture coordinate shows in with where level 0 shows that coordinate.
+			const VertexType* face = vertices + (triangle / faceTriangles) * faceSize * faceSize;
+			for (int s = 0; s < 4; s++)
+			{
+				XMVECTOR point = a * samples[s][0] + b * samples[s][1] + c * samples[s][2];
+				float u = vertices[corner[0]].texture.x * samples[s][0] + vertices[corner[1]].texture.x * samples[s][1] + vertices[corner[2]].texture.x * samples[s][2];
+				float t = vertices[corner[0]].texture.y * samples[s][0] + vertices[corner[1]].texture.y * samples[s][1] + vertices[corner[2]].texture.y * samples[s][2];
+				XMVECTOR target = getLevelZeroPoint(face, faceSize, u, t);
+				float chord = XMVectorGetX(XMVector3Length(XMVector3Normalize(point) - XMVector3Normalize(target)));
+				insideError = std::max(insideError, 2.0f * asinf(std::min(chord * 0.5f, 1.0f)));
+			}
 		}
 
-		ystart -= yincrement;
-		xstart = -1;
-		txu = 0;
-		txv += txvinc;
+		// Coarser levels never count as closer, so selecting can stop at the first level that is too far out.
+		if (lod > 0)
+		{
+			error = std::max(error, lods[lod - 1].error);
+			insideError = std::max(insideError, insideErrors[lod - 1]);
+		}
+		lods[lod].error = error;
+		insideErrors[lod] = insideError;
 	}
+}
 
-	txv = 0;
-	
-	//bottom face
-	ystart = -1;
-	xstart = -1;
+int SphereMesh::selectInsideLod(const XMMATRIX& projection, float viewportHeight, float pixelError)
+{
+	// Pixels covered by one radian in the middle of the screen. The texture moves least at the edges, so this never underestimates.
+	XMFLOAT4X4 projectionValues;
+	XMStoreFloat4x4(&projectionValues, projection);
+	float pixelsPerRadian = projectionValues.m[1][1] * viewportHeight * 0.5f;
 
-	for (int y = 0; y<resolution; y++)	// for each quad in the y direction
+	int lod = 0;
+	for (int i = 1; i < (int)insideErrors.size(); i++)
 	{
-		for (int x = 0; x < resolution; x++)	// for each quad in the x direction
+		if (insideErrors[i] * pixelsPerRadian <= pixelError)
 		{
-			// Load the vertex array with data.
-			//0
-			vertices[v].position = XMFLOAT3(xstart, -1.0f, ystart + yincrement);  // Bottom left. -1. -1. 0
-			vertices[v].texture = XMFLOAT2(txu, txv+txvinc);
-			vertices[v].normal = XMFLOAT3(0.0f, -1.0f, 0.0f);
-
-			indices[i] = i;
-			v++;
-			i++;
-
-			//2
-			vertices[v].position = XMFLOAT3(xstart + xincrement, -1.0f, ystart);  // Top right.	1.0, 1.0 0.0
-			vertices[v].texture = XMFLOAT2(txu+txuinc, txv);
-			vertices[v].normal = XMFLOAT3(0.0f, -1.0f, 0.0f);
-
-			indices[i] = i;
-			v++;
-			i++;
-
-			//1
-			vertices[v].position = XMFLOAT3(xstart, -1.0f, ystart);  // Top left.	-1.0, 1.0
-			vertices[v].texture = XMFLOAT2(txu, txv);
-			vertices[v].normal = XMFLOAT3(0.0f, -1.0f, 0.0f);
-
-			indices[i] = i;
-			v++;
-			i++;
-			
-			//0
-			vertices[v].position = XMFLOAT3(xstart, -1.0f, ystart + yincrement);  // Bottom left. -1. -1. 0
-			vertices[v].texture = XMFLOAT2(txu, txv+txvinc);
-			vertices[v].normal = XMFLOAT3(0.0f, -1.0f, 0.0f);
-
-			indices[i] = i;
-			v++;
-			i++;
-
-			//3
-			vertices[v].position = XMFLOAT3(xstart + xincrement, -1.0f, ystart + yincrement);  // Bottom right.	1.0, -1.0, 0.0
-			vertices[v].texture = XMFLOAT2(txu+txuinc, txv+txvinc);
-			vertices[v].normal = XMFLOAT3(0.0f, -1.0f, 0.0f);
-
-			indices[i] = i;
-			v++;
-			i++;
-
-			//2
-			vertices[v].position = XMFLOAT3(xstart + xincrement, -1.0f, ystart);  // Top right.	1.0, 1.0 0.0
-			vertices[v].texture = XMFLOAT2(txu+txuinc, txv);
-			vertices[v].normal = XMFLOAT3(0.0f, -1.0f, 0.0f);
-
-			indices[i] = i;
-			v++;
-			i++;
-
-			// increment
-			xstart += xincrement;
-			//ystart -= yincrement;
-			txu += txuinc;
+			lod = i;
 		}
-
-		ystart += yincrement;
-		xstart = -1;
-		txu = 0;
-		txv += txvinc;
 	}
+	return lod;
+}
 
-	// now loop over every vertex and bend into a sphere (normalise the vertices)
-	float x = 0;
-	float y = 0;
-	float z = 0;
-	float dx = 0;
-	float dy = 0;
-	float dz = 0;
-
-	for (int counter = 0; counter < v; counter++)
+// Texture coordinates are affine on each triangle, so the point can be found from the quad and the side of its diagonal.
+XMVECTOR SphereMesh::getLevelZeroPoint(const VertexType* face, int faceSize, float u, float v)
+{
+	int quads = faceSize - 1;
+	int x = std::min(std::max((int)(u * quads), 0), quads - 1);
+	int y = std::min(std::max((int)(v * quads), 0), quads - 1);
+	float fu = u * quads - x;
+	float fv = v * quads - y;
+
+	XMVECTOR topLeft = XMLoadFloat3(&face[y * faceSize + x].position);
+	XMVECTOR topRight = XMLoadFloat3(&face[y * faceSize + x + 1].position);
+	XMVECTOR bottomLeft = XMLoadFloat3(&face[(y + 1) * faceSize + x].position);
+	XMVECTOR bottomRight = XMLoadFloat3(&face[(y + 1) * faceSize + x + 1].position);
+
+	// The quad is split along the diagonal from bottom left to top right.
+	if (fu + fv <= 1.0f)
 	{
-		x = vertices[counter].position.x;
-		y = vertices[counter].position.y;
-		z = vertices[counter].position.z;
-
-		dx = x * sqrtf(1.0f - (y*y / 2.0f) - (z*z / 2.0f) + (y*y*z*z / 3.0f));
-		dy = y * sqrtf(1.0f - (z*z / 2.0f) - (x*x / 2.0f) + (z*z*x*x / 3.0f));
-		dz = z * sqrtf(1.0f - (x*x / 2.0f) - (y*y / 2.0f) + (x*x*y*y / 3.0f));
-
-		vertices[counter].position.x = dx;
-		vertices[counter].position.y = dy;
-		vertices[counter].position.z = dz;
-
-		vertices[counter].normal.x = dx;
-		vertices[counter].normal.y = dy;
-		vertices[counter].normal.z = dz;
+		return topLeft + (topRight - topLeft) * fu + (bottomLeft - topLeft) * fv;
 	}
-
-	// Set up the description of the static vertex buffer.
-	vertexBufferDesc.Usage = D3D11_USAGE_DEFAULT;
-	vertexBufferDesc.ByteWidth = sizeof(VertexType)* vertexCount;
-	vertexBufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-	vertexBufferDesc.CPUAccessFlags = 0;
-	vertexBufferDesc.MiscFlags = 0;
-	vertexBufferDesc.StructureByteStride = 0;
-	// Give the subresource structure a pointer to the vertex data.
-	vertexData.pSysMem = vertices;
-	vertexData.SysMemPitch = 0;
-	vertexData.SysMemSlicePitch = 0;
-	// Now create the vertex buffer.
-	device->CreateBuffer(&vertexBufferDesc, &vertexData, &vertexBuffer);
-
-	// Set up the description of the static index buffer.
-	indexBufferDesc.Usage = D3D11_USAGE_DEFAULT;
-	indexBufferDesc.ByteWidth = sizeof(unsigned long)* indexCount;
-	indexBufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
-	indexBufferDesc.CPUAccessFlags = 0;
-	indexBufferDesc.MiscFlags = 0;
-	indexBufferDesc.StructureByteStride = 0;
-	// Give the subresource structure a pointer to the index data.
-	indexData.pSysMem = indices;
-	indexData.SysMemPitch = 0;
-	indexData.SysMemSlicePitch = 0;
-	// Create the index buffer.
-	device->CreateBuffer(&indexBufferDesc, &indexData, &indexBuffer);
-
-	// Release the arrays now that the vertex and index buffers have been created and loaded.
-	delete[] vertices;
-	vertices = 0;
-	delete[] indices;
-	indices = 0;
+	return bottomRight + (bottomLeft - bottomRight) * (1.0f - fu) + (topRight - bottomRight) * (1.0f - fv);
 }
-
@@ -1,8 +1,11 @@
 // Sphere Mesh
 // Generated sphere mesh with texture coordinates and normals.
-// Uses the cube sphere normalisation method. First a cube is generated,
-// then the vertices are normalised creating a sphere.
+// Uses the cube sphere method. First a cube is generated, then its vertices
+// are mapped onto the sphere, which spaces them more evenly than normalising.
 // Resolution specifies the number of segments in the sphere (top and bottom, matches equator).
+// Each face is a grid of vertices shared by the quads around them. The index buffer holds a level of detail for every
+// resolution that divides the full one (20, 10, 5, 4, 2 and 1 by default), all drawn from the same vertices, so one
+// sphere serves every user. Pick a level with selectLod() from outside, or selectInsideLod() for a sphere around the viewer.
 
 #ifndef _SPHEREMESH_H_
 #define _SPHEREMESH_H_
@@ -18,9 +21,25 @@ public:
 	SphereMesh(ID3D11Device* device, ID3D11DeviceContext* deviceContext, int resolution = 20);
 	~SphereMesh();
 
+	int getLodResolution(int lod) { return resolution / lodSteps[lod]; }	///< Segments along each face's edge at a level
+
+	/** \brief Picks the coarsest level for a sphere drawn around the viewer, such as a skybox.
+	* From the inside the outline never shows, only how far the texture moves from where level 0 would show it.
+	* @param projection is the projection matrix the sphere will be drawn with
+	* @param viewportHeight is the height of the render target in pixels
+	* @param pixelError is the largest acceptable movement in pixels
+	*/
+	int selectInsideLod(const XMMATRIX& projection, float viewportHeight, float pixelError = 1.0f);
+
 protected:
 	void initBuffers(ID3D11Device* device);
+	/// Largest distance between each level and a perfect sphere (into lods), and largest texture movement from level 0 seen from the centre, in radians (into insideErrors).
+	void measureErrors(const VertexType* vertices, const unsigned long* indices);
+	/// Point with texture coordinate (u, v) on one face of the full resolution mesh.
+	static XMVECTOR getLevelZeroPoint(const VertexType* face, int faceSize, float u, float v);
 	int resolution;
+	std::vector<int> lodSteps;			///< Vertices each level steps over on the grid, 1 for level 0
+	std::vector<float> insideErrors;	///< Radians, see selectInsideLod()
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,479 @@
+// State cache
+// Filters out device context binds that set what is already bound.
+#include "StateCache.h"
+#include "Benchmark.h"
+#include <algorithm>
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace
+{
+	// Stands for a slot whose binding isn't known. Never a real object, and not null, which is a real binding.
+	const void* const unknown = (const void*)~(size_t)0;
+	const D3D11_PRIMITIVE_TOPOLOGY unknownTopology = (D3D11_PRIMITIVE_TOPOLOGY)-1;
+
+	// The cache for each device context that has asked for one.
+	struct CacheEntry
+	{
+		ID3D11DeviceContext* context;
+		StateCache::DeviceTarget* target;
+		StateCache* cache;
+	};
+	std::vector<CacheEntry> caches;
+}
+
+void StateCache::DeviceTarget::setInputLayout(ID3D11InputLayout* layout)
+{
+	context->IASetInputLayout(layout);
+}
+
+void StateCache::DeviceTarget::setVertexBuffers(UINT startSlot, UINT count, ID3D11Buffer* const* buffers, const UINT* strides, const UINT* offsets)
+{
+	context->IASetVertexBuffers(startSlot, count, buffers, strides, offsets);
+}
+
+void StateCache::DeviceTarget::setIndexBuffer(ID3D11Buffer* buffer, DXGI_FORMAT format, UINT offset)
+{
+	context->IASetIndexBuffer(buffer, format, offset);
+}
+
+void StateCache::DeviceTarget::setPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY topology)
+{
+	context->IASetPrimitiveTopology(topology);
+}
+
+void StateCache::DeviceTarget::setShader(StageType stage, ID3D11DeviceChild* shader)
+{
+	switch (stage)
+	{
+	case VERTEX_STAGE: context->VSSetShader((ID3D11VertexShader*)shader, NULL, 0); break;
+	case HULL_STAGE: context->HSSetShader((ID3D11HullShader*)shader, NULL, 0); break;
+	case DOMAIN_STAGE: context->DSSetShader((ID3D11DomainShader*)shader, NULL, 0); break;
+	case GEOMETRY_STAGE: context->GSSetShader((ID3D11GeometryShader*)shader, NULL, 0); break;
+	case PIXEL_STAGE: context->PSSetShader((ID3D11PixelShader*)shader, NULL, 0); break;
+	default: context->CSSetShader((ID3D11ComputeShader*)shader, NULL, 0); break;
+	}
+}
+
+void StateCache::DeviceTarget::setConstantBuffers(StageType stage, UINT startSlot, UINT count, ID3D11Buffer* const* buffers)
+{
+	switch (stage)
+	{
+	case VERTEX_STAGE: context->VSSetConstantBuffers(startSlot, count, buffers); break;
+	case HULL_STAGE: context->HSSetConstantBuffers(startSlot, count, buffers); break;
+	case DOMAIN_STAGE: context->DSSetConstantBuffers(startSlot, count, buffers); break;
+	case GEOMETRY_STAGE: context->GSSetConstantBuffers(startSlot, count, buffers); break;
+	case PIXEL_STAGE: context->PSSetConstantBuffers(startSlot, count, buffers); break;
+	default: context->CSSetConstantBuffers(startSlot, count, buffers); break;
+	}
+}
+
+void StateCache::DeviceTarget::setShaderResources(StageType stage, UINT startSlot, UINT count, ID3D11ShaderResourceView* const* views)
+{
+	switch (stage)
+	{
+	case VERTEX_STAGE: context->VSSetShaderResources(startSlot, count, views); break;
+	case HULL_STAGE: context->HSSetShaderResources(startSlot, count, views); break;
+	case DOMAIN_STAGE: context->DSSetShaderResources(startSlot, count, views); break;
+	case GEOMETRY_STAGE: context->GSSetShaderResources(startSlot, count, views); break;
+	case PIXEL_STAGE: context->PSSetShaderResources(startSlot, count, views); break;
+	default: context->CSSetShaderResources(startSlot, count, views); break;
+	}
+}
+
+void StateCache::DeviceTarget::setSamplers(StageType stage, UINT startSlot, UINT count, ID3D11SamplerState* const* samplers)
+{
+	switch (stage)
+	{
+	case VERTEX_STAGE: context->VSSetSamplers(startSlot, count, samplers); break;
+	case HULL_STAGE: context->HSSetSamplers(startSlot, count, samplers); break;
+	case DOMAIN_STAGE: context->DSSetSamplers(startSlot, count, samplers); break;
+	case GEOMETRY_STAGE: context->GSSetSamplers(startSlot, count, samplers); break;
+	case PIXEL_STAGE: context->PSSetSamplers(startSlot, count, samplers); break;
+	default: context->CSSetSamplers(startSlot, count, samplers); break;
+	}
+}
+
+StateCache::StateCache(Target& ltarget) : target(ltarget)
+{
+	invalidate();
+	memset(&stats, 0, sizeof(stats));
+	memset(&frameStats, 0, sizeof(frameStats));
+}
+
+StateCache* StateCache::get(ID3D11DeviceContext* deviceContext)
+{
+	for (size_t i = 0; i < caches.size(); i++)
+	{
+		if (caches[i].context == deviceContext)
+		{
+			return caches[i].cache;
+		}
+	}
+
+	CacheEntry entry;
+	entry.context = deviceContext;
+	entry.target = new DeviceTarget(deviceContext);
+	entry.cache = new StateCache(*entry.target);
+	caches.push_back(entry);
+	return entry.cache;
+}
+
+void StateCache::release(ID3D11DeviceContext* deviceContext)
+{
+	for (size_t i = 0; i < caches.size(); i++)
+	{
+		if (caches[i].context == deviceContext)
+		{
+			delete caches[i].cache;
+			delete caches[i].target;
+			caches.erase(caches.begin() + i);
+			return;
+		}
+	}
+}
+
+void StateCache::invalidate()
+{
+	for (int stage = 0; stage < STAGE_COUNT; stage++)
+	{
+		StageState& state = stages[stage];
+		state.shader = unknown;
+		std::fill(state.constantBuffers, state.constantBuffers + D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT, unknown);
+		std::fill(state.samplers, state.samplers + D3D11_COMMONSHADER_SAMPLER_SLOT_COUNT, unknown);
+	}
+	invalidateShaderResources();
+
+	inputLayout = unknown;
+	std::fill(vertexBuffers, vertexBuffers + D3D11_IA_VERTEX_INPUT_RESOURCE_SLOT_COUNT, unknown);
+	memset(vertexStrides, 0, sizeof(vertexStrides));
+	memset(vertexOffsets, 0, sizeof(vertexOffsets));
+	indexBuffer = unknown;
+	indexFormat = DXGI_FORMAT_UNKNOWN;
+	indexOffset = 0;
+	topology = unknownTopology;
+}
+
+void StateCache::invalidateShaderResources()
+{
+	for (int stage = 0; stage < STAGE_COUNT; stage++)
+	{
+		std::fill(stages[stage].shaderResources, stages[stage].shaderResources + D3D11_COMMONSHADER_INPUT_RESOURCE_SLOT_COUNT, unknown);
+	}
+}
+
+void StateCache::beginFrame()
+{
+	frameStats = stats;
+	memset(&stats, 0, sizeof(stats));
+	invalidate();
+}
+
+// Trims startSlot and count to the slots whose values differ from what is bound, and records them as bound.
+// False when nothing differs. Calls past the last slot are left whole for the runtime to report.
+bool StateCache::narrow(const void** bound, UINT slotCount, UINT& startSlot, UINT& count, const void* const* values)
+{
+	if (startSlot >= slotCount || count > slotCount - startSlot)
+	{
+		return true;
+	}
+
+	UINT first = 0;
+	while (first < count && bound[startSlot + first] == values[first])
+	{
+		first++;
+	}
+	if (first == count)
+	{
+		return false;
+	}
+
+	UINT last = count;
+	while (bound[startSlot + last - 1] == values[last - 1])
+	{
+		last--;
+	}
+
+	for (UINT i = first; i < last; i++)
+	{
+		bound[startSlot + i] = values[i];
+	}
+	startSlot += first;
+	count = last - first;
+	return true;
+}
+
+void StateCache::IASetInputLayout(ID3D11InputLayout* layout)
+{
+	if (layout == inputLayout)
+	{
+		stats.elided++;
+		return;
+	}
+	inputLayout = layout;
+	target.setInputLayout(layout);
+	stats.issued++;
+}
+
+void StateCache::IASetVertexBuffers(UINT startSlot, UINT count, ID3D11Buffer* const* buffers, const UINT* strides, const UINT* offsets)
+{
+	// A slot only matches when its buffer, stride and offset all do.
+	UINT first = 0;
+	UINT last = count;
+	if (startSlot < D3D11_IA_VERTEX_INPUT_RESOURCE_SLOT_COUNT && count <= D3D11_IA_VERTEX_INPUT_RESOURCE_SLOT_COUNT - startSlot)
+	{
+		while (first < count && vertexBuffers[startSlot + first] == buffers[first] && vertexStrides[startSlot + first] == strides[first] &&
+			vertexOffsets[startSlot + first] == offsets[first])
+		{
+			first++;
+		}
+		if (first == count)
+		{
+			stats.elided++;
+			return;
+		}
+		while (vertexBuffers[startSlot + last - 1] == buffers[last - 1] && vertexStrides[startSlot + last - 1] == strides[last - 1] &&
+			vertexOffsets[startSlot + last - 1] == offsets[last - 1])
+		{
+			last--;
+		}
+		for (UINT i = first; i < last; i++)
+		{
+			vertexBuffers[startSlot + i] = buffers[i];
+			vertexStrides[startSlot + i] = strides[i];
+			vertexOffsets[startSlot + i] = offsets[i];
+		}
+	}
+	target.setVertexBuffers(startSlot + first, last - first, buffers + first, strides + first, offsets + first);
+	stats.issued++;
+}
+
+void StateCache::IASetIndexBuffer(ID3D11Buffer* buffer, DXGI_FORMAT format, UINT offset)
+{
+	if (buffer == indexBuffer && format == indexFormat && offset == indexOffset)
+	{
+		stats.elided++;
+		return;
+	}
+	indexBuffer = buffer;
+	indexFormat = format;
+	indexOffset = offset;
+	target.setIndexBuffer(buffer, format, offset);
+	stats.issued++;
+}
+
+void StateCache::IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY ltopology)
+{
+	if (ltopology == topology)
+	{
+		stats.elided++;
+		return;
+	}
+	topology = ltopology;
+	target.setPrimitiveTopology(ltopology);
+	stats.issued++;
+}
+
+void StateCache::setShader(StageType stage, ID3D11DeviceChild* shader)
+{
+	if (shader == stages[stage].shader)
+	{
+		stats.elided++;
+		return;
+	}
+	stages[stage].shader = shader;
+	target.setShader(stage, shader);
+	stats.issued++;
+}
+
+void StateCache::setConstantBuffers(StageType stage, UINT startSlot, UINT count, ID3D11Buffer* const* buffers)
+{
+	UINT first = startSlot;
+	UINT changed = count;
+	if (!narrow(stages[stage].constantBuffers, D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT, first, changed, (const void* const*)buffers))
+	{
+		stats.elided++;
+		return;
+	}
+	target.setConstantBuffers(stage, first, changed, buffers + (first - startSlot));
+	stats.issued++;
+}
+
+void StateCache::setShaderResources(StageType stage, UINT startSlot, UINT count, ID3D11ShaderResourceView* const* views)
+{
+	UINT first = startSlot;
+	UINT changed = count;
+	if (!narrow(stages[stage].shaderResources, D3D11_COMMONSHADER_INPUT_RESOURCE_SLOT_COUNT, first, changed, (const void* const*)views))
+	{
+		stats.elided++;
+		return;
+	}
+	target.setShaderResources(stage, first, changed, views + (first - startSlot));
+	stats.issued++;
+}
+
+void StateCache::setSamplers(StageType stage, UINT startSlot, UINT count, ID3D11SamplerState* const* samplers)
+{
+	UINT first = startSlot;
+	UINT changed = count;
+	if (!narrow(stages[stage].samplers, D3D11_COMMONSHADER_SAMPLER_SLOT_COUNT, first, changed, (const void* const*)samplers))
+	{
+		stats.elided++;
+		return;
+	}
+	target.setSamplers(stage, first, changed, samplers + (first - startSlot));
+	stats.issued++;
+}
+
+namespace
+{
+	// One draw of the benchmark's scene, by index into its stand in objects.
+	struct DrawType
+	{
+		int shader;
+		int texture;
+		int mesh;
+	};
+
+	// Stand ins for the device objects. Only their addresses matter.
+	struct SceneObjects
+	{
+		char meshes[32][2];
+		char shaders[4][8];
+		char textures[64];
+		char shadowMaps[24];
+		char samplers[2];
+	};
+
+	// The binds of one draw, in the order a mesh's sendData(), a light shader's setShaderParameters() and BaseShader::render() make them.
+	template <class Context>
+	void bindDraw(Context& context, SceneObjects& objects, const DrawType& draw)
+	{
+		UINT stride = 32;
+		UINT offset = 0;
+		ID3D11Buffer* vertexBuffer = (ID3D11Buffer*)&objects.meshes[draw.mesh][0];
+		context.IASetVertexBuffers(0, 1, &vertexBuffer, &stride, &offset);
+		context.IASetIndexBuffer((ID3D11Buffer*)&objects.meshes[draw.mesh][1], DXGI_FORMAT_R32_UINT, 0);
+		context.IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+
+		char* shader = objects.shaders[draw.shader];
+		ID3D11Buffer* constantBuffers[4] = { (ID3D11Buffer*)&shader[4], (ID3D11Buffer*)&shader[5], (ID3D11Buffer*)&shader[6], (ID3D11Buffer*)&shader[7] };
+		context.VSSetConstantBuffers(0, 1, &constantBuffers[0]);
+		context.VSSetConstantBuffers(1, 1, &constantBuffers[1]);
+		context.PSSetConstantBuffers(0, 1, &constantBuffers[2]);
+		context.PSSetConstantBuffers(1, 1, &constantBuffers[3]);
+
+		ID3D11ShaderResourceView* texture = (ID3D11ShaderResourceView*)&objects.textures[draw.texture];
+		ID3D11ShaderResourceView* heightMap = NULL;
+		ID3D11ShaderResourceView* shadowMaps[24];
+		for (int i = 0; i < 24; i++)
+		{
+			shadowMaps[i] = (ID3D11ShaderResourceView*)&objects.shadowMaps[i];
+		}
+		context.PSSetShaderResources(0, 1, &texture);
+		context.PSSetShaderResources(1, 1, &heightMap);
+		context.PSSetShaderResources(2, 24, shadowMaps);
+		ID3D11SamplerState* samplers[2] = { (ID3D11SamplerState*)&objects.samplers[0], (ID3D11SamplerState*)&objects.samplers[1] };
+		context.PSSetSamplers(0, 1, &samplers[0]);
+		context.PSSetSamplers(1, 1, &samplers[1]);
+
+		context.IASetInputLayout((ID3D11InputLayout*)&shader[0]);
+		context.VSSetShader((ID3D11VertexShader*)&shader[1]);
+		context.PSSetShader((ID3D11PixelShader*)&shader[2]);
+		context.CSSetShader(NULL);
+		context.HSSetShader(NULL);
+		context.DSSetShader(NULL);
+		context.GSSetShader(draw.shader == 3 ? (ID3D11GeometryShader*)&shader[3] : NULL);
+	}
+
+	// Makes the same binds straight on a target, with nothing skipped.
+	class DirectContext
+	{
+	public:
+		DirectContext(StateCache::Target& ltarget) : target(ltarget) {}
+		void IASetInputLayout(ID3D11InputLayout* layout) { target.setInputLayout(layout); }
+		void IASetVertexBuffers(UINT startSlot, UINT count, ID3D11Buffer* const* buffers, const UINT* strides, const UINT* offsets) { target.setVertexBuffers(startSlot, count, buffers, strides, offsets); }
+		void IASetIndexBuffer(ID3D11Buffer* buffer, DXGI_FORMAT format, UINT offset) { target.setIndexBuffer(buffer, format, offset); }
+		void IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY topology) { target.setPrimitiveTopology(topology); }
+		void VSSetShader(ID3D11VertexShader* shader) { target.setShader(StateCache::VERTEX_STAGE, shader); }
+		void HSSetShader(ID3D11HullShader* shader) { target.setShader(StateCache::HULL_STAGE, shader); }
+		void DSSetShader(ID3D11DomainShader* shader) { target.setShader(StateCache::DOMAIN_STAGE, shader); }
+		void GSSetShader(ID3D11GeometryShader* shader) { target.setShader(StateCache::GEOMETRY_STAGE, shader); }
+		void PSSetShader(ID3D11PixelShader* shader) { target.setShader(StateCache::PIXEL_STAGE, shader); }
+		void CSSetShader(ID3D11ComputeShader* shader) { target.setShader(StateCache::COMPUTE_STAGE, shader); }
+		void VSSetConstantBuffers(UINT startSlot, UINT count, ID3D11Buffer* const* buffers) { target.setConstantBuffers(StateCache::VERTEX_STAGE, startSlot, count, buffers); }
+		void PSSetConstantBuffers(UINT startSlot, UINT count, ID3D11Buffer* const* buffers) { target.setConstantBuffers(StateCache::PIXEL_STAGE, startSlot, count, buffers); }
+		void PSSetShaderResources(UINT startSlot, UINT count, ID3D11ShaderResourceView* const* views) { target.setShaderResources(StateCache::PIXEL_STAGE, startSlot, count, views); }
+		void PSSetSamplers(UINT startSlot, UINT count, ID3D11SamplerState* const* samplers) { target.setSamplers(StateCache::PIXEL_STAGE, startSlot, count, samplers); }
+
+	private:
+		StateCache::Target& target;
+	};
+}
+
+void StateCache::benchmark(FILE* report)
+{
+	const int drawCounts[] = { 100, 1000, 10000 };
+	const int runs = 20;
+	SceneObjects objects;
+
+	Benchmark::report(report, "State cache, the binds of a light shaded draw over 4 shaders, 64 textures and 32 meshes, against a null target. Best of %d runs\n", runs);
+	Benchmark::report(report, "%10s %10s %14s %14s %14s %14s %12s %12s\n", "draws", "calls", "issued random", "issued sorted", "slots direct", "slots sorted",
+		"direct ms", "cached ms");
+
+	for (int c = 0; c < (int)(sizeof(drawCounts) / sizeof(drawCounts[0])); c++)
+	{
+		std::mt19937 random(1);
+		std::vector<DrawType> draws(drawCounts[c]);
+		for (size_t i = 0; i < draws.size(); i++)
+		{
+			draws[i].shader = random() % 4;
+			draws[i].texture = random() % 64;
+			draws[i].mesh = random() % 32;
+		}
+
+		// Submission order, as the hand written passes drew.
+		NullTarget randomTarget;
+		StateCache randomCache(randomTarget);
+		for (size_t i = 0; i < draws.size(); i++)
+		{
+			bindDraw(randomCache, objects, draws[i]);
+		}
+
+		// Shader, then texture, then mesh, as the render queue sorts them.
+		std::vector<DrawType> sorted = draws;
+		std::sort(sorted.begin(), sorted.end(), [](const DrawType& a, const DrawType& b)
+		{
+			return a.shader != b.shader ? a.shader < b.shader : a.texture != b.texture ? a.texture < b.texture : a.mesh < b.mesh;
+		});
+
+		double directTime = 1e30, cachedTime = 1e30;
+		NullTarget directTarget, sortedTarget;
+		StatsType sortedStats = {};
+		for (int run = 0; run < runs; run++)
+		{
+			directTarget = NullTarget();
+			DirectContext direct(directTarget);
+			double start = Benchmark::seconds();
+			for (size_t i = 0; i < sorted.size(); i++)
+			{
+				bindDraw(direct, objects, sorted[i]);
+			}
+			directTime = std::min(directTime, Benchmark::seconds() - start);
+
+			sortedTarget = NullTarget();
+			StateCache sortedCache(sortedTarget);
+			start = Benchmark::seconds();
+			for (size_t i = 0; i < sorted.size(); i++)
+			{
+				bindDraw(sortedCache, objects, sorted[i]);
+			}
+			cachedTime = std::min(cachedTime, Benchmark::seconds() - start);
+			sortedStats = sortedCache.getStats();
+		}
+
+		Benchmark::report(report, "%10d %10d %14d %14d %14d %14d %12.3f %12.3f\n", drawCounts[c], sortedStats.issued + sortedStats.elided, randomTarget.calls,
+			sortedTarget.calls, directTarget.slots, sortedTarget.slots, directTime * 1000.0, cachedTime * 1000.0);
+	}
+}
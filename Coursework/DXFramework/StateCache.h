@@ -0,0 +1,187 @@
+/**
+* \class StateCache
+*
+* \brief Skips device context binds that would set what is already bound
+*
+* Meshes and shaders bind everything they use before every draw: the input layout, vertex and index buffers and
+* topology, the shader stages, and each stage's constant buffers, shader resources and samplers. Most of it is still
+* bound from the previous draw. The cache remembers what was last bound to each stage and slot, and only passes a call
+* on when something in it differs, trimmed to the slots that changed.
+*
+* The calls have the names and arguments of ID3D11DeviceContext's, without class instances, and are made on the cache
+* for the context: StateCache::get(deviceContext)->VSSetConstantBuffers(0, 1, &buffer). The calls that get through
+* are made on a Target. DeviceTarget makes them on the device context; NullTarget only counts them, so the cache can
+* be checked and measured without a device (see benchmark()).
+*
+* Anything that changes bindings behind the cache's back must invalidate it. Binding a render target unbinds any shader
+* resource view of the same texture, so RenderTexture and ShadowMap call invalidateShaderResources() when they do.
+*/
+
+
+#ifndef _STATECACHE_H_
+#define _STATECACHE_H_
+
+#include <d3d11.h>
+#include <cstdio>
+
+class StateCache
+{
+public:
+	enum StageType
+	{
+		VERTEX_STAGE,
+		HULL_STAGE,
+		DOMAIN_STAGE,
+		GEOMETRY_STAGE,
+		PIXEL_STAGE,
+		COMPUTE_STAGE,
+		STAGE_COUNT
+	};
+
+	/// Receives the calls the cache doesn't skip.
+	class Target
+	{
+	public:
+		virtual ~Target() {}
+		virtual void setInputLayout(ID3D11InputLayout* layout) = 0;
+		virtual void setVertexBuffers(UINT startSlot, UINT count, ID3D11Buffer* const* buffers, const UINT* strides, const UINT* offsets) = 0;
+		virtual void setIndexBuffer(ID3D11Buffer* buffer, DXGI_FORMAT format, UINT offset) = 0;
+		virtual void setPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY topology) = 0;
+		virtual void setShader(StageType stage, ID3D11DeviceChild* shader) = 0;
+		virtual void setConstantBuffers(StageType stage, UINT startSlot, UINT count, ID3D11Buffer* const* buffers) = 0;
+		virtual void setShaderResources(StageType stage, UINT startSlot, UINT count, ID3D11ShaderResourceView* const* views) = 0;
+		virtual void setSamplers(StageType stage, UINT startSlot, UINT count, ID3D11SamplerState* const* samplers) = 0;
+	};
+
+	/// Makes the calls on a device context.
+	class DeviceTarget : public Target
+	{
+	public:
+		DeviceTarget(ID3D11DeviceContext* deviceContext) : context(deviceContext) {}
+		void setInputLayout(ID3D11InputLayout* layout) override;
+		void setVertexBuffers(UINT startSlot, UINT count, ID3D11Buffer* const* buffers, const UINT* strides, const UINT* offsets) override;
+		void setIndexBuffer(ID3D11Buffer* buffer, DXGI_FORMAT format, UINT offset) override;
+		void setPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY topology) override;
+		void setShader(StageType stage, ID3D11DeviceChild* shader) override;
+		void setConstantBuffers(StageType stage, UINT startSlot, UINT count, ID3D11Buffer* const* buffers) override;
+		void setShaderResources(StageType stage, UINT startSlot, UINT count, ID3D11ShaderResourceView* const* views) override;
+		void setSamplers(StageType stage, UINT startSlot, UINT count, ID3D11SamplerState* const* samplers) override;
+
+	private:
+		ID3D11DeviceContext* context;
+	};
+
+	/// Target without a device. Counts the calls and the slots they set, for benchmarks and for checking the cache.
+	class NullTarget : public Target
+	{
+	public:
+		NullTarget() : calls(0), slots(0) {}
+		void setInputLayout(ID3D11InputLayout* layout) override { calls++; slots++; }
+		void setVertexBuffers(UINT startSlot, UINT count, ID3D11Buffer* const* buffers, const UINT* strides, const UINT* offsets) override { calls++; slots += count; }
+		void setIndexBuffer(ID3D11Buffer* buffer, DXGI_FORMAT format, UINT offset) override { calls++; slots++; }
+		void setPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY topology) override { calls++; slots++; }
+		void setShader(StageType stage, ID3D11DeviceChild* shader) override { calls++; slots++; }
+		void setConstantBuffers(StageType stage, UINT startSlot, UINT count, ID3D11Buffer* const* buffers) override { calls++; slots += count; }
+		void setShaderResources(StageType stage, UINT startSlot, UINT count, ID3D11ShaderResourceView* const* views) override { calls++; slots += count; }
+		void setSamplers(StageType stage, UINT startSlot, UINT count, ID3D11SamplerState* const* samplers) override { calls++; slots += count; }
+		int calls;
+		int slots;
+	};
+
+	/// Calls made on the cache: passed on to the target, and skipped because nothing in them changed.
+	struct StatsType
+	{
+		int issued;
+		int elided;
+	};
+
+	/// Everything starts unknown, so the first call to each slot is always passed on.
+	StateCache(Target& target);
+
+	/// The cache for a device context, made on first use. Every bind to the context should go through it.
+	static StateCache* get(ID3D11DeviceContext* deviceContext);
+	/// Deletes the context's cache, for when the context is released.
+	static void release(ID3D11DeviceContext* deviceContext);
+
+	void IASetInputLayout(ID3D11InputLayout* layout);
+	void IASetVertexBuffers(UINT startSlot, UINT count, ID3D11Buffer* const* buffers, const UINT* strides, const UINT* offsets);
+	void IASetIndexBuffer(ID3D11Buffer* buffer, DXGI_FORMAT format, UINT offset);
+	void IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY topology);
+
+	void VSSetShader(ID3D11VertexShader* shader) { setShader(VERTEX_STAGE, shader); }
+	void HSSetShader(ID3D11HullShader* shader) { setShader(HULL_STAGE, shader); }
+	void DSSetShader(ID3D11DomainShader* shader) { setShader(DOMAIN_STAGE, shader); }
+	void GSSetShader(ID3D11GeometryShader* shader) { setShader(GEOMETRY_STAGE, shader); }
+	void PSSetShader(ID3D11PixelShader* shader) { setShader(PIXEL_STAGE, shader); }
+	void CSSetShader(ID3D11ComputeShader* shader) { setShader(COMPUTE_STAGE, shader); }
+
+	void VSSetConstantBuffers(UINT startSlot, UINT count, ID3D11Buffer* const* buffers) { setConstantBuffers(VERTEX_STAGE, startSlot, count, buffers); }
+	void HSSetConstantBuffers(UINT startSlot, UINT count, ID3D11Buffer* const* buffers) { setConstantBuffers(HULL_STAGE, startSlot, count, buffers); }
+	void DSSetConstantBuffers(UINT startSlot, UINT count, ID3D11Buffer* const* buffers) { setConstantBuffers(DOMAIN_STAGE, startSlot, count, buffers); }
+	void GSSetConstantBuffers(UINT startSlot, UINT count, ID3D11Buffer* const* buffers) { setConstantBuffers(GEOMETRY_STAGE, startSlot, count, buffers); }
+	void PSSetConstantBuffers(UINT startSlot, UINT count, ID3D11Buffer* const* buffers) { setConstantBuffers(PIXEL_STAGE, startSlot, count, buffers); }
+
+	void VSSetShaderResources(UINT startSlot, UINT count, ID3D11ShaderResourceView* const* views) { setShaderResources(VERTEX_STAGE, startSlot, count, views); }
+	void HSSetShaderResources(UINT startSlot, UINT count, ID3D11ShaderResourceView* const* views) { setShaderResources(HULL_STAGE, startSlot, count, views); }
+	void DSSetShaderResources(UINT startSlot, UINT count, ID3D11ShaderResourceView* const* views) { setShaderResources(DOMAIN_STAGE, startSlot, count, views); }
+	void GSSetShaderResources(UINT startSlot, UINT count, ID3D11ShaderResourceView* const* views) { setShaderResources(GEOMETRY_STAGE, startSlot, count, views); }
+	void PSSetShaderResources(UINT startSlot, UINT count, ID3D11ShaderResourceView* const* views) { setShaderResources(PIXEL_STAGE, startSlot, count, views); }
+
+	void VSSetSamplers(UINT startSlot, UINT count, ID3D11SamplerState* const* samplers) { setSamplers(VERTEX_STAGE, startSlot, count, samplers); }
+	void HSSetSamplers(UINT startSlot, UINT count, ID3D11SamplerState* const* samplers) { setSamplers(HULL_STAGE, startSlot, count, samplers); }
+	void DSSetSamplers(UINT startSlot, UINT count, ID3D11SamplerState* const* samplers) { setSamplers(DOMAIN_STAGE, startSlot, count, samplers); }
+	void GSSetSamplers(UINT startSlot, UINT count, ID3D11SamplerState* const* samplers) { setSamplers(GEOMETRY_STAGE, startSlot, count, samplers); }
+	void PSSetSamplers(UINT startSlot, UINT count, ID3D11SamplerState* const* samplers) { setSamplers(PIXEL_STAGE, startSlot, count, samplers); }
+
+	void setShader(StageType stage, ID3D11DeviceChild* shader);
+	void setConstantBuffers(StageType stage, UINT startSlot, UINT count, ID3D11Buffer* const* buffers);
+	void setShaderResources(StageType stage, UINT startSlot, UINT count, ID3D11ShaderResourceView* const* views);
+	void setSamplers(StageType stage, UINT startSlot, UINT count, ID3D11SamplerState* const* samplers);
+
+	/// Forgets everything bound, so the next call to each slot is passed on.
+	void invalidate();
+	/// Forgets the shader resources bound to every stage.
+	void invalidateShaderResources();
+
+	/// Starts counting a new frame, keeping the last one's stats for getFrameStats(). Also invalidates, in case anything bound state between frames.
+	void beginFrame();
+	/// The last whole frame's stats.
+	const StatsType& getFrameStats() { return frameStats; }
+	/// The stats so far this frame.
+	const StatsType& getStats() { return stats; }
+
+	/** \brief Binds a frame's worth of draws the way the meshes and shaders do, through the cache and straight to a NullTarget.
+	* Compares the calls passed on for draws in submission order and in render queue order.
+	* @param report is an open file to write the results to
+	*/
+	static void benchmark(FILE* report);
+
+private:
+	StateCache(const StateCache&);
+	StateCache& operator=(const StateCache&);
+
+	bool narrow(const void** bound, UINT slotCount, UINT& startSlot, UINT& count, const void* const* values);
+
+	struct StageState
+	{
+		const void* shader;
+		const void* constantBuffers[D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT];
+		const void* shaderResources[D3D11_COMMONSHADER_INPUT_RESOURCE_SLOT_COUNT];
+		const void* samplers[D3D11_COMMONSHADER_SAMPLER_SLOT_COUNT];
+	};
+
+	Target& target;
+	StageState stages[STAGE_COUNT];
+	const void* inputLayout;
+	const void* vertexBuffers[D3D11_IA_VERTEX_INPUT_RESOURCE_SLOT_COUNT];
+	UINT vertexStrides[D3D11_IA_VERTEX_INPUT_RESOURCE_SLOT_COUNT];
+	UINT vertexOffsets[D3D11_IA_VERTEX_INPUT_RESOURCE_SLOT_COUNT];
+	const void* indexBuffer;
+	DXGI_FORMAT indexFormat;
+	UINT indexOffset;
+	D3D11_PRIMITIVE_TOPOLOGY topology;
+	StatsType stats;
+	StatsType frameStats;
+};
+
+#endif
@@ -0,0 +1,518 @@
+// Terrain mesh
+// Height mapped tiles sharing one index buffer of levels of detail, with skirts hiding the cracks between levels.
+#include "TerrainMesh.h"
+#include "Benchmark.h"
+#include "VertexGenerator.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define TERRAIN_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+	// Tile edges, in the order their skirt vertices follow the grid vertices.
+	enum EdgeType { EdgeBottom, EdgeRight, EdgeTop, EdgeLeft, EdgeCount };
+
+	// Grid coordinates of the vertex k steps along an edge of a tile of size quads.
+	void getEdgeVertex(int edge, int k, int size, int& i, int& j)
+	{
+		switch (edge)
+		{
+		case EdgeBottom: i = k; j = 0; break;
+		case EdgeRight: i = size; j = k; break;
+		case EdgeTop: i = k; j = size; break;
+		default: i = 0; j = k; break;
+		}
+	}
+}
+
+TerrainMesh::TerrainMesh(ID3D11Device* device, ID3D11DeviceContext* deviceContext, int lresolution, int ltileSize, int ltiles)
+{
+	resolution = lresolution;
+
+	// Every level halves the vertices along an edge, so the tile size has to be a power of two.
+	tileSize = 1;
+	while (tileSize < ltileSize)
+	{
+		tileSize *= 2;
+	}
+	tiles = ltiles > 0 ? ltiles : std::max((resolution - 1 + tileSize - 1) / tileSize, 1);
+
+	gridSize = tiles * tileSize + 1;
+	spacing = (float)(resolution - 1) / (tiles * tileSize);
+	levels = 0;
+	for (int step = 1; step <= tileSize; step *= 2)
+	{
+		levels++;
+	}
+	tileVertexCount = (tileSize + 1) * (tileSize + 1) + EdgeCount * (tileSize + 1);
+
+	sampledMap = nullptr;
+	sampledVersion = 0;
+	builtAmplitude = 0.0f;
+	rebuildCount = 0;
+	rebuildTime = 0.0;
+	samples.assign((size_t)gridSize * gridSize, 0.0f);
+	normals.resize(samples.size());
+	tileErrors.assign((size_t)tiles * tiles * levels, 0.0f);
+	tileLowest.assign((size_t)tiles * tiles, 0.0f);
+	tileHighest.assign((size_t)tiles * tiles, 0.0f);
+
+	initBuffers(device);
+}
+
+TerrainMesh::~TerrainMesh()
+{
+	// BaseMesh's destructor runs after this one and releases the buffers.
+}
+
+void TerrainMesh::initBuffers(ID3D11Device* device)
+{
+	int gridVertices = (tileSize + 1) * (tileSize + 1);
+
+	// Every tile is a part with its own vertices. They all draw from the same index ranges.
+	vertexCount = tiles * tiles * tileVertexCount;
+	submeshes.resize((size_t)tiles * tiles);
+	for (int t = 0; t < tiles * tiles; t++)
+	{
+		SubmeshType& tile = submeshes[t];
+		tile.baseVertex = t * tileVertexCount;
+		tile.vertexCount = tileVertexCount;
+		tile.materialIndex = 0;
+		tile.meshletStart = 0;
+		tile.meshletCount = 0;
+		tile.padding = 0;
+	}
+
+	// Each level is the grid at a step of 2^level vertices, then its skirts.
+	std::vector<unsigned long> indices;
+	lods.resize(levels);
+	for (int level = 0; level < levels; level++)
+	{
+		int step = 1 << level;
+		lods[level].indexStart = (unsigned int)indices.size();
+		lods[level].error = 0.0f;
+		lods[level].padding = 0;
+
+		// Two triangles per cell, split along the diagonal from (i, j) to (i + step, j + step), as PlaneMesh does.
+		for (int j = 0; j < tileSize; j += step)
+		{
+			for (int i = 0; i < tileSize; i += step)
+			{
+				unsigned long lowerLeft = j * (tileSize + 1) + i;
+				unsigned long lowerRight = lowerLeft + step;
+				unsigned long upperLeft = lowerLeft + step * (tileSize + 1);
+				unsigned long upperRight = upperLeft + step;
+
+				indices.push_back(lowerLeft);
+				indices.push_back(upperRight);
+				indices.push_back(upperLeft);
+
+				indices.push_back(lowerLeft);
+				indices.push_back(lowerRight);
+				indices.push_back(upperRight);
+			}
+		}
+
+		// A quad down from every edge segment, wound to face out of the tile. The bottom and right edges run backwards for that.
+		for (int edge = 0; edge < EdgeCount; edge++)
+		{
+			bool backwards = (edge == EdgeBottom || edge == EdgeRight);
+			for (int k = 0; k < tileSize; k += step)
+			{
+				int first = backwards ? k + step : k;
+				int second = backwards ? k : k + step;
+				int i, j;
+				getEdgeVertex(edge, first, tileSize, i, j);
+				unsigned long top0 = j * (tileSize + 1) + i;
+				getEdgeVertex(edge, second, tileSize, i, j);
+				unsigned long top1 = j * (tileSize + 1) + i;
+				unsigned long bottom0 = gridVertices + edge * (tileSize + 1) + first;
+				unsigned long bottom1 = gridVertices + edge * (tileSize + 1) + second;
+
+				indices.push_back(top0);
+				indices.push_back(top1);
+				indices.push_back(bottom0);
+
+				indices.push_back(top1);
+				indices.push_back(bottom1);
+				indices.push_back(bottom0);
+			}
+		}
+		lods[level].indexCount = (unsigned int)indices.size() - lods[level].indexStart;
+	}
+	indexCount = lods[0].indexCount;
+
+	// Level 0 is each tile's full range, and every tile has the same range at each level.
+	submeshLods.clear();
+	for (int level = 0; level < levels; level++)
+	{
+		for (int t = 0; t < tiles * tiles; t++)
+		{
+			submeshLods.push_back(lods[level]);
+		}
+	}
+	for (size_t t = 0; t < submeshes.size(); t++)
+	{
+		submeshes[t].indexStart = lods[0].indexStart;
+		submeshes[t].indexCount = lods[0].indexCount;
+	}
+
+	// Flat until the first update().
+	std::vector<VertexType> vertices(vertexCount);
+	buildNormals(0.0f);
+	buildVertices(vertices.data(), 0.0f);
+
+	createVertexBuffer(device, vertices.data());
+	createIndexBuffer(device, indices.data());
+}
+
+bool TerrainMesh::update(ID3D11DeviceContext* deviceContext, const Heightmap& heightmap, float amplitude)
+{
+	bool resample = (&heightmap != sampledMap || heightmap.getVersion() != sampledVersion);
+	if (!resample && amplitude == builtAmplitude)
+	{
+		return false;
+	}
+
+	double start = Benchmark::seconds();
+
+	// Sample the map once per grid vertex, at the vertex's texture coordinates.
+	if (resample)
+	{
+		float increment = spacing / resolution;
+		for (int j = 0; j < gridSize; j++)
+		{
+			for (int i = 0; i < gridSize; i++)
+			{
+				samples[(size_t)j * gridSize + i] = heightmap.sample(i * increment, j * increment);
+			}
+		}
+		sampledMap = &heightmap;
+		sampledVersion = heightmap.getVersion();
+		measureErrors();
+	}
+
+	std::vector<VertexType> vertices(vertexCount);
+	buildNormals(amplitude);
+	buildVertices(vertices.data(), amplitude);
+	deviceContext->UpdateSubresource(vertexBuffer, 0, NULL, vertices.data(), 0, 0);
+	builtAmplitude = amplitude;
+
+	rebuildCount++;
+	rebuildTime = Benchmark::seconds() - start;
+	return true;
+}
+
+void TerrainMesh::measureErrors()
+{
+	for (int tz = 0; tz < tiles; tz++)
+	{
+		for (int tx = 0; tx < tiles; tx++)
+		{
+			int t = tz * tiles + tx;
+			const float* origin = &samples[(size_t)tz * tileSize * gridSize + tx * tileSize];
+			auto height = [&](int i, int j) { return origin[(size_t)j * gridSize + i]; };
+
+			tileLowest[t] = FLT_MAX;
+			tileHighest[t] = -FLT_MAX;
+			for (int j = 0; j <= tileSize; j++)
+			{
+				for (int i = 0; i <= tileSize; i++)
+				{
+					tileLowest[t] = std::min(tileLowest[t], height(i, j));
+					tileHighest[t] = std::max(tileHighest[t], height(i, j));
+				}
+			}
+
+			// Largest difference between a full detail vertex and the coarser level's triangle above or below it.
+			float* errors = &tileErrors[(size_t)t * levels];
+			errors[0] = 0.0f;
+			for (int level = 1; level < levels; level++)
+			{
+				int step = 1 << level;
+				float error = 0.0f;
+				for (int j = 0; j <= tileSize; j++)
+				{
+					for (int i = 0; i <= tileSize; i++)
+					{
+						int cellI = std::min(i / step * step, tileSize - step);
+						int cellJ = std::min(j / step * step, tileSize - step);
+						float fx = (float)(i - cellI) / step;
+						float fz = (float)(j - cellJ) / step;
+						float lowerLeft = height(cellI, cellJ);
+						float lowerRight = height(cellI + step, cellJ);
+						float upperLeft = height(cellI, cellJ + step);
+						float upperRight = height(cellI + step, cellJ + step);
+
+						// The cell is split from lower left to upper right.
+						float interpolated = fz >= fx ?
+							lowerLeft + fx * (upperRight - upperLeft) + fz * (upperLeft - lowerLeft) :
+							lowerLeft + fx * (lowerRight - lowerLeft) + fz * (upperRight - lowerRight);
+						error = std::max(error, fabsf(height(i, j) - interpolated));
+					}
+				}
+				// Never less than a finer level, so picking the coarsest level under the limit stays safe.
+				errors[level] = std::max(error, errors[level - 1]);
+			}
+		}
+	}
+}
+
+void TerrainMesh::buildNormals(float amplitude)
+{
+	int last = gridSize - 1;
+
+	for (int j = 0; j < gridSize; j++)
+	{
+		// Central differences inside the grid, one sided along the edges.
+		const float* row = &samples[(size_t)j * gridSize];
+		const float* up = &samples[(size_t)std::min(j + 1, last) * gridSize];
+		const float* down = &samples[(size_t)std::max(j - 1, 0) * gridSize];
+		float scaleZ = amplitude / (spacing * std::max(std::min(j + 1, last) - std::max(j - 1, 0), 1));
+		XMFLOAT3* out = &normals[(size_t)j * gridSize];
+
+		// Scalar version, for the edges and what the SIMD loop leaves over.
+		auto writeNormal = [&](int i)
+		{
+			int left = std::max(i - 1, 0);
+			int right = std::min(i + 1, last);
+			float gradientX = (row[right] - row[left]) * amplitude / (spacing * std::max(right - left, 1));
+			float gradientZ = (up[i] - down[i]) * scaleZ;
+			float inverse = 1.0f / sqrtf(gradientX * gradientX + gradientZ * gradientZ + 1.0f);
+			out[i] = XMFLOAT3(-gradientX * inverse, inverse, -gradientZ * inverse);
+		};
+
+		int i = 0;
+#ifdef TERRAIN_SSE2
+		// Four vertices at a time along the row, away from the edges. Normalised with a refined reciprocal square root.
+		const __m128 scaleX = _mm_set1_ps(amplitude * 0.5f / spacing);
+		const __m128 scaleZ4 = _mm_set1_ps(scaleZ);
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 half = _mm_set1_ps(0.5f);
+		const __m128 threeHalves = _mm_set1_ps(1.5f);
+
+		writeNormal(0);
+		for (i = 1; i + 4 <= last; i += 4)
+		{
+			__m128 gradientX = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(row + i + 1), _mm_loadu_ps(row + i - 1)), scaleX);
+			__m128 gradientZ = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(up + i), _mm_loadu_ps(down + i)), scaleZ4);
+			__m128 lengthSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(gradientX, gradientX), _mm_mul_ps(gradientZ, gradientZ)), one);
+			__m128 inverse = _mm_rsqrt_ps(lengthSquared);
+			inverse = _mm_mul_ps(inverse, _mm_sub_ps(threeHalves, _mm_mul_ps(_mm_mul_ps(half, lengthSquared), _mm_mul_ps(inverse, inverse))));
+
+			float normalX[4], normalY[4], normalZ[4];
+			_mm_storeu_ps(normalX, _mm_sub_ps(_mm_setzero_ps(), _mm_mul_ps(gradientX, inverse)));
+			_mm_storeu_ps(normalY, inverse);
+			_mm_storeu_ps(normalZ, _mm_sub_ps(_mm_setzero_ps(), _mm_mul_ps(gradientZ, inverse)));
+
+			for (int k = 0; k < 4; k++)
+			{
+				out[i + k] = XMFLOAT3(normalX[k], normalY[k], normalZ[k]);
+			}
+		}
+#endif
+		for (; i < gridSize; i++)
+		{
+			writeNormal(i);
+		}
+	}
+}
+
+void TerrainMesh::buildVertices(VertexType* vertices, float amplitude)
+{
+	int gridVertices = (tileSize + 1) * (tileSize + 1);
+	float increment = spacing / resolution;
+	float tileWidth = tileSize * spacing;
+	XMFLOAT3 minimum(FLT_MAX, FLT_MAX, FLT_MAX), maximum(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+
+	for (int tz = 0; tz < tiles; tz++)
+	{
+		for (int tx = 0; tx < tiles; tx++)
+		{
+			int t = tz * tiles + tx;
+			VertexType* out = &vertices[(size_t)t * tileVertexCount];
+
+			// Tile edges are copies of their neighbours' edges, with the same normals, so shared edges match exactly.
+			for (int j = 0; j <= tileSize; j++)
+			{
+				int gridZ = tz * tileSize + j;
+				size_t sample = (size_t)gridZ * gridSize + tx * tileSize;
+				VertexGenerator::writeGridRow(reinterpret_cast<PrimitiveShapes::VertexType*>(out + j * (tileSize + 1)), tileSize + 1, tx * tileSize, spacing, increment,
+					gridZ * spacing, gridZ * increment, &samples[sample], amplitude, &normals[sample]);
+			}
+
+			// Neighbouring edges can each be off by their own tile's coarsest error, so the skirt covers both.
+			float neighbourError = 0.0f;
+			if (tx > 0) neighbourError = std::max(neighbourError, tileErrors[(size_t)(t - 1) * levels + levels - 1]);
+			if (tx + 1 < tiles) neighbourError = std::max(neighbourError, tileErrors[(size_t)(t + 1) * levels + levels - 1]);
+			if (tz > 0) neighbourError = std::max(neighbourError, tileErrors[(size_t)(t - tiles) * levels + levels - 1]);
+			if (tz + 1 < tiles) neighbourError = std::max(neighbourError, tileErrors[(size_t)(t + tiles) * levels + levels - 1]);
+			float skirtDepth = (tileErrors[(size_t)t * levels + levels - 1] + neighbourError) * amplitude;
+
+			for (int edge = 0; edge < EdgeCount; edge++)
+			{
+				for (int k = 0; k <= tileSize; k++)
+				{
+					int i, j;
+					getEdgeVertex(edge, k, tileSize, i, j);
+					VertexType& skirt = out[gridVertices + edge * (tileSize + 1) + k];
+					skirt = out[j * (tileSize + 1) + i];
+					skirt.position.y -= skirtDepth;
+				}
+			}
+
+			// Box around the tile's heights and skirts, for culling.
+			SubmeshType& tile = submeshes[t];
+			tile.boundsMin[0] = tx * tileWidth;
+			tile.boundsMin[1] = tileLowest[t] * amplitude - skirtDepth;
+			tile.boundsMin[2] = tz * tileWidth;
+			tile.boundsMax[0] = (tx + 1) * tileWidth;
+			tile.boundsMax[1] = tileHighest[t] * amplitude;
+			tile.boundsMax[2] = (tz + 1) * tileWidth;
+			minimum = XMFLOAT3(std::min(minimum.x, tile.boundsMin[0]), std::min(minimum.y, tile.boundsMin[1]), std::min(minimum.z, tile.boundsMin[2]));
+			maximum = XMFLOAT3(std::max(maximum.x, tile.boundsMax[0]), std::max(maximum.y, tile.boundsMax[1]), std::max(maximum.z, tile.boundsMax[2]));
+		}
+	}
+
+	// The whole terrain's sphere, and each level's worst error for selectLod().
+	boundsCentre = XMFLOAT3((minimum.x + maximum.x) * 0.5f, (minimum.y + maximum.y) * 0.5f, (minimum.z + maximum.z) * 0.5f);
+	boundsRadius = 0.5f * sqrtf((maximum.x - minimum.x) * (maximum.x - minimum.x) + (maximum.y - minimum.y) * (maximum.y - minimum.y) + (maximum.z - minimum.z) * (maximum.z - minimum.z));
+	for (int level = 0; level < levels; level++)
+	{
+		float error = 0.0f;
+		for (int t = 0; t < tiles * tiles; t++)
+		{
+			error = std::max(error, tileErrors[(size_t)t * levels + level]);
+		}
+		lods[level].error = error * amplitude;
+	}
+}
+
+bool TerrainMesh::getHeight(float x, float z, float& height)
+{
+	float size = (float)(resolution - 1);
+	if (!sampledMap || x < 0.0f || z < 0.0f || x > size || z > size)
+	{
+		return false;
+	}
+	height = sampledMap->sample(x / resolution, z / resolution) * builtAmplitude;
+	return true;
+}
+
+bool TerrainMesh::getBounds(float x0, float z0, float x1, float z1, XMFLOAT3& minimum, XMFLOAT3& maximum)
+{
+	float size = (float)(resolution - 1);
+	minimum = XMFLOAT3(std::max(std::min(x0, x1), 0.0f), 0.0f, std::max(std::min(z0, z1), 0.0f));
+	maximum = XMFLOAT3(std::min(std::max(x0, x1), size), 0.0f, std::min(std::max(z0, z1), size));
+	if (!sampledMap || minimum.x > maximum.x || minimum.z > maximum.z)
+	{
+		return false;
+	}
+
+	float lowest, highest;
+	sampledMap->getRange(minimum.x / resolution, minimum.z / resolution, maximum.x / resolution, maximum.z / resolution, lowest, highest);
+	minimum.y = std::min(lowest * builtAmplitude, highest * builtAmplitude);
+	maximum.y = std::max(lowest * builtAmplitude, highest * builtAmplitude);
+	return true;
+}
+
+bool TerrainMesh::intersect(const XMFLOAT3& origin, const XMFLOAT3& direction, float maxDistance, float& distance)
+{
+	if (!sampledMap)
+	{
+		return false;
+	}
+
+	// Clip the ray to the terrain first, the height map carries on past its far edges.
+	float size = (float)(resolution - 1);
+	float nearest = 0.0f, farthest = maxDistance;
+	const float* start = &origin.x;
+	const float* step = &direction.x;
+	for (int axis = 0; axis < 3; axis += 2)
+	{
+		if (step[axis] == 0.0f)
+		{
+			if (start[axis] < 0.0f || start[axis] > size)
+			{
+				return false;
+			}
+			continue;
+		}
+		float enter = (0.0f - start[axis]) / step[axis];
+		float exit = (size - start[axis]) / step[axis];
+		nearest = std::max(nearest, std::min(enter, exit));
+		farthest = std::min(farthest, std::max(enter, exit));
+	}
+	if (nearest > farthest)
+	{
+		return false;
+	}
+
+	// Model space x and z are texture coordinates times the resolution, heights are already in model units.
+	XMFLOAT3 mapOrigin((origin.x + direction.x * nearest) / resolution, origin.y + direction.y * nearest, (origin.z + direction.z * nearest) / resolution);
+	XMFLOAT3 mapDirection(direction.x / resolution, direction.y, direction.z / resolution);
+	if (!sampledMap->intersect(mapOrigin, mapDirection, builtAmplitude, farthest - nearest, distance))
+	{
+		return false;
+	}
+	distance += nearest;
+	return true;
+}
+
+int TerrainMesh::select(const XMMATRIX& world, const XMMATRIX& view, const XMMATRIX& projection, float viewportHeight, float pixelError, std::vector<MeshletBuilder::RangeType>& ranges)
+{
+	XMMATRIX worldView = world * view;
+	XMFLOAT4 planes[6];
+	getFrustumPlanes(worldView * projection, planes);
+
+	// Largest scale the world matrix applies, so the errors and radii are never underestimated.
+	float scale = 0.0f;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		scale = std::max(scale, XMVectorGetX(XMVector3Length(world.r[axis])));
+	}
+	XMFLOAT4X4 projectionValues;
+	XMStoreFloat4x4(&projectionValues, projection);
+
+	int visible = 0;
+	for (int t = 0; t < tiles * tiles; t++)
+	{
+		const SubmeshType& tile = submeshes[t];
+		if (!boxInFrustum(tile.boundsMin, tile.boundsMax, planes))
+		{
+			continue;
+		}
+
+		// Clip space w at the nearest point of the tile's sphere (depth for perspective, 1 for orthographic), as selectLod() does.
+		XMFLOAT3 extent((tile.boundsMax[0] - tile.boundsMin[0]) * 0.5f, (tile.boundsMax[1] - tile.boundsMin[1]) * 0.5f, (tile.boundsMax[2] - tile.boundsMin[2]) * 0.5f);
+		XMVECTOR centre = XMVectorSet(tile.boundsMin[0] + extent.x, tile.boundsMin[1] + extent.y, tile.boundsMin[2] + extent.z, 1.0f);
+		float radius = sqrtf(extent.x * extent.x + extent.y * extent.y + extent.z * extent.z);
+		float depth = XMVectorGetZ(XMVector3TransformCoord(centre, worldView)) - radius * scale;
+		float w = depth * projectionValues.m[2][3] + projectionValues.m[3][3];
+
+		// Coarsest level whose error covers no more than pixelError pixels there.
+		int level = 0;
+		if (w > 0.0f)
+		{
+			float pixelsPerUnit = scale * projectionValues.m[1][1] * viewportHeight * 0.5f / w;
+			const float* errors = &tileErrors[(size_t)t * levels];
+			for (int l = 1; l < levels; l++)
+			{
+				if (errors[l] * builtAmplitude * pixelsPerUnit <= pixelError)
+				{
+					level = l;
+				}
+			}
+		}
+
+		MeshletBuilder::RangeType range = { lods[level].indexStart, lods[level].indexCount, tile.baseVertex };
+		ranges.push_back(range);
+		visible++;
+	}
+	return visible;
+}
@@ -69,6 +69,11 @@ void TextureManager::loadTexture(const wchar_t* uid, const wchar_t* filename)
 	}
 }
 
+void TextureManager::addTexture(const wchar_t* uid, ID3D11ShaderResourceView* newTexture)
+{
+	textureMap.insert(std::make_pair(const_cast<wchar_t*>(uid), newTexture));
+}
+
 // Release resource.
 TextureManager::~TextureManager()
 {
@@ -3,6 +3,8 @@
     By Allen Sherrod and Wendy Jones
 
     TokenStream - Used to return blocks of text in a file.
+
+    Superseded by Tokenizer, kept as a reference for Tokenizer::benchmark().
 */
 
 
@@ -0,0 +1,309 @@
+// Tokenizer
+// Borrowed buffer tokenizer with table driven delimiters and SSE2 scans for whitespace and newlines.
+#include "Tokenizer.h"
+#include "Benchmark.h"
+#include "MappedFile.h"
+#include "TokenStream.h"
+#include <cmath>
+#include <vector>
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define TOKENIZER_SSE2
+#include <emmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+namespace
+{
+	enum { tokenChar = 0, delimiterChar = 1, quoteChar = 2 };
+
+	// TokenStream's default: only printable ASCII other than space is part of a token.
+	inline bool isDefaultDelimiter(unsigned char c)
+	{
+		return c <= 32 || c >= 127;
+	}
+
+#ifdef TOKENIZER_SSE2
+	inline int lowestBit(int mask)
+	{
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanForward(&index, (unsigned long)mask);
+		return (int)index;
+#else
+		return __builtin_ctz((unsigned)mask);
+#endif
+	}
+
+	// One bit per byte that is a default delimiter. Bytes 128-255 are negative as signed chars, so they fall under the < 33 test.
+	inline int defaultDelimiterMask(__m128i bytes)
+	{
+		__m128i control = _mm_cmpgt_epi8(_mm_set1_epi8(33), bytes);
+		__m128i del = _mm_cmpeq_epi8(bytes, _mm_set1_epi8(127));
+		return _mm_movemask_epi8(_mm_or_si128(control, del));
+	}
+#endif
+
+	// Returns the first newline in [p, end), or end.
+	inline const char* findNewline(const char* p, const char* end)
+	{
+#ifdef TOKENIZER_SSE2
+		const __m128i newline = _mm_set1_epi8('\n');
+		for (; end - p >= 16; p += 16)
+		{
+			int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)p), newline));
+			if (mask)
+			{
+				return p + lowestBit(mask);
+			}
+		}
+#endif
+		while (p < end && *p != '\n')
+		{
+			p++;
+		}
+		return p;
+	}
+
+	// FNV-1a over every token, so the two tokenizers can be compared without storing the tokens.
+	inline unsigned int hashToken(unsigned int hash, const char* data, size_t length)
+	{
+		for (size_t i = 0; i < length; i++)
+		{
+			hash = (hash ^ (unsigned char)data[i]) * 16777619u;
+		}
+		return (hash ^ 0xffu) * 16777619u;
+	}
+}
+
+Tokenizer::Tokenizer()
+{
+	setBuffer(NULL, 0);
+	setDelimiters(NULL, 0);
+}
+
+Tokenizer::Tokenizer(const char* data, size_t length)
+{
+	setBuffer(data, length);
+	setDelimiters(NULL, 0);
+}
+
+void Tokenizer::setBuffer(const char* data, size_t length)
+{
+	begin = data;
+	end = data + length;
+	reset();
+}
+
+void Tokenizer::reset()
+{
+	position = begin;
+}
+
+void Tokenizer::setDelimiters(const char* delimiters, int totalDelimiters)
+{
+	defaultDelimiters = (delimiters == NULL || totalDelimiters == 0);
+	for (int c = 0; c < 256; c++)
+	{
+		classes[c] = (defaultDelimiters && isDefaultDelimiter((unsigned char)c)) ? delimiterChar : tokenChar;
+	}
+	for (int i = 0; !defaultDelimiters && i < totalDelimiters; i++)
+	{
+		classes[(unsigned char)delimiters[i]] = delimiterChar;
+	}
+
+	// A quote only starts a string if it isn't itself a delimiter.
+	if (classes['"'] == tokenChar)
+	{
+		classes['"'] = quoteChar;
+	}
+}
+
+const char* Tokenizer::skipDelimiters(const char* p) const
+{
+#ifdef TOKENIZER_SSE2
+	if (defaultDelimiters)
+	{
+		for (; end - p >= 16; p += 16)
+		{
+			int mask = ~defaultDelimiterMask(_mm_loadu_si128((const __m128i*)p)) & 0xffff;
+			if (mask)
+			{
+				return p + lowestBit(mask);
+			}
+		}
+	}
+#endif
+	while (p < end && classes[(unsigned char)*p] == delimiterChar)
+	{
+		p++;
+	}
+	return p;
+}
+
+const char* Tokenizer::skipToken(const char* p) const
+{
+#ifdef TOKENIZER_SSE2
+	if (defaultDelimiters)
+	{
+		const __m128i quote = _mm_set1_epi8('"');
+		for (; end - p >= 16; p += 16)
+		{
+			__m128i bytes = _mm_loadu_si128((const __m128i*)p);
+			int mask = defaultDelimiterMask(bytes) | _mm_movemask_epi8(_mm_cmpeq_epi8(bytes, quote));
+			if (mask)
+			{
+				return p + lowestBit(mask);
+			}
+		}
+	}
+#endif
+	while (p < end && classes[(unsigned char)*p] == tokenChar)
+	{
+		p++;
+	}
+	return p;
+}
+
+bool Tokenizer::nextToken(TokenType& token)
+{
+	const char* p = skipDelimiters(position);
+	token.data = p;
+	token.length = 0;
+	if (p == end)
+	{
+		position = end;
+		return false;
+	}
+
+	// Run to the next delimiter. Inside quotes delimiters are part of the token, so only the closing quote is searched for.
+	bool inString = false;
+	while (p < end)
+	{
+		if (inString)
+		{
+			const char* quote = (const char*)memchr(p, '"', end - p);
+			p = quote ? quote : end;
+		}
+		else
+		{
+			p = skipToken(p);
+		}
+
+		if (p == end || classes[(unsigned char)*p] == delimiterChar)
+		{
+			break;
+		}
+
+		inString = !inString;
+		p++;
+	}
+
+	token.length = p - token.data;
+	position = p;
+	return true;
+}
+
+bool Tokenizer::nextLine(TokenType& line)
+{
+	line.data = position;
+	line.length = 0;
+	if (position == end)
+	{
+		return false;
+	}
+
+	const char* newline = findNewline(position, end);
+	const char* last = newline;
+	if (last > position && last[-1] == '\r')
+	{
+		last--;
+	}
+
+	line.length = last - position;
+	position = newline < end ? newline + 1 : end;
+	return true;
+}
+
+void Tokenizer::benchmark(const char* directory, FILE* report)
+{
+	const int runs = 5;
+
+	std::string pattern = std::string(directory) + "\\*.obj";
+	WIN32_FIND_DATAA findData;
+	HANDLE find = FindFirstFileA(pattern.c_str(), &findData);
+	if (find == INVALID_HANDLE_VALUE)
+	{
+		Benchmark::report(report, "Tokenizer benchmark: no .obj files in %s\n", directory);
+		return;
+	}
+
+	Benchmark::report(report, "Tokenizer benchmark, whitespace separated tokens, best of %d runs\n", runs);
+	Benchmark::report(report, "%-24s %10s %12s %16s %16s %8s\n", "file", "MB", "tokens", "TokenStream MB/s", "Tokenizer MB/s", "speedup");
+
+	double totalMB = 0.0, totalOld = 0.0, totalNew = 0.0;
+	do
+	{
+		std::string path = std::string(directory) + "\\" + findData.cFileName;
+		MappedFile file;
+		if (!file.open(path.c_str()) || file.getSize() == 0)
+		{
+			continue;
+		}
+		double megabytes = (double)file.getSize() / (1024.0 * 1024.0);
+
+		// TokenStream needs a null terminated, writable copy.
+		std::vector<char> text(file.getData(), file.getData() + file.getSize());
+		text.push_back('\0');
+
+		double bestOld = 1e30, bestNew = 1e30;
+		unsigned int oldHash = 2166136261u, newHash = 2166136261u;
+		size_t oldCount = 0, newCount = 0;
+
+		for (int run = 0; run < runs; run++)
+		{
+			oldHash = newHash = 2166136261u;
+			oldCount = newCount = 0;
+
+			double start = Benchmark::seconds();
+			TokenStream stream;
+			std::string buffer;
+			stream.SetTokenStream(text.data());
+			while (stream.GetNextToken(&buffer, 0, 0))
+			{
+				oldHash = hashToken(oldHash, buffer.data(), buffer.size());
+				oldCount++;
+			}
+			double oldDone = Benchmark::seconds();
+
+			Tokenizer tokenizer(file.getData(), file.getSize());
+			TokenType token;
+			while (tokenizer.nextToken(token))
+			{
+				newHash = hashToken(newHash, token.data, token.length);
+				newCount++;
+			}
+			double newDone = Benchmark::seconds();
+
+			bestOld = fmin(bestOld, oldDone - start);
+			bestNew = fmin(bestNew, newDone - oldDone);
+		}
+
+		const char* note = (oldCount != newCount || oldHash != newHash) ? "MISMATCH" : "";
+		Benchmark::report(report, "%-24s %10.2f %12zu %16.1f %16.1f %7.1fx %s\n", findData.cFileName, megabytes, newCount,
+			megabytes / bestOld, megabytes / bestNew, bestOld / bestNew, note);
+
+		totalMB += megabytes;
+		totalOld += bestOld;
+		totalNew += bestNew;
+	} while (FindNextFileA(find, &findData));
+	FindClose(find);
+
+	if (totalNew > 0.0)
+	{
+		Benchmark::report(report, "%-24s %10.2f %12s %16.1f %16.1f %7.1fx\n", "total", totalMB, "",
+			totalMB / totalOld, totalMB / totalNew, totalOld / totalNew);
+	}
+}
@@ -0,0 +1,300 @@
+// Vertex generator
+// Grid and cube sphere rows, four vertices at a time.
+#include "VertexGenerator.h"
+#include "Benchmark.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define GENERATOR_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+	// Cube point to sphere point. Bends the cube onto the sphere more evenly than normalising.
+	inline void spherify(float x, float y, float z, float* out)
+	{
+		out[0] = x * sqrtf(1.0f - (y*y / 2.0f) - (z*z / 2.0f) + (y*y*z*z / 3.0f));
+		out[1] = y * sqrtf(1.0f - (z*z / 2.0f) - (x*x / 2.0f) + (z*z*x*x / 3.0f));
+		out[2] = z * sqrtf(1.0f - (x*x / 2.0f) - (y*y / 2.0f) + (x*x*y*y / 3.0f));
+	}
+
+#ifdef GENERATOR_SSE2
+	// Transposes four lanes of x, y, z, u and four of v, nx, ny, nz into four interleaved vertices.
+	inline void storeVertices(PrimitiveShapes::VertexType* vertices, __m128 x, __m128 y, __m128 z, __m128 u, __m128 v, __m128 nx, __m128 ny, __m128 nz)
+	{
+		_MM_TRANSPOSE4_PS(x, y, z, u);
+		_MM_TRANSPOSE4_PS(v, nx, ny, nz);
+		_mm_storeu_ps(vertices[0].position, x);
+		_mm_storeu_ps(vertices[0].texture + 1, v);
+		_mm_storeu_ps(vertices[1].position, y);
+		_mm_storeu_ps(vertices[1].texture + 1, nx);
+		_mm_storeu_ps(vertices[2].position, z);
+		_mm_storeu_ps(vertices[2].texture + 1, ny);
+		_mm_storeu_ps(vertices[3].position, u);
+		_mm_storeu_ps(vertices[3].texture + 1, nz);
+	}
+
+	// Grid columns first to first + 3 as floats.
+	inline __m128 columnLanes(int first)
+	{
+		return _mm_cvtepi32_ps(_mm_add_epi32(_mm_set1_epi32(first), _mm_setr_epi32(0, 1, 2, 3)));
+	}
+
+	// spherify() for four points: a * sqrt(1 - b*b / 2 - c*c / 2 + b*b*c*c / 3), multiplied in the same order.
+	inline __m128 spherifyLane(__m128 a, __m128 b, __m128 c)
+	{
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 two = _mm_set1_ps(2.0f);
+		const __m128 three = _mm_set1_ps(3.0f);
+		__m128 b2 = _mm_mul_ps(b, b);
+		__m128 c2 = _mm_mul_ps(c, c);
+		__m128 inside = _mm_sub_ps(_mm_sub_ps(one, _mm_div_ps(b2, two)), _mm_div_ps(c2, two));
+		inside = _mm_add_ps(inside, _mm_div_ps(_mm_mul_ps(_mm_mul_ps(b2, c), c), three));
+		return _mm_mul_ps(a, _mm_sqrt_ps(inside));
+	}
+#endif
+
+	// The loops the meshes used before the kernels, kept for the benchmark. One XMFLOAT3 at a time.
+	struct ReferenceVertexType
+	{
+		XMFLOAT3 position;
+		XMFLOAT2 texture;
+		XMFLOAT3 normal;
+	};
+
+	void referenceGrid(ReferenceVertexType* vertices, int resolution)
+	{
+		float increment = 1.0f / resolution;
+		int index = 0;
+		for (int j = 0; j < resolution; j++)
+		{
+			for (int i = 0; i < resolution; i++)
+			{
+				vertices[index].position = XMFLOAT3((float)i, 0.0f, (float)j);
+				vertices[index].texture = XMFLOAT2(i * increment, j * increment);
+				vertices[index].normal = XMFLOAT3(0.0, 1.0, 0.0);
+				index++;
+			}
+		}
+	}
+
+	void referenceSphere(ReferenceVertexType* vertices, int resolution)
+	{
+		int v = 0;
+		for (int face = 0; face < 6; face++)
+		{
+			const PrimitiveShapes::FaceType& f = PrimitiveShapes::cubeFaces[face];
+			for (int y = 0; y <= resolution; y++)
+			{
+				for (int x = 0; x <= resolution; x++)
+				{
+					float u = (float)x / resolution;
+					float t = (float)y / resolution;
+					float cube[3], sphere[3];
+					for (int axis = 0; axis < 3; axis++)
+					{
+						cube[axis] = f.origin[axis] + (f.uAxis[axis] * u + f.vAxis[axis] * t) * 2.0f;
+					}
+					spherify(cube[0], cube[1], cube[2], sphere);
+					vertices[v].position = XMFLOAT3(sphere[0], sphere[1], sphere[2]);
+					vertices[v].texture = XMFLOAT2(u, t);
+					vertices[v].normal = vertices[v].position;
+					v++;
+				}
+			}
+		}
+	}
+
+	// Largest difference between two vertex arrays of the same layout, over every float.
+	float compareVertices(const void* a, const void* b, size_t count)
+	{
+		const float* first = (const float*)a;
+		const float* second = (const float*)b;
+		float difference = 0.0f;
+		for (size_t i = 0; i < count * 8; i++)
+		{
+			difference = std::max(difference, fabsf(first[i] - second[i]));
+		}
+		return difference;
+	}
+}
+
+void VertexGenerator::writeGridRow(PrimitiveShapes::VertexType* vertices, int count, int first, float step, float uvStep, float z, float v,
+	const float* heights, float amplitude, const XMFLOAT3* normals)
+{
+	int k = 0;
+#ifdef GENERATOR_SSE2
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 up = _mm_set1_ps(1.0f);
+	const __m128 laneStep = _mm_set1_ps(step);
+	const __m128 laneUVStep = _mm_set1_ps(uvStep);
+	const __m128 laneZ = _mm_set1_ps(z);
+	const __m128 laneV = _mm_set1_ps(v);
+	const __m128 scale = _mm_set1_ps(amplitude);
+
+	for (; k + 4 <= count; k += 4)
+	{
+		// Positions are worked out from the column, not by adding the step, so tiles starting at different columns agree exactly.
+		__m128 column = columnLanes(first + k);
+		__m128 positionX = _mm_mul_ps(column, laneStep);
+		__m128 textureU = _mm_mul_ps(column, laneUVStep);
+		__m128 positionY = heights ? _mm_mul_ps(_mm_loadu_ps(heights + k), scale) : zero;
+
+		__m128 normalX = zero, normalY = up, normalZ = zero;
+		if (normals)
+		{
+			// The normals are packed as x, y, z triples. Four of them are three loads, shuffled apart into lanes.
+			const float* packed = &normals[k].x;
+			__m128 a = _mm_loadu_ps(packed);			// x0 y0 z0 x1
+			__m128 b = _mm_loadu_ps(packed + 4);		// y1 z1 x2 y2
+			__m128 c = _mm_loadu_ps(packed + 8);		// z2 x3 y3 z3
+			__m128 xy = _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 1, 3, 2));	// x2 y2 x3 y3
+			__m128 yz = _mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 0, 2, 1));	// y0 z0 y1 z1
+			normalX = _mm_shuffle_ps(a, xy, _MM_SHUFFLE(2, 0, 3, 0));
+			normalY = _mm_shuffle_ps(yz, xy, _MM_SHUFFLE(3, 1, 2, 0));
+			normalZ = _mm_shuffle_ps(yz, c, _MM_SHUFFLE(3, 0, 3, 1));
+		}
+
+		storeVertices(vertices + k, positionX, positionY, laneZ, textureU, laneV, normalX, normalY, normalZ);
+	}
+#endif
+	for (; k < count; k++)
+	{
+		PrimitiveShapes::VertexType& vertex = vertices[k];
+		vertex.position[0] = (first + k) * step;
+		vertex.position[1] = heights ? heights[k] * amplitude : 0.0f;
+		vertex.position[2] = z;
+		vertex.texture[0] = (first + k) * uvStep;
+		vertex.texture[1] = v;
+		vertex.normal[0] = normals ? normals[k].x : 0.0f;
+		vertex.normal[1] = normals ? normals[k].y : 1.0f;
+		vertex.normal[2] = normals ? normals[k].z : 0.0f;
+	}
+}
+
+void VertexGenerator::writeGrid(PrimitiveShapes::VertexType* vertices, int columns, int rows, float spacing, float uvStep)
+{
+	for (int j = 0; j < rows; j++)
+	{
+		writeGridRow(vertices + (size_t)j * columns, columns, 0, spacing, uvStep, j * spacing, j * uvStep);
+	}
+}
+
+void VertexGenerator::writeSphereRow(PrimitiveShapes::VertexType* vertices, const PrimitiveShapes::FaceType& face, int y, int resolution)
+{
+	int count = resolution + 1;
+	float v = (float)y / resolution;
+	int k = 0;
+#ifdef GENERATOR_SSE2
+	const __m128 laneResolution = _mm_set1_ps((float)resolution);
+	const __m128 laneV = _mm_set1_ps(v);
+	const __m128 two = _mm_set1_ps(2.0f);
+
+	// The cube point is origin + (uAxis * u + vAxis * v) * 2. Only u changes along the row.
+	__m128 origin[3], uAxis[3], vOffset[3];
+	for (int axis = 0; axis < 3; axis++)
+	{
+		origin[axis] = _mm_set1_ps(face.origin[axis]);
+		uAxis[axis] = _mm_set1_ps(face.uAxis[axis]);
+		vOffset[axis] = _mm_set1_ps(face.vAxis[axis] * v);
+	}
+
+	for (; k + 4 <= count; k += 4)
+	{
+		__m128 textureU = _mm_div_ps(columnLanes(k), laneResolution);
+		__m128 cube[3];
+		for (int axis = 0; axis < 3; axis++)
+		{
+			cube[axis] = _mm_add_ps(origin[axis], _mm_mul_ps(_mm_add_ps(_mm_mul_ps(uAxis[axis], textureU), vOffset[axis]), two));
+		}
+
+		__m128 sphereX = spherifyLane(cube[0], cube[1], cube[2]);
+		__m128 sphereY = spherifyLane(cube[1], cube[2], cube[0]);
+		__m128 sphereZ = spherifyLane(cube[2], cube[0], cube[1]);
+
+		storeVertices(vertices + k, sphereX, sphereY, sphereZ, textureU, laneV, sphereX, sphereY, sphereZ);
+	}
+#endif
+	for (; k < count; k++)
+	{
+		PrimitiveShapes::VertexType& vertex = vertices[k];
+		float u = (float)k / resolution;
+		spherify(face.origin[0] + (face.uAxis[0] * u + face.vAxis[0] * v) * 2.0f,
+			face.origin[1] + (face.uAxis[1] * u + face.vAxis[1] * v) * 2.0f,
+			face.origin[2] + (face.uAxis[2] * u + face.vAxis[2] * v) * 2.0f, vertex.position);
+		vertex.texture[0] = u;
+		vertex.texture[1] = v;
+		vertex.normal[0] = vertex.position[0];
+		vertex.normal[1] = vertex.position[1];
+		vertex.normal[2] = vertex.position[2];
+	}
+}
+
+void VertexGenerator::benchmark(FILE* report)
+{
+	const int resolutions[] = { 64, 256, 1024 };
+	const double minimumTime = 0.2;
+
+#ifdef GENERATOR_SSE2
+	Benchmark::report(report, "Grid and cube sphere vertex generation, SSE2 kernels against one vertex at a time. Times in ms per mesh\n");
+#else
+	Benchmark::report(report, "Grid and cube sphere vertex generation, built without SSE2 so both run one vertex at a time. Times in ms per mesh\n");
+#endif
+	Benchmark::report(report, "%-8s %6s %10s %12s %12s %8s %10s %12s\n", "shape", "res", "vertices", "before ms", "kernel ms", "speedup", "Mvert/s", "difference");
+
+	for (int shape = 0; shape < 2; shape++)
+	{
+		for (int r = 0; r < (int)(sizeof(resolutions) / sizeof(resolutions[0])); r++)
+		{
+			int resolution = resolutions[r];
+			size_t count = shape == 0 ? (size_t)resolution * resolution : (size_t)PrimitiveShapes::getCubeVertexCount(resolution);
+			std::vector<ReferenceVertexType> before(count);
+			std::vector<PrimitiveShapes::VertexType> after(count);
+
+			// Repeat each until it has run for long enough to time, and keep the best pass.
+			double beforeTime = 1e30, kernelTime = 1e30;
+			double start = Benchmark::seconds();
+			while (Benchmark::seconds() - start < minimumTime)
+			{
+				double passStart = Benchmark::seconds();
+				if (shape == 0)
+				{
+					referenceGrid(before.data(), resolution);
+				}
+				else
+				{
+					referenceSphere(before.data(), resolution);
+				}
+				beforeTime = std::min(beforeTime, Benchmark::seconds() - passStart);
+			}
+
+			start = Benchmark::seconds();
+			while (Benchmark::seconds() - start < minimumTime)
+			{
+				double passStart = Benchmark::seconds();
+				if (shape == 0)
+				{
+					writeGrid(after.data(), resolution, resolution, 1.0f, 1.0f / resolution);
+				}
+				else
+				{
+					int faceSize = resolution + 1;
+					for (int face = 0; face < 6; face++)
+					{
+						for (int y = 0; y < faceSize; y++)
+						{
+							writeSphereRow(&after[((size_t)face * faceSize + y) * faceSize], PrimitiveShapes::cubeFaces[face], y, resolution);
+						}
+					}
+				}
+				kernelTime = std::min(kernelTime, Benchmark::seconds() - passStart);
+			}
+
+			Benchmark::report(report, "%-8s %6d %10zu %12.3f %12.3f %7.1fx %10.1f %12.2g\n", shape == 0 ? "grid" : "sphere", resolution, count,
+				beforeTime * 1000.0, kernelTime * 1000.0, beforeTime / kernelTime, count / kernelTime / 1e6, compareVertices(before.data(), after.data(), count));
+		}
+	}
+}
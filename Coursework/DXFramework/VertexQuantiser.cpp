@@ -0,0 +1,262 @@
+// Vertex quantiser
+// Packs position, texture and normal into 16 byte vertices, and measures how much precision that loses.
+#include "VertexQuantiser.h"
+#include "Benchmark.h"
+#include "ObjParser.h"
+#include "VertexWelder.h"
+#include <windows.h>
+#include <DirectXPackedVector.h>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <string>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+	const float snormMax = 32767.0f;
+
+	// Rounds a value in [-1, 1] to the nearest snorm16.
+	short toSnorm(float value)
+	{
+		value = std::max(-1.0f, std::min(1.0f, value));
+		return (short)(value * snormMax + (value >= 0.0f ? 0.5f : -0.5f));
+	}
+
+	// The D3D snorm conversion, -32768 and -32767 both map to -1.
+	float fromSnorm(short value)
+	{
+		return std::max(value / snormMax, -1.0f);
+	}
+
+	float signNotZero(float value)
+	{
+		return value >= 0.0f ? 1.0f : -1.0f;
+	}
+
+	// Vertex layout shared with BaseMesh::VertexType and ObjParser::VertexType.
+	const float* vertexAt(const void* vertices, unsigned long index, unsigned int stride)
+	{
+		return (const float*)((const char*)vertices + (size_t)index * stride);
+	}
+}
+
+VertexQuantiser::DecodeType VertexQuantiser::quantise(const void* vertices, unsigned long vertexCount, unsigned int stride, QuantisedVertexType* quantised)
+{
+	DecodeType decode;
+	float minimum[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+	float maximum[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+	for (unsigned long i = 0; i < vertexCount; i++)
+	{
+		const float* position = vertexAt(vertices, i, stride);
+		for (int axis = 0; axis < 3; axis++)
+		{
+			minimum[axis] = std::min(minimum[axis], position[axis]);
+			maximum[axis] = std::max(maximum[axis], position[axis]);
+		}
+	}
+
+	// Centre on the bounds and scale by the largest half extent, the same on every axis.
+	decode.scale = 0.0f;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		decode.bias[axis] = vertexCount > 0 ? (minimum[axis] + maximum[axis]) * 0.5f : 0.0f;
+		decode.scale = std::max(decode.scale, vertexCount > 0 ? (maximum[axis] - minimum[axis]) * 0.5f : 0.0f);
+	}
+	if (decode.scale <= 0.0f)
+	{
+		decode.scale = 1.0f;
+	}
+
+	for (unsigned long i = 0; i < vertexCount; i++)
+	{
+		const float* vertex = vertexAt(vertices, i, stride);
+		QuantisedVertexType& packed = quantised[i];
+
+		for (int axis = 0; axis < 3; axis++)
+		{
+			packed.position[axis] = toSnorm((vertex[axis] - decode.bias[axis]) / decode.scale);
+		}
+		packed.position[3] = (short)snormMax;
+
+		packed.texture[0] = PackedVector::XMConvertFloatToHalf(vertex[3]);
+		packed.texture[1] = PackedVector::XMConvertFloatToHalf(vertex[4]);
+
+		encodeOctahedral(vertex + 5, packed.normal);
+	}
+
+	return decode;
+}
+
+void VertexQuantiser::dequantise(const QuantisedVertexType& vertex, const DecodeType& decode, float* position, float* texture, float* normal)
+{
+	for (int axis = 0; axis < 3; axis++)
+	{
+		position[axis] = fromSnorm(vertex.position[axis]) * decode.scale + decode.bias[axis];
+	}
+
+	texture[0] = PackedVector::XMConvertHalfToFloat(vertex.texture[0]);
+	texture[1] = PackedVector::XMConvertHalfToFloat(vertex.texture[1]);
+
+	decodeOctahedral(vertex.normal, normal);
+}
+
+// Projects the normal onto the octahedron |x| + |y| + |z| = 1, then folds the lower half over the upper half.
+void VertexQuantiser::encodeOctahedral(const float* normal, short* encoded)
+{
+	float sum = fabsf(normal[0]) + fabsf(normal[1]) + fabsf(normal[2]);
+	if (sum <= 0.0f)
+	{
+		encoded[0] = 0;
+		encoded[1] = 0;
+		return;
+	}
+
+	float u = normal[0] / sum;
+	float v = normal[1] / sum;
+	if (normal[2] < 0.0f)
+	{
+		float foldedU = (1.0f - fabsf(v)) * signNotZero(u);
+		float foldedV = (1.0f - fabsf(u)) * signNotZero(v);
+		u = foldedU;
+		v = foldedV;
+	}
+
+	encoded[0] = toSnorm(u);
+	encoded[1] = toSnorm(v);
+}
+
+// Matches the decode in light_quantised_vs.hlsl.
+void VertexQuantiser::decodeOctahedral(const short* encoded, float* normal)
+{
+	float x = fromSnorm(encoded[0]);
+	float y = fromSnorm(encoded[1]);
+	float z = 1.0f - fabsf(x) - fabsf(y);
+
+	// Unfold the lower half.
+	float t = std::max(-z, 0.0f);
+	x += x >= 0.0f ? -t : t;
+	y += y >= 0.0f ? -t : t;
+
+	float length = sqrtf(x * x + y * y + z * z);
+	normal[0] = x / length;
+	normal[1] = y / length;
+	normal[2] = z / length;
+}
+
+VertexQuantiser::ErrorType VertexQuantiser::measureError(const void* vertices, unsigned long vertexCount, unsigned int stride, DecodeType* ldecode)
+{
+	ErrorType error = { 0.0f, 0.0f, 0.0f };
+
+	std::vector<QuantisedVertexType> quantised(vertexCount);
+	DecodeType decode = quantise(vertices, vertexCount, stride, quantised.data());
+	if (ldecode)
+	{
+		*ldecode = decode;
+	}
+
+	for (unsigned long i = 0; i < vertexCount; i++)
+	{
+		const float* vertex = vertexAt(vertices, i, stride);
+		float position[3], texture[2], normal[3];
+		dequantise(quantised[i], decode, position, texture, normal);
+
+		float dx = position[0] - vertex[0];
+		float dy = position[1] - vertex[1];
+		float dz = position[2] - vertex[2];
+		error.position = std::max(error.position, sqrtf(dx * dx + dy * dy + dz * dz));
+
+		error.texture = std::max(error.texture, std::max(fabsf(texture[0] - vertex[3]), fabsf(texture[1] - vertex[4])));
+
+		// Compare directions, files don't always store unit normals. Zero normals have no direction to keep.
+		// The angle comes from both the sine and the cosine: acos of a float cosine can't resolve angles under about 0.02 degrees, and the
+		// rounding error is far smaller than that.
+		float length = sqrtf(vertex[5] * vertex[5] + vertex[6] * vertex[6] + vertex[7] * vertex[7]);
+		if (length > 0.0f)
+		{
+			double cosine = (double)normal[0] * vertex[5] + (double)normal[1] * vertex[6] + (double)normal[2] * vertex[7];
+			double cross[3] =
+			{
+				(double)normal[1] * vertex[7] - (double)normal[2] * vertex[6],
+				(double)normal[2] * vertex[5] - (double)normal[0] * vertex[7],
+				(double)normal[0] * vertex[6] - (double)normal[1] * vertex[5],
+			};
+			double sine = sqrt(cross[0] * cross[0] + cross[1] * cross[1] + cross[2] * cross[2]);
+			float angle = (float)(atan2(sine, cosine) * (180.0 / XM_PI));
+			error.normal = std::max(error.normal, angle);
+		}
+	}
+
+	return error;
+}
+
+VertexQuantiser::ErrorType VertexQuantiser::errorBound(const DecodeType& decode)
+{
+	ErrorType bound = { 0.0f, 0.0f, 0.0f };
+
+	// Each axis rounds to within half a step, scale / 32767, of the original. The distance covers all three at once.
+	// The float maths of the encode and decode adds a few rounding errors at the size of the coordinates.
+	float halfStep = 0.5f * decode.scale / snormMax;
+	float largest = decode.scale + std::max(fabsf(decode.bias[0]), std::max(fabsf(decode.bias[1]), fabsf(decode.bias[2])));
+	bound.position = sqrtf(3.0f) * halfStep + 4.0f * FLT_EPSILON * largest;
+
+	// The octahedral coordinates also round to within half a step, 1 / 32767, on each axis, which moves the point on the octahedron
+	// by at most sqrt(6) half steps. No point on the octahedron is closer than 1 / sqrt(3) to the centre, so the direction turns by at most
+	// sqrt(18) half steps in radians. The normalise on decode adds a little more.
+	bound.normal = (sqrtf(18.0f) * 0.5f / snormMax + 4.0f * FLT_EPSILON) * (180.0f / XM_PI);
+
+	return bound;
+}
+
+void VertexQuantiser::benchmark(const char* directory, FILE* report)
+{
+	std::string pattern = std::string(directory) + "\\*.obj";
+	WIN32_FIND_DATAA findData;
+	HANDLE find = FindFirstFileA(pattern.c_str(), &findData);
+	if (find == INVALID_HANDLE_VALUE)
+	{
+		Benchmark::report(report, "Vertex quantiser: no .obj files in %s\n", directory);
+		return;
+	}
+
+	Benchmark::report(report, "Vertex quantiser, 32 byte float vertices against 16 byte packed vertices\n");
+	Benchmark::report(report, "Position error is bounded by half a snorm16 step of the extent on each axis, normal error by %g degrees for 16 bit octahedral\n",
+		errorBound(DecodeType()).normal);
+	Benchmark::report(report, "%-24s %10s %18s %18s %12s %12s %12s %12s\n", "file", "vertices", "vertex KB before/after", "index KB before/after", "position err", "position max",
+		"normal deg", "uv err");
+
+	do
+	{
+		std::string path = std::string(directory) + "\\" + findData.cFileName;
+
+		std::vector<ObjParser::VertexType> vertices;
+		if (!ObjParser::load(path.c_str(), vertices))
+		{
+			Benchmark::report(report, "%-24s parse failed\n", findData.cFileName);
+			continue;
+		}
+
+		// Weld first, so the sizes are for the indexed mesh the loaders upload.
+		std::vector<unsigned long> indices(vertices.size());
+		unsigned long vertexCount = VertexWelder::weld(vertices.data(), (unsigned long)vertices.size(), sizeof(ObjParser::VertexType), vertices.data(), indices.data());
+		unsigned long indexCount = (unsigned long)indices.size();
+
+		DecodeType decode;
+		ErrorType error = measureError(vertices.data(), vertexCount, sizeof(ObjParser::VertexType), &decode);
+		ErrorType bound = errorBound(decode);
+
+		// Meshes under 65536 vertices get 16 bit indices (see BaseMesh::createIndexBuffer()).
+		size_t indexSize = vertexCount < 65536 ? sizeof(unsigned short) : sizeof(unsigned long);
+
+		const char* note = error.position > bound.position ? (error.normal > bound.normal ? "POSITION AND NORMAL OVER BOUND" : "POSITION OVER BOUND") :
+			(error.normal > bound.normal ? "NORMAL OVER BOUND" : "");
+		Benchmark::report(report, "%-24s %10lu %8.1f / %7.1f %8.1f / %7.1f %12g %12g %12g %12g %s\n", findData.cFileName, vertexCount,
+			vertexCount * sizeof(ObjParser::VertexType) / 1024.0, vertexCount * sizeof(QuantisedVertexType) / 1024.0,
+			indexCount * sizeof(unsigned long) / 1024.0, indexCount * indexSize / 1024.0,
+			error.position, bound.position, error.normal, error.texture, note);
+	} while (FindNextFileA(find, &findData));
+	FindClose(find);
+}
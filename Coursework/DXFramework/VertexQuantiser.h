@@ -0,0 +1,71 @@
+/**
+* \class Vertex Quantiser
+*
+* \brief Packs the standard 32 byte vertex (position, texture, normal) into 16 bytes
+*
+* - Position: three snorm16 values relative to the mesh bounds, w stored as 1 so the shader still reads a float4.
+* - Normal: octahedral encoding in two snorm16 values, unpacked in the vertex shader (see light_quantised_vs.hlsl).
+* - Texture: two half floats, so tiled coordinates outside 0-1 still work.
+*
+* The positions decode with one uniform scale and a bias, folded into the world matrix (see BaseMesh::getDecodeMatrix()).
+* The scale is uniform so normals transformed by that matrix only need normalising, as they already are.
+*/
+
+
+#ifndef _VERTEXQUANTISER_H_
+#define _VERTEXQUANTISER_H_
+
+#include <cstdio>
+
+class VertexQuantiser
+{
+public:
+	/// 16 byte vertex, matches the input layout from BaseShader::loadQuantisedVertexShader().
+	struct QuantisedVertexType
+	{
+		short position[4];			///< R16G16B16A16_SNORM
+		short normal[2];			///< R16G16_SNORM, octahedral
+		unsigned short texture[2];	///< R16G16_FLOAT
+	};
+
+	/// Maps decoded snorm positions back to model space: position * scale + bias.
+	struct DecodeType
+	{
+		float scale;
+		float bias[3];
+	};
+
+	/// Largest differences between a decoded vertex and the original.
+	struct ErrorType
+	{
+		float position;		///< Model space distance
+		float normal;		///< Angle in degrees
+		float texture;		///< Texture coordinate difference
+	};
+
+	/** \brief Quantises an array of vertices.
+	* @param vertices are laid out as three position floats, two texture floats then three normal floats, stride bytes apart
+	* @param vertexCount is the number of vertices
+	* @param stride is the size of one vertex in bytes
+	* @param quantised receives vertexCount packed vertices
+	* @return the decode values for the positions
+	*/
+	static DecodeType quantise(const void* vertices, unsigned long vertexCount, unsigned int stride, QuantisedVertexType* quantised);
+
+	/// Unpacks one vertex back into position[3], texture[2] and normal[3], the same way the GPU does.
+	static void dequantise(const QuantisedVertexType& vertex, const DecodeType& decode, float* position, float* texture, float* normal);
+
+	/// Round trips the vertices and returns the worst error of each attribute. decode, if given, receives the decode values they were quantised with.
+	static ErrorType measureError(const void* vertices, unsigned long vertexCount, unsigned int stride, DecodeType* decode = nullptr);
+
+	/// Largest position and normal errors rounding to 16 bits can cause, for vertices quantised with decode. Texture is left 0, half float error depends on the value.
+	static ErrorType errorBound(const DecodeType& decode);
+
+	static void encodeOctahedral(const float* normal, short* encoded);
+	static void decodeOctahedral(const short* encoded, float* normal);
+
+	/// Quantises every .obj in directory and writes the decode error and buffer sizes to the report. Flags files whose error is over errorBound().
+	static void benchmark(const char* directory, FILE* report);
+};
+
+#endif
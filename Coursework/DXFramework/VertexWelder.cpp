@@ -0,0 +1,78 @@
+// Vertex welder
+// Deduplicates vertices with a hash table and writes the matching index buffer.
+#include "VertexWelder.h"
+#include <windows.h>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+	const unsigned long emptySlot = 0xffffffff;
+
+	// Hashes a vertex 4 bytes at a time (FNV-1a over words, with a final mix).
+	inline unsigned int hashVertex(const unsigned char* vertex, unsigned int stride)
+	{
+		unsigned int hash = 2166136261u;
+		for (unsigned int i = 0; i < stride; i += 4)
+		{
+			unsigned int word;
+			memcpy(&word, vertex + i, 4);
+			hash = (hash ^ word) * 16777619u;
+		}
+		hash ^= hash >> 15;
+		hash *= 0x2c1b3c6du;
+		hash ^= hash >> 12;
+		return hash;
+	}
+}
+
+unsigned long VertexWelder::weld(const void* vertices, unsigned long vertexCount, unsigned int stride, void* weldedVertices, unsigned long* indices)
+{
+	const unsigned char* in = (const unsigned char*)vertices;
+	unsigned char* out = (unsigned char*)weldedVertices;
+
+	// Open addressing table of welded vertex indices, kept at most half full.
+	unsigned long tableSize = 16;
+	while (tableSize < vertexCount * 2)
+	{
+		tableSize <<= 1;
+	}
+	const unsigned long mask = tableSize - 1;
+	std::vector<unsigned long> table(tableSize, emptySlot);
+
+	unsigned long uniqueCount = 0;
+	for (unsigned long i = 0; i < vertexCount; i++)
+	{
+		const unsigned char* vertex = in + (size_t)i * stride;
+		unsigned long slot = hashVertex(vertex, stride) & mask;
+		while (true)
+		{
+			unsigned long candidate = table[slot];
+			if (candidate == emptySlot)
+			{
+				// First time this vertex has been seen. Compacting in place is safe, as uniqueCount never passes i.
+				memmove(out + (size_t)uniqueCount * stride, vertex, stride);
+				table[slot] = uniqueCount;
+				indices[i] = uniqueCount;
+				uniqueCount++;
+				break;
+			}
+			if (memcmp(out + (size_t)candidate * stride, vertex, stride) == 0)
+			{
+				indices[i] = candidate;
+				break;
+			}
+			slot = (slot + 1) & mask;
+		}
+	}
+
+	return uniqueCount;
+}
+
+void VertexWelder::report(const char* meshName, unsigned long before, unsigned long after)
+{
+	char line[256];
+	sprintf_s(line, sizeof(line), "%s: welded %lu vertices to %lu (%.1fx)\n", meshName, before, after, after ? (double)before / after : 0.0);
+	OutputDebugStringA(line);
+}
@@ -0,0 +1,156 @@
+// Worker pool
+// Runs queued tasks on a fixed set of threads.
+#include "WorkerPool.h"
+#include <exception>
+
+WorkerPool::WorkerPool(unsigned int threadCount)
+{
+	stopping = false;
+
+	if (threadCount == 0)
+	{
+		unsigned int hardwareThreads = std::thread::hardware_concurrency();
+		threadCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+	}
+
+	for (unsigned int i = 0; i < threadCount; i++)
+	{
+		workers.push_back(std::thread(&WorkerPool::workerLoop, this));
+	}
+}
+
+// Finish any queued tasks, then join the workers.
+WorkerPool::~WorkerPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(taskMutex);
+		stopping = true;
+	}
+	taskAvailable.notify_all();
+
+	for (size_t i = 0; i < workers.size(); i++)
+	{
+		workers[i].join();
+	}
+}
+
+WorkerPool& WorkerPool::shared()
+{
+	static WorkerPool pool;
+	return pool;
+}
+
+void WorkerPool::run(const std::function<void()>& task)
+{
+	{
+		std::lock_guard<std::mutex> lock(taskMutex);
+		tasks.push_back(task);
+	}
+	taskAvailable.notify_one();
+}
+
+void WorkerPool::parallelFor(int count, const std::function<void(int)>& body)
+{
+	if (count <= 0)
+	{
+		return;
+	}
+
+	// The tasks reference these on the caller's stack, so a task only touches them while holding doneMutex, and the caller
+	// takes doneMutex to see the count reach zero. Once it has, no task can still be using them and it is safe to return.
+	// A throwing call still counts as finished, or the caller would return while other tasks still use its stack.
+	int remaining = count;
+	std::exception_ptr error;
+	std::mutex doneMutex;
+	std::condition_variable done;
+
+	{
+		std::lock_guard<std::mutex> lock(taskMutex);
+		for (int i = 0; i < count; i++)
+		{
+			tasks.push_back([&body, &remaining, &error, &doneMutex, &done, i]()
+			{
+				std::exception_ptr thrown;
+				try
+				{
+					body(i);
+				}
+				catch (...)
+				{
+					thrown = std::current_exception();
+				}
+				std::lock_guard<std::mutex> doneLock(doneMutex);
+				if (thrown && !error)
+				{
+					error = thrown;
+				}
+				if (--remaining == 0)
+				{
+					done.notify_all();
+				}
+			});
+		}
+	}
+	taskAvailable.notify_all();
+
+	// Help out rather than just blocking. This also keeps nested calls from a worker thread from deadlocking.
+	while (true)
+	{
+		{
+			std::lock_guard<std::mutex> doneLock(doneMutex);
+			if (remaining == 0)
+			{
+				break;
+			}
+		}
+		if (!tryRunTask())
+		{
+			std::unique_lock<std::mutex> doneLock(doneMutex);
+			done.wait(doneLock, [&remaining]() { return remaining == 0; });
+		}
+	}
+
+	if (error)
+	{
+		std::rethrow_exception(error);
+	}
+}
+
+// Runs one queued task on the calling thread, if there is one.
+bool WorkerPool::tryRunTask()
+{
+	std::function<void()> task;
+	{
+		std::lock_guard<std::mutex> lock(taskMutex);
+		if (tasks.empty())
+		{
+			return false;
+		}
+		task = std::move(tasks.front());
+		tasks.pop_front();
+	}
+
+	task();
+	return true;
+}
+
+void WorkerPool::workerLoop()
+{
+	while (true)
+	{
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(taskMutex);
+			taskAvailable.wait(lock, [this]() { return stopping || !tasks.empty(); });
+			if (tasks.empty())
+			{
+				// Stopping and nothing left to do.
+				return;
+			}
+			task = std::move(tasks.front());
+			tasks.pop_front();
+		}
+
+		task();
+	}
+}
@@ -0,0 +1,268 @@
+// State cache test
+// Drives StateCache into a NullTarget and checks which calls get through, without a device.
+// Built against stub/d3d11.h with the system compiler, see the Makefile.
+#include "StateCache.h"
+#include "Benchmark.h"
+#include <cstdarg>
+#include <cstdio>
+
+// StateCache::benchmark() reports through these. Benchmark.cpp needs windows.h, so the test brings its own.
+void Benchmark::report(FILE* out, const char* format, ...)
+{
+	va_list arguments;
+	va_start(arguments, format);
+	vfprintf(out, format, arguments);
+	va_end(arguments);
+}
+
+double Benchmark::seconds()
+{
+	return 0.0;
+}
+
+namespace
+{
+	int failures = 0;
+
+	void check(bool passed, const char* what, int line)
+	{
+		if (!passed)
+		{
+			printf("FAILED line %d: %s\n", line, what);
+			failures++;
+		}
+	}
+
+#define CHECK(condition) check((condition), #condition, __LINE__)
+
+	// Also remembers the slots of the last ranged call, to check how narrow() trimmed it.
+	class RecordingTarget : public StateCache::NullTarget
+	{
+	public:
+		RecordingTarget() : lastStage(StateCache::STAGE_COUNT), lastStart(0), lastCount(0) {}
+
+		void setConstantBuffers(StateCache::StageType stage, UINT startSlot, UINT count, ID3D11Buffer* const* buffers) override
+		{
+			NullTarget::setConstantBuffers(stage, startSlot, count, buffers);
+			record(stage, startSlot, count);
+		}
+		void setShaderResources(StateCache::StageType stage, UINT startSlot, UINT count, ID3D11ShaderResourceView* const* views) override
+		{
+			NullTarget::setShaderResources(stage, startSlot, count, views);
+			record(stage, startSlot, count);
+		}
+		void setSamplers(StateCache::StageType stage, UINT startSlot, UINT count, ID3D11SamplerState* const* samplers) override
+		{
+			NullTarget::setSamplers(stage, startSlot, count, samplers);
+			record(stage, startSlot, count);
+		}
+		void setVertexBuffers(UINT startSlot, UINT count, ID3D11Buffer* const* buffers, const UINT* strides, const UINT* offsets) override
+		{
+			NullTarget::setVertexBuffers(startSlot, count, buffers, strides, offsets);
+			record(StateCache::STAGE_COUNT, startSlot, count);
+		}
+
+		StateCache::StageType lastStage;
+		UINT lastStart;
+		UINT lastCount;
+
+	private:
+		void record(StateCache::StageType stage, UINT startSlot, UINT count)
+		{
+			lastStage = stage;
+			lastStart = startSlot;
+			lastCount = count;
+		}
+	};
+
+	void testRepeats()
+	{
+		RecordingTarget target;
+		StateCache cache(target);
+		ID3D11InputLayout layout;
+		ID3D11VertexShader vertexShader;
+		ID3D11PixelShader pixelShader;
+		ID3D11Buffer buffers[2];
+		ID3D11Buffer* buffer = &buffers[0];
+
+		// The first call to each slot always gets through, repeats don't.
+		cache.IASetInputLayout(&layout);
+		cache.IASetInputLayout(&layout);
+		cache.IASetIndexBuffer(&buffers[1], DXGI_FORMAT_R32_UINT, 0);
+		cache.IASetIndexBuffer(&buffers[1], DXGI_FORMAT_R32_UINT, 0);
+		cache.IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+		cache.IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+		cache.VSSetShader(&vertexShader);
+		cache.VSSetShader(&vertexShader);
+		cache.PSSetShader(&pixelShader);
+		cache.VSSetConstantBuffers(0, 1, &buffer);
+		cache.VSSetConstantBuffers(0, 1, &buffer);
+		CHECK(target.calls == 6);
+		CHECK(cache.getStats().issued == 6);
+		CHECK(cache.getStats().elided == 5);
+
+		// The same buffer on another stage, or another buffer in the same slot, is a change.
+		cache.PSSetConstantBuffers(0, 1, &buffer);
+		buffer = &buffers[1];
+		cache.VSSetConstantBuffers(0, 1, &buffer);
+		CHECK(target.calls == 8);
+
+		// So is the same index buffer at another format or offset.
+		cache.IASetIndexBuffer(&buffers[1], DXGI_FORMAT_R16_UINT, 0);
+		cache.IASetIndexBuffer(&buffers[1], DXGI_FORMAT_R16_UINT, 64);
+		CHECK(target.calls == 10);
+
+		// Unbinding is a binding like any other: null is cached, not treated as unknown.
+		cache.HSSetShader(NULL);
+		cache.HSSetShader(NULL);
+		CHECK(target.calls == 11);
+		CHECK(cache.getStats().issued == 11);
+		CHECK(cache.getStats().elided == 6);
+	}
+
+	void testNarrow()
+	{
+		RecordingTarget target;
+		StateCache cache(target);
+		ID3D11ShaderResourceView views[30];
+		ID3D11ShaderResourceView* bound[24];
+		for (int i = 0; i < 24; i++)
+		{
+			bound[i] = &views[i];
+		}
+
+		cache.PSSetShaderResources(2, 24, bound);
+		CHECK(target.lastStart == 2 && target.lastCount == 24);
+		CHECK(target.slots == 24);
+
+		cache.PSSetShaderResources(2, 24, bound);
+		CHECK(target.calls == 1);
+
+		// Only the span from the first to the last changed slot is passed on, unchanged slots inside it included.
+		bound[5] = &views[28];
+		bound[7] = &views[29];
+		cache.PSSetShaderResources(2, 24, bound);
+		CHECK(target.calls == 2);
+		CHECK(target.lastStage == StateCache::PIXEL_STAGE);
+		CHECK(target.lastStart == 7 && target.lastCount == 3);
+		CHECK(target.slots == 27);
+
+		// A call inside an already bound range trims the same way.
+		bound[10] = &views[27];
+		cache.PSSetShaderResources(4, 10, bound + 2);
+		CHECK(target.lastStart == 12 && target.lastCount == 1);
+
+		// Nothing to bind is always a repeat.
+		cache.PSSetShaderResources(0, 0, bound);
+		CHECK(target.calls == 3);
+
+		// Calls that run past the last slot go through whole, for the runtime to report.
+		ID3D11SamplerState sampler;
+		ID3D11SamplerState* samplers[2] = { &sampler, &sampler };
+		cache.PSSetSamplers(D3D11_COMMONSHADER_SAMPLER_SLOT_COUNT - 1, 2, samplers);
+		cache.PSSetSamplers(D3D11_COMMONSHADER_SAMPLER_SLOT_COUNT - 1, 2, samplers);
+		CHECK(target.calls == 5);
+		CHECK(target.lastStart == D3D11_COMMONSHADER_SAMPLER_SLOT_COUNT - 1 && target.lastCount == 2);
+
+		// Vertex buffer slots only match when the buffer, stride and offset all do.
+		ID3D11Buffer buffers[2];
+		ID3D11Buffer* vertexBuffers[2] = { &buffers[0], &buffers[1] };
+		UINT strides[2] = { 32, 64 };
+		UINT offsets[2] = { 0, 0 };
+		cache.IASetVertexBuffers(0, 2, vertexBuffers, strides, offsets);
+		cache.IASetVertexBuffers(0, 2, vertexBuffers, strides, offsets);
+		CHECK(target.calls == 6);
+		offsets[1] = 128;
+		cache.IASetVertexBuffers(0, 2, vertexBuffers, strides, offsets);
+		CHECK(target.calls == 7);
+		CHECK(target.lastStart == 1 && target.lastCount == 1);
+	}
+
+	void testInvalidate()
+	{
+		RecordingTarget target;
+		StateCache cache(target);
+		ID3D11VertexShader vertexShader;
+		ID3D11Buffer buffer;
+		ID3D11Buffer* constantBuffer = &buffer;
+		ID3D11ShaderResourceView views[2];
+		ID3D11ShaderResourceView* resources[2] = { &views[0], &views[1] };
+		ID3D11SamplerState sampler;
+		ID3D11SamplerState* samplerState = &sampler;
+
+		cache.VSSetShader(&vertexShader);
+		cache.VSSetConstantBuffers(0, 1, &constantBuffer);
+		cache.PSSetShaderResources(0, 2, resources);
+		cache.DSSetShaderResources(0, 1, resources);
+		cache.PSSetSamplers(0, 1, &samplerState);
+		CHECK(target.calls == 5);
+
+		// Only the shader resources are forgotten, on every stage.
+		cache.invalidateShaderResources();
+		cache.VSSetShader(&vertexShader);
+		cache.VSSetConstantBuffers(0, 1, &constantBuffer);
+		cache.PSSetSamplers(0, 1, &samplerState);
+		CHECK(target.calls == 5);
+		cache.PSSetShaderResources(0, 2, resources);
+		cache.DSSetShaderResources(0, 1, resources);
+		CHECK(target.calls == 7);
+		CHECK(target.lastStage == StateCache::DOMAIN_STAGE);
+		cache.PSSetShaderResources(0, 2, resources);
+		CHECK(target.calls == 7);
+
+		// Everything is forgotten.
+		cache.invalidate();
+		cache.VSSetShader(&vertexShader);
+		cache.VSSetConstantBuffers(0, 1, &constantBuffer);
+		cache.PSSetShaderResources(0, 2, resources);
+		cache.PSSetSamplers(0, 1, &samplerState);
+		cache.IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+		CHECK(target.calls == 12);
+
+		// A new frame keeps the last one's stats, starts counting again and invalidates.
+		StateCache::StatsType before = cache.getStats();
+		cache.beginFrame();
+		CHECK(cache.getFrameStats().issued == before.issued && cache.getFrameStats().elided == before.elided);
+		CHECK(cache.getStats().issued == 0 && cache.getStats().elided == 0);
+		cache.VSSetShader(&vertexShader);
+		CHECK(target.calls == 13);
+		CHECK(cache.getStats().issued == 1);
+	}
+
+	void testRegistry()
+	{
+		ID3D11DeviceContext first;
+		ID3D11DeviceContext second;
+		StateCache* cache = StateCache::get(&first);
+		CHECK(cache != NULL);
+		CHECK(StateCache::get(&first) == cache);
+		CHECK(StateCache::get(&second) != cache);
+
+		ID3D11VertexShader vertexShader;
+		cache->VSSetShader(&vertexShader);
+		cache->VSSetShader(&vertexShader);
+		CHECK(cache->getStats().issued == 1 && cache->getStats().elided == 1);
+
+		StateCache::release(&first);
+		StateCache::release(&second);
+	}
+}
+
+int main()
+{
+	testRepeats();
+	testNarrow();
+	testInvalidate();
+	testRegistry();
+
+	// The benchmark checks its cache against binding everything, and must still run.
+	StateCache::benchmark(stdout);
+
+	if (failures > 0)
+	{
+		printf("%d checks failed\n", failures);
+		return 1;
+	}
+	printf("All checks passed\n");
+	return 0;
+}
@@ -0,0 +1,67 @@
+// Stand-in for the parts of d3d11.h the state cache uses, so it can be built and tested without the Windows SDK.
+// The interfaces are empty types whose addresses are all the cache looks at. The device context ignores every call.
+#ifndef _STUB_D3D11_H_
+#define _STUB_D3D11_H_
+
+#include <cstddef>
+
+typedef unsigned int UINT;
+
+enum DXGI_FORMAT
+{
+	DXGI_FORMAT_UNKNOWN = 0,
+	DXGI_FORMAT_R32_UINT = 42,
+	DXGI_FORMAT_R16_UINT = 57
+};
+
+enum D3D11_PRIMITIVE_TOPOLOGY
+{
+	D3D11_PRIMITIVE_TOPOLOGY_UNDEFINED = 0,
+	D3D11_PRIMITIVE_TOPOLOGY_POINTLIST = 1,
+	D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST = 4,
+	D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP = 5,
+	D3D11_PRIMITIVE_TOPOLOGY_3_CONTROL_POINT_PATCHLIST = 35,
+	D3D11_PRIMITIVE_TOPOLOGY_4_CONTROL_POINT_PATCHLIST = 36
+};
+
+#define D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT 14
+#define D3D11_COMMONSHADER_INPUT_RESOURCE_SLOT_COUNT 128
+#define D3D11_COMMONSHADER_SAMPLER_SLOT_COUNT 16
+#define D3D11_IA_VERTEX_INPUT_RESOURCE_SLOT_COUNT 32
+
+struct ID3D11DeviceChild {};
+struct ID3D11Buffer : ID3D11DeviceChild {};
+struct ID3D11InputLayout : ID3D11DeviceChild {};
+struct ID3D11ShaderResourceView : ID3D11DeviceChild {};
+struct ID3D11SamplerState : ID3D11DeviceChild {};
+struct ID3D11VertexShader : ID3D11DeviceChild {};
+struct ID3D11HullShader : ID3D11DeviceChild {};
+struct ID3D11DomainShader : ID3D11DeviceChild {};
+struct ID3D11GeometryShader : ID3D11DeviceChild {};
+struct ID3D11PixelShader : ID3D11DeviceChild {};
+struct ID3D11ComputeShader : ID3D11DeviceChild {};
+struct ID3D11ClassInstance {};
+
+#define STUB_D3D11_STAGE(prefix, shaderType) \
+	void prefix##SetShader(shaderType*, ID3D11ClassInstance* const*, UINT) {} \
+	void prefix##SetConstantBuffers(UINT, UINT, ID3D11Buffer* const*) {} \
+	void prefix##SetShaderResources(UINT, UINT, ID3D11ShaderResourceView* const*) {} \
+	void prefix##SetSamplers(UINT, UINT, ID3D11SamplerState* const*) {}
+
+struct ID3D11DeviceContext
+{
+	void IASetInputLayout(ID3D11InputLayout*) {}
+	void IASetVertexBuffers(UINT, UINT, ID3D11Buffer* const*, const UINT*, const UINT*) {}
+	void IASetIndexBuffer(ID3D11Buffer*, DXGI_FORMAT, UINT) {}
+	void IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY) {}
+	STUB_D3D11_STAGE(VS, ID3D11VertexShader)
+	STUB_D3D11_STAGE(HS, ID3D11HullShader)
+	STUB_D3D11_STAGE(DS, ID3D11DomainShader)
+	STUB_D3D11_STAGE(GS, ID3D11GeometryShader)
+	STUB_D3D11_STAGE(PS, ID3D11PixelShader)
+	STUB_D3D11_STAGE(CS, ID3D11ComputeShader)
+};
+
+#undef STUB_D3D11_STAGE
+
+#endif
@@ -11,6 +11,8 @@
 #pragma once
 
 #include "BaseMesh.h"
+#include "ImportProfile.h"
+#include "MeshCache.h"
 #include "assimp\Importer.hpp"      // C++ importer interface
 #include "assimp\scene.h"           // Output data structure
 #include "assimp\postprocess.h"     // Post processing flags
@@ -23,22 +25,40 @@ class AModel : public BaseMesh
 public:
 	/** \brief Imports model and builds mesh representation.
 	*
-	* Loads a sub-set of model. Tested with single mesh FBX and OBJ. Currently does not auto load textures. 
+	* Loads a sub-set of model. Tested with FBX and OBJ. Currently does not auto load textures. 
+	* Each mesh in the file becomes a part (see getSubmesh()), which can be culled and drawn on its own.
+	* The imported mesh is cached next to the file (see MeshCache), later runs load that instead of running Assimp.
 	* @param device is the renderer device
 	* @param file path to model file
+	* @param quantise stores 16 byte vertices (see VertexQuantiser), draw it with a quantised shader and the decode matrix.
+	* @param keepCpuMesh keeps a read-only copy of the geometry after upload (see getCpuMesh()), otherwise it is freed.
+	* @param profile picks the Assimp post processing for this asset (see ImportProfile). The default computes only what VertexType holds.
 	*/
-	AModel(ID3D11Device* device, const std::string& file);
+	AModel(ID3D11Device* device, const std::string& file, bool quantise = false, bool keepCpuMesh = false, const ImportProfile& profile = ImportProfile());
+
+	/** \brief Imports the model without touching the GPU, so it can run on a worker thread (see AssetLoader).
+	* Call createBuffers() on the render thread before drawing it.
+	*/
+	AModel(const std::string& file, bool quantise = false, bool keepCpuMesh = false, const ImportProfile& profile = ImportProfile());
 	~AModel();
 
+	/// Creates the vertex and index buffers for a model imported without a device, then frees the CPU copy.
+	void createBuffers(ID3D11Device* device);
+
 protected:
 	void initBuffers(ID3D11Device* device);
 	void importModel(const std::string& pFile);
 	void modelProcessing(const aiScene* scene);
 
 	void processScene(const aiScene* scene);
-	void processNode(const aiNode* node, const aiScene* scene);
-	void processMesh(const aiMesh* mesh, const aiScene* scene);
+	void processNode(const aiNode* node, const aiScene* scene, const aiMatrix4x4& parentTransform);
+	void processMesh(const aiMesh* mesh, const aiScene* scene, const aiMatrix4x4& transform);
+	void cookSubmeshes();
+
 	ID3D11Device* device;
+	ImportProfile profile;
+	std::string file;
+	MeshCache cache;
 	std::vector<VertexType> vertices;
 	std::vector<unsigned long> indices;
 };
\ No newline at end of file
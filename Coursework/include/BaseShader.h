@@ -18,6 +18,10 @@
 #include <D3Dcompiler.h>
 #include <dxgi.h>
 #include <DirectXMath.h>
+#include "MeshletBuilder.h"
+#include "InstanceBuffer.h"
+#include "StateCache.h"
+#include <vector>
 #include <fstream>
 #include "imGUI/imgui.h"
 
@@ -52,15 +56,31 @@ public:
 
 	/** \Brief render function
 	* Sets shader stages and draws the indexed data
+	* startIndex selects a range of the index buffer, such as a mesh's level of detail (see BaseMesh::getLodIndexStart())
 	*/
-	virtual void render(ID3D11DeviceContext* deviceContext, int vertexCount);
+	virtual void render(ID3D11DeviceContext* deviceContext, int vertexCount, int startIndex = 0);
+	/// Sets the shader stages once and draws each index range with its base vertex, such as the meshlets left after BaseMesh::cullMeshlets() or the parts from cullSubmeshes().
+	void render(ID3D11DeviceContext* deviceContext, const std::vector<MeshletBuilder::RangeType>& ranges);
+	/// As above, for rangeCount ranges from an array, such as a RenderQueue packet's.
+	void render(ID3D11DeviceContext* deviceContext, const MeshletBuilder::RangeType* ranges, size_t rangeCount);
+	/// Draws instanceCount copies of the index range in one call, for shaders loaded with loadInstancedVertexShader(). Write the world matrices with InstanceBuffer::write() first.
+	void renderInstanced(ID3D11DeviceContext* deviceContext, int indexCount, int startIndex, int instanceCount);
+	/// Draws vertexCount vertices without an index buffer, such as a point list of particles streamed in each frame.
+	void renderVertices(ID3D11DeviceContext* deviceContext, int vertexCount, int startVertex = 0);
 	void compute(ID3D11DeviceContext* dc, int x, int y, int z);
 
 protected:
+	/// Sets the input layout and every shader stage for drawing.
+	void setShaders(ID3D11DeviceContext* deviceContext);
+
 	virtual void initShader(const wchar_t*, const wchar_t*) = 0;
 	void loadVertexShader(const wchar_t* filename);		///< Load Vertex shader, for stand position, tex, normal geomtry
+	void loadVertexShader(const wchar_t* filename, const D3D11_INPUT_ELEMENT_DESC* elements, UINT elementCount);	///< Load Vertex shader with any input layout, the others pass theirs to this
 	void loadColourVertexShader(const wchar_t* filename);		///< Load Vertex shader, pre-made for position and colour only
 	void loadTextureVertexShader(const wchar_t* filename);		///< Load Vertex shader, pre-made for position and tex only
+	void loadQuantisedVertexShader(const wchar_t* filename);	///< Load Vertex shader, for quantised position, tex, normal geometry (see VertexQuantiser)
+	void loadInstancedVertexShader(const wchar_t* filename);	///< Load Vertex shader, for position, tex, normal geometry plus a world matrix per instance (see InstanceBuffer)
+	void loadPointVertexShader(const wchar_t* filename);	///< Load Vertex shader, for points with a position and size only, such as particles
 	void loadHullShader(const wchar_t* filename);		///< Load Hull shader
 	void loadDomainShader(const wchar_t* filename);		///< Load Domain shader
 	void loadGeometryShader(const wchar_t* filename);	///< Load Geometry shader
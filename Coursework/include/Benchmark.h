@@ -0,0 +1,25 @@
+/**
+* \class Benchmark
+*
+* \brief Small helpers shared by the headless benchmarks
+*
+* Benchmarks are run from the command line ("-benchmark <name>") and write plain text tables.
+*/
+
+
+#ifndef _BENCHMARK_H_
+#define _BENCHMARK_H_
+
+#include <cstdio>
+
+class Benchmark
+{
+public:
+	/// Writes a printf style line to the report file and the debugger output.
+	static void report(FILE* out, const char* format, ...);
+
+	/// High resolution time in seconds, for measuring intervals.
+	static double seconds();
+};
+
+#endif
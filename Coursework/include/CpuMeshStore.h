@@ -0,0 +1,70 @@
+/**
+* \class CpuMeshStore
+*
+* \brief Shared, read-only CPU copies of mesh geometry for meshes that need it after upload
+*
+* Meshes release their vertex and index arrays once the GPU buffers exist. The few that need the geometry afterwards
+* (picking, physics, tighter culling bounds) opt in and get a compact copy from this store: positions only, welded on
+* position, with 16 bit indices where they fit. Copies are shared by key, so two meshes loaded from the same file hold
+* one copy, and are freed when the last mesh using them is deleted.
+*/
+
+
+#ifndef _CPUMESHSTORE_H_
+#define _CPUMESHSTORE_H_
+
+#include <directxmath.h>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using namespace DirectX;
+
+class CpuMeshStore
+{
+public:
+	/// Level 0 of a mesh, in model space. Indices are absolute, parts are already offset by their base vertex.
+	struct MeshType
+	{
+		std::vector<XMFLOAT3> positions;
+		std::vector<unsigned short> shortIndices;	///< Used when there are fewer than 65536 positions
+		std::vector<unsigned int> longIndices;		///< Used otherwise
+		XMFLOAT3 boundsMin;
+		XMFLOAT3 boundsMax;
+
+		size_t getIndexCount() const { return shortIndices.empty() ? longIndices.size() : shortIndices.size(); }
+		unsigned int getIndex(size_t i) const { return shortIndices.empty() ? longIndices[i] : shortIndices[i]; }
+		/// Memory held by the copy.
+		size_t getBytes() const;
+	};
+
+	/// Store shared by the framework meshes, created on first use.
+	static CpuMeshStore& shared();
+
+	/** \brief Returns the copy stored under key, building it first if there isn't one.
+	* @param key identifies the source, such as the file and how it was imported
+	* @param vertices holds vertexCount vertices, stride bytes apart, each starting with an XMFLOAT3 position
+	* @param indices holds indexCount absolute indices into vertices
+	*/
+	std::shared_ptr<const MeshType> acquire(const std::string& key, const void* vertices, unsigned long vertexCount, unsigned int stride, const unsigned long* indices, unsigned long indexCount);
+	/// Returns the copy stored under key, or null.
+	std::shared_ptr<const MeshType> find(const std::string& key);
+
+	/// Memory held by every live copy.
+	size_t getBytes();
+	/// Writes a line per live copy (positions, triangles, memory, users) and the total.
+	void report(FILE* out);
+
+private:
+	CpuMeshStore() {}
+	CpuMeshStore(const CpuMeshStore&);
+	CpuMeshStore& operator=(const CpuMeshStore&);
+
+	std::mutex mutex;
+	std::map<std::string, std::weak_ptr<const MeshType>> meshes;	///< Weak, the meshes using a copy own it
+};
+
+#endif
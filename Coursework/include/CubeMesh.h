@@ -4,6 +4,7 @@
 * \brief Simple cube mesh object
 *
 * Inherits from Base Mesh, Builds a simple cube with texture coordinates and normals.
+* Cubes of the same resolution share one pair of buffers, generated once per device (see PrimitiveShapes::fillCube()).
 *
 * \author Paul Robertson
 */
@@ -14,6 +14,7 @@
 //#include "D3D.h"
 #include "BaseApplication.h"
 #include "BaseShader.h"
+#include "AssetLoader.h"
 //#include "TextureManager.h"
 
 // Inlcude geometry headers
@@ -25,12 +26,16 @@
 #include "PointMesh.h"
 #include "QuadMesh.h"
 #include "SphereMesh.h"
+#include "TerrainMesh.h"
 #include "TessellationMesh.h"
 #include "TriangleMesh.h"
 #include "AModel.h"
 
 // Include additional rendering headers
 #include "Light.h"
+#include "RenderQueue.h"
+#include "InstanceBuffer.h"
+#include "StateCache.h"
 #include "RenderTexture.h"
 #include "ShadowMap.h"
 
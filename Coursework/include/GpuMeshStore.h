@@ -0,0 +1,67 @@
+/**
+* \class GpuMeshStore
+*
+* \brief Vertex and index buffers shared by every mesh of the same fixed shape on a device
+*
+* Primitive meshes (cubes, quads, triangles, points) hold the same geometry however many of them a scene creates. The first
+* mesh of a shape uploads it and offers its buffers here under a key; later meshes take the same buffers instead of creating
+* their own, so the scene holds one pair of buffers per shape. Every mesh keeps its own reference on the buffers and releases
+* it as usual, and an entry is forgotten when the last mesh using it is deleted.
+*/
+
+
+#ifndef _GPUMESHSTORE_H_
+#define _GPUMESHSTORE_H_
+
+#include <d3d11.h>
+#include <directxmath.h>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+
+using namespace DirectX;
+
+class GpuMeshStore
+{
+public:
+	/// Uploaded buffers and everything a mesh needs to draw them. The store doesn't hold a reference on the buffers.
+	struct BuffersType
+	{
+		ID3D11Buffer* vertexBuffer;
+		ID3D11Buffer* indexBuffer;
+		int vertexCount;
+		int indexCount;
+		unsigned int vertexStride;
+		DXGI_FORMAT indexFormat;
+		XMFLOAT3 boundsCentre;
+		float boundsRadius;
+		size_t vertexBufferBytes;
+		size_t indexBufferBytes;
+	};
+
+	/// Store shared by the framework meshes, created on first use.
+	static GpuMeshStore& shared();
+
+	/// Returns the buffers stored under key for a device, or null if no live mesh has offered them.
+	std::shared_ptr<const BuffersType> find(ID3D11Device* device, const std::string& key);
+	/// Stores buffers under key for a device. If another mesh got there first its buffers are returned instead, and the caller can drop its own.
+	std::shared_ptr<const BuffersType> add(ID3D11Device* device, const std::string& key, const BuffersType& buffers);
+
+	/// Writes a line per live shape (vertices, triangles, memory, users) and the memory saved by sharing.
+	void report(FILE* out);
+
+private:
+	GpuMeshStore() {}
+	GpuMeshStore(const GpuMeshStore&);
+	GpuMeshStore& operator=(const GpuMeshStore&);
+
+	typedef std::pair<ID3D11Device*, std::string> KeyType;
+
+	std::mutex mutex;
+	std::map<KeyType, std::weak_ptr<const BuffersType>> shapes;	///< Weak, the meshes using a shape own it
+};
+
+#endif
@@ -0,0 +1,95 @@
+/**
+* \class Heightmap
+*
+* \brief CPU copy of a height map image, sampled the way a linear, wrapping sampler would on the GPU
+*
+* Holds one height per pixel, from the red channel scaled to 0 to 1, which is what the shaders read from the texture.
+* Filled from the decoded image while it is loaded (see AssetLoader::loadTexture()), so the file is only decoded once.
+*
+* Also builds a min/max quadtree over the bilinear surface, so bounds and ray queries don't have to scan the pixels.
+* The leaves are the cells between four neighbouring texel centres (including the cells that wrap around the edges) and
+* are read straight from the heights. Every level above stores the lowest and highest height under each node as bytes,
+* which is exact for 8 bit images and adds about a third of a byte pair per pixel instead of doubling the float heights.
+*
+* Queries work in map space: x and z are texture coordinates from 0 to 1, y is height.
+*/
+
+
+#ifndef _HEIGHTMAP_H_
+#define _HEIGHTMAP_H_
+
+#include <directxmath.h>
+#include <cstdio>
+#include <vector>
+
+using namespace DirectX;
+
+class Heightmap
+{
+public:
+	Heightmap();
+
+	/// Takes the red channel of 32 bit RGBA pixels and builds the quadtree. Counts as a change, see getVersion().
+	void setPixels(const unsigned char* rgba, int width, int height);
+
+	bool empty() const { return heights.empty(); }
+	int getWidth() const { return width; }
+	int getHeight() const { return height; }
+	/// Goes up every time the heights change, so meshes built from the map can tell when to rebuild.
+	unsigned int getVersion() const { return version; }
+
+	/// Bilinear height at texture coordinates (u, v), wrapping at the edges. 0 if the map is empty.
+	float sample(float u, float v) const;
+
+	/** \brief Finds the lowest and highest height of the bilinear surface over a rectangle of texture coordinates.
+	* @param u0, v0, u1, v1 are opposite corners, clamped to 0 to 1
+	* @param lowest and highest receive the range, 0 to 1. Both are 0 if the map is empty.
+	*/
+	void getRange(float u0, float v0, float u1, float v1, float& lowest, float& highest) const;
+
+	/** \brief Finds where a ray first crosses the bilinear surface, scaled by amplitude, over texture coordinates 0 to 1.
+	* Only nodes whose box the ray passes through are visited, nearest first, and the leaves are solved exactly.
+	* @param origin and direction are in map space, with heights in amplitude units
+	* @param maxDistance limits the ray to origin + direction * maxDistance, so a segment is a ray with maxDistance 1
+	* @param distance receives how many directions along the ray the surface is
+	* @return false if the ray misses, or the map is empty
+	*/
+	bool intersect(const XMFLOAT3& origin, const XMFLOAT3& direction, float amplitude, float maxDistance, float& distance) const;
+
+	/// Memory held by the heights and the quadtree.
+	size_t getBytes() const;
+
+	/** \brief Loads every height map image in a directory and times building the quadtree, bounds queries and ray queries.
+	* Each query type is compared with scanning or marching the pixels, and the quadtree's memory is reported.
+	* @param directory is the folder to search, e.g. "res"
+	* @param report is an open file to write the results to
+	*/
+	static void benchmark(const char* directory, FILE* report);
+
+private:
+	/// One level of the quadtree. Node (x, z) covers 2^level leaves on each axis.
+	struct LevelType
+	{
+		int width;
+		int height;
+		std::vector<unsigned char> lowest;
+		std::vector<unsigned char> highest;
+	};
+
+	int getLevelWidth(int level) const { return level == 0 ? width + 1 : levels[level - 1].width; }
+	int getLevelHeight(int level) const { return level == 0 ? height + 1 : levels[level - 1].height; }
+	/// Height range under a node. Leaves are read from the four texels at their corners.
+	void getNodeRange(int level, int x, int z, float& lowest, float& highest) const;
+	void queryRange(int level, int x, int z, const int* leaves, float& lowest, float& highest) const;
+	void intersectNode(int level, int x, int z, const double* origin, const double* direction, float amplitude, double nearest, double farthest, double& hit) const;
+	/// Builds levels from the heights.
+	void buildQuadtree();
+
+	std::vector<float> heights;
+	int width;
+	int height;
+	unsigned int version;
+	std::vector<LevelType> levels;	///< Level 1 up to the single root node, level 0 (the leaves) isn't stored
+};
+
+#endif
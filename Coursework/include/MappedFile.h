@@ -0,0 +1,45 @@
+/**
+* \class Mapped File
+*
+* \brief Read-only memory mapped view of a file
+*
+* Maps a whole file into the address space so loaders can scan it in place, without copying it into a buffer first.
+* The view is released when the object is destroyed.
+*/
+
+
+#ifndef _MAPPEDFILE_H_
+#define _MAPPEDFILE_H_
+
+#include <windows.h>
+#include <cstddef>
+
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+
+	/** \brief Maps the file read-only.
+	* @param filename is the path to the file
+	* @return false if the file could not be opened or mapped. Empty files are opened but have no data.
+	*/
+	bool open(const char* filename);
+	void close();
+
+	const char* getData() const { return data; }	///< Start of the mapped view, null if nothing is mapped
+	size_t getSize() const { return size; }			///< Size of the mapped view in bytes
+	bool isOpen() const { return file != INVALID_HANDLE_VALUE; }
+
+private:
+	// Non-copyable, the handles are owned by this object.
+	MappedFile(const MappedFile&);
+	MappedFile& operator=(const MappedFile&);
+
+	HANDLE file;
+	HANDLE mapping;
+	const char* data;
+	size_t size;
+};
+
+#endif
@@ -0,0 +1,98 @@
+/**
+* \class Mesh Cache
+*
+* \brief Versioned binary cache of imported (cooked) mesh data
+*
+* The first time a model file is imported, its final vertex and index arrays are written next to it as "<file>.<import flags>.mesh",
+* the flags in hex. Each importer and import profile of a file gets its own cooked copy, so loading it more than one way doesn't
+* overwrite the others'.
+* Later loads memory map that file and hand the streams straight to the buffer upload, skipping the importer.
+* A cache file is only used if it matches the format version, a hash of the source file, the import flags and the vertex stride.
+*
+* File layout: header, bounds, level of detail table, meshlet table, part table, per part level table, vertex stream, index stream. Streams start on 16 byte boundaries.
+*/
+
+
+#ifndef _MESHCACHE_H_
+#define _MESHCACHE_H_
+
+#include "BaseMesh.h"
+#include "MappedFile.h"
+#include "MeshletBuilder.h"
+#include "MeshSimplifier.h"
+#include <string>
+
+class MeshCache
+{
+public:
+	MeshCache();
+	~MeshCache();
+
+	/** \brief Hashes the source file and maps its cooked mesh, if there is an up to date one.
+	* @param sourceFile is the path to the model file
+	* @param importFlags identifies how the source was imported, a different value invalidates the cache
+	* @param vertexStride is the size of the vertex struct the caller expects
+	* @return true if the cooked mesh was mapped. If false, call write() once the mesh has been imported.
+	*/
+	bool open(const char* sourceFile, unsigned int importFlags, unsigned int vertexStride);
+	void close();
+
+	/// Writes the cooked mesh for the source passed to open(). Failure to write isn't an error, the mesh just isn't cached.
+	/// The indices may hold several levels of detail, described by lods (see MeshSimplifier), and level 0 may be split into meshlets (see MeshletBuilder).
+	/// A mesh made of parts also passes the part table and the range of each part at each level (submeshCount * lodCount entries, level by level).
+	bool write(const void* vertices, unsigned int vertexCount, const unsigned long* indices, unsigned int indexCount, const MeshSimplifier::LodType* lods = nullptr, unsigned int lodCount = 0,
+		const MeshletBuilder::MeshletType* meshlets = nullptr, unsigned int meshletCount = 0,
+		const BaseMesh::SubmeshType* submeshes = nullptr, unsigned int submeshCount = 0, const MeshSimplifier::LodType* submeshLods = nullptr);
+
+	const void* getVertices() const;
+	const unsigned long* getIndices() const;
+	unsigned int getVertexCount() const;
+	unsigned int getIndexCount() const;
+	const MeshSimplifier::LodType* getLods() const;
+	unsigned int getLodCount() const;		///< Zero if the indices are a single level
+	const MeshletBuilder::MeshletType* getMeshlets() const;
+	unsigned int getMeshletCount() const;	///< Zero if the mesh wasn't split into meshlets
+	const BaseMesh::SubmeshType* getSubmeshes() const;
+	unsigned int getSubmeshCount() const;	///< Zero if the mesh is a single part
+	const MeshSimplifier::LodType* getSubmeshLods() const;	///< getSubmeshCount() * getLodCount() entries
+	const float* getBoundsMin() const;		///< Smallest x, y, z of the vertex positions
+	const float* getBoundsMax() const;		///< Largest x, y, z of the vertex positions
+
+	/// Path of the cooked copy of sourceFile imported with importFlags.
+	static std::string getCachePath(const char* sourceFile, unsigned int importFlags);
+
+private:
+	/// Bump when the file layout or the contents any loader writes change, to invalidate existing caches.
+	static const unsigned int version = 6;
+
+	struct HeaderType
+	{
+		char magic[4];
+		unsigned int version;
+		unsigned long long sourceHash;
+		unsigned int importFlags;
+		unsigned int vertexStride;
+		unsigned int vertexCount;
+		unsigned int indexSize;
+		unsigned int indexCount;
+		unsigned int vertexOffset;
+		unsigned int indexOffset;
+		unsigned int lodCount;
+		unsigned int meshletCount;
+		unsigned int submeshCount;
+		float boundsMin[3];
+		float boundsMax[3];
+	};
+
+	MeshCache(const MeshCache&);
+	MeshCache& operator=(const MeshCache&);
+
+	MappedFile file;
+	const HeaderType* header;
+	std::string cachePath;
+	unsigned long long sourceHash;
+	unsigned int importFlags;
+	unsigned int vertexStride;
+};
+
+#endif
@@ -0,0 +1,51 @@
+/**
+* \class Mesh Optimiser
+*
+* \brief Reorders indexed triangle lists for the GPU
+*
+* Run at import time, before a mesh is uploaded or cooked. Three passes, in order:
+* - Vertex cache: Forsyth's linear-speed triangle reordering, so neighbouring triangles reuse transformed vertices.
+* - Overdraw: splits the result into clusters where the cache restarts and draws the outward facing clusters first, so early-Z rejects more of the rest.
+* - Vertex fetch: renumbers vertices in the order they are first used, so vertex reads walk through memory.
+*
+* Vertices are treated as opaque blocks of stride bytes, with the position in the first three floats.
+*/
+
+
+#ifndef _MESHOPTIMISER_H_
+#define _MESHOPTIMISER_H_
+
+#include <cstdio>
+
+class MeshOptimiser
+{
+public:
+	/// Post-transform cache statistics for an index buffer.
+	struct StatsType
+	{
+		float acmr;		///< Average cache miss ratio, vertex shader runs per triangle (0.5 is ideal, 3 is worst)
+		float atvr;		///< Average transform to vertex ratio, vertex shader runs per vertex (1 is ideal)
+	};
+
+	/** \brief Runs all three passes.
+	* @param vertices is the vertex array, reordered in place
+	* @param vertexCount is the number of vertices
+	* @param stride is the size of one vertex in bytes
+	* @param indices is the triangle list, reordered and renumbered in place
+	* @param indexCount is the number of indices
+	* @return the new vertex count, smaller if some vertices weren't referenced
+	*/
+	static unsigned long optimise(void* vertices, unsigned long vertexCount, unsigned int stride, unsigned long* indices, unsigned long indexCount);
+
+	static void optimiseVertexCache(unsigned long* indices, unsigned long indexCount, unsigned long vertexCount);
+	static void optimiseOverdraw(unsigned long* indices, unsigned long indexCount, const void* vertices, unsigned long vertexCount, unsigned int stride);
+	static unsigned long optimiseVertexFetch(void* vertices, unsigned long vertexCount, unsigned int stride, unsigned long* indices, unsigned long indexCount);
+
+	/// Simulates a FIFO post-transform cache of cacheSize entries over the index buffer.
+	static StatsType analyse(const unsigned long* indices, unsigned long indexCount, unsigned long vertexCount, unsigned int cacheSize = 16);
+
+	/// Reports ACMR/ATVR before and after optimisation for every .obj file in a directory.
+	static void benchmark(const char* directory, FILE* report);
+};
+
+#endif
@@ -0,0 +1,75 @@
+/**
+* \class Meshlet Builder
+*
+* \brief Splits indexed triangle lists into small clusters (meshlets) that can be culled on the CPU
+*
+* Each meshlet has at most 64 vertices and 124 triangles, grown from neighbouring triangles so it stays compact.
+* The builder reorders the triangles so every meshlet is one contiguous range of the index buffer, drawn with a single DrawIndexed.
+* Every meshlet stores a bounding sphere for frustum culling and a normal cone for backface culling.
+*
+* Vertices are treated as opaque blocks of stride bytes, with the position in the first three floats.
+*/
+
+
+#ifndef _MESHLETBUILDER_H_
+#define _MESHLETBUILDER_H_
+
+#include <directxmath.h>
+#include <cstdio>
+#include <vector>
+
+using namespace DirectX;
+
+class MeshletBuilder
+{
+public:
+	static const unsigned int maxVertices = 64;
+	static const unsigned int maxTriangles = 124;
+
+	/// One cluster of triangles, a range of the index buffer.
+	struct MeshletType
+	{
+		unsigned int indexStart;
+		unsigned int indexCount;
+		float centre[3];			///< Bounding sphere, in model space
+		float radius;
+		float coneApex[3];			///< Normal cone. Every triangle faces away from a viewer inside the cone behind the apex.
+		float coneCutoff;			///< Sine of the cone's half angle, 1 if the triangles face too many ways to cull
+		float coneAxis[3];
+		unsigned int vertexCount;
+	};
+
+	/// A range of the index buffer to draw, visible meshlets next to each other are merged into one.
+	struct RangeType
+	{
+		unsigned int indexStart;
+		unsigned int indexCount;
+		int baseVertex;				///< Added to every index, for meshes made of parts
+	};
+
+	/** \brief Reorders a triangle list into meshlets.
+	* @param vertices is the vertex array, which isn't changed
+	* @param vertexCount is the number of vertices
+	* @param stride is the size of one vertex in bytes
+	* @param indices is the triangle list, reordered in place so each meshlet is contiguous
+	* @param indexCount is the number of indices
+	* @param meshlets receives the meshlets, in index buffer order
+	*/
+	static void build(const void* vertices, unsigned long vertexCount, unsigned int stride, unsigned long* indices, unsigned long indexCount, std::vector<MeshletType>& meshlets);
+
+	/** \brief Finds the meshlets that may be visible and appends their index ranges.
+	* @param planes are the six frustum planes in model space, (a, b, c, d) with the inside where ax + by + cz + d >= 0
+	* @param viewer is the eye position in model space with w = 1, or for orthographic views the view direction with w = 0
+	* @param displacementY covers vertex shader displacement along model space y, between 0 and this. Disables cone culling, the normals aren't known.
+	* @param ranges receives the index ranges to draw
+	* @param baseVertex is stored in the ranges, for the meshlets of one part of a mesh
+	* @return the number of meshlets that passed
+	*/
+	static unsigned int cull(const MeshletType* meshlets, unsigned int meshletCount, const XMFLOAT4* planes, const XMFLOAT4& viewer, float displacementY, std::vector<RangeType>& ranges,
+		int baseVertex = 0);
+
+	/// Builds the meshlets of every .obj in directory and writes their sizes, build times and how many each axis view culls to the report.
+	static void benchmark(const char* directory, FILE* report);
+};
+
+#endif
@@ -14,6 +14,8 @@
 #define _MODEL_H_
 
 #include "BaseMesh.h"
+#include "MeshCache.h"
+#include "ObjParser.h"
 //#include "TokenStream.h"
 #include <vector>
 #include <fstream>
@@ -22,28 +24,42 @@ using namespace DirectX;
 
 class Model : public BaseMesh
 {
-	struct ModelType
-	{
-		float x, y, z;
-		float tu, tv;
-		float nx, ny, nz;
-	};
+	typedef ObjParser::VertexType ModelType;
 
 public:
 	/** \brief Initialises the mesh and vertex list, but loading in from a file
 	* Provide filename to OBJ object, will be loaded and store like other mesh objects.
+	* The processed mesh is cached next to the file (see MeshCache) and reused while the file is unchanged.
 	* @param device is the renderer device
 	* @param device context is the renderer device context
 	* @param filename is a char* for filename.
+	* @param quantise stores 16 byte vertices (see VertexQuantiser), draw it with a quantised shader and the decode matrix.
+	* @param keepCpuMesh keeps a read-only copy of the geometry after upload (see getCpuMesh()), otherwise it is freed.
 	*/
-	Model(ID3D11Device* device, ID3D11DeviceContext* deviceContext, const char* filename);
+	Model(ID3D11Device* device, ID3D11DeviceContext* deviceContext, const char* filename, bool quantise = false, bool keepCpuMesh = false);
+
+	/** \brief Loads and cooks the mesh without touching the GPU, so it can run on a worker thread (see AssetLoader).
+	* Call createBuffers() on the render thread before drawing it.
+	*/
+	Model(const char* filename, bool quantise = false, bool keepCpuMesh = false);
 	~Model();
 
+	/// Creates the vertex and index buffers for a model loaded without a device, then frees the CPU copy.
+	void createBuffers(ID3D11Device* device);
+
 protected:
 	void initBuffers(ID3D11Device* device);
+	void load(const char* filename);
 	void loadModel(const char* filename);
-	
-	ModelType* model;
+	void cookModel();
+
+	static const unsigned int importFlags;
+
+	std::vector<ModelType> model;
+	std::vector<VertexType> vertices;
+	std::vector<unsigned long> indices;
+	std::string file;
+	MeshCache cache;
 };
 
 #endif
\ No newline at end of file
@@ -5,7 +5,7 @@
 *
 * Inherits from Base Mesh, Builds a simple plane with texture coordinates and normals.
 * Provided resolution values deteremines the subdivisions of the plane.
-* Builds a plane from unit quads.
+* Builds a plane from unit quads, on a resolution x resolution grid of vertices shared by the neighbouring quads.
 *
 * \author Paul Robertson
 */
@@ -15,24 +15,48 @@
 #define _PLANEMESH_H_
 
 #include "BaseMesh.h"
+#include <cstdio>
 
 class PlaneMesh : public BaseMesh
 {
 
 public:
+	/// How the index buffer lists the triangles.
+	enum LayoutType
+	{
+		LayoutList,		///< Triangle list, split into meshlets for culling
+		LayoutStrip,	///< One triangle strip per row, separated by restart indices. Fewer indices, but no meshlets.
+	};
+
 	/** \brief Initialises and builds a plane mesh
 	*
 	* Can specify resolution of plane, this deteremines how many subdivisions of the plane.
 	* @param device is the renderer device
 	* @param device context is the renderer device context
-	* @param resolution is a int for subdivision of the plane. The number of unit quad on each axis. Default is 100.
+	* @param resolution is a int for subdivision of the plane. The number of vertices on each axis, one more than the number of unit quads. Default is 100.
+	* @param layout is the index layout, see LayoutType. Indices are 16 bit whenever the vertex count allows.
 	*/
-	PlaneMesh(ID3D11Device* device, ID3D11DeviceContext* deviceContext, int resolution = 100);
+	PlaneMesh(ID3D11Device* device, ID3D11DeviceContext* deviceContext, int resolution = 100, LayoutType layout = LayoutList);
 	~PlaneMesh();
 
+	/// Sends the buffers, switching the default triangle list to a strip for LayoutStrip.
+	void sendData(ID3D11DeviceContext* deviceContext, D3D_PRIMITIVE_TOPOLOGY top = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST) override;
+
+	/// Number of indices writeIndices() writes for a plane of resolution x resolution vertices.
+	static unsigned long getIndexCount(int resolution, LayoutType layout);
+	/// Writes the index buffer for a plane of resolution x resolution vertices, laid out as VertexGenerator::writeGrid() writes them.
+	static void writeIndices(unsigned long* indices, int resolution, LayoutType layout);
+
+	/** \brief Checks the planes against the generator that wrote six vertices per quad, for resolutions 2 to 100 in both layouts.
+	* Flags any resolution whose triangles, their winding or their texture coordinates differ.
+	* @param report is an open file to write the results to
+	*/
+	static void benchmark(FILE* report);
+
 protected:
 	void initBuffers(ID3D11Device* device);
 	int resolution;
+	LayoutType layout;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,107 @@
+/**
+* \class TerrainMesh
+*
+* \brief Height mapped terrain split into square tiles, each drawn at its own level of detail (geomipmapping)
+*
+* The terrain is a grid of tiles of tileSize x tileSize quads. Every tile has its own vertices in one vertex buffer, and all
+* tiles share one index buffer holding every level of detail of a tile: level n skips 2^n - 1 vertices between the ones it
+* uses, down to two triangles per tile. Each level also draws a skirt hanging down from the tile's edges, deep enough to
+* hide the gaps where neighbouring tiles use different levels, so no stitching variants are needed.
+*
+* The heights and smooth normals are baked into the vertex buffer on the CPU. update() only does work when something changed:
+* a new height map is resampled, a new amplitude only rescales the stored samples and recomputes the normals (four vertices
+* at a time with SSE2). select() culls the tiles against a view with boxes around their heights and picks each visible tile's
+* level from how far its error projects on screen, so distant and off screen terrain costs little in every pass.
+*
+* Height, bounds and ray queries go to the height map's min/max quadtree, scaled into model space. They follow the bilinear
+* height map, which the drawn surface matches at every vertex.
+*
+* Tiles are also the mesh's parts (see BaseMesh::SubmeshType), so cullSubmeshes() draws every visible tile at one level.
+*/
+
+
+#ifndef _TERRAINMESH_H_
+#define _TERRAINMESH_H_
+
+#include "BaseMesh.h"
+#include "Heightmap.h"
+#include <vector>
+
+class TerrainMesh : public BaseMesh
+{
+public:
+	/** \brief Builds a flat terrain, displaced by the first update().
+	* @param resolution sets the size, as for PlaneMesh: the terrain covers 0 to resolution - 1 on x and z, with texture coordinates of position / resolution
+	* @param tileSize is the number of quads along a tile's edge, rounded up to a power of two
+	* @param tiles is the number of tiles along each axis, 0 for enough to give about one quad per unit. More tiles sample a large height map more finely.
+	*/
+	TerrainMesh(ID3D11Device* device, ID3D11DeviceContext* deviceContext, int resolution = 100, int tileSize = 16, int tiles = 0);
+	~TerrainMesh();
+
+	/** \brief Displaces the terrain by heightmap * amplitude if either changed since the last call.
+	* @return true if the vertex buffer was rewritten
+	*/
+	bool update(ID3D11DeviceContext* deviceContext, const Heightmap& heightmap, float amplitude);
+
+	/** \brief Culls the tiles against a view and appends an index range for each visible tile, at the coarsest level whose error stays under pixelError pixels.
+	* Works for the camera and for light views, perspective or orthographic.
+	* @param world, view and projection are the matrices the terrain will be drawn with
+	* @param viewportHeight is the height of the render target in pixels
+	* @param pixelError is the largest acceptable error in pixels
+	* @param ranges receives the index ranges, draw them with the shader's render()
+	* @return the number of tiles that passed
+	*/
+	int select(const XMMATRIX& world, const XMMATRIX& view, const XMMATRIX& projection, float viewportHeight, float pixelError, std::vector<MeshletBuilder::RangeType>& ranges);
+
+	/** \brief Height of the surface at model space (x, z), from the height map the terrain was last built from.
+	* @return false outside the terrain, or before the first update()
+	*/
+	bool getHeight(float x, float z, float& height);
+
+	/** \brief Box around the surface over a model space rectangle, from the height map's quadtree.
+	* @param x0, z0, x1, z1 are opposite corners, clipped to the terrain
+	* @return false if the rectangle is outside the terrain, or before the first update()
+	*/
+	bool getBounds(float x0, float z0, float x1, float z1, XMFLOAT3& minimum, XMFLOAT3& maximum);
+
+	/** \brief Finds where a model space ray first meets the surface, see Heightmap::intersect().
+	* @param maxDistance limits the ray to origin + direction * maxDistance, 1 for a segment from origin to origin + direction
+	* @param distance receives how many directions along the ray the surface is
+	* @return false if the ray misses the terrain, or before the first update()
+	*/
+	bool intersect(const XMFLOAT3& origin, const XMFLOAT3& direction, float maxDistance, float& distance);
+
+	int getTileCount() { return tiles * tiles; }		///< Number of tiles in the terrain
+	int getRebuildCount() { return rebuildCount; }		///< Number of times the vertex buffer has been rewritten
+	double getRebuildTime() { return rebuildTime; }		///< Seconds the last rewrite took on the CPU
+
+protected:
+	void initBuffers(ID3D11Device* device);
+	/// Measures how far each level of each tile is from the full grid, in height map units. Needs the samples.
+	void measureErrors();
+	/// Writes the normals of the whole grid from the sampled heights.
+	void buildNormals(float amplitude);
+	/// Writes the vertices of every tile, including the skirts, and updates the tiles' bounds.
+	void buildVertices(VertexType* vertices, float amplitude);
+
+	int resolution;
+	int tileSize;
+	int tiles;
+	int gridSize;						///< Vertices along each axis of the whole terrain, tiles * tileSize + 1
+	float spacing;						///< Distance between neighbouring vertices
+	int levels;							///< Levels of detail of a tile
+	int tileVertexCount;				///< Grid and skirt vertices of one tile
+
+	std::vector<float> samples;			///< Height map value at every grid vertex, 0 to 1
+	std::vector<XMFLOAT3> normals;		///< Normal at every grid vertex
+	std::vector<float> tileErrors;		///< Error of every level of every tile in height map units, tile by tile
+	std::vector<float> tileLowest;		///< Lowest and highest sample in each tile
+	std::vector<float> tileHighest;
+	const Heightmap* sampledMap;
+	unsigned int sampledVersion;
+	float builtAmplitude;
+	int rebuildCount;
+	double rebuildTime;
+};
+
+#endif
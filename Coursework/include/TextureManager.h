@@ -26,6 +26,8 @@ public:
 	~TextureManager();
 
 	void loadTexture(const wchar_t* uid, const wchar_t* filename);
+	// Store a texture created elsewhere (such as by AssetLoader) under uid. The manager takes the reference.
+	void addTexture(const wchar_t* uid, ID3D11ShaderResourceView* texture);
 	ID3D11ShaderResourceView* getTexture(const wchar_t* uid);
 
 private:
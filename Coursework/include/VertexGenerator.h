@@ -0,0 +1,52 @@
+/**
+* \class VertexGenerator
+*
+* \brief Writes the vertices of grid and cube sphere meshes a row at a time, four vertices per step with SSE2
+*
+* Meshes whose resolution is only known at runtime (PlaneMesh, the water's tessellation plane, TerrainMesh, SphereMesh)
+* used to write one XMFLOAT3 at a time. These kernels work out the positions, texture coordinates and normals of four
+* vertices at once as separate x, y, z, u and v lanes, then transpose them into the interleaved vertex layout and store
+* each vertex as two 16 byte writes. Builds without SSE2 run the same rows one vertex at a time.
+*
+* Both paths do the same arithmetic in the same order as the loops they replaced, so the vertices are bit for bit the same.
+* Vertices use PrimitiveShapes::VertexType, which matches BaseMesh::VertexType.
+*/
+
+
+#ifndef _VERTEXGENERATOR_H_
+#define _VERTEXGENERATOR_H_
+
+#include "PrimitiveShapes.h"
+#include <directxmath.h>
+#include <cstdio>
+
+using namespace DirectX;
+
+class VertexGenerator
+{
+public:
+	/** \brief Writes a row of grid vertices along x, starting at grid column first.
+	* Vertex k is at ((first + k) * step, height, z) with texture coordinates ((first + k) * uvStep, v).
+	* @param heights gives each vertex's height as heights[k] * amplitude, null for a flat row at height 0
+	* @param normals gives each vertex's normal, null for straight up
+	*/
+	static void writeGridRow(PrimitiveShapes::VertexType* vertices, int count, int first, float step, float uvStep, float z, float v,
+		const float* heights = nullptr, float amplitude = 0.0f, const XMFLOAT3* normals = nullptr);
+
+	/** \brief Writes a flat grid of columns x rows vertices, row by row along x, as PlaneMesh lays it out.
+	* Vertex (i, j) is at (i * spacing, 0, j * spacing) with texture coordinates (i, j) * uvStep, facing up.
+	*/
+	static void writeGrid(PrimitiveShapes::VertexType* vertices, int columns, int rows, float spacing, float uvStep);
+
+	/** \brief Writes row y of a cube sphere face with resolution quads along each edge, resolution + 1 vertices.
+	* Vertex x has texture coordinates (x, y) / resolution. Its position is the face's cube point bent onto the unit sphere, and its normal is the same.
+	*/
+	static void writeSphereRow(PrimitiveShapes::VertexType* vertices, const PrimitiveShapes::FaceType& face, int y, int resolution);
+
+	/** \brief Times the kernels against the one vertex at a time loops they replaced, for grids and spheres up to 1024 x 1024.
+	* @param report is an open file to write the results to
+	*/
+	static void benchmark(FILE* report);
+};
+
+#endif
@@ -0,0 +1,33 @@
+/**
+* \class Vertex Welder
+*
+* \brief Merges duplicate vertices and builds an index buffer
+*
+* Takes an unindexed vertex list (three corners per triangle, or four per patch) and hashes each vertex, so corners
+* sharing the same position, texture coordinate and normal are stored once and referenced through the index buffer.
+* Vertices are compared bytewise, so any vertex struct can be welded.
+*/
+
+
+#ifndef _VERTEXWELDER_H_
+#define _VERTEXWELDER_H_
+
+class VertexWelder
+{
+public:
+	/** \brief Welds an unindexed vertex list.
+	* Unique vertices keep their first-seen order. weldedVertices may be the same array as vertices, it is compacted in place.
+	* @param vertices is the unindexed vertex list
+	* @param vertexCount is the number of vertices in the list
+	* @param stride is the size of one vertex in bytes, a multiple of 4
+	* @param weldedVertices receives the unique vertices, room for vertexCount vertices
+	* @param indices receives one index per input vertex
+	* @return the number of unique vertices
+	*/
+	static unsigned long weld(const void* vertices, unsigned long vertexCount, unsigned int stride, void* weldedVertices, unsigned long* indices);
+
+	/// Writes the before and after vertex counts for a mesh to the debug output.
+	static void report(const char* meshName, unsigned long before, unsigned long after);
+};
+
+#endif
@@ -0,0 +1,53 @@
+/**
+* \class Worker Pool
+*
+* \brief Fixed set of worker threads that run queued tasks
+*
+* Used for CPU heavy loading work such as parsing large model files in chunks.
+* parallelFor() runs a loop body across the workers and the calling thread and returns once every iteration has finished.
+*/
+
+
+#ifndef _WORKERPOOL_H_
+#define _WORKERPOOL_H_
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class WorkerPool
+{
+public:
+	/// Starts threadCount workers. Zero uses one less than the number of hardware threads, as the caller also does work.
+	WorkerPool(unsigned int threadCount = 0);
+	~WorkerPool();
+
+	/// Queues a task to run on a worker thread.
+	void run(const std::function<void()>& task);
+
+	/// Calls body(i) for i in [0, count), spread over the workers and this thread. Blocks until all calls have returned, then rethrows the first exception a call threw, if any.
+	void parallelFor(int count, const std::function<void(int)>& body);
+
+	unsigned int getThreadCount() const { return (unsigned int)workers.size(); }
+
+	/// Pool shared by the framework loaders, created on first use.
+	static WorkerPool& shared();
+
+private:
+	WorkerPool(const WorkerPool&);
+	WorkerPool& operator=(const WorkerPool&);
+
+	void workerLoop();
+	bool tryRunTask();
+
+	std::vector<std::thread> workers;
+	std::deque<std::function<void()>> tasks;
+	std::mutex taskMutex;
+	std::condition_variable taskAvailable;
+	bool stopping;
+};
+
+#endif